@@ -0,0 +1,405 @@
+// Global header files.
+#include "tools.h"
+
+// PARDISO parameters are shared, each worker has its own handle.
+#include "pardiso_param.h"
+#include "pardiso.h"
+#include "mkl_service.h"
+
+// Elliptic solver headers.
+#include "general_elliptic_csr_gen.h"
+#include "stencil_csr_gen.h"
+#include "elliptic_tools.h"
+#include "grid_map.h"
+#include "solver_stats.h"
+#include "batch.h"
+
+// BATCH DEFAULTS.
+// Reduced grid points per thread of a single solve when picking threads
+// automatically: a 128 x 128 grid gets one thread.
+#define BATCH_POINTS_PER_THREAD 16384
+
+// Batched solves for parameter scans.
+//
+// All jobs share the grid, order and boundary conditions, so the matrix
+// pattern is the same for every job: each worker analyses it once and then
+// only needs numerical factorization and back substitution per job.
+// Workers take the next job from a shared counter, so fast workers keep
+// taking jobs while slow ones finish theirs and the load evens out without
+// a static partition.
+//
+// A worker with two or more threads pipelines its jobs: while PARDISO
+// factors and solves job k with the remaining threads, one thread reduces
+// the arrays of job k + 1 and assembles its matrix into a second buffer.
+// Small grids get one thread per worker and more workers, large grids fewer
+// workers with more threads each, so the total never exceeds the available
+// threads.
+
+// Worker state: PARDISO handle and two matrix/RHS buffers.
+typedef struct batch_workers
+{
+	void *pt[64];
+	int iparm[64];
+	int analysed;
+	csr_matrix A[2];
+	double *g_f[2];
+	double *g_u;
+	double *g_res;
+	double *g_a, *g_b, *g_c, *g_d, *g_e, *g_s;
+} batch_worker;
+
+// Batch-wide problem.
+typedef struct batch_problems
+{
+	int robin;
+	int r_sym;
+	int z_sym;
+	int NrInterior;
+	int NzInterior;
+	int ghost;
+	double dr;
+	double dz;
+	int norder;
+	int tabled;
+	int nnz;
+} batch_problem;
+
+// Reduce the arrays of a job and assemble its matrix and RHS into buffer b.
+// A rejected order or Robin type is left in the job status.
+static void batch_assemble(batch_worker *w, const int b, batch_job *job, const batch_problem *p)
+{
+	double t0 = omp_get_wtime();
+
+	ghost_reduce(job->ell_a, w->g_a, p->NrInterior, p->NzInterior, p->ghost);
+	ghost_reduce(job->ell_b, w->g_b, p->NrInterior, p->NzInterior, p->ghost);
+	ghost_reduce(job->ell_c, w->g_c, p->NrInterior, p->NzInterior, p->ghost);
+	ghost_reduce(job->ell_d, w->g_d, p->NrInterior, p->NzInterior, p->ghost);
+	ghost_reduce(job->ell_e, w->g_e, p->NrInterior, p->NzInterior, p->ghost);
+	ghost_reduce(job->ell_s, w->g_s, p->NrInterior, p->NzInterior, p->ghost);
+	ghost_reduce(job->ell_f, w->g_f[b], p->NrInterior, p->NzInterior, p->ghost);
+	job->stats.t_reduce = omp_get_wtime() - t0;
+
+	t0 = omp_get_wtime();
+	if (p->tabled)
+		csr_gen_stencil(w->A[b], p->NrInterior, p->NzInterior, p->norder, p->dr, p->dz,
+			w->g_a, w->g_b, w->g_c, w->g_d, w->g_e, w->g_s, w->g_f[b], job->uInf, p->robin, p->r_sym, p->z_sym);
+	else
+		job->stats.status = csr_gen_general_elliptic(w->A[b], p->NrInterior, p->NzInterior, p->norder, p->dr, p->dz,
+			w->g_a, w->g_b, w->g_c, w->g_d, w->g_e, w->g_s, w->g_f[b], job->uInf, p->robin, p->r_sym, p->z_sym);
+	job->stats.t_assemble = omp_get_wtime() - t0;
+
+	return;
+}
+
+// Release the PARDISO handle of a worker: the next job analyses again.
+static void batch_release(batch_worker *w, int nrows)
+{
+	int i, w_phase = -1, w_error = 0, w_idum = 0;
+	double w_ddum = 0.0;
+
+	if (w->analysed)
+		pardiso(w->pt, &maxfct, &mnum, &mtype, &w_phase,
+			&nrows, &w_ddum, w->A[0].ia, w->A[0].ja, &w_idum, &nrhs,
+			w->iparm, &msglvl, &w_ddum, &w_ddum, &w_error);
+	for (i = 0; i < 64; i++)
+		w->pt[i] = 0;
+	w->analysed = 0;
+
+	return;
+}
+
+// Factor and solve buffer b with nthreads MKL threads: the pattern is
+// analysed by the first job of the worker only. A failed phase releases the
+// handle and returns its status code.
+static int batch_factor_solve(batch_worker *w, const int b, batch_job *job, const int nthreads)
+{
+	int nrows = w->A[b].nrows;
+	int w_phase, w_error = 0, w_idum = 0;
+	double w_ddum = 0.0;
+	double t0 = omp_get_wtime();
+
+	// Nothing to factor if the assembly failed.
+	if (job->stats.status != ELL_SUCCESS)
+		return job->stats.status;
+
+	int prev = mkl_set_num_threads_local(nthreads);
+
+	job->stats.t_analyse = 0.0;
+	if (!w->analysed)
+	{
+		w_phase = 11;
+		pardiso(w->pt, &maxfct, &mnum, &mtype, &w_phase,
+			&nrows, w->A[b].a, w->A[b].ia, w->A[b].ja, &w_idum, &nrhs,
+			w->iparm, &msglvl, &w_ddum, &w_ddum, &w_error);
+		w->analysed = 1;
+		if (w_error != 0)
+		{
+			printf("BATCH: ERROR during symbolic factorization: %d.\n", w_error);
+			mkl_set_num_threads_local(prev);
+			batch_release(w, nrows);
+			return ELL_ERROR_ANALYSIS;
+		}
+		job->stats.t_analyse = omp_get_wtime() - t0;
+	}
+
+	t0 = omp_get_wtime();
+	w_phase = 22;
+	pardiso(w->pt, &maxfct, &mnum, &mtype, &w_phase,
+		&nrows, w->A[b].a, w->A[b].ia, w->A[b].ja, &w_idum, &nrhs,
+		w->iparm, &msglvl, &w_ddum, &w_ddum, &w_error);
+	if (w_error != 0)
+	{
+		printf("BATCH: ERROR during numerical factorization: %d.\n", w_error);
+		mkl_set_num_threads_local(prev);
+		batch_release(w, nrows);
+		return ELL_ERROR_FACTOR;
+	}
+	job->stats.t_factor = omp_get_wtime() - t0;
+
+	t0 = omp_get_wtime();
+	w_phase = 33;
+	pardiso(w->pt, &maxfct, &mnum, &mtype, &w_phase,
+		&nrows, w->A[b].a, w->A[b].ia, w->A[b].ja, &w_idum, &nrhs,
+		w->iparm, &msglvl, w->g_f[b], w->g_u, &w_error);
+	if (w_error != 0)
+	{
+		printf("BATCH: ERROR during solution: %d,\n", w_error);
+		mkl_set_num_threads_local(prev);
+		batch_release(w, nrows);
+		return ELL_ERROR_SOLVE;
+	}
+	job->stats.t_solve = omp_get_wtime() - t0;
+
+	job->stats.perturbed_pivots = w->iparm[14 - 1];
+	job->stats.mem_peak_analysis = w->iparm[15 - 1];
+	job->stats.mem_permanent = w->iparm[16 - 1];
+	job->stats.mem_factor = w->iparm[17 - 1];
+	job->stats.factor_nnz = w->iparm[18 - 1];
+	job->stats.factor_mflops = w->iparm[19 - 1];
+	job->stats.refinement_steps = w->iparm[7 - 1];
+
+	mkl_set_num_threads_local(prev);
+
+	return ELL_SUCCESS;
+}
+
+// Residual, transfer to the job arrays and statistics of buffer b. A failed
+// job keeps its solution and residual arrays.
+static void batch_finish(batch_worker *w, const int b, batch_job *job, const batch_problem *p, const int status)
+{
+	struct matrix_descr descrA;
+	sparse_matrix_t csrA;
+	csr_matrix A = w->A[b];
+	double t0 = omp_get_wtime();
+
+	job->stats.solver = "general_batch";
+	job->stats.NrInterior = p->NrInterior;
+	job->stats.NzInterior = p->NzInterior;
+	job->stats.order = p->norder;
+	job->stats.robin = p->robin;
+	job->stats.nnz = A.nnz;
+	job->stats.status = status;
+	if (status != ELL_SUCCESS)
+	{
+		job->stats.convergence = 0;
+		return;
+	}
+
+	// r = f - A u.
+	mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, A.nrows, A.ncols, A.ia, A.ia + 1, A.ja, A.a);
+	descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
+	mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, -1.0, csrA, descrA, w->g_u, 0.0, w->g_res);
+	mkl_sparse_destroy(csrA);
+	cblas_daxpy(A.nrows, 1.0, w->g_f[b], 1, w->g_res, 1);
+	double res = cblas_dnrm2(A.nrows, w->g_res, 1);
+	double res0 = res / cblas_dnrm2(A.nrows, w->g_f[b], 1);
+	job->stats.t_residual = omp_get_wtime() - t0;
+
+	t0 = omp_get_wtime();
+	ghost_fill(w->g_u, job->u, p->r_sym, p->z_sym, p->NrInterior, p->NzInterior, p->ghost);
+	ghost_fill(w->g_res, job->res, p->r_sym, p->z_sym, p->NrInterior, p->NzInterior, p->ghost);
+	job->stats.t_fill = omp_get_wtime() - t0;
+
+	// Same tolerance as general_elliptic.
+	double tol = (p->norder == 6) ? p->dr * p->dr * p->dr * p->dz * p->dz * p->dz
+		: (p->norder == 4) ? p->dr * p->dr * p->dz * p->dz : p->dr * p->dz;
+
+	job->stats.abs_residual = res;
+	job->stats.rel_residual = res0;
+	job->stats.convergence = (res0 < tol);
+
+	return;
+}
+
+int batch_solve(batch_job *jobs,	// Job queue.
+	const int njobs,		// Number of jobs.
+	const int robin,		// Robin BC type: 1, 2, 3.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym,		// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const int ghost_zones,		// Number of ghost zones.
+	const double dr,		// Spatial step in r.
+	const double dz,		// Spatial step in z.
+	const int norder,		// Finite difference order: 2, 4 or 6.
+	const int nworkers,		// Concurrent solves, 0 for automatic.
+	const int threads_per_worker,	// Threads per solve, 0 for automatic.
+	double *throughput)		// Output solves per second, may be NULL.
+{
+	double t_start = omp_get_wtime();
+	int NrTotal = NrInterior + 2;
+	int NzTotal = NzInterior + 2;
+	int DIM0 = NrTotal * NzTotal;
+	int k;
+
+	if (throughput)
+		*throughput = 0.0;
+	if (njobs <= 0)
+		return 0;
+
+	// Batch-wide problem and generator.
+	batch_problem p;
+	p.robin = robin;
+	p.r_sym = r_sym;
+	p.z_sym = z_sym;
+	p.NrInterior = NrInterior;
+	p.NzInterior = NzInterior;
+	p.ghost = ghost_zones;
+	p.dr = dr;
+	p.dz = dz;
+	p.norder = norder;
+	p.tabled = (norder == 6 || grid_map_active());
+	p.nnz = p.tabled ? nnz_stencil(NrInterior, NzInterior, norder, robin, 1)
+		: nnz_general_elliptic(NrInterior, NzInterior, norder, robin);
+
+	// Threads per worker from the grid size, workers from the threads left.
+	int max_threads = omp_get_max_threads();
+	int tpw = threads_per_worker;
+	if (tpw <= 0)
+		tpw = MIN(MAX(DIM0 / BATCH_POINTS_PER_THREAD, 1), max_threads);
+	int nw = nworkers;
+	if (nw <= 0)
+		nw = MAX(max_threads / tpw, 1);
+	nw = MIN(nw, njobs);
+	printf("BATCH: %d jobs on %d workers with %d threads each.\n", njobs, nw, tpw);
+
+	// Workers and their nested regions: a worker's own parallel loops run
+	// on one thread, the pipeline is a nested team of two.
+	int prev_levels = omp_get_max_active_levels();
+	omp_set_max_active_levels(2);
+	int next = 0;
+
+	#pragma omp parallel num_threads(nw)
+	{
+		batch_worker w;
+		int b, cur, nxt, i, status = ELL_SUCCESS;
+
+		omp_set_num_threads(1);
+
+		// Handle with the global fine-tuning for direct solves.
+		for (i = 0; i < 64; i++)
+		{
+			w.iparm[i] = iparm[i];
+			w.pt[i] = 0;
+		}
+		w.iparm[4 - 1] = 0;	// No iterative-direct algorithm.
+		w.iparm[5 - 1] = 0;	// No user fill-in reducing permutation.
+		w.iparm[39 - 1] = 0;	// No low rank update.
+		if (tpw == 1)
+			w.iparm[2 - 1] = 2;	// Sequential fill-in reordering from METIS.
+		w.analysed = 0;
+
+		for (b = 0; b < 2; b++)
+		{
+			csr_allocate(&w.A[b], DIM0, DIM0, p.nnz);
+			w.g_f[b] = (double *)malloc(DIM0 * sizeof(double));
+		}
+		w.g_u = (double *)malloc(DIM0 * sizeof(double));
+		w.g_res = (double *)malloc(DIM0 * sizeof(double));
+		w.g_a = (double *)malloc(DIM0 * sizeof(double));
+		w.g_b = (double *)malloc(DIM0 * sizeof(double));
+		w.g_c = (double *)malloc(DIM0 * sizeof(double));
+		w.g_d = (double *)malloc(DIM0 * sizeof(double));
+		w.g_e = (double *)malloc(DIM0 * sizeof(double));
+		w.g_s = (double *)malloc(DIM0 * sizeof(double));
+
+		// First job.
+		#pragma omp atomic capture
+		cur = next++;
+		b = 0;
+		if (cur < njobs)
+		{
+			solver_stats_reset(&jobs[cur].stats);
+			jobs[cur].stats.t_total = omp_get_wtime();
+			batch_assemble(&w, b, &jobs[cur], &p);
+		}
+
+		while (cur < njobs)
+		{
+			#pragma omp atomic capture
+			nxt = next++;
+			if (nxt < njobs)
+			{
+				solver_stats_reset(&jobs[nxt].stats);
+				jobs[nxt].stats.t_total = omp_get_wtime();
+			}
+
+			// Factor job cur while assembling job nxt into the other buffer.
+			if (tpw > 1 && nxt < njobs)
+			{
+				#pragma omp parallel sections num_threads(2)
+				{
+					#pragma omp section
+					status = batch_factor_solve(&w, b, &jobs[cur], tpw - 1);
+					#pragma omp section
+					batch_assemble(&w, 1 - b, &jobs[nxt], &p);
+				}
+			}
+			else
+			{
+				status = batch_factor_solve(&w, b, &jobs[cur], tpw);
+				if (nxt < njobs)
+					batch_assemble(&w, 1 - b, &jobs[nxt], &p);
+			}
+
+			batch_finish(&w, b, &jobs[cur], &p, status);
+			jobs[cur].stats.t_total = omp_get_wtime() - jobs[cur].stats.t_total;
+
+			cur = nxt;
+			b = 1 - b;
+		}
+
+		// Release worker memory.
+		batch_release(&w, DIM0);
+		for (b = 0; b < 2; b++)
+		{
+			csr_deallocate(&w.A[b]);
+			free(w.g_f[b]);
+		}
+		free(w.g_u);
+		free(w.g_res);
+		free(w.g_a);
+		free(w.g_b);
+		free(w.g_c);
+		free(w.g_d);
+		free(w.g_e);
+		free(w.g_s);
+	}
+
+	omp_set_max_active_levels(prev_levels);
+
+	// Throughput.
+	double t_total = omp_get_wtime() - t_start;
+	int nconverged = 0, nfailed = 0;
+	for (k = 0; k < njobs; k++)
+	{
+		nconverged += jobs[k].stats.convergence;
+		nfailed += (jobs[k].stats.status != ELL_SUCCESS);
+	}
+	printf("BATCH: %d solves (%d converged, %d failed) in %3.3E seconds: %3.3E solves per second.\n",
+		njobs, nconverged, nfailed, t_total, (double)njobs / t_total);
+	if (throughput)
+		*throughput = (double)njobs / t_total;
+
+	return nfailed;
+}
@@ -0,0 +1,42 @@
+// Independent general elliptic problem of a batch: coefficients, source and
+// RHS on the full grid with ghost zones, output solution and residual.
+// Jobs may share input arrays.
+typedef struct batch_jobs
+{
+	// Input.
+	const double *ell_a;	// Coefficient of (d^2/dr^2)
+	const double *ell_b;	// Coefficient of (d^2/drdz)
+	const double *ell_c;	// Coefficient of (d^2/dz^2)
+	const double *ell_d;	// Coefficient of (d/dr)
+	const double *ell_e;	// Coefficient of (d/dz)
+	const double *ell_s;	// Linear source.
+	const double *ell_f;	// RHS.
+	double uInf;		// u value at infinity for Robin BC.
+	// Output.
+	double *u;		// Solution.
+	double *res;		// Residual.
+	solver_stats stats;	// Per-job statistics.
+} batch_job;
+
+// Solve a queue of independent general elliptic problems on the same grid
+// and boundary conditions concurrently: nworkers workers, each with its own
+// PARDISO handle and threads_per_worker threads, take jobs from the queue
+// until it is empty. Zero nworkers or threads_per_worker picks them from the
+// grid size and the available threads. Requires pardiso_start.
+// A job whose PARDISO phase fails gets the status code in its statistics and
+// keeps its solution; the other jobs go on. Returns the number of failed
+// jobs, and the aggregate throughput in solves per second in throughput.
+int batch_solve(batch_job *jobs,	// Job queue.
+	const int njobs,		// Number of jobs.
+	const int robin,		// Robin BC type: 1, 2, 3.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym,		// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const int ghost_zones,		// Number of ghost zones.
+	const double dr,		// Spatial step in r.
+	const double dz,		// Spatial step in z.
+	const int norder,		// Finite difference order: 2, 4 or 6.
+	const int nworkers,		// Concurrent solves, 0 for automatic.
+	const int threads_per_worker,	// Threads per solve, 0 for automatic.
+	double *throughput);		// Output solves per second, may be NULL.
@@ -0,0 +1,1084 @@
+// Global headers and variables.
+#include "tools.h"
+
+// PARDISO tools.
+#include "pardiso_param.h"
+#include "pardiso.h"
+#include "pardiso_start.h"
+#include "pardiso_stop.h"
+#include "low_rank.h"
+
+// Kernels to benchmark.
+#include "elliptic_tools.h"
+#include "flat_laplacian_csr_gen.h"
+#include "general_elliptic_csr_gen.h"
+
+// Per-phase thread counts.
+#include "thread_profile.h"
+
+// MKL version for machine fingerprints.
+#include "mkl_service.h"
+#include <errno.h>
+
+// BENCHMARK DEFAULTS.
+#define BENCH_NMIN 32
+#define BENCH_NMAX 2048
+#define BENCH_REPS 10
+#define BENCH_WARMUP 2
+#define BENCH_MAX_REPS 1000
+#define BENCH_PROFILE "thread_profile.txt"
+
+// REGRESSION DEFAULTS.
+// Baseline files inside the baseline directory.
+#define BENCH_BASELINE_CSV "baseline.csv"
+#define BENCH_BASELINE_JSON "fingerprint.json"
+#define BENCH_COMPARE_CSV "compare.csv"
+// Relative slowdown of the median that counts as a regression.
+#define BENCH_SLOWDOWN 0.10
+// The slowdown must also exceed this many combined standard deviations,
+// estimated from the median absolute deviations of both runs.
+#define BENCH_NOISE 3.0
+// Length of names and fingerprint fields.
+#define BENCH_NAME 64
+#define BENCH_FIELD 256
+
+// Compiler of this build for machine fingerprints.
+#if defined(__INTEL_COMPILER)
+#define BENCH_COMPILER "intel " __VERSION__
+#elif defined(__GNUC__)
+#define BENCH_COMPILER "gnu " __VERSION__
+#else
+#define BENCH_COMPILER "unknown"
+#endif
+
+// Benchmark context: every kernel reads and writes these arrays.
+typedef struct bench_contexts
+{
+	// Grid parameters.
+	int NrInterior;
+	int NzInterior;
+	int ghost;
+	int order;
+	int robin;
+	double dr;
+	double dz;
+	// Full grid arrays of size NrTotal * NzTotal.
+	double *u;
+	// Reduced arrays of size (NrInterior + 2) * (NzInterior + 2).
+	double *g_u;
+	double *g_a;
+	double *g_b;
+	double *g_c;
+	double *g_d;
+	double *g_e;
+	double *g_s;
+	double *g_f;
+	double *g_f0;
+	double *g_res;
+	// CSR matrices.
+	csr_matrix A_flat;
+	csr_matrix A_general;
+} bench_context;
+
+// Kernel and preparation function type: preparation is not timed.
+typedef void (*bench_kernel)(bench_context *ctx);
+
+// Timing of one kernel in one configuration.
+typedef struct bench_results
+{
+	char name[BENCH_NAME];
+	int NrInterior;
+	int NzInterior;
+	int order;
+	int robin;
+	int threads;
+	int reps;
+	double median;
+	double p95;
+	double tmin;
+	double mean;
+	double mad;		// Median absolute deviation of the samples.
+} bench_result;
+
+// Results recorded by bench_run for baselines and comparisons.
+static bench_result *bench_log = NULL;
+static int bench_nlog = 0;
+static int bench_maxlog = 0;
+static int bench_record = 0;
+
+// Sort doubles in ascending order.
+static int bench_compare(const void *p, const void *q)
+{
+	double x = *(const double *)p;
+	double y = *(const double *)q;
+
+	return (x > y) - (x < y);
+}
+
+// Run kernel with warm-up and repetitions, then print wall-clock statistics.
+//
+// Bytes and flops are per call and are used to derive GB/s and GFLOP/s from
+// the median time. A zero value prints a dash. Returns the median time.
+// While recording, the statistics are also appended to the result log.
+static double bench_run(const char *name,	// Kernel name.
+	bench_kernel kernel,		// Timed kernel.
+	bench_kernel prep,		// Untimed preparation before each call, may be NULL.
+	bench_context *ctx,		// Kernel context.
+	const int reps,			// Number of timed repetitions.
+	const int warmup,		// Number of untimed warm-up calls.
+	const double bytes,		// Bytes moved per call.
+	const double flops)		// Floating point operations per call.
+{
+	// Wall-clock samples.
+	double samples[BENCH_MAX_REPS];
+	double t0, median, p95, tmin, mean;
+	int k;
+
+	// Warm-up: touch pages and populate caches.
+	for (k = 0; k < warmup; k++)
+	{
+		if (prep)
+			prep(ctx);
+		kernel(ctx);
+	}
+
+	// Timed repetitions.
+	for (k = 0; k < reps; k++)
+	{
+		if (prep)
+			prep(ctx);
+		t0 = omp_get_wtime();
+		kernel(ctx);
+		samples[k] = omp_get_wtime() - t0;
+	}
+
+	// Order statistics: p95 is nearest-rank.
+	qsort(samples, reps, sizeof(double), bench_compare);
+	median = (reps % 2) ? samples[reps / 2] : 0.5 * (samples[reps / 2 - 1] + samples[reps / 2]);
+	p95 = samples[(int)ceil(0.95 * reps) - 1];
+	tmin = samples[0];
+	mean = 0.0;
+	for (k = 0; k < reps; k++)
+		mean += samples[k];
+	mean /= (double)reps;
+
+	// Median absolute deviation: robust spread for regression thresholds.
+	double deviations[BENCH_MAX_REPS];
+	for (k = 0; k < reps; k++)
+		deviations[k] = fabs(samples[k] - median);
+	qsort(deviations, reps, sizeof(double), bench_compare);
+	double mad = (reps % 2) ? deviations[reps / 2] : 0.5 * (deviations[reps / 2 - 1] + deviations[reps / 2]);
+
+	if (bench_record)
+	{
+		if (bench_nlog == bench_maxlog)
+		{
+			bench_maxlog = (bench_maxlog > 0) ? 2 * bench_maxlog : 64;
+			bench_log = (bench_result *)realloc(bench_log, bench_maxlog * sizeof(bench_result));
+		}
+		bench_result *result = &bench_log[bench_nlog++];
+		snprintf(result->name, BENCH_NAME, "%s", name);
+		result->NrInterior = ctx->NrInterior;
+		result->NzInterior = ctx->NzInterior;
+		result->order = ctx->order;
+		result->robin = ctx->robin;
+		result->threads = omp_get_max_threads();
+		result->reps = reps;
+		result->median = median;
+		result->p95 = p95;
+		result->tmin = tmin;
+		result->mean = mean;
+		result->mad = mad;
+	}
+
+	printf("%-26s %5d %5d %2d %2d %3d  %10.4E %10.4E %10.4E %10.4E ",
+		name, ctx->NrInterior, ctx->NzInterior, ctx->order, ctx->robin, omp_get_max_threads(),
+		median, p95, tmin, mean);
+	if (bytes > 0.0)
+		printf("%9.3f ", 1.0E-9 * bytes / median);
+	else
+		printf("%9s ", "-");
+	if (flops > 0.0)
+		printf("%9.3f\n", 1.0E-9 * flops / median);
+	else
+		printf("%9s\n", "-");
+	fflush(stdout);
+
+	return median;
+}
+
+// KERNELS.
+//
+// Ghost zone reduction and fill.
+static void bench_ghost_reduce(bench_context *ctx)
+{
+	ghost_reduce(ctx->u, ctx->g_u, ctx->NrInterior, ctx->NzInterior, ctx->ghost);
+}
+static void bench_ghost_fill(bench_context *ctx)
+{
+	ghost_fill(ctx->g_u, ctx->u, 1, 1, ctx->NrInterior, ctx->NzInterior, ctx->ghost);
+}
+
+// Generators scale the RHS in place: restore it before each call.
+static void bench_restore_rhs(bench_context *ctx)
+{
+	memcpy(ctx->g_f, ctx->g_f0, (ctx->NrInterior + 2) * (ctx->NzInterior + 2) * sizeof(double));
+}
+static void bench_csr_gen_flat_laplacian(bench_context *ctx)
+{
+	csr_gen_flat_laplacian(ctx->A_flat, ctx->NrInterior, ctx->NzInterior, ctx->order, ctx->dr, ctx->dz,
+		ctx->g_s, ctx->g_f, 1.0, ctx->robin, 1, 1);
+}
+static void bench_csr_gen_general_elliptic(bench_context *ctx)
+{
+	csr_gen_general_elliptic(ctx->A_general, ctx->NrInterior, ctx->NzInterior, ctx->order, ctx->dr, ctx->dz,
+		ctx->g_a, ctx->g_b, ctx->g_c, ctx->g_d, ctx->g_e, ctx->g_s, ctx->g_f, 1.0, ctx->robin, 1, 1);
+}
+
+// Low rank diff arrays: release before each call.
+static void bench_low_rank_flat_prep(bench_context *ctx)
+{
+	low_rank_deallocate();
+	low_rank_allocate(ndiff_flat_laplacian(ctx->NrInterior, ctx->NzInterior));
+}
+static void bench_low_rank_general_prep(bench_context *ctx)
+{
+	low_rank_deallocate();
+	low_rank_allocate(ndiff_general_elliptic(ctx->NrInterior, ctx->NzInterior, ctx->order));
+}
+static void bench_low_rank_flat_laplacian(bench_context *ctx)
+{
+	low_rank_flat_laplacian(ctx->NrInterior, ctx->NzInterior);
+}
+static void bench_low_rank_general_elliptic(bench_context *ctx)
+{
+	low_rank_general_elliptic(ctx->NrInterior, ctx->NzInterior, ctx->order);
+}
+
+// Residual r = f - Au exactly as computed in pardiso_wrapper.
+static void bench_residual(bench_context *ctx)
+{
+	csr_matrix A = ctx->A_general;
+	struct matrix_descr descrA;
+	sparse_matrix_t csrA;
+
+	mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, A.nrows, A.ncols, A.ia, A.ia + 1, A.ja, A.a);
+	descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
+	mkl_sparse_optimize(csrA);
+	mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, -1.0, csrA, descrA, ctx->g_u, 0.0, ctx->g_res);
+	cblas_daxpy(A.nrows, 1.0, ctx->g_f, 1, ctx->g_res, 1);
+	mkl_sparse_destroy(csrA);
+}
+
+// PARDISO phases on the general elliptic matrix.
+static void bench_pardiso_phase(bench_context *ctx, const int p)
+{
+	csr_matrix A = ctx->A_general;
+
+	phase = p;
+	if (p == 33)
+	{
+		pardiso(pt, &maxfct, &mnum, &mtype, &phase,
+			&n, A.a, A.ia, A.ja, perm, &nrhs,
+			iparm, &msglvl, ctx->g_f, ctx->g_u, &error);
+	}
+	else
+	{
+		pardiso(pt, &maxfct, &mnum, &mtype, &phase,
+			&n, A.a, A.ia, A.ja, perm, &nrhs,
+			iparm, &msglvl, &ddum, &ddum, &error);
+	}
+
+	if (error != 0)
+	{
+		printf("ELLBENCH: ERROR! PARDISO phase %d returned %d.\n", p, error);
+		exit(1);
+	}
+}
+static void bench_pardiso_analyse(bench_context *ctx)
+{
+	bench_pardiso_phase(ctx, 11);
+}
+static void bench_pardiso_factor(bench_context *ctx)
+{
+	bench_pardiso_phase(ctx, 22);
+}
+static void bench_pardiso_solve(bench_context *ctx)
+{
+	bench_pardiso_phase(ctx, 33);
+}
+
+// Allocate and fill benchmark context for a single grid size, order and Robin type.
+static void bench_setup(bench_context *p_ctx, const int N, const int order, const int robin)
+{
+	bench_context ctx;
+	int i, j, k;
+	double r, z;
+
+	// Grid parameters: fixed [0, 10] x [0, 10] domain.
+	ctx.NrInterior = N;
+	ctx.NzInterior = N;
+	ctx.ghost = (order == 2) ? 2 : 3;
+	ctx.order = order;
+	ctx.robin = robin;
+	ctx.dr = 10.0 / (double)N;
+	ctx.dz = 10.0 / (double)N;
+
+	int NrTotal = ctx.ghost + N + 1;
+	int NzTotal = ctx.ghost + N + 1;
+	int g_dim = (N + 2) * (N + 2);
+	size_t g_size = g_dim * sizeof(double);
+
+	// Allocate arrays.
+	ctx.u = (double *)malloc(NrTotal * NzTotal * sizeof(double));
+	ctx.g_u = (double *)malloc(g_size);
+	ctx.g_a = (double *)malloc(g_size);
+	ctx.g_b = (double *)malloc(g_size);
+	ctx.g_c = (double *)malloc(g_size);
+	ctx.g_d = (double *)malloc(g_size);
+	ctx.g_e = (double *)malloc(g_size);
+	ctx.g_s = (double *)malloc(g_size);
+	ctx.g_f = (double *)malloc(g_size);
+	ctx.g_f0 = (double *)malloc(g_size);
+	ctx.g_res = (double *)malloc(g_size);
+
+	// Deterministic inputs: same coefficients as the C main program.
+	#pragma omp parallel for schedule(static) private(j)
+	for (i = 0; i < NrTotal; i++)
+	{
+		for (j = 0; j < NzTotal; j++)
+		{
+			ctx.u[IDX(i, j)] = 0.0;
+		}
+	}
+	#pragma omp parallel for schedule(static) private(j, k, r, z)
+	for (i = 0; i < N + 2; i++)
+	{
+		r = ((double)i - 0.5) * ctx.dr;
+		for (j = 0; j < N + 2; j++)
+		{
+			z = ((double)j - 0.5) * ctx.dz;
+			k = i * (N + 2) + j;
+			ctx.g_u[k] = 0.0;
+			ctx.g_res[k] = 0.0;
+			ctx.g_a[k] = r;
+			ctx.g_b[k] = 0.0;
+			ctx.g_c[k] = r;
+			ctx.g_d[k] = 1.0;
+			ctx.g_e[k] = 0.0;
+			ctx.g_s[k] = r * exp(-r * r - z * z) * (0.5 + r * r * (-3.0 + r * r + z * z));
+			ctx.g_f0[k] = exp(-r * r - z * z);
+			ctx.g_f[k] = ctx.g_f0[k];
+		}
+	}
+
+	// Allocate CSR matrices.
+	int nnz_flat = nnz_flat_laplacian(N, N, order, robin);
+	int nnz_general = nnz_general_elliptic(N, N, order, robin);
+	csr_allocate(&ctx.A_flat, g_dim, g_dim, nnz_flat);
+	csr_allocate(&ctx.A_general, g_dim, g_dim, nnz_general);
+
+	*p_ctx = ctx;
+
+	return;
+}
+
+// Release benchmark context.
+static void bench_teardown(bench_context *ctx)
+{
+	csr_deallocate(&ctx->A_flat);
+	csr_deallocate(&ctx->A_general);
+	free(ctx->u);
+	free(ctx->g_u);
+	free(ctx->g_a);
+	free(ctx->g_b);
+	free(ctx->g_c);
+	free(ctx->g_d);
+	free(ctx->g_e);
+	free(ctx->g_s);
+	free(ctx->g_f);
+	free(ctx->g_f0);
+	free(ctx->g_res);
+
+	return;
+}
+
+// Benchmark all kernels for a single grid size, order and Robin type.
+static void bench_configuration(const int N, const int order, const int robin, const int reps, const int warmup)
+{
+	bench_context ctx;
+	bench_setup(&ctx, N, order, robin);
+
+	int g_dim = (N + 2) * (N + 2);
+	int nnz_flat = ctx.A_flat.nnz;
+	int nnz_general = ctx.A_general.nnz;
+
+	// Per-call traffic estimates.
+	double grid_bytes = 2.0 * sizeof(double) * (double)g_dim;
+	double csr_flat_bytes = (sizeof(double) + sizeof(int)) * (double)nnz_flat
+		+ sizeof(int) * (double)(g_dim + 1) + 3.0 * sizeof(double) * (double)g_dim;
+	double csr_general_bytes = (sizeof(double) + sizeof(int)) * (double)nnz_general
+		+ sizeof(int) * (double)(g_dim + 1) + 8.0 * sizeof(double) * (double)g_dim;
+	double lr_flat_bytes = sizeof(int) * (2.0 * ndiff_flat_laplacian(N, N) + 1.0);
+	double lr_general_bytes = sizeof(int) * (2.0 * ndiff_general_elliptic(N, N, order) + 1.0);
+	double spmv_bytes = (sizeof(double) + sizeof(int)) * (double)nnz_general
+		+ sizeof(int) * (double)(g_dim + 1) + 5.0 * sizeof(double) * (double)g_dim;
+	double spmv_flops = 2.0 * (double)nnz_general + 2.0 * (double)g_dim;
+
+	// Ghost zones.
+	bench_run("ghost_reduce", bench_ghost_reduce, NULL, &ctx, reps, warmup, grid_bytes, 0.0);
+	bench_run("ghost_fill", bench_ghost_fill, NULL, &ctx, reps, warmup, grid_bytes, 0.0);
+
+	// CSR generators.
+	bench_run("csr_gen_flat_laplacian", bench_csr_gen_flat_laplacian, bench_restore_rhs, &ctx, reps, warmup, csr_flat_bytes, 0.0);
+	bench_run("csr_gen_general_elliptic", bench_csr_gen_general_elliptic, bench_restore_rhs, &ctx, reps, warmup, csr_general_bytes, 0.0);
+
+	// Low rank diff arrays.
+	bench_run("low_rank_flat_laplacian", bench_low_rank_flat_laplacian, bench_low_rank_flat_prep, &ctx, reps, warmup, lr_flat_bytes, 0.0);
+	bench_run("low_rank_general_elliptic", bench_low_rank_general_elliptic, bench_low_rank_general_prep, &ctx, reps, warmup, lr_general_bytes, 0.0);
+	low_rank_deallocate();
+
+	// PARDISO phases on the general matrix with a fresh RHS.
+	bench_restore_rhs(&ctx);
+	csr_gen_general_elliptic(ctx.A_general, N, N, order, ctx.dr, ctx.dz,
+		ctx.g_a, ctx.g_b, ctx.g_c, ctx.g_d, ctx.g_e, ctx.g_s, ctx.g_f, 1.0, robin, 1, 1);
+	pardiso_start(N, N);
+	bench_run("pardiso_analyse", bench_pardiso_analyse, NULL, &ctx, reps, warmup, 0.0, 0.0);
+	// Factorization statistics are only known after analysis.
+	double factor_flops = 1.0E6 * (double)iparm[19 - 1];
+	double factor_nnz = (double)iparm[18 - 1];
+	bench_run("pardiso_factor", bench_pardiso_factor, NULL, &ctx, reps, warmup, 0.0, factor_flops);
+	bench_run("pardiso_solve", bench_pardiso_solve, NULL, &ctx, reps, warmup,
+		(sizeof(double) + sizeof(int)) * factor_nnz, 2.0 * factor_nnz);
+
+	// Residual SpMV on the solution.
+	bench_run("residual_spmv", bench_residual, NULL, &ctx, reps, warmup, spmv_bytes, spmv_flops);
+	pardiso_stop();
+
+	// Clean up.
+	bench_teardown(&ctx);
+
+	return;
+}
+
+// Time one phase kernel for thread counts 1, 2, 4, ... up to the number of
+// available threads and store the fastest count in the thread profile.
+static void bench_tune_phase(const int phase_id, bench_kernel kernel, bench_kernel prep, bench_context *ctx,
+	const int reps, const int warmup)
+{
+	int max_threads = omp_get_max_threads();
+	int best_threads = 1;
+	double best = 0.0, t;
+	int nthreads;
+
+	for (nthreads = 1; ; nthreads = (2 * nthreads < max_threads) ? 2 * nthreads : max_threads)
+	{
+		thread_profile_set(phase_id, nthreads);
+		thread_phase_begin(phase_id);
+		t = bench_run(thread_phase_name(phase_id), kernel, prep, ctx, reps, warmup, 0.0, 0.0);
+		thread_phase_end();
+
+		if (nthreads == 1 || t < best)
+		{
+			best = t;
+			best_threads = nthreads;
+		}
+
+		if (nthreads == max_threads)
+			break;
+	}
+
+	thread_profile_set(phase_id, best_threads);
+	printf("ELLBENCH: Phase %s tuned to %d threads.\n", thread_phase_name(phase_id), best_threads);
+
+	return;
+}
+
+// Tune per-phase thread counts for a single configuration and save the profile.
+//
+// Phases are tuned in solver order on the general elliptic matrix since
+// PARDISO factorization and solve require a previous analysis.
+static void bench_tune(const int N, const int order, const int robin, const int reps, const int warmup, const char *fname)
+{
+	bench_context ctx;
+	bench_setup(&ctx, N, order, robin);
+	thread_profile_clear();
+
+	bench_tune_phase(PHASE_REDUCE, bench_ghost_reduce, NULL, &ctx, reps, warmup);
+	bench_tune_phase(PHASE_ASSEMBLE, bench_csr_gen_general_elliptic, bench_restore_rhs, &ctx, reps, warmup);
+
+	// PARDISO phases with a fresh RHS.
+	bench_restore_rhs(&ctx);
+	csr_gen_general_elliptic(ctx.A_general, N, N, order, ctx.dr, ctx.dz,
+		ctx.g_a, ctx.g_b, ctx.g_c, ctx.g_d, ctx.g_e, ctx.g_s, ctx.g_f, 1.0, robin, 1, 1);
+	pardiso_start(N, N);
+	bench_tune_phase(PHASE_ANALYSE, bench_pardiso_analyse, NULL, &ctx, reps, warmup);
+	bench_tune_phase(PHASE_FACTOR, bench_pardiso_factor, NULL, &ctx, reps, warmup);
+	bench_tune_phase(PHASE_SOLVE, bench_pardiso_solve, NULL, &ctx, reps, warmup);
+	bench_tune_phase(PHASE_RESIDUAL, bench_residual, NULL, &ctx, reps, warmup);
+	pardiso_stop();
+
+	bench_tune_phase(PHASE_FILL, bench_ghost_fill, NULL, &ctx, reps, warmup);
+
+	if (thread_profile_save(fname, N, N, order) == 0)
+		printf("ELLBENCH: Thread profile written to %s.\n", fname);
+
+	bench_teardown(&ctx);
+
+	return;
+}
+
+// Machine fingerprint stored with a baseline.
+typedef struct bench_fingerprints
+{
+	char host[BENCH_FIELD];
+	char cpu[BENCH_FIELD];
+	char compiler[BENCH_FIELD];
+	char mkl[BENCH_FIELD];
+	int nprocs;
+	int threads;
+} bench_fingerprint;
+
+// Fingerprint of the current machine and build.
+static void bench_fingerprint_get(bench_fingerprint *fp)
+{
+	char line[BENCH_FIELD];
+	char *p;
+	FILE *fcpu;
+
+	memset(fp, 0, sizeof(bench_fingerprint));
+	if (gethostname(fp->host, BENCH_FIELD - 1) != 0)
+		snprintf(fp->host, BENCH_FIELD, "unknown");
+
+	// CPU model from the first processor entry.
+	snprintf(fp->cpu, BENCH_FIELD, "unknown");
+	fcpu = fopen("/proc/cpuinfo", "r");
+	if (fcpu != NULL)
+	{
+		while (fgets(line, BENCH_FIELD, fcpu) != NULL)
+		{
+			if (strncmp(line, "model name", 10) == 0 && (p = strchr(line, ':')) != NULL)
+			{
+				p++;
+				while (*p == ' ' || *p == '\t')
+					p++;
+				p[strcspn(p, "\n")] = '\0';
+				snprintf(fp->cpu, BENCH_FIELD, "%s", p);
+				break;
+			}
+		}
+		fclose(fcpu);
+	}
+
+	snprintf(fp->compiler, BENCH_FIELD, "%s", BENCH_COMPILER);
+	mkl_get_version_string(fp->mkl, BENCH_FIELD);
+	// Drop trailing blanks.
+	p = fp->mkl + strlen(fp->mkl);
+	while (p > fp->mkl && (p[-1] == ' ' || p[-1] == '\n'))
+		*--p = '\0';
+	fp->nprocs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	fp->threads = omp_get_max_threads();
+
+	return;
+}
+
+// Write a JSON string value, escaping quotes and backslashes.
+static void bench_json_string(FILE *fp, const char *key, const char *value)
+{
+	fprintf(fp, "\t\"%s\": \"", key);
+	for (; *value != '\0'; value++)
+	{
+		if (*value == '"' || *value == '\\')
+			fputc('\\', fp);
+		fputc(*value, fp);
+	}
+	fprintf(fp, "\",\n");
+
+	return;
+}
+
+// Write fingerprint as JSON.
+static int bench_fingerprint_write(const char *fname, const bench_fingerprint *fp)
+{
+	FILE *fjson = fopen(fname, "w");
+	if (fjson == NULL)
+	{
+		printf("ELLBENCH: ERROR! Could not write fingerprint %s.\n", fname);
+		return -1;
+	}
+
+	fprintf(fjson, "{\n");
+	bench_json_string(fjson, "host", fp->host);
+	bench_json_string(fjson, "cpu", fp->cpu);
+	bench_json_string(fjson, "compiler", fp->compiler);
+	bench_json_string(fjson, "mkl", fp->mkl);
+	fprintf(fjson, "\t\"nprocs\": %d,\n", fp->nprocs);
+	fprintf(fjson, "\t\"threads\": %d\n", fp->threads);
+	fprintf(fjson, "}\n");
+	fclose(fjson);
+
+	return 0;
+}
+
+// Find the value of a key in a flat JSON object written by bench_fingerprint_write.
+static const char *bench_json_find(const char *json, const char *key)
+{
+	char pattern[BENCH_NAME];
+	const char *p;
+
+	snprintf(pattern, BENCH_NAME, "\"%s\":", key);
+	p = strstr(json, pattern);
+	if (p == NULL)
+		return NULL;
+	p += strlen(pattern);
+	while (*p == ' ' || *p == '\t')
+		p++;
+
+	return p;
+}
+
+// Read a JSON string value, undoing the escapes.
+static void bench_json_read_string(const char *json, const char *key, char *value)
+{
+	const char *p = bench_json_find(json, key);
+	int k = 0;
+
+	if (p != NULL && *p == '"')
+	{
+		for (p++; *p != '\0' && *p != '"' && k < BENCH_FIELD - 1; p++)
+		{
+			if (*p == '\\' && p[1] != '\0')
+				p++;
+			value[k++] = *p;
+		}
+	}
+	value[k] = '\0';
+
+	return;
+}
+
+// Read fingerprint from JSON. Missing fields are left empty.
+static int bench_fingerprint_read(const char *fname, bench_fingerprint *fp)
+{
+	char json[8 * BENCH_FIELD];
+	const char *p;
+	size_t n;
+
+	memset(fp, 0, sizeof(bench_fingerprint));
+	FILE *fjson = fopen(fname, "r");
+	if (fjson == NULL)
+		return -1;
+	n = fread(json, 1, sizeof(json) - 1, fjson);
+	json[n] = '\0';
+	fclose(fjson);
+
+	bench_json_read_string(json, "host", fp->host);
+	bench_json_read_string(json, "cpu", fp->cpu);
+	bench_json_read_string(json, "compiler", fp->compiler);
+	bench_json_read_string(json, "mkl", fp->mkl);
+	if ((p = bench_json_find(json, "nprocs")) != NULL)
+		fp->nprocs = atoi(p);
+	if ((p = bench_json_find(json, "threads")) != NULL)
+		fp->threads = atoi(p);
+
+	return 0;
+}
+
+// Write recorded results as CSV, one row per kernel and configuration.
+static int bench_results_write(const char *fname, const bench_result *results, const int n)
+{
+	int k;
+
+	FILE *fcsv = fopen(fname, "w");
+	if (fcsv == NULL)
+	{
+		printf("ELLBENCH: ERROR! Could not write results %s.\n", fname);
+		return -1;
+	}
+
+	fprintf(fcsv, "kernel,Nr,Nz,order,robin,threads,reps,median,p95,min,mean,mad\n");
+	for (k = 0; k < n; k++)
+	{
+		fprintf(fcsv, "%s,%d,%d,%d,%d,%d,%d,%.6E,%.6E,%.6E,%.6E,%.6E\n", results[k].name,
+			results[k].NrInterior, results[k].NzInterior, results[k].order, results[k].robin,
+			results[k].threads, results[k].reps, results[k].median, results[k].p95,
+			results[k].tmin, results[k].mean, results[k].mad);
+	}
+	fclose(fcsv);
+
+	return 0;
+}
+
+// Read results from CSV. Returns the number of rows or -1 on error; the
+// array is allocated here and released by the caller.
+static int bench_results_read(const char *fname, bench_result **p_results)
+{
+	char line[4 * BENCH_FIELD];
+	bench_result row;
+	bench_result *results = NULL;
+	int n = 0, nmax = 0;
+
+	FILE *fcsv = fopen(fname, "r");
+	if (fcsv == NULL)
+	{
+		printf("ELLBENCH: ERROR! Could not read baseline %s.\n", fname);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fcsv) != NULL)
+	{
+		// Header and malformed rows are skipped.
+		if (sscanf(line, "%63[^,],%d,%d,%d,%d,%d,%d,%lf,%lf,%lf,%lf,%lf", row.name,
+			&row.NrInterior, &row.NzInterior, &row.order, &row.robin, &row.threads, &row.reps,
+			&row.median, &row.p95, &row.tmin, &row.mean, &row.mad) != 12)
+			continue;
+		if (n == nmax)
+		{
+			nmax = (nmax > 0) ? 2 * nmax : 64;
+			results = (bench_result *)realloc(results, nmax * sizeof(bench_result));
+		}
+		results[n++] = row;
+	}
+	fclose(fcsv);
+
+	*p_results = results;
+
+	return n;
+}
+
+// Join directory and file name.
+static void bench_path(char *path, const char *dir, const char *fname)
+{
+	snprintf(path, BENCH_FIELD, "%s/%s", dir, fname);
+
+	return;
+}
+
+// Record a grid sweep as baseline in a directory, which is created if needed.
+static int bench_baseline(const char *dir, const int Nmin, const int Nmax, const int reps, const int warmup)
+{
+	char path[BENCH_FIELD];
+	bench_fingerprint fp;
+	int N, order, robin;
+
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+	{
+		printf("ELLBENCH: ERROR! Could not create baseline directory %s: %s.\n", dir, strerror(errno));
+		return -1;
+	}
+
+	bench_record = 1;
+	for (N = Nmin; N <= Nmax; N *= 2)
+		for (order = 2; order <= 4; order += 2)
+			for (robin = 1; robin <= 3; robin++)
+				bench_configuration(N, order, robin, reps, warmup);
+	bench_record = 0;
+
+	bench_fingerprint_get(&fp);
+	bench_path(path, dir, BENCH_BASELINE_JSON);
+	if (bench_fingerprint_write(path, &fp) != 0)
+		return -1;
+	bench_path(path, dir, BENCH_BASELINE_CSV);
+	if (bench_results_write(path, bench_log, bench_nlog) != 0)
+		return -1;
+	printf("ELLBENCH: Baseline of %d kernel timings written to %s.\n", bench_nlog, dir);
+
+	return 0;
+}
+
+// Compare a fingerprint field and report differences.
+static int bench_fingerprint_field(const char *field, const char *base, const char *current)
+{
+	if (strcmp(base, current) == 0)
+		return 0;
+	printf("ELLBENCH: %-8s baseline \"%s\", current \"%s\".\n", field, base, current);
+
+	return 1;
+}
+
+// Rerun the configurations of a baseline and compare kernel medians.
+//
+// A kernel regresses when its median grows by more than the relative
+// slowdown and the growth is also significant against the noise of both
+// runs: BENCH_NOISE combined standard deviations, each estimated as
+// 1.4826 times the median absolute deviation. Speedups use the same test.
+// Returns the number of regressions or -1 on error.
+static int bench_compare_baseline(const char *dir, const double slowdown, const int reps, const int warmup)
+{
+	char path[BENCH_FIELD];
+	bench_fingerprint base_fp, fp;
+	bench_result *base = NULL;
+	int nbase, k, l;
+	int regressions = 0, speedups = 0, missing = 0;
+
+	bench_path(path, dir, BENCH_BASELINE_CSV);
+	nbase = bench_results_read(path, &base);
+	if (nbase <= 0)
+	{
+		printf("ELLBENCH: ERROR! Baseline %s has no timings.\n", path);
+		free(base);
+		return -1;
+	}
+
+	// Fingerprints: other machines make the comparison meaningless, other
+	// compilers or MKL versions are usually what is being compared.
+	bench_fingerprint_get(&fp);
+	bench_path(path, dir, BENCH_BASELINE_JSON);
+	if (bench_fingerprint_read(path, &base_fp) != 0)
+		printf("ELLBENCH: WARNING! Baseline fingerprint %s not found.\n", path);
+	else
+	{
+		int machine = bench_fingerprint_field("host", base_fp.host, fp.host)
+			+ bench_fingerprint_field("cpu", base_fp.cpu, fp.cpu);
+		if (base_fp.nprocs != fp.nprocs || base_fp.threads != fp.threads)
+		{
+			printf("ELLBENCH: %-8s baseline %d/%d, current %d/%d processors/threads.\n", "threads",
+				base_fp.nprocs, base_fp.threads, fp.nprocs, fp.threads);
+			machine++;
+		}
+		bench_fingerprint_field("compiler", base_fp.compiler, fp.compiler);
+		bench_fingerprint_field("mkl", base_fp.mkl, fp.mkl);
+		if (machine)
+			printf("ELLBENCH: WARNING! Baseline was recorded on a different machine or thread count.\n");
+	}
+
+	// Rerun every configuration of the baseline in its order.
+	bench_record = 1;
+	for (k = 0; k < nbase; k++)
+	{
+		if (k > 0 && base[k].NrInterior == base[k - 1].NrInterior && base[k].order == base[k - 1].order
+			&& base[k].robin == base[k - 1].robin)
+			continue;
+		bench_configuration(base[k].NrInterior, base[k].order, base[k].robin,
+			(reps > 0) ? reps : base[k].reps, warmup);
+	}
+	bench_record = 0;
+
+	bench_path(path, dir, BENCH_COMPARE_CSV);
+	FILE *fcsv = fopen(path, "w");
+	if (fcsv == NULL)
+		printf("ELLBENCH: WARNING! Could not write comparison %s.\n", path);
+	else
+		fprintf(fcsv, "kernel,Nr,Nz,order,robin,base_median,median,ratio,limit,status\n");
+
+	printf("\n%-26s %5s %5s %2s %2s  %10s %10s %7s %10s  %s\n",
+		"kernel", "Nr", "Nz", "o", "rb", "base[s]", "median[s]", "ratio", "limit[s]", "status");
+	for (k = 0; k < nbase; k++)
+	{
+		bench_result *b = &base[k];
+		bench_result *r = NULL;
+		for (l = 0; l < bench_nlog; l++)
+		{
+			if (strcmp(bench_log[l].name, b->name) == 0 && bench_log[l].NrInterior == b->NrInterior
+				&& bench_log[l].NzInterior == b->NzInterior && bench_log[l].order == b->order
+				&& bench_log[l].robin == b->robin)
+			{
+				r = &bench_log[l];
+				break;
+			}
+		}
+		if (r == NULL)
+		{
+			printf("%-26s %5d %5d %2d %2d  %10.3E %10s %7s %10s  missing\n",
+				b->name, b->NrInterior, b->NzInterior, b->order, b->robin, b->median, "-", "-", "-");
+			missing++;
+			continue;
+		}
+
+		double noise = BENCH_NOISE * 1.4826 * sqrt(b->mad * b->mad + r->mad * r->mad);
+		double limit = MAX(slowdown * b->median, noise);
+		double delta = r->median - b->median;
+		const char *status = "ok";
+		if (delta > limit)
+		{
+			status = "SLOWER";
+			regressions++;
+		}
+		else if (-delta > limit)
+		{
+			status = "faster";
+			speedups++;
+		}
+
+		printf("%-26s %5d %5d %2d %2d  %10.3E %10.3E %7.3f %10.3E  %s\n",
+			b->name, b->NrInterior, b->NzInterior, b->order, b->robin,
+			b->median, r->median, r->median / b->median, limit, status);
+		if (fcsv != NULL)
+			fprintf(fcsv, "%s,%d,%d,%d,%d,%.6E,%.6E,%.6E,%.6E,%s\n", b->name, b->NrInterior, b->NzInterior,
+				b->order, b->robin, b->median, r->median, r->median / b->median, limit, status);
+	}
+	if (fcsv != NULL)
+		fclose(fcsv);
+
+	printf("\nELLBENCH: %d of %d kernel timings slower, %d faster, %d missing (slowdown %.1f%%, noise %.1f sigma).\n",
+		regressions, nbase, speedups, missing, 100.0 * slowdown, BENCH_NOISE);
+	free(base);
+
+	return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+	// PARAMETERS: Default values.
+	int Nmin = BENCH_NMIN;
+	int Nmax = BENCH_NMAX;
+	int reps = BENCH_REPS;
+	int warmup = BENCH_WARMUP;
+	int N, order, robin;
+
+	// Baseline mode: ELLBENCH baseline dir [Nmin] [Nmax] [reps] [warmup].
+	if (argc > 1 && strcmp(argv[1], "baseline") == 0)
+	{
+		if (argc < 3)
+		{
+			printf("ELLBENCH: ERROR! Usage: ELLBENCH baseline dir [Nmin] [Nmax] [reps] [warmup].\n");
+			exit(1);
+		}
+		if (argc > 3)
+			Nmin = atoi(argv[3]);
+		if (argc > 4)
+			Nmax = atoi(argv[4]);
+		if (argc > 5)
+			reps = atoi(argv[5]);
+		if (argc > 6)
+			warmup = atoi(argv[6]);
+
+		if (Nmin < BENCH_NMIN || Nmax < Nmin)
+		{
+			printf("ELLBENCH: ERROR! Grid sweep [%d, %d] must satisfy %d <= Nmin <= Nmax.\n", Nmin, Nmax, BENCH_NMIN);
+			exit(1);
+		}
+		if (reps < 1 || reps > BENCH_MAX_REPS || warmup < 0)
+		{
+			printf("ELLBENCH: ERROR! Repetitions %d must be in [1, %d] and warm-up %d non-negative.\n", reps, BENCH_MAX_REPS, warmup);
+			exit(1);
+		}
+
+		printf("ELLBENCH: Baseline %d^2 to %d^2, %d repetitions, %d warm-up, %d threads.\n", Nmin, Nmax, reps, warmup, omp_get_max_threads());
+		printf("%-26s %5s %5s %2s %2s %3s  %10s %10s %10s %10s %9s %9s\n",
+			"kernel", "Nr", "Nz", "o", "rb", "thr", "median[s]", "p95[s]", "min[s]", "mean[s]", "GB/s", "GFLOP/s");
+
+		return (bench_baseline(argv[2], Nmin, Nmax, reps, warmup) == 0) ? 0 : 1;
+	}
+
+	// Comparison mode: ELLBENCH compare dir [slowdown] [reps] [warmup].
+	// Exits with 2 if any kernel is significantly slower than the baseline.
+	if (argc > 1 && strcmp(argv[1], "compare") == 0)
+	{
+		double slowdown = BENCH_SLOWDOWN;
+		// Zero repetitions reuse those of the baseline.
+		reps = 0;
+
+		if (argc < 3)
+		{
+			printf("ELLBENCH: ERROR! Usage: ELLBENCH compare dir [slowdown] [reps] [warmup].\n");
+			exit(1);
+		}
+		if (argc > 3)
+			slowdown = atof(argv[3]);
+		if (argc > 4)
+			reps = atoi(argv[4]);
+		if (argc > 5)
+			warmup = atoi(argv[5]);
+
+		if (slowdown < 0.0)
+		{
+			printf("ELLBENCH: ERROR! Relative slowdown %g must be non-negative.\n", slowdown);
+			exit(1);
+		}
+		if (reps < 0 || reps > BENCH_MAX_REPS || warmup < 0)
+		{
+			printf("ELLBENCH: ERROR! Repetitions %d must be in [0, %d] and warm-up %d non-negative.\n", reps, BENCH_MAX_REPS, warmup);
+			exit(1);
+		}
+
+		printf("ELLBENCH: Comparing against baseline %s, slowdown %.1f%%, %d threads.\n", argv[2], 100.0 * slowdown, omp_get_max_threads());
+		printf("%-26s %5s %5s %2s %2s %3s  %10s %10s %10s %10s %9s %9s\n",
+			"kernel", "Nr", "Nz", "o", "rb", "thr", "median[s]", "p95[s]", "min[s]", "mean[s]", "GB/s", "GFLOP/s");
+
+		int regressions = bench_compare_baseline(argv[2], slowdown, reps, warmup);
+		if (regressions < 0)
+			return 1;
+
+		return (regressions > 0) ? 2 : 0;
+	}
+
+	// Tuning mode: ELLBENCH tune N order robin [profile] [reps] [warmup].
+	if (argc > 1 && strcmp(argv[1], "tune") == 0)
+	{
+		if (argc < 5)
+		{
+			printf("ELLBENCH: ERROR! Usage: ELLBENCH tune N order robin [profile] [reps] [warmup].\n");
+			exit(1);
+		}
+		N = atoi(argv[2]);
+		order = atoi(argv[3]);
+		robin = atoi(argv[4]);
+		const char *fname = (argc > 5) ? argv[5] : BENCH_PROFILE;
+		if (argc > 6)
+			reps = atoi(argv[6]);
+		if (argc > 7)
+			warmup = atoi(argv[7]);
+
+		if (N < BENCH_NMIN || (order != 2 && order != 4) || robin < 1 || robin > 3)
+		{
+			printf("ELLBENCH: ERROR! Tuning needs N >= %d, order 2 or 4 and Robin 1, 2 or 3.\n", BENCH_NMIN);
+			exit(1);
+		}
+		if (reps < 1 || reps > BENCH_MAX_REPS || warmup < 0)
+		{
+			printf("ELLBENCH: ERROR! Repetitions %d must be in [1, %d] and warm-up %d non-negative.\n", reps, BENCH_MAX_REPS, warmup);
+			exit(1);
+		}
+
+		// Tune from default thread counts, not from a previous profile.
+		unsetenv("ELL_THREAD_PROFILE");
+
+		printf("ELLBENCH: Tuning %d^2, order %d, Robin %d, %d repetitions, %d warm-up, up to %d threads.\n",
+			N, order, robin, reps, warmup, omp_get_max_threads());
+		printf("%-26s %5s %5s %2s %2s %3s  %10s %10s %10s %10s %9s %9s\n",
+			"phase", "Nr", "Nz", "o", "rb", "thr", "median[s]", "p95[s]", "min[s]", "mean[s]", "GB/s", "GFLOP/s");
+		bench_tune(N, order, robin, reps, warmup, fname);
+
+		return 0;
+	}
+
+	// Optional arguments: ELLBENCH [Nmin] [Nmax] [reps] [warmup].
+	if (argc > 1)
+		Nmin = atoi(argv[1]);
+	if (argc > 2)
+		Nmax = atoi(argv[2]);
+	if (argc > 3)
+		reps = atoi(argv[3]);
+	if (argc > 4)
+		warmup = atoi(argv[4]);
+
+	if (Nmin < BENCH_NMIN || Nmax < Nmin)
+	{
+		printf("ELLBENCH: ERROR! Grid sweep [%d, %d] must satisfy %d <= Nmin <= Nmax.\n", Nmin, Nmax, BENCH_NMIN);
+		exit(1);
+	}
+	if (reps < 1 || reps > BENCH_MAX_REPS || warmup < 0)
+	{
+		printf("ELLBENCH: ERROR! Repetitions %d must be in [1, %d] and warm-up %d non-negative.\n", reps, BENCH_MAX_REPS, warmup);
+		exit(1);
+	}
+
+	printf("ELLBENCH: Grid sweep %d^2 to %d^2, %d repetitions, %d warm-up, %d threads.\n", Nmin, Nmax, reps, warmup, omp_get_max_threads());
+	printf("%-26s %5s %5s %2s %2s %3s  %10s %10s %10s %10s %9s %9s\n",
+		"kernel", "Nr", "Nz", "o", "rb", "thr", "median[s]", "p95[s]", "min[s]", "mean[s]", "GB/s", "GFLOP/s");
+
+	// Sweep: doubling grid sizes, orders 2/4 and Robin 1/2/3.
+	for (N = Nmin; N <= Nmax; N *= 2)
+	{
+		for (order = 2; order <= 4; order += 2)
+		{
+			for (robin = 1; robin <= 3; robin++)
+			{
+				bench_configuration(N, order, robin, reps, warmup);
+			}
+		}
+	}
+
+	return 0;
+}
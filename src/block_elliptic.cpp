@@ -0,0 +1,419 @@
+// Global header files.
+#include "tools.h"
+
+// PARDISO parameters are shared, the coupled system has its own handle.
+#include "pardiso_param.h"
+#include "pardiso.h"
+
+// Elliptic solver headers.
+#include "general_elliptic_csr_gen.h"
+#include "stencil_csr_gen.h"
+#include "elliptic_tools.h"
+#include "grid_map.h"
+#include "block_elliptic.h"
+
+// Use infinity norm in solver.
+#define INFNORM 0
+
+// Coupled systems.
+//
+// The unknowns are interleaved per grid point, u(k, p) at row k * nfields + p,
+// so the couplings of a point form a dense nfields x nfields block and the
+// stencil of every field touches the same rows of the factor. Every block
+// (p, q) is generated by the scalar generator with the symmetries of field
+// q, which folds its stencil across the axis and the equator. Interior rows
+// of all blocks of equation p are merged, while boundary rows (symmetry and
+// Robin) only come from the diagonal block, so the boundary conditions of
+// each field stay decoupled. Off-diagonal blocks that vanish on the interior
+// are skipped.
+#ifdef FORTRAN
+extern "C" int block_elliptic_(double *u,// Output solutions.
+	double *res,		// Output residuals.
+	const double *ell_a,	// Input a coefficient blocks.
+	const double *ell_b,	// Input b coefficient blocks.
+	const double *ell_c,	// Input c coefficient blocks.
+	const double *ell_d,	// Input d coefficient blocks.
+	const double *ell_e,	// Input e coefficient blocks.
+	const double *ell_s,	// Input s coefficient blocks.
+	const double *ell_f,	// Input RHS per field.
+	const double *uInf,	// u value at infinity for Robin BC per field.
+	const int *p_robin,	// Robin BC type: 1, 2, 3.
+	const int *r_sym,	// R symmetry per field: 1(even), -1(odd).
+	const int *z_sym,	// Z symmetry per field: 1(even), -1(odd).
+	const int *p_NrInterior,// Number of r interior points.
+	const int *p_NzInterior,// Number of z interior points.
+	const int *p_ghost_zones,// Number of ghost zones.
+	const double *p_dr,	// Spatial step in r.
+	const double *p_dz,	// Spatial step in z.
+	const int *p_norder,	// Finite difference order: 2, 4 or 6.
+	const int *p_nfields)	// Number of coupled fields.
+{
+	// Variables passed by reference.
+	int robin = *p_robin;
+	int NrInterior = *p_NrInterior;
+	int NzInterior = *p_NzInterior;
+	int ghost_zones = *p_ghost_zones;
+	double dr = *p_dr;
+	double dz = *p_dz;
+	int norder = *p_norder;
+	int nfields = *p_nfields;
+	// Statistics are only available from C.
+	solver_stats *stats = NULL;
+#else
+int block_elliptic(double *u,	// Output solutions.
+	double *res,		// Output residuals.
+	const double *ell_a,	// Input a coefficient blocks.
+	const double *ell_b,	// Input b coefficient blocks.
+	const double *ell_c,	// Input c coefficient blocks.
+	const double *ell_d,	// Input d coefficient blocks.
+	const double *ell_e,	// Input e coefficient blocks.
+	const double *ell_s,	// Input s coefficient blocks.
+	const double *ell_f,	// Input RHS per field.
+	const double *uInf,	// u value at infinity for Robin BC per field.
+	const int robin,	// Robin BC type: 1, 2, 3.
+	const int *r_sym,	// R symmetry per field: 1(even), -1(odd).
+	const int *z_sym,	// Z symmetry per field: 1(even), -1(odd).
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost_zones,	// Number of ghost zones.
+	const double dr,	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2, 4 or 6.
+	const int nfields,	// Number of coupled fields.
+	solver_stats *stats)	// Output solver statistics, may be NULL.
+{
+#endif
+	int ghost = ghost_zones;
+	int nf = nfields;
+	int NrTotal = NrInterior + 2;
+	int NzTotal = NzInterior + 2;
+	int DIM = (ghost + NrInterior + 1) * (ghost + NzInterior + 1);
+	int DIM0 = NrTotal * NzTotal;
+	int p, q, k, l, m;
+
+	// Wall-clock phase timers.
+	double t_start = omp_get_wtime();
+	double t0 = t_start;
+	double t_reduce = 0.0, t_assemble = 0.0, t_analyse = 0.0, t_factor = 0.0, t_solve = 0.0, t_residual = 0.0, t_fill = 0.0;
+
+	// Sixth order and stretched grids only have the table-driven generator.
+	int tabled = (norder == 6 || grid_map_active());
+	int nnz0 = tabled ? nnz_stencil(NrInterior, NzInterior, norder, robin, 1)
+		: nnz_general_elliptic(NrInterior, NzInterior, norder, robin);
+
+	// Reduced coefficients of one block.
+	double *g_a = (double *)malloc(DIM0 * sizeof(double));
+	double *g_b = (double *)malloc(DIM0 * sizeof(double));
+	double *g_c = (double *)malloc(DIM0 * sizeof(double));
+	double *g_d = (double *)malloc(DIM0 * sizeof(double));
+	double *g_e = (double *)malloc(DIM0 * sizeof(double));
+	double *g_s = (double *)malloc(DIM0 * sizeof(double));
+	double *g_tmp = (double *)malloc(DIM0 * sizeof(double));
+
+	// Interleaved RHS, solution and residual.
+	int n_block = nf * DIM0;
+	double *b_f = (double *)malloc(n_block * sizeof(double));
+	double *b_u = (double *)calloc(n_block, sizeof(double));
+	double *b_res = (double *)malloc(n_block * sizeof(double));
+
+	// Generate every active block: the generators reject unsupported arguments.
+	int status = ELL_SUCCESS;
+	csr_matrix *B = (csr_matrix *)malloc(nf * nf * sizeof(csr_matrix));
+	int *active = (int *)calloc(nf * nf, sizeof(int));
+	for (p = 0; p < nf; p++)
+	{
+		for (q = 0; q < nf; q++)
+		{
+			const double *coeff[6];
+			int off = (p * nf + q) * DIM;
+			coeff[0] = ell_a + off;
+			coeff[1] = ell_b + off;
+			coeff[2] = ell_c + off;
+			coeff[3] = ell_d + off;
+			coeff[4] = ell_e + off;
+			coeff[5] = ell_s + off;
+
+			t0 = omp_get_wtime();
+			ghost_reduce(coeff[0], g_a, NrInterior, NzInterior, ghost);
+			ghost_reduce(coeff[1], g_b, NrInterior, NzInterior, ghost);
+			ghost_reduce(coeff[2], g_c, NrInterior, NzInterior, ghost);
+			ghost_reduce(coeff[3], g_d, NrInterior, NzInterior, ghost);
+			ghost_reduce(coeff[4], g_e, NrInterior, NzInterior, ghost);
+			ghost_reduce(coeff[5], g_s, NrInterior, NzInterior, ghost);
+			t_reduce += omp_get_wtime() - t0;
+
+			// Skip couplings that vanish on the reduced grid.
+			active[p * nf + q] = (p == q);
+			for (k = 0; k < DIM0 && !active[p * nf + q]; k++)
+				active[p * nf + q] = (g_a[k] != 0.0 || g_b[k] != 0.0 || g_c[k] != 0.0
+					|| g_d[k] != 0.0 || g_e[k] != 0.0 || g_s[k] != 0.0);
+			if (!active[p * nf + q])
+				continue;
+
+			// The diagonal block writes the RHS of field p.
+			t0 = omp_get_wtime();
+			ghost_reduce(ell_f + p * DIM, g_tmp, NrInterior, NzInterior, ghost);
+			csr_allocate(&B[p * nf + q], DIM0, DIM0, nnz0);
+			if (tabled)
+				csr_gen_stencil(B[p * nf + q], NrInterior, NzInterior, norder, dr, dz,
+					g_a, g_b, g_c, g_d, g_e, g_s, g_tmp, uInf[q], robin, r_sym[q], z_sym[q]);
+			else if (csr_gen_general_elliptic(B[p * nf + q], NrInterior, NzInterior, norder, dr, dz,
+					g_a, g_b, g_c, g_d, g_e, g_s, g_tmp, uInf[q], robin, r_sym[q], z_sym[q]) != ELL_SUCCESS)
+				status = ELL_ERROR_ARGUMENT;
+			if (p == q)
+			{
+				#pragma omp parallel for schedule(static)
+				for (k = 0; k < DIM0; k++)
+					b_f[k * nf + p] = g_tmp[k];
+			}
+			t_assemble += omp_get_wtime() - t0;
+		}
+	}
+
+	// Interleaved row lengths: boundary rows only keep the diagonal block.
+	t0 = omp_get_wtime();
+	csr_matrix A;
+	A.nrows = n_block;
+	A.ncols = n_block;
+	A.ia = (int *)malloc((n_block + 1) * sizeof(int));
+	A.ia[0] = BASE;
+	for (k = 0; k < DIM0; k++)
+	{
+		int i = k / NzTotal;
+		int j = k % NzTotal;
+		int interior = (i >= 1 && i <= NrInterior && j >= 1 && j <= NzInterior);
+		for (p = 0; p < nf; p++)
+		{
+			int len = 0;
+			for (q = 0; q < nf; q++)
+			{
+				if (active[p * nf + q] && (interior || q == p))
+					len += B[p * nf + q].ia[k + 1] - B[p * nf + q].ia[k];
+			}
+			A.ia[k * nf + p + 1] = A.ia[k * nf + p] + len;
+		}
+	}
+	A.nnz = A.ia[n_block] - BASE;
+	A.a = (double *)malloc(A.nnz * sizeof(double));
+	A.ja = (int *)malloc(A.nnz * sizeof(int));
+
+	// Merge the blocks of every row and sort its columns.
+	#pragma omp parallel for schedule(static) private(p, q, l, m)
+	for (k = 0; k < DIM0; k++)
+	{
+		int i = k / NzTotal;
+		int j = k % NzTotal;
+		int interior = (i >= 1 && i <= NrInterior && j >= 1 && j <= NzInterior);
+		for (p = 0; p < nf; p++)
+		{
+			int row = k * nf + p;
+			int begin = A.ia[row] - BASE;
+			int offset = begin;
+			for (q = 0; q < nf; q++)
+			{
+				if (!active[p * nf + q] || !(interior || q == p))
+					continue;
+				csr_matrix Bpq = B[p * nf + q];
+				for (l = Bpq.ia[k] - BASE; l < Bpq.ia[k + 1] - BASE; l++)
+				{
+					A.a[offset] = Bpq.a[l];
+					A.ja[offset] = (Bpq.ja[l] - BASE) * nf + q + BASE;
+					offset++;
+				}
+			}
+			// Insertion sort: rows hold a few dozen entries.
+			for (l = begin + 1; l < offset; l++)
+			{
+				double a_l = A.a[l];
+				int ja_l = A.ja[l];
+				for (m = l - 1; m >= begin && A.ja[m] > ja_l; m--)
+				{
+					A.a[m + 1] = A.a[m];
+					A.ja[m + 1] = A.ja[m];
+				}
+				A.a[m + 1] = a_l;
+				A.ja[m + 1] = ja_l;
+			}
+		}
+	}
+	for (l = 0; l < nf * nf; l++)
+	{
+		if (active[l])
+			csr_deallocate(&B[l]);
+	}
+	t_assemble += omp_get_wtime() - t0;
+
+	printf("BLOCK ELLIPTIC: Generated CSR matrix with %d fields, %d rows, %d columns and %d nnz.\n",
+		nf, A.nrows, A.ncols, A.nnz);
+
+	// Own handle with the global fine-tuning for direct solves.
+	void *b_pt[64];
+	int b_iparm[64];
+	for (l = 0; l < 64; l++)
+	{
+		b_iparm[l] = iparm[l];
+		b_pt[l] = 0;
+	}
+	b_iparm[4 - 1] = 0;	// No iterative-direct algorithm.
+	b_iparm[5 - 1] = 0;	// No user fill-in reducing permutation.
+	b_iparm[39 - 1] = 0;	// No low rank update.
+	int b_phase, b_error = 0, b_idum = 0;
+	double b_ddum = 0.0;
+
+	if (status == ELL_SUCCESS)
+	{
+		t0 = omp_get_wtime();
+		b_phase = 11;
+		pardiso(b_pt, &maxfct, &mnum, &mtype, &b_phase,
+			&n_block, A.a, A.ia, A.ja, &b_idum, &nrhs,
+			b_iparm, &msglvl, &b_ddum, &b_ddum, &b_error);
+		if (b_error != 0)
+		{
+			printf("BLOCK ELLIPTIC: ERROR during symbolic factorization: %d.\n", b_error);
+			status = ELL_ERROR_ANALYSIS;
+		}
+		t_analyse = omp_get_wtime() - t0;
+	}
+
+	if (status == ELL_SUCCESS)
+	{
+		t0 = omp_get_wtime();
+		b_phase = 22;
+		pardiso(b_pt, &maxfct, &mnum, &mtype, &b_phase,
+			&n_block, A.a, A.ia, A.ja, &b_idum, &nrhs,
+			b_iparm, &msglvl, &b_ddum, &b_ddum, &b_error);
+		if (b_error != 0)
+		{
+			printf("BLOCK ELLIPTIC: ERROR during numerical factorization: %d.\n", b_error);
+			status = ELL_ERROR_FACTOR;
+		}
+		t_factor = omp_get_wtime() - t0;
+	}
+
+	if (status == ELL_SUCCESS)
+	{
+		t0 = omp_get_wtime();
+		b_phase = 33;
+		pardiso(b_pt, &maxfct, &mnum, &mtype, &b_phase,
+			&n_block, A.a, A.ia, A.ja, &b_idum, &nrhs,
+			b_iparm, &msglvl, b_f, b_u, &b_error);
+		if (b_error != 0)
+		{
+			printf("BLOCK ELLIPTIC: ERROR during solution: %d,\n", b_error);
+			status = ELL_ERROR_SOLVE;
+		}
+		t_solve = omp_get_wtime() - t0;
+	}
+
+	// Residual r = f - A u.
+	double norm = 0.0, norm0 = 0.0;
+	int convergence = 0;
+	if (status == ELL_SUCCESS)
+	{
+		t0 = omp_get_wtime();
+		struct matrix_descr descrA;
+		sparse_matrix_t csrA;
+		mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, A.nrows, A.ncols, A.ia, A.ia + 1, A.ja, A.a);
+		descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
+		mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, -1.0, csrA, descrA, b_u, 0.0, b_res);
+		mkl_sparse_destroy(csrA);
+		cblas_daxpy(n_block, 1.0, b_f, 1, b_res, 1);
+		if (INFNORM)
+		{
+			norm = fabs(b_res[cblas_idamax(n_block, b_res, 1)]);
+			norm0 = fabs(b_f[cblas_idamax(n_block, b_f, 1)]);
+		}
+		else
+		{
+			norm = cblas_dnrm2(n_block, b_res, 1);
+			norm0 = cblas_dnrm2(n_block, b_f, 1);
+		}
+		norm0 = norm / norm0;
+		t_residual = omp_get_wtime() - t0;
+
+		// Same tolerance as general_elliptic.
+		double tol = (norder == 6) ? dr * dr * dr * dz * dz * dz : (norder == 4) ? dr * dr * dz * dz : dr * dz;
+		convergence = (norm0 < tol);
+		if (convergence)
+			printf("BLOCK ELLIPTIC: Solver converged!\n");
+		else
+			printf("BLOCK ELLIPTIC: WARNING possible no convergence: %d.!\n", convergence);
+		printf("BLOCK ELLIPTIC: ||r|| = %3.3E.\n", norm);
+
+		// Transfer every field to the original arrays.
+		t0 = omp_get_wtime();
+		for (p = 0; p < nf; p++)
+		{
+			#pragma omp parallel for schedule(static)
+			for (k = 0; k < DIM0; k++)
+			{
+				g_a[k] = b_u[k * nf + p];
+				g_b[k] = b_res[k * nf + p];
+			}
+			ghost_fill(g_a, u + p * DIM, r_sym[p], z_sym[p], NrInterior, NzInterior, ghost);
+			ghost_fill(g_b, res + p * DIM, r_sym[p], z_sym[p], NrInterior, NzInterior, ghost);
+		}
+		t_fill = omp_get_wtime() - t0;
+	}
+	else
+	{
+		printf("BLOCK ELLIPTIC: ERROR! Solver failed with status %d, solutions and residuals unchanged.\n", status);
+	}
+
+	// Report solver statistics.
+	if (stats)
+	{
+		stats->solver = "block";
+		stats->NrInterior = NrInterior;
+		stats->NzInterior = NzInterior;
+		stats->order = norder;
+		stats->robin = robin;
+		stats->nnz = A.nnz;
+		stats->lr_use = 0;
+		stats->precond_use = 0;
+		stats->t_reduce = t_reduce;
+		stats->t_assemble = t_assemble;
+		stats->t_analyse = t_analyse;
+		stats->t_factor = t_factor;
+		stats->t_solve = t_solve;
+		stats->t_residual = t_residual;
+		stats->t_fill = t_fill;
+		stats->t_coarse = 0.0;
+		stats->perturbed_pivots = b_iparm[14 - 1];
+		stats->mem_peak_analysis = b_iparm[15 - 1];
+		stats->mem_permanent = b_iparm[16 - 1];
+		stats->mem_factor = b_iparm[17 - 1];
+		stats->factor_nnz = b_iparm[18 - 1];
+		stats->factor_mflops = b_iparm[19 - 1];
+		stats->refinement_steps = b_iparm[7 - 1];
+		stats->abs_residual = norm;
+		stats->rel_residual = norm0;
+		stats->convergence = convergence;
+		stats->status = status;
+		stats->fallback = 0;
+	}
+
+	// Release PARDISO memory and arrays.
+	b_phase = -1;
+	pardiso(b_pt, &maxfct, &mnum, &mtype, &b_phase,
+		&n_block, &b_ddum, A.ia, A.ja, &b_idum, &nrhs,
+		b_iparm, &msglvl, &b_ddum, &b_ddum, &b_error);
+	csr_deallocate(&A);
+	free(B);
+	free(active);
+	free(g_a);
+	free(g_b);
+	free(g_c);
+	free(g_d);
+	free(g_e);
+	free(g_s);
+	free(g_tmp);
+	free(b_f);
+	free(b_u);
+	free(b_res);
+
+	if (stats)
+		stats->t_total = omp_get_wtime() - t_start;
+
+	return status;
+}
@@ -0,0 +1,31 @@
+// Coupled system of nfields general elliptic equations: equation p is
+//
+//   sum_q (a d  +  b d  +  c d  +  d d  +  e d  +  s) u  = f ,
+//            rr      rz      zz      r       z  pq  q    p
+//
+// with block (p, q) coefficients stored at offset (p * nfields + q) * DIM
+// of ell_a to ell_s, and field p of u, res and ell_f at offset p * DIM.
+// Every field has its own symmetries and value at infinity. Requires
+// pardiso_start for the PARDISO parameters. Returns ELL_SUCCESS or the
+// failed PARDISO phase, with u and res unchanged.
+int block_elliptic(double *u,	// Output solutions.
+	double *res,		// Output residuals.
+	const double *ell_a,	// Input a coefficient blocks.
+	const double *ell_b,	// Input b coefficient blocks.
+	const double *ell_c,	// Input c coefficient blocks.
+	const double *ell_d,	// Input d coefficient blocks.
+	const double *ell_e,	// Input e coefficient blocks.
+	const double *ell_s,	// Input s coefficient blocks.
+	const double *ell_f,	// Input RHS per field.
+	const double *uInf,	// u value at infinity for Robin BC per field.
+	const int robin,	// Robin BC type: 1, 2, 3.
+	const int *r_sym,	// R symmetry per field: 1(even), -1(odd).
+	const int *z_sym,	// Z symmetry per field: 1(even), -1(odd).
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost_zones,	// Number of ghost zones.
+	const double dr,	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2, 4 or 6.
+	const int nfields,	// Number of coupled fields.
+	solver_stats *stats = NULL);// Output solver statistics, optional.
@@ -0,0 +1,458 @@
+// Global headers and variables.
+#include "tools.h"
+
+// PARDISO tools.
+#include "pardiso_start.h"
+#include "pardiso_stop.h"
+
+// Solvers.
+#include "flat_laplacian.h"
+#include "general_elliptic.h"
+
+// Solver statistics.
+#include "solver_stats.h"
+
+// Process control.
+#include <sys/wait.h>
+
+// HARNESS DEFAULTS.
+#define CONV_NMIN 32
+#define CONV_NMAX 256
+#define CONV_L 8.0
+#define CONV_MAX_LEVELS 8
+#define CONV_MAX_JOBS (2 * 4 * 3 * CONV_MAX_LEVELS)
+// Orders under test: -4 is the compact fourth order flat Laplacian.
+#define CONV_NORDERS 4
+static const int conv_orders[CONV_NORDERS] = { 2, 4, 6, -4 };
+// Observed order may fall this much below the nominal order. The compact
+// scheme loses a logarithm to its truncation error near the axis.
+#define CONV_ORDER_TOL 0.3
+#define CONV_COMPACT_ORDER_TOL 0.5
+// Memory heuristic for one solve: bytes per unknown per log2(unknowns),
+// dominated by the nested dissection fill-in of the LU factors.
+#define CONV_BYTES_PER_POINT 160.0
+
+// A single manufactured-solution solve.
+typedef struct conv_jobs
+{
+	// Configuration.
+	int general;
+	int order;
+	int robin;
+	int N;
+	double h;
+	// Results.
+	double error;
+	double time;
+	double rel_residual;
+	int status;
+	pid_t pid;
+	int fd;
+} conv_job;
+
+// Manufactured solution u = exp(-rho^2 - z^2) with uInf = 0.
+//
+// The solution is even in rho and z and is exponentially small at the
+// boundary of a [0, L]^2 domain with L >= 6, so every Robin type is
+// satisfied to round-off and the error measures the interior stencils.
+static double conv_exact(const double r, const double z)
+{
+	return exp(-r * r - z * z);
+}
+
+// Run one solve and fill error and time: called in a child process.
+static void conv_solve(conv_job *job, const double L)
+{
+	int N = job->N;
+	int order = job->order;
+	int ghost = (order < 0) ? 2 : order / 2 + 1;
+	int NrTotal = ghost + N + 1;
+	int NzTotal = ghost + N + 1;
+	int DIM = NrTotal * NzTotal;
+	double h = L / (double)N;
+	double r, z, r2, u0, err;
+	int i, j, k;
+	solver_stats stats;
+
+	// Grid functions.
+	double *u = (double *)malloc(DIM * sizeof(double));
+	double *res = (double *)malloc(DIM * sizeof(double));
+	double *f = (double *)malloc(DIM * sizeof(double));
+	double *s = (double *)malloc(DIM * sizeof(double));
+	double *a = (double *)malloc(DIM * sizeof(double));
+	double *b = (double *)malloc(DIM * sizeof(double));
+	double *c = (double *)malloc(DIM * sizeof(double));
+	double *d = (double *)malloc(DIM * sizeof(double));
+	double *e = (double *)malloc(DIM * sizeof(double));
+
+	// Flat: u_rr + u_r / r + u_zz + s u = f with s = -1 / (1 + r^2).
+	// General: a u_rr + b u_rz + c u_zz + d u_r + e u_z + s u = f with
+	// coefficients of the parity required by the symmetry conditions.
+	#pragma omp parallel for schedule(static) private(j, k, r, z, r2, u0)
+	for (i = 0; i < NrTotal; i++)
+	{
+		r = ((double)(i - ghost) + 0.5) * h;
+		for (j = 0; j < NzTotal; j++)
+		{
+			z = ((double)(j - ghost) + 0.5) * h;
+			k = IDX(i, j);
+			r2 = r * r + z * z;
+			u0 = conv_exact(r, z);
+			u[k] = 0.0;
+			res[k] = 0.0;
+			s[k] = -1.0 / (1.0 + r2);
+			if (job->general)
+			{
+				a[k] = 1.0 + 0.5 * exp(-r2);
+				b[k] = 0.2 * r * z / (1.0 + r2);
+				c[k] = 1.0;
+				d[k] = a[k] / r;
+				e[k] = 0.3 * z / (1.0 + r2);
+				f[k] = (a[k] * (4.0 * r * r - 2.0) + b[k] * 4.0 * r * z + c[k] * (4.0 * z * z - 2.0)
+					- 2.0 * d[k] * r - 2.0 * e[k] * z + s[k]) * u0;
+			}
+			else
+			{
+				f[k] = (4.0 * r2 - 6.0 + s[k]) * u0;
+			}
+		}
+	}
+
+	// Solve.
+	pardiso_start(N, N);
+	solver_stats_reset(&stats);
+	if (job->general)
+	{
+		general_elliptic(u, res, a, b, c, d, e, s, f, 0.0, job->robin, 1, 1,
+			N, N, ghost, h, h, order, 0, 0, &stats);
+	}
+	else
+	{
+		flat_laplacian(u, res, s, f, 0.0, job->robin, 1, 1,
+			N, N, ghost, h, h, order, 0, 0, &stats);
+	}
+	pardiso_stop();
+
+	// Infinity norm of the error over interior points.
+	err = 0.0;
+	for (i = ghost; i < ghost + N; i++)
+	{
+		r = ((double)(i - ghost) + 0.5) * h;
+		for (j = ghost; j < ghost + N; j++)
+		{
+			z = ((double)(j - ghost) + 0.5) * h;
+			err = MAX(err, fabs(u[IDX(i, j)] - conv_exact(r, z)));
+		}
+	}
+
+	job->h = h;
+	job->error = err;
+	job->time = stats.t_total;
+	job->rel_residual = stats.rel_residual;
+	job->status = stats.convergence ? 0 : 1;
+
+	free(u);
+	free(res);
+	free(f);
+	free(s);
+	free(a);
+	free(b);
+	free(c);
+	free(d);
+	free(e);
+
+	return;
+}
+
+// Estimated peak memory of one solve in bytes.
+static double conv_memory(const conv_job *job)
+{
+	double n = (double)(job->N + 2) * (double)(job->N + 2);
+
+	return CONV_BYTES_PER_POINT * ((job->order < 0) ? 1 : job->order / 2) * n * log2(n);
+}
+
+// Available physical memory in bytes.
+static double conv_available_memory(void)
+{
+	return (double)sysconf(_SC_AVPHYS_PAGES) * (double)sysconf(_SC_PAGESIZE);
+}
+
+// Start a job in a child process: the result comes back through a pipe.
+static void conv_launch(conv_job *job, const double L, const int nthreads)
+{
+	int fds[2];
+
+	if (pipe(fds) != 0)
+	{
+		printf("ELLCONV: ERROR! Could not create pipe.\n");
+		exit(1);
+	}
+
+	fflush(stdout);
+	job->pid = fork();
+	if (job->pid < 0)
+	{
+		printf("ELLCONV: ERROR! Could not fork.\n");
+		exit(1);
+	}
+	else if (job->pid == 0)
+	{
+		// Child: silence solver output and share the cores.
+		close(fds[0]);
+		if (freopen("/dev/null", "w", stdout) == NULL)
+			_exit(1);
+		omp_set_num_threads(nthreads);
+		conv_solve(job, L);
+		if (write(fds[1], job, sizeof(conv_job)) != (ssize_t)sizeof(conv_job))
+			_exit(1);
+		close(fds[1]);
+		_exit(0);
+	}
+
+	// Parent.
+	close(fds[1]);
+	job->fd = fds[0];
+
+	return;
+}
+
+// Wait for any running job and collect its result.
+static void conv_collect(conv_job *jobs, const int njobs)
+{
+	int status, k;
+	pid_t pid = wait(&status);
+
+	for (k = 0; k < njobs; k++)
+	{
+		if (jobs[k].pid == pid)
+		{
+			conv_job result;
+			if (read(jobs[k].fd, &result, sizeof(conv_job)) == (ssize_t)sizeof(conv_job))
+			{
+				jobs[k].h = result.h;
+				jobs[k].error = result.error;
+				jobs[k].time = result.time;
+				jobs[k].rel_residual = result.rel_residual;
+				jobs[k].status = result.status;
+			}
+			else
+			{
+				// Child crashed or ran out of memory.
+				jobs[k].status = 2;
+			}
+			close(jobs[k].fd);
+			jobs[k].pid = 0;
+			break;
+		}
+	}
+
+	return;
+}
+
+// Run all jobs, keeping as many in flight as memory and maxjobs allow.
+//
+// Jobs are launched largest first so that the big solves start early and
+// small ones fill the remaining memory.
+static void conv_run_all(conv_job *jobs, const int njobs, const double L, const int maxjobs)
+{
+	int running = 0, next = njobs - 1, k;
+	double in_use = 0.0;
+	int nthreads;
+
+	while (next >= 0 || running > 0)
+	{
+		// Launch while the next job fits.
+		while (next >= 0 && running < maxjobs
+			&& (running == 0 || in_use + conv_memory(&jobs[next]) < 0.8 * conv_available_memory()))
+		{
+			nthreads = MAX(1, omp_get_max_threads() / maxjobs);
+			conv_launch(&jobs[next], L, nthreads);
+			in_use += conv_memory(&jobs[next]);
+			running++;
+			next--;
+		}
+
+		// Wait for one job.
+		conv_collect(jobs, njobs);
+		running--;
+
+		// Recount memory in use.
+		in_use = 0.0;
+		for (k = 0; k < njobs; k++)
+		{
+			if (jobs[k].pid > 0)
+				in_use += conv_memory(&jobs[k]);
+		}
+	}
+
+	return;
+}
+
+// Sort by time, then by error.
+static int conv_compare_time(const void *p, const void *q)
+{
+	const conv_job *x = *(const conv_job **)p;
+	const conv_job *y = *(const conv_job **)q;
+
+	if (x->time != y->time)
+		return (x->time > y->time) - (x->time < y->time);
+	return (x->error > y->error) - (x->error < y->error);
+}
+
+// Print error versus wall-time Pareto front of a solver and return the
+// cheapest point with error below tol, or NULL.
+static const conv_job *conv_pareto(conv_job *jobs, const int njobs, const int general, const double tol)
+{
+	const conv_job *sorted[CONV_MAX_JOBS];
+	const conv_job *cheapest = NULL;
+	double best = HUGE_VAL;
+	int m = 0, k;
+
+	for (k = 0; k < njobs; k++)
+	{
+		if (jobs[k].general == general && jobs[k].status == 0)
+			sorted[m++] = &jobs[k];
+	}
+	qsort(sorted, m, sizeof(conv_job *), conv_compare_time);
+
+	printf("\nELLCONV: Pareto front for %s solver (error vs. wall time).\n", general ? "general" : "flat");
+	printf("%2s %2s %5s %10s %10s %10s\n", "o", "rb", "N", "h", "time[s]", "error");
+	for (k = 0; k < m; k++)
+	{
+		// Keep points more accurate than every faster point.
+		if (sorted[k]->error < best)
+		{
+			best = sorted[k]->error;
+			printf("%2d %2d %5d %10.4E %10.4E %10.4E\n", sorted[k]->order, sorted[k]->robin, sorted[k]->N,
+				sorted[k]->h, sorted[k]->time, sorted[k]->error);
+			if (cheapest == NULL && sorted[k]->error <= tol)
+				cheapest = sorted[k];
+		}
+	}
+
+	return cheapest;
+}
+
+int main(int argc, char *argv[])
+{
+	// PARAMETERS: Default values.
+	int Nmin = CONV_NMIN;
+	int Nmax = CONV_NMAX;
+	double L = CONV_L;
+	int maxjobs = 1;
+	double tol = 0.0;
+	int nlevels, njobs, general, order, robin, level, k, l;
+	int failures = 0;
+	conv_job jobs[CONV_MAX_JOBS];
+
+	// Optional arguments: ELLCONV [Nmin] [Nmax] [L] [jobs] [tol].
+	if (argc > 1)
+		Nmin = atoi(argv[1]);
+	if (argc > 2)
+		Nmax = atoi(argv[2]);
+	if (argc > 3)
+		L = atof(argv[3]);
+	if (argc > 4)
+		maxjobs = atoi(argv[4]);
+	if (argc > 5)
+		tol = atof(argv[5]);
+
+	// Resolution ladder: doubling from Nmin to Nmax.
+	nlevels = 0;
+	for (k = Nmin; k <= Nmax; k *= 2)
+		nlevels++;
+
+	if (Nmin < CONV_NMIN || nlevels < 2 || nlevels > CONV_MAX_LEVELS)
+	{
+		printf("ELLCONV: ERROR! Ladder [%d, %d] needs Nmin >= %d and 2 to %d levels.\n", Nmin, Nmax, CONV_NMIN, CONV_MAX_LEVELS);
+		exit(1);
+	}
+	if (L < 6.0 || maxjobs < 1)
+	{
+		printf("ELLCONV: ERROR! Domain size L = %3.3E must be >= 6 and jobs = %d positive.\n", L, maxjobs);
+		exit(1);
+	}
+
+	// Job list ordered by solver, order, Robin type and increasing N.
+	njobs = 0;
+	for (general = 0; general <= 1; general++)
+	{
+		for (l = 0; l < CONV_NORDERS; l++)
+		{
+			// The compact scheme is only available for the flat Laplacian.
+			order = conv_orders[l];
+			if (general && order < 0)
+				continue;
+			for (robin = 1; robin <= 3; robin++)
+			{
+				for (level = 0, k = Nmin; level < nlevels; level++, k *= 2)
+				{
+					memset(&jobs[njobs], 0, sizeof(conv_job));
+					jobs[njobs].general = general;
+					jobs[njobs].order = order;
+					jobs[njobs].robin = robin;
+					jobs[njobs].N = k;
+					jobs[njobs].status = 2;
+					njobs++;
+				}
+			}
+		}
+	}
+
+	printf("ELLCONV: Ladder %d^2 to %d^2 on [0, %g]^2, %d solves, up to %d in parallel.\n", Nmin, Nmax, L, njobs, maxjobs);
+	conv_run_all(jobs, njobs, L, maxjobs);
+
+	// Convergence table: observed order from consecutive levels.
+	printf("\n%-7s %2s %2s %5s %10s %10s %10s %10s %6s\n",
+		"solver", "o", "rb", "N", "h", "time[s]", "error", "rel_res", "p_obs");
+	for (k = 0; k < njobs; k++)
+	{
+		printf("%-7s %2d %2d %5d %10.4E %10.4E %10.4E %10.4E ", jobs[k].general ? "general" : "flat",
+			jobs[k].order, jobs[k].robin, jobs[k].N, jobs[k].h, jobs[k].time, jobs[k].error, jobs[k].rel_residual);
+		if (jobs[k].status != 0)
+		{
+			printf("%6s\n", jobs[k].status == 1 ? "NOCONV" : "FAILED");
+			failures++;
+		}
+		else if (k % nlevels == 0)
+		{
+			printf("%6s\n", "-");
+		}
+		else
+		{
+			double p = log2(jobs[k - 1].error / jobs[k].error);
+			printf("%6.3f\n", p);
+			// Regression check on the finest pair.
+			if ((k % nlevels == nlevels - 1) && (p < (double)abs(jobs[k].order) - ((jobs[k].order < 0) ? CONV_COMPACT_ORDER_TOL : CONV_ORDER_TOL)))
+			{
+				printf("ELLCONV: REGRESSION! %s order %d Robin %d converges with order %3.3f.\n",
+					jobs[k].general ? "general" : "flat", jobs[k].order, jobs[k].robin, p);
+				failures++;
+			}
+		}
+	}
+
+	// Pareto fronts and cheapest configuration for the target accuracy.
+	for (general = 0; general <= 1; general++)
+	{
+		const conv_job *cheapest = conv_pareto(jobs, njobs, general, tol);
+		if (tol > 0.0)
+		{
+			if (cheapest)
+				printf("ELLCONV: Cheapest for error <= %3.3E: order %d, Robin %d, N = %d (%3.3E seconds).\n",
+					tol, cheapest->order, cheapest->robin, cheapest->N, cheapest->time);
+			else
+				printf("ELLCONV: No configuration reaches error <= %3.3E.\n", tol);
+		}
+	}
+
+	if (failures)
+	{
+		printf("\nELLCONV: %d failures.\n", failures);
+		return 1;
+	}
+	printf("\nELLCONV: All configurations converge at their nominal order.\n");
+
+	return 0;
+}
@@ -0,0 +1,357 @@
+// Global header files.
+#include "tools.h"
+
+// MPI and MKL Cluster Sparse Solver.
+#include <mpi.h>
+#include "mkl_cluster_sparse_solver.h"
+#include "mkl_cblas.h"
+
+// Elliptic solver headers.
+#include "stencil_csr_gen.h"
+#include "elliptic_tools.h"
+#include "grid_map.h"
+#include "distributed.h"
+
+// Max numbers of iterative refinement steps.
+#define REFINEMENT_STEPS 10
+
+#undef DEBUG
+
+// Distributed solve of the reduced system: the (NrInterior + 2) x (NzInterior + 2)
+// grid is split into contiguous r-strips, rank p owning the rows
+//
+//	p * NrTotal / size <= i < (p + 1) * NrTotal / size,
+//
+// which in the rho-major layout are the contiguous matrix rows IDX(i_begin, 0)
+// to IDX(i_end, 0) - 1. Each rank assembles only these rows with the
+// table-driven generator and hands them to the Cluster Sparse Solver as a
+// distributed matrix (iparm(40) = 2), so the LU factors are also distributed.
+// The RHS and solution are distributed in the same way and the solution is
+// gathered on every rank before the residual, which needs the halo columns.
+static void distributed_solve(double *u,	// Output solution.
+	double *res,			// Output residual.
+	const double *ell_a,		// Coefficients, NULL for the flat Laplacian.
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,		// Input linear source.
+	const double *ell_f,		// Input RHS.
+	const double uInf,		// u value at infinity for Robin BC.
+	const int robin,		// Robin BC type: 1, 2, 3.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym,		// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const int ghost_zones,		// Number of ghost zones.
+	const double dr,		// Spatial step in r.
+	const double dz,		// Spatial step in z.
+	const int norder,		// Finite difference order.
+	MPI_Comm comm,			// Communicator.
+	const char *name,		// Solver name for messages and statistics.
+	solver_stats *stats)		// Output solver statistics, may be NULL.
+{
+	// Wall-clock phase timers.
+	double t_start = omp_get_wtime();
+	double t0 = t_start;
+	double t_reduce, t_assemble, t_analyse, t_factor, t_solve, t_residual, t_fill;
+
+	// Rank and number of ranks.
+	int rank, size;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	// Reduced grid.
+	int NrTotal = NrInterior + 2;
+	int NzTotal = NzInterior + 2;
+	int DIM0 = NrTotal * NzTotal;
+	int mixed = (ell_a != NULL);
+	int i, k;
+
+	if (NrTotal < size)
+	{
+		if (rank == 0)
+			printf("%s: ERROR! %d ranks for only %d r rows.\n", name, size, NrTotal);
+		MPI_Abort(comm, 1);
+	}
+	if (norder == -4 && (mixed || grid_map_active()))
+	{
+		if (rank == 0)
+			printf("%s: ERROR! Compact fourth order needs the flat Laplacian on a uniform grid.\n", name);
+		MPI_Abort(comm, 1);
+	}
+
+	// Strip of every rank, in points of the reduced grid.
+	int *counts = (int *)malloc(size * sizeof(int));
+	int *displs = (int *)malloc(size * sizeof(int));
+	for (k = 0; k < size; k++)
+	{
+		displs[k] = (k * NrTotal / size) * NzTotal;
+		counts[k] = ((k + 1) * NrTotal / size) * NzTotal - displs[k];
+	}
+	int i_begin = rank * NrTotal / size;
+	int i_end = (rank + 1) * NrTotal / size;
+	int offset = displs[rank];
+	int nloc = counts[rank];
+
+	// Reduce arrays: grid functions are replicated on every rank.
+	double *g_u = grid_allocate(NrTotal, NzTotal);
+	double *g_f = grid_allocate(NrTotal, NzTotal);
+	double *g_s = grid_allocate(NrTotal, NzTotal);
+	double *g_res = grid_allocate(NrTotal, NzTotal);
+	double *g_a = NULL, *g_b = NULL, *g_c = NULL, *g_d = NULL, *g_e = NULL;
+	ghost_reduce(u, g_u, NrInterior, NzInterior, ghost_zones);
+	ghost_reduce(ell_f, g_f, NrInterior, NzInterior, ghost_zones);
+	ghost_reduce(ell_s, g_s, NrInterior, NzInterior, ghost_zones);
+	if (mixed)
+	{
+		g_a = grid_allocate(NrTotal, NzTotal);
+		g_b = grid_allocate(NrTotal, NzTotal);
+		g_c = grid_allocate(NrTotal, NzTotal);
+		g_d = grid_allocate(NrTotal, NzTotal);
+		g_e = grid_allocate(NrTotal, NzTotal);
+		ghost_reduce(ell_a, g_a, NrInterior, NzInterior, ghost_zones);
+		ghost_reduce(ell_b, g_b, NrInterior, NzInterior, ghost_zones);
+		ghost_reduce(ell_c, g_c, NrInterior, NzInterior, ghost_zones);
+		ghost_reduce(ell_d, g_d, NrInterior, NzInterior, ghost_zones);
+		ghost_reduce(ell_e, g_e, NrInterior, NzInterior, ghost_zones);
+	}
+	t_reduce = omp_get_wtime() - t0;
+
+	// Local rows: offsets local to the strip, global columns.
+	t0 = omp_get_wtime();
+	csr_matrix A;
+	csr_allocate(&A, nloc, DIM0, nnz_stencil_rows(NrInterior, NzInterior, norder, robin, mixed, i_begin, i_end));
+	csr_gen_stencil_rows(A, i_begin, i_end, NrInterior, NzInterior, norder, dr, dz,
+		g_a, g_b, g_c, g_d, g_e, g_s, g_f, uInf, robin, r_sym, z_sym);
+	int nnz_total = 0;
+	MPI_Allreduce(&A.nnz, &nnz_total, 1, MPI_INT, MPI_SUM, comm);
+	if (rank == 0)
+		printf("%s: Generated distributed CSR matrix with %d rows and %d nnz on %d ranks.\n", name, DIM0, nnz_total, size);
+	t_assemble = omp_get_wtime() - t0;
+
+	// Cluster Sparse Solver parameters: same fine-tuning as pardiso_start,
+	// with the matrix, RHS and solution distributed by row domains.
+	void *c_pt[64];
+	int c_iparm[64];
+	int c_mtype = 11;
+	int c_nrhs = 1;
+	int c_maxfct = 1;
+	int c_mnum = 1;
+	int c_msglvl = 0;
+	int c_phase, c_error = 0, c_idum = 0;
+	double c_ddum = 0.0;
+	int fcomm = (int)MPI_Comm_c2f(comm);
+	for (k = 0; k < 64; k++)
+	{
+		c_iparm[k] = 0;
+		c_pt[k] = 0;
+	}
+	c_iparm[1 - 1] = 1;	// Do not use default parameters.
+	c_iparm[2 - 1] = 3;	// Parallel fill-in reordering from METIS.
+	c_iparm[8 - 1] = REFINEMENT_STEPS; // Max numbers of iterative refinement steps.
+	c_iparm[10 - 1] = 13;	// Perturb the pivot elements with 1E-13.
+	c_iparm[11 - 1] = 1;	// Use nonsymmetric permutation and scaling MPS.
+	c_iparm[13 - 1] = 1;	// Maximum weighted matching algorithm.
+	c_iparm[35 - 1] = 0;	// One-based indexing.
+	c_iparm[40 - 1] = 2;	// Distributed matrix, RHS and solution.
+	c_iparm[41 - 1] = offset + 1;		// First row of this rank.
+	c_iparm[42 - 1] = offset + nloc;	// Last row of this rank.
+
+	// Reordering and symbolic factorization.
+	t0 = omp_get_wtime();
+	c_phase = 11;
+	cluster_sparse_solver(c_pt, &c_maxfct, &c_mnum, &c_mtype, &c_phase, &DIM0, A.a, A.ia, A.ja,
+		&c_idum, &c_nrhs, c_iparm, &c_msglvl, &c_ddum, &c_ddum, &fcomm, &c_error);
+	if (c_error != 0)
+	{
+		if (rank == 0)
+			printf("ERROR during symbolic factorization: %d.\n", c_error);
+		MPI_Abort(comm, 1);
+	}
+	t_analyse = omp_get_wtime() - t0;
+
+	// Numerical factorization.
+	t0 = omp_get_wtime();
+	c_phase = 22;
+	cluster_sparse_solver(c_pt, &c_maxfct, &c_mnum, &c_mtype, &c_phase, &DIM0, A.a, A.ia, A.ja,
+		&c_idum, &c_nrhs, c_iparm, &c_msglvl, &c_ddum, &c_ddum, &fcomm, &c_error);
+	if (c_error != 0)
+	{
+		if (rank == 0)
+			printf("ERROR during numerical factorization: %d.\n", c_error);
+		MPI_Abort(comm, 2);
+	}
+	if (rank == 0)
+	{
+		printf("CLUSTER SPARSE SOLVER: Number of nonzeros in factors = %d.\n", c_iparm[18 - 1]);
+		printf("CLUSTER SPARSE SOLVER: Number of factorization MFLOPS = %d.\n", c_iparm[19 - 1]);
+	}
+	t_factor = omp_get_wtime() - t0;
+
+	// Back substitution and iterative refinement: the strip of the
+	// solution is written in place.
+	t0 = omp_get_wtime();
+	c_phase = 33;
+	cluster_sparse_solver(c_pt, &c_maxfct, &c_mnum, &c_mtype, &c_phase, &DIM0, A.a, A.ia, A.ja,
+		&c_idum, &c_nrhs, c_iparm, &c_msglvl, g_f + offset, g_u + offset, &fcomm, &c_error);
+	if (c_error != 0)
+	{
+		if (rank == 0)
+			printf("ERROR during solution: %d,\n", c_error);
+		MPI_Abort(comm, 3);
+	}
+	MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DOUBLE, g_u, counts, displs, MPI_DOUBLE, comm);
+	t_solve = omp_get_wtime() - t0;
+
+	// Residual of the local rows and global two-norms.
+	t0 = omp_get_wtime();
+	double norms[2], sums[2];
+	#pragma omp parallel for schedule(static) private(k)
+	for (i = 0; i < nloc; i++)
+	{
+		double aux = g_f[offset + i];
+		for (k = A.ia[i] - BASE; k < A.ia[i + 1] - BASE; k++)
+			aux -= A.a[k] * g_u[A.ja[k] - BASE];
+		g_res[offset + i] = aux;
+	}
+	norms[0] = cblas_ddot(nloc, g_res + offset, 1, g_res + offset, 1);
+	norms[1] = cblas_ddot(nloc, g_f + offset, 1, g_f + offset, 1);
+	MPI_Allreduce(norms, sums, 2, MPI_DOUBLE, MPI_SUM, comm);
+	MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DOUBLE, g_res, counts, displs, MPI_DOUBLE, comm);
+	double abs_res = sqrt(sums[0]);
+	double rel_res = abs_res / sqrt(sums[1]);
+	t_residual = omp_get_wtime() - t0;
+
+	// Same tolerance as the shared memory solvers.
+	double tol = (norder == 6) ? dr * dr * dr * dz * dz * dz : (norder == 4 || norder == -4) ? dr * dr * dz * dz : dr * dz;
+	int convergence = (rel_res < tol);
+	if (rank == 0)
+	{
+		if (convergence)
+			printf("%s: Solver converged!\n", name);
+		else
+			printf("%s: WARNING possible no convergence: %d.!\n", name, convergence);
+		printf("%s: ||r|| = %3.3E.\n", name, abs_res);
+	}
+
+	// Transfer solution and residual to original arrays.
+	t0 = omp_get_wtime();
+	ghost_fill(g_u, u, r_sym, z_sym, NrInterior, NzInterior, ghost_zones);
+	ghost_fill(g_res, res, r_sym, z_sym, NrInterior, NzInterior, ghost_zones);
+	t_fill = omp_get_wtime() - t0;
+
+	// Report solver statistics: PARDISO outputs are those of rank 0.
+	if (stats)
+	{
+		stats->solver = mixed ? "general_mpi" : "flat_mpi";
+		stats->NrInterior = NrInterior;
+		stats->NzInterior = NzInterior;
+		stats->order = norder;
+		stats->robin = robin;
+		stats->nnz = nnz_total;
+		stats->lr_use = 0;
+		stats->precond_use = 0;
+		stats->t_reduce = t_reduce;
+		stats->t_assemble = t_assemble;
+		stats->t_analyse = t_analyse;
+		stats->t_factor = t_factor;
+		stats->t_solve = t_solve;
+		stats->t_residual = t_residual;
+		stats->t_fill = t_fill;
+		stats->t_coarse = 0.0;
+		stats->perturbed_pivots = c_iparm[14 - 1];
+		stats->mem_peak_analysis = c_iparm[15 - 1];
+		stats->mem_permanent = c_iparm[16 - 1];
+		stats->mem_factor = c_iparm[17 - 1];
+		stats->factor_nnz = c_iparm[18 - 1];
+		stats->factor_mflops = c_iparm[19 - 1];
+		stats->cgs_iterations = 0;
+		stats->refinement_steps = c_iparm[7 - 1];
+		stats->corrections = 0;
+		stats->iterations = 0;
+		stats->abs_residual = abs_res;
+		stats->rel_residual = rel_res;
+		stats->convergence = convergence;
+	}
+
+	// Release solver memory.
+	c_phase = -1;
+	cluster_sparse_solver(c_pt, &c_maxfct, &c_mnum, &c_mtype, &c_phase, &DIM0, &c_ddum, A.ia, A.ja,
+		&c_idum, &c_nrhs, c_iparm, &c_msglvl, &c_ddum, &c_ddum, &fcomm, &c_error);
+
+	// Clear memory.
+	csr_deallocate(&A);
+	free(g_u);
+	free(g_f);
+	free(g_s);
+	free(g_res);
+	if (mixed)
+	{
+		free(g_a);
+		free(g_b);
+		free(g_c);
+		free(g_d);
+		free(g_e);
+	}
+	free(counts);
+	free(displs);
+
+	if (stats)
+		stats->t_total = omp_get_wtime() - t_start;
+
+	return;
+}
+
+// Flat Laplacian on the ranks of comm.
+void flat_laplacian_mpi(double *u,	// Output solution.
+	double *res,		// Ouput residual.
+	const double *s,	// Input linear source.
+	const double *f,	// Input RHS.
+	const double uInf,	// u value at infinity for Robin BC.
+	const int robin,	// Robin BC type: 1, 2, 3.
+	const int r_sym,	// R symmetry: 1(even), -1(odd).
+	const int z_sym,	// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost_zones,	// Number of ghost zones.
+	const double dr, 	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2, 4, 6 or -4 (compact).
+	MPI_Comm comm,		// Communicator of the ranks sharing the solve.
+	solver_stats *stats)	// Output solver statistics, may be NULL.
+{
+	distributed_solve(u, res, NULL, NULL, NULL, NULL, NULL, s, f, uInf, robin, r_sym, z_sym,
+		NrInterior, NzInterior, ghost_zones, dr, dz, norder, comm, "FLAT LAPLACIAN MPI", stats);
+
+	return;
+}
+
+// General elliptic equation on the ranks of comm.
+void general_elliptic_mpi(double *u,	// Output solution.
+	double *res,		// Ouput residual.
+	const double *ell_a,	// Coefficient of (d^2/dr^2)
+	const double *ell_b,	// Coefficient of (d^2/drdz)
+	const double *ell_c,	// Coefficient of (d^2/dz^2)
+	const double *ell_d,	// Coefficient of (d/dr)
+	const double *ell_e,	// Coefficient of (d/dz)
+	const double *ell_s,	// Input linear source.
+	const double *ell_f,	// Input RHS.
+	const double uInf,	// u value at infinity for Robin BC.
+	const int robin,	// Robin BC type: 1, 2, 3.
+	const int r_sym,	// R symmetry: 1(even), -1(odd).
+	const int z_sym,	// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost_zones,	// Number of ghost zones.
+	const double dr, 	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2, 4 or 6.
+	MPI_Comm comm,		// Communicator of the ranks sharing the solve.
+	solver_stats *stats)	// Output solver statistics, may be NULL.
+{
+	distributed_solve(u, res, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, robin, r_sym, z_sym,
+		NrInterior, NzInterior, ghost_zones, dr, dz, norder, comm, "GENERAL ELLIPTIC MPI", stats);
+
+	return;
+}
@@ -0,0 +1,43 @@
+// Distributed solves with MKL's Cluster Sparse Solver: the reduced grid is
+// split into r-strips, one per rank of comm, and every rank assembles and
+// factors only its own rows. Grid functions are replicated: every rank
+// passes the full input arrays and receives the full solution and residual.
+// Always uses the table-driven generator: orders 2, 4, 6 and -4 (flat only).
+void flat_laplacian_mpi(double *u,	// Output solution.
+	double *res,		// Ouput residual.
+	const double *s,	// Input linear source.
+	const double *f,	// Input RHS.
+	const double uInf,	// u value at infinity for Robin BC.
+	const int robin,	// Robin BC type: 1, 2, 3.
+	const int r_sym,	// R symmetry: 1(even), -1(odd).
+	const int z_sym,	// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost_zones,	// Number of ghost zones.
+	const double dr, 	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2, 4, 6 or -4 (compact).
+	MPI_Comm comm,		// Communicator of the ranks sharing the solve.
+	solver_stats *stats);	// Output solver statistics, may be NULL.
+
+void general_elliptic_mpi(double *u,	// Output solution.
+	double *res,		// Ouput residual.
+	const double *ell_a,	// Coefficient of (d^2/dr^2)
+	const double *ell_b,	// Coefficient of (d^2/drdz)
+	const double *ell_c,	// Coefficient of (d^2/dz^2)
+	const double *ell_d,	// Coefficient of (d/dr)
+	const double *ell_e,	// Coefficient of (d/dz)
+	const double *ell_s,	// Input linear source.
+	const double *ell_f,	// Input RHS.
+	const double uInf,	// u value at infinity for Robin BC.
+	const int robin,	// Robin BC type: 1, 2, 3.
+	const int r_sym,	// R symmetry: 1(even), -1(odd).
+	const int z_sym,	// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost_zones,	// Number of ghost zones.
+	const double dr, 	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2, 4 or 6.
+	MPI_Comm comm,		// Communicator of the ranks sharing the solve.
+	solver_stats *stats);	// Output solver statistics, may be NULL.
@@ -20,7 +20,7 @@ void ghost_reduce(const double *u, 		// Original array to reduce.
 	// Loop over interior points.
 	#pragma omp parallel shared(g_u) private(j)
 	{
-		#pragma omp for schedule(guided)
+		#pragma omp for schedule(static)
 		for (i = 0; i < NrInterior + 2; i++)
 		{
 			for (j = 0; j < NzInterior + 2; j++)
@@ -56,7 +56,7 @@ void ghost_fill(const double *g_u, 	// Reduced to array to extend.
 	// Fill points that coincide with reduced array.
 	#pragma omp parallel shared(u) private(j)
 	{
-		#pragma omp for schedule(guided)
+		#pragma omp for schedule(static)
 		for (i = 0; i < NrInterior + 2; i++)
 		{
 			for (j = 0; j < NzInterior + 2; j++)
@@ -73,7 +73,7 @@ void ghost_fill(const double *g_u, 	// Reduced to array to extend.
 		// Correct R boundaries.
 		#pragma omp parallel shared(u) 
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = k + 1; j < NzInterior + ghost + 1; j++)
 			{
 				// Symmetry.
@@ -84,7 +84,7 @@ void ghost_fill(const double *g_u, 	// Reduced to array to extend.
 		// Correct Z boundaries.
 		#pragma omp parallel shared(u)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (i = k + 1; i < NrInterior + ghost + 1; i++)
 			{
 				// Symmetry.
@@ -98,3 +98,227 @@ void ghost_fill(const double *g_u, 	// Reduced to array to extend.
 
 	return;
 }
+
+// Restrict array u to array c_u on a grid with twice the spatial step.
+//
+// Both grids are cell-centered with the same number of ghost zones, so the
+// coarse point (i - ghost + 1/2) * 2h is the center of fine points 2(i - ghost) + ghost
+// and the next one in each direction. Coarse points are the 2x2 average of
+// those fine points, which is second-order accurate. Fine points outside the
+// grid are clamped: they only reach ghost zones below ghost - 1 and the
+// outer boundary, which the CSR generators overwrite.
+void grid_restrict(const double *u,	// Fine array to restrict.
+		double *c_u,		// Output coarse array.
+		const int NrInterior,	// Number of fine interior points in r: must be even.
+		const int NzInterior,	// Number of fine interior points in z: must be even.
+		const int ghost)	// Number of ghost zones.
+{
+	// Auxiliary integers.
+	int i, j, i1, i2, j1, j2;
+	int NrTotal = ghost + NrInterior + 1;
+	int NzTotal = ghost + NzInterior + 1;
+	int c_NrTotal = ghost + NrInterior / 2 + 1;
+	int c_NzTotal = ghost + NzInterior / 2 + 1;
+
+	#pragma omp parallel shared(c_u) private(j, i1, i2, j1, j2)
+	{
+		#pragma omp for schedule(static)
+		for (i = 0; i < c_NrTotal; i++)
+		{
+			i1 = 2 * (i - ghost) + ghost;
+			i1 = (i1 < 0) ? 0 : i1;
+			i2 = (i1 + 1 < NrTotal) ? i1 + 1 : i1;
+			for (j = 0; j < c_NzTotal; j++)
+			{
+				j1 = 2 * (j - ghost) + ghost;
+				j1 = (j1 < 0) ? 0 : j1;
+				j2 = (j1 + 1 < NzTotal) ? j1 + 1 : j1;
+				c_u[i * c_NzTotal + j] = 0.25 * (u[IDX(i1, j1)] + u[IDX(i1, j2)] + u[IDX(i2, j1)] + u[IDX(i2, j2)]);
+			}
+		}
+	}
+
+	return;
+}
+
+// Cubic Lagrange weights on nodes 0, 1, 2, 3 at position t.
+static void cubic_weights(const double t, double *w)
+{
+	w[0] = -(t - 1.0) * (t - 2.0) * (t - 3.0) / 6.0;
+	w[1] = t * (t - 2.0) * (t - 3.0) / 2.0;
+	w[2] = -t * (t - 1.0) * (t - 3.0) / 2.0;
+	w[3] = t * (t - 1.0) * (t - 2.0) / 6.0;
+}
+
+// Prolong array c_u on a grid with twice the spatial step to array u.
+//
+// Tensor-product cubic Lagrange interpolation, fourth-order accurate. Fine
+// points lie a quarter coarse step from the nearest coarse point; stencils
+// are centered where possible and shifted inwards at the outer boundary.
+// The coarse ghost zones must already hold the symmetry values, as left by
+// ghost_fill, so the stencils near the axis and equator see the right parity.
+void grid_prolong(const double *c_u,	// Coarse array to prolong.
+		double *u,		// Output fine array.
+		const int NrInterior,	// Number of fine interior points in r: must be even.
+		const int NzInterior,	// Number of fine interior points in z: must be even.
+		const int ghost)	// Number of ghost zones.
+{
+	// Auxiliary integers.
+	int i, j, p, q, ir, jz;
+	int NrTotal = ghost + NrInterior + 1;
+	int NzTotal = ghost + NzInterior + 1;
+	int c_NrTotal = ghost + NrInterior / 2 + 1;
+	int c_NzTotal = ghost + NzInterior / 2 + 1;
+	// Coarse index coordinates and weights.
+	double x, sum, wr[4], wz[4];
+
+	#pragma omp parallel shared(u) private(j, p, q, ir, jz, x, sum, wr, wz)
+	{
+		#pragma omp for schedule(static)
+		for (i = 0; i < NrTotal; i++)
+		{
+			// Position of fine point i in coarse index space.
+			x = 0.5 * ((double)(i - ghost) + 0.5) - 0.5 + (double)ghost;
+			ir = (int)floor(x) - 1;
+			ir = (ir < 0) ? 0 : ((ir > c_NrTotal - 4) ? c_NrTotal - 4 : ir);
+			cubic_weights(x - (double)ir, wr);
+
+			for (j = 0; j < NzTotal; j++)
+			{
+				x = 0.5 * ((double)(j - ghost) + 0.5) - 0.5 + (double)ghost;
+				jz = (int)floor(x) - 1;
+				jz = (jz < 0) ? 0 : ((jz > c_NzTotal - 4) ? c_NzTotal - 4 : jz);
+				cubic_weights(x - (double)jz, wz);
+
+				sum = 0.0;
+				for (p = 0; p < 4; p++)
+				{
+					for (q = 0; q < 4; q++)
+					{
+						sum += wr[p] * wz[q] * c_u[(ir + p) * c_NzTotal + jz + q];
+					}
+				}
+				u[IDX(i, j)] = sum;
+			}
+		}
+	}
+
+	return;
+}
+
+// Restrict array u to array c_u on a grid with twice the spatial step by
+// tensor-product cubic interpolation, fourth-order accurate.
+//
+// Coarse points lie midway between two fine points, so interior stencils
+// are the symmetric (-1, 9, 9, -1) / 16. Unlike the 2x2 average this adds no
+// second order term, so coefficients and solutions compared across grids
+// keep the same error expansion. Stencils are shifted inwards at the edges
+// of the fine array: the fine ghost zones must hold the symmetry values.
+//
+// With r_weight set r * u is interpolated and divided by r afterwards, which
+// is exact for the 1/r coefficients of axisymmetric operators.
+void grid_restrict_cubic(const double *u,	// Fine array to restrict.
+		double *c_u,		// Output coarse array.
+		const int NrInterior,	// Number of fine interior points in r: must be even.
+		const int NzInterior,	// Number of fine interior points in z: must be even.
+		const int ghost,	// Number of ghost zones.
+		const int r_weight)	// Interpolate r * u: 1(yes), 0(no).
+{
+	// Auxiliary integers.
+	int i, j, p, q, ir, jz;
+	int NrTotal = ghost + NrInterior + 1;
+	int NzTotal = ghost + NzInterior + 1;
+	int c_NrTotal = ghost + NrInterior / 2 + 1;
+	int c_NzTotal = ghost + NzInterior / 2 + 1;
+	// Fine index coordinates, weights and r in units of the fine step.
+	double x, sum, wr[4], wz[4], rp[4], rc;
+
+	#pragma omp parallel shared(c_u) private(j, p, q, ir, jz, x, sum, wr, wz, rp, rc)
+	{
+		#pragma omp for schedule(static)
+		for (i = 0; i < c_NrTotal; i++)
+		{
+			// Position of coarse point i in fine index space.
+			x = 2.0 * (double)i - (double)ghost + 0.5;
+			ir = (int)floor(x) - 1;
+			ir = (ir < 0) ? 0 : ((ir > NrTotal - 4) ? NrTotal - 4 : ir);
+			cubic_weights(x - (double)ir, wr);
+			rc = r_weight ? x - (double)ghost + 0.5 : 1.0;
+			for (p = 0; p < 4; p++)
+				rp[p] = r_weight ? (double)(ir + p - ghost) + 0.5 : 1.0;
+
+			for (j = 0; j < c_NzTotal; j++)
+			{
+				x = 2.0 * (double)j - (double)ghost + 0.5;
+				jz = (int)floor(x) - 1;
+				jz = (jz < 0) ? 0 : ((jz > NzTotal - 4) ? NzTotal - 4 : jz);
+				cubic_weights(x - (double)jz, wz);
+
+				sum = 0.0;
+				for (p = 0; p < 4; p++)
+				{
+					for (q = 0; q < 4; q++)
+					{
+						sum += wr[p] * wz[q] * rp[p] * u[IDX(ir + p, jz + q)];
+					}
+				}
+				c_u[i * c_NzTotal + j] = sum / rc;
+			}
+		}
+	}
+
+	return;
+}
+
+// Interpolate reduced array g at reduced index coordinates (x, y) by
+// tensor-product cubic interpolation, fourth-order accurate.
+//
+// g has the (NrInterior + 2) x (NzInterior + 2) layout of the solvers, where
+// index i sits at (i - 1/2) times the step. Points on or below the axis or the
+// equator are folded back with the symmetry, so any x, y >= 0 is valid up
+// to the outer boundary, where stencils are shifted inwards.
+double grid_interpolate(const double *g,	// Reduced array.
+		const int NrInterior,	// Number of r interior points.
+		const int NzInterior,	// Number of z interior points.
+		const double x,		// Reduced index coordinate in r.
+		const double y,		// Reduced index coordinate in z.
+		const int r_sym,	// R symmetry: 1(even), -1(odd).
+		const int z_sym)	// Z symmetry: 1(even), -1(odd).
+{
+	int NzTotal = NzInterior + 2;
+	int p, q, m, n, ir, jz;
+	double wr[4], wz[4], sr, sz;
+	double sum = 0.0;
+
+	// First stencil points: shifted inwards at the outer boundary.
+	ir = (int)floor(x) - 1;
+	ir = (ir > NrInterior - 2) ? NrInterior - 2 : ir;
+	jz = (int)floor(y) - 1;
+	jz = (jz > NzInterior - 2) ? NzInterior - 2 : jz;
+	cubic_weights(x - (double)ir, wr);
+	cubic_weights(y - (double)jz, wz);
+
+	for (p = 0; p < 4; p++)
+	{
+		m = ir + p;
+		sr = 1.0;
+		if (m <= 0)
+		{
+			m = 1 - m;
+			sr = (double)r_sym;
+		}
+		for (q = 0; q < 4; q++)
+		{
+			n = jz + q;
+			sz = 1.0;
+			if (n <= 0)
+			{
+				n = 1 - n;
+				sz = (double)z_sym;
+			}
+			sum += wr[p] * wz[q] * sr * sz * g[IDX(m, n)];
+		}
+	}
+
+	return sum;
+}
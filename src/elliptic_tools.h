@@ -3,3 +3,17 @@ void ghost_reduce(const double *u, double *g_u, const int NrInterior, const int
 
 // Fill array u from elliptic solver sized-array g_u using symmetry conditions.
 void ghost_fill(const double *g_u, double *u, const int r_sym, const int z_sym, const int NrInterior, const int NzInterior, const int ghost);
+
+// Restrict array u to a grid with twice the spatial step by 2x2 averaging.
+void grid_restrict(const double *u, double *c_u, const int NrInterior, const int NzInterior, const int ghost);
+
+// Prolong array c_u from a grid with twice the spatial step using cubic interpolation.
+void grid_prolong(const double *c_u, double *u, const int NrInterior, const int NzInterior, const int ghost);
+
+// Restrict array u to a grid with twice the spatial step using cubic interpolation.
+void grid_restrict_cubic(const double *u, double *c_u, const int NrInterior, const int NzInterior, const int ghost,
+	const int r_weight);
+
+// Interpolate reduced array g at reduced index coordinates x, y using cubic interpolation.
+double grid_interpolate(const double *g, const int NrInterior, const int NzInterior, const double x, const double y,
+	const int r_sym, const int z_sym);
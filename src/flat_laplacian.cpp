@@ -3,8 +3,14 @@
 
 // Elliptic solver headers.
 #include "flat_laplacian_csr_gen.h"
+#include "stencil_csr_gen.h"
+#include "pardiso_param.h"
 #include "pardiso_wrapper.h"
 #include "elliptic_tools.h"
+#include "thread_profile.h"
+#include "perf_counters.h"
+#include "grid_map.h"
+#include "schwarz.h"
 
 // Use infinity norm in solver: 0(twonorm), 1(infnorm).
 #define INFNORM 0
@@ -24,7 +30,8 @@
 //     flat    rr     zz           r
 //
 //  And is solved to a specified order finite difference, 
-//  i.e. either second or fourth order.
+//  i.e. second, fourth or sixth order, or the fourth order
+//  compact scheme (-4) on uniform grids.
 //
 //  s(r, z) is a linear source.
 //  f(r, z) is the RHS.
@@ -32,7 +39,7 @@
 //  It returns the solution u(r, z) and the residual res(r, z).
 //
 #ifdef FORTRAN
-extern "C" void flat_laplacian_(double *u,	// Output solution.
+extern "C" int flat_laplacian_(double *u,	// Output solution.
 	double *res,		 // Ouput residual.
 	const double *s,	 // Input linear source.
 	const double *f,	 // Input RHS.
@@ -45,7 +52,7 @@ extern "C" void flat_laplacian_(double *u,	// Output solution.
 	const int *p_ghost_zones,// Number of ghost zones.
 	const double *p_dr, 	 // Spatial step in r.
 	const double *p_dz,	 // Spatial step in z.
-	const int *p_norder,	 // Finite difference evolution: 2 or 4.
+	const int *p_norder,	 // Finite difference evolution: 2, 4, 6 or -4 (compact).
 	const int *p_lr_use,	 // Use low rank update.
 	const int *p_precond_use)// Calculate and/or use preconditioner.
 {
@@ -62,8 +69,10 @@ extern "C" void flat_laplacian_(double *u,	// Output solution.
 	int norder = *p_norder;
 	int lr_use = *p_lr_use;
 	int precond_use = *p_precond_use;
+	// Statistics are only available from C.
+	solver_stats *stats = NULL;
 #else 
-void flat_laplacian(double *u,	// Output solution.
+int flat_laplacian(double *u,	// Output solution.
 	double *res,		// Ouput residual.
 	const double *s,	// Input linear source.
 	const double *f,	// Input RHS.
@@ -76,14 +85,39 @@ void flat_laplacian(double *u,	// Output solution.
 	const int ghost_zones,	// Number of ghost zones.
 	const double dr, 	// Spatial step in r.
 	const double dz,	// Spatial step in z.
-	const int norder,	// Finite difference evolution: 2 or 4.
+	const int norder,	// Finite difference evolution: 2, 4, 6 or -4 (compact).
 	const int lr_use,	// Use low rank update.
-	const int precond_use) 	// Calculate and/or use preconditioner.
+	const int precond_use,	// Calculate and/or use preconditioner.
+	solver_stats *stats)	// Output solver statistics, may be NULL.
 {
 #endif
 	// Set original number of ghost zones.
 	int ghost = ghost_zones;
 
+	// Wall-clock phase timers and hardware counters.
+	double t_start = omp_get_wtime();
+	perf_counters_reset();
+	double t0 = t_start;
+	double t_reduce, t_assemble, t_fill;
+
+	// Only the generated stencils are supported.
+	if ((norder != 2) && (norder != 4) && (norder != 6) && (norder != -4))
+	{
+		printf("FLAT LAPLACIAN: ERROR! Finite difference order %d is not supported, only 2, 4, 6 or -4.\n", norder);
+		if (stats)
+			stats->status = ELL_ERROR_ARGUMENT;
+		return ELL_ERROR_ARGUMENT;
+	}
+
+	// The compact scheme has no stretched grid stencil.
+	if (norder == -4 && grid_map_active())
+	{
+		printf("FLAT LAPLACIAN: ERROR! Compact fourth order needs a uniform grid.\n");
+		if (stats)
+			stats->status = ELL_ERROR_ARGUMENT;
+		return ELL_ERROR_ARGUMENT;
+	}
+
 	// The main point of this solver is that it works on a smaller grid
 	// than that used on the rest of the program.
 	// For a second and fourth order approximations, we use a grid of 
@@ -97,20 +131,21 @@ void flat_laplacian(double *u,	// Output solution.
 	// Ghost zones will later be reset to this original value.
 	int temp_ghost = ghost;
 
-	// Size of reduced arrays.
-	size_t g_size = (NrInterior + 2) * (NzInterior + 2) * sizeof(double);
-
-	// Allocate reduced arrays.
-	double *g_u = (double *)malloc(g_size);
-	double *g_f = (double *)malloc(g_size);
-	double *g_s = (double *)malloc(g_size);
-	double *g_res = (double *)malloc(g_size);
+	// Allocate reduced arrays: first-touch matches the static row partition.
+	double *g_u = grid_allocate(NrInterior + 2, NzInterior + 2);
+	double *g_f = grid_allocate(NrInterior + 2, NzInterior + 2);
+	double *g_s = grid_allocate(NrInterior + 2, NzInterior + 2);
+	double *g_res = grid_allocate(NrInterior + 2, NzInterior + 2);
 
 	// Reduce arrays.
+	thread_phase_begin(PHASE_REDUCE);
 	ghost_reduce(u, g_u, NrInterior, NzInterior, ghost);
 	ghost_reduce(f, g_f, NrInterior, NzInterior, ghost);
 	ghost_reduce(s, g_s, NrInterior, NzInterior, ghost);
 	ghost_reduce(res, g_res, NrInterior, NzInterior, ghost);
+	thread_phase_end();
+
+	t_reduce = omp_get_wtime() - t0;
 
 	// Set new ghost.
 	ghost = 1;
@@ -119,26 +154,100 @@ void flat_laplacian(double *u,	// Output solution.
 	int NrTotal = NrInterior + 2;
 	int NzTotal = NzInterior + 2;
 
+	// Sixth order, the compact scheme and stretched grids only have the
+	// table-driven generator.
+	int stretched = grid_map_active();
+	int tabled = (norder == 6 || norder == -4 || stretched);
+
 	// Allocate and generate CSR matrix.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_ASSEMBLE);
 	csr_matrix A;
 	int DIM0 = NrTotal * NzTotal;
-	int nnz0 = nnz_flat_laplacian(NrInterior, NzInterior, norder, robin);
+	int nnz0 = tabled ? nnz_stencil(NrInterior, NzInterior, norder, robin, 0)
+		: nnz_flat_laplacian(NrInterior, NzInterior, norder, robin);
 	csr_allocate(&A, DIM0, DIM0, nnz0);
 	printf("FLAT LAPLACIAN: Generated CSR matrix with %d rows, %d columns and %d nnz.\n", A.nrows, A.ncols, A.nnz);
 
-	// Fill CSR matrix.
-	csr_gen_flat_laplacian(A, NrInterior, NzInterior, norder, dr, dz, g_s, g_f, uInf, robin, r_sym, z_sym);
+	// Fill CSR matrix: the generators reject unsupported arguments.
+	int status = ELL_SUCCESS;
+	if (tabled)
+		csr_gen_stencil(A, NrInterior, NzInterior, norder, dr, dz, NULL, NULL, NULL, NULL, NULL, g_s, g_f, uInf, robin, r_sym, z_sym);
+	else
+		status = csr_gen_flat_laplacian(A, NrInterior, NzInterior, norder, dr, dz, g_s, g_f, uInf, robin, r_sym, z_sym);
+
+	// Deferred correction: the second order matrix is factored instead and
+	// the fourth order one only enters through its residual.
+	int deferred = (dc_use > 0 && norder == 4 && !lr_use && !precond_use);
+	// Additive Schwarz: one LU per overlapping subdomain and GMRES.
+	int schwarz = (schwarz_use > 0 && !deferred && !lr_use && !precond_use);
+	csr_matrix A2;
+	double *g_f2 = NULL;
+	if (deferred)
+	{
+		g_f2 = grid_allocate(NrTotal, NzTotal);
+		ghost_reduce(f, g_f2, NrInterior, NzInterior, temp_ghost);
+		if (stretched)
+		{
+			csr_allocate(&A2, DIM0, DIM0, nnz_stencil(NrInterior, NzInterior, 2, robin, 0));
+			csr_gen_stencil(A2, NrInterior, NzInterior, 2, dr, dz, NULL, NULL, NULL, NULL, NULL, g_s, g_f2, uInf, robin, r_sym, z_sym);
+		}
+		else
+		{
+			csr_allocate(&A2, DIM0, DIM0, nnz_flat_laplacian(NrInterior, NzInterior, 2, robin));
+			status = csr_gen_flat_laplacian(A2, NrInterior, NzInterior, 2, dr, dz, g_s, g_f2, uInf, robin, r_sym, z_sym);
+		}
+	}
+	thread_phase_end();
+
+	t_assemble = omp_get_wtime() - t0;
 
 	// Elliptic solver return variables.
 	double norm = 0.0;
 	int convergence = 0;
-	double tol = (norder == 4) ? dr * dr * dz * dz : dr * dz;
+	double tol = (norder == 6) ? dr * dr * dr * dz * dz * dz : (norder == 4 || norder == -4) ? dr * dr * dz * dz : dr * dz;
+
+	// Low rank diff arrays of low_rank.cpp only cover orders 2 and 4 on
+	// uniform grids: otherwise the changed entries are detected instead.
+	int low_rank = lr_use;
+	if ((norder == 6 || stretched) && lr_use == 1)
+	{
+		printf("FLAT LAPLACIAN: Table-driven low rank update detects changed entries.\n");
+		low_rank = 2;
+	}
+	// The compact stencil depends on s at all nine points, not only the diagonal.
+	else if (norder == -4 && lr_use == 1)
+	{
+		printf("FLAT LAPLACIAN: Compact low rank update detects changed entries.\n");
+		low_rank = 2;
+	}
 
-	// Call elliptic solver.
-	pardiso_wrapper(A, g_u, g_f, g_res, tol, &norm, &convergence, INFNORM, lr_use, precond_use);
+	// Call elliptic solver: every path returns a status code.
+	if (status != ELL_SUCCESS)
+	{
+		printf("FLAT LAPLACIAN: ERROR! Unsupported order %d or Robin type %d.\n", norder, robin);
+	}
+	else if (deferred)
+	{
+		printf("FLAT LAPLACIAN: Deferred correction with the second order LU.\n");
+		status = pardiso_deferred(A2, A, g_u, g_f2, g_f, g_res, tol, &norm, &convergence, INFNORM, dc_use, stats);
+	}
+	else if (schwarz)
+	{
+		printf("FLAT LAPLACIAN: Additive Schwarz GMRES with %d x %d subdomains.\n", schwarz_use, schwarz_use);
+		status = schwarz_gmres(A, g_u, g_f, g_res, NrInterior, NzInterior, tol, &norm, &convergence, INFNORM, schwarz_use, stats);
+	}
+	else
+	{
+		status = pardiso_wrapper(A, g_u, g_f, g_res, tol, &norm, &convergence, INFNORM, low_rank, precond_use, stats);
+	}
 
-	// Check solver convergence.
-	if (convergence == 1)
+	// Check solver status and convergence.
+	if (status != ELL_SUCCESS)
+	{
+		printf("FLAT LAPLACIAN: ERROR! Solver failed with status %d, solution and residual unchanged.\n", status);
+	}
+	else if (convergence == 1)
 	{
 		printf("FLAT LAPLACIAN: Solver converged!\n");
 	}
@@ -153,9 +262,17 @@ void flat_laplacian(double *u,	// Output solution.
 	NzTotal = NzInterior + ghost + 1;
 	NrTotal = NrInterior + ghost + 1;
 
-	// Transfer solution and residual to original arrays.
-	ghost_fill(g_u, u, r_sym, z_sym, NrInterior, NzInterior, ghost);
-	ghost_fill(g_res, res, r_sym, z_sym, NrInterior, NzInterior, ghost);
+	// Transfer solution and residual to original arrays: a failed solve
+	// leaves them as they were.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_FILL);
+	if (status == ELL_SUCCESS)
+	{
+		ghost_fill(g_u, u, r_sym, z_sym, NrInterior, NzInterior, ghost);
+		ghost_fill(g_res, res, r_sym, z_sym, NrInterior, NzInterior, ghost);
+	}
+	thread_phase_end();
+	t_fill = omp_get_wtime() - t0;
 
 	// Clear memory.
 	free(g_u);
@@ -165,6 +282,28 @@ void flat_laplacian(double *u,	// Output solution.
 
 	// Clear CSR matrix.
 	csr_deallocate(&A);
+	if (deferred)
+	{
+		free(g_f2);
+		csr_deallocate(&A2);
+	}
+
+	// Report solver statistics: PARDISO phases were filled by the wrapper.
+	if (stats)
+	{
+		stats->solver = "flat";
+		stats->NrInterior = NrInterior;
+		stats->NzInterior = NzInterior;
+		stats->order = norder;
+		stats->robin = robin;
+		stats->t_reduce = t_reduce;
+		stats->t_assemble = t_assemble;
+		stats->t_fill = t_fill;
+		stats->t_coarse = 0.0;
+		stats->t_total = omp_get_wtime() - t_start;
+		stats->status = status;
+		perf_counters_read(stats);
+	}
 
-	return;
+	return status;
 }
@@ -1,4 +1,6 @@
-void flat_laplacian(double *u,	// Output solution.
+// Returns ELL_SUCCESS or the status code of the failed PARDISO phase, in
+// which case u and res are left unchanged.
+int flat_laplacian(double *u,	// Output solution.
 	double *res,		// Ouput residual.
 	const double *s,	// Input linear source.
 	const double *f,	// Input RHS.
@@ -11,6 +13,7 @@ void flat_laplacian(double *u,	// Output solution.
 	const int ghost_zones,	// Number of ghost zones.
 	const double dr, 	// Spatial step in r.
 	const double dz,	// Spatial step in z.
-	const int norder,	// Finite difference evolution: 2 or 4.
+	const int norder,	// Finite difference evolution: 2, 4, 6 or -4 (compact).
 	const int lr_use,	// Low rank update.
-	const int precond_use);	// Calculate and/or use preconditioner.
+	const int precond_use,	// Calculate and/or use preconditioner.
+	solver_stats *stats = NULL);// Output solver statistics, optional.
@@ -31,17 +31,18 @@ int nnz_flat_laplacian(const int NrInterior, const int NzInterior, const int ord
 	return nnz;
 }
 
-// Write CSR matrix for the flat laplacian.
-void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
+// Write CSR matrix for the flat laplacian, specialized at compile time on
+// finite difference order and Robin BC type so that the order branches and
+// the Robin switches on boundary rows are resolved by the compiler.
+template <int order, int robin>
+static void csr_gen_flat_laplacian_kernel(csr_matrix A,	// CSR matrix structure.
 	const int NrInterior,			// Number of r interior points.
 	const int NzInterior,			// Number of z interior points.
-	const int order,			// Finite difference order: 2 or 4.
 	const double dr,			// Spatial step in r.
 	const double dz,			// Spatial step in z.
 	const double *s,			// Linear source.
 	double *f,				// RHS.
 	const double uInf,			// Value at infinity.
-	const int robin,			// Robin BC type: 1, 2, 3.
 	const int r_sym,			// R symmetry: 1(even), -1(odd).
 	const int z_sym)			// Z symmetry: 1(even), -1(odd).
 {
@@ -90,7 +91,7 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 		// Fill left-boundary using axis symmetry.
 		#pragma omp parallel shared(A, f) private(offset)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 1; j < NzInterior + 1; j++)
 			{
 				// Each j iteration fills 2 elements.
@@ -123,7 +124,7 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 		// Robin and equatorial symmetry respectively.
 		#pragma omp parallel shared(A, f) private(offset, j, r, z, ir, rr2, robin1, robin2, robin3)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (i = 1; i < NrInterior + 1; i++)
 			{
 				// Each iteration of i loop will fill 5 * NzInterior + (2 + n_robin) values.
@@ -236,7 +237,7 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 		r = (double)NrInterior + 0.5;
 		#pragma omp parallel shared(A, f) private(offset, z, rr2, robin1, robin2, robin3)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 1; j < NzInterior + 1; j++)
 			{
 
@@ -370,7 +371,7 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 		// Fill left-boundary using axis symmetry.
 		#pragma omp parallel shared(A, f) private(offset)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 1; j < NzInterior + 1; j++)
 			{
 				// Each j iteration fills 2 elements.
@@ -489,7 +490,7 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 		//
 		#pragma omp parallel shared(A, f) private(offset)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 2; j < NzInterior; j++)
 			{
 				// Each iteration fills 8 elements.
@@ -646,7 +647,7 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 		#pragma omp parallel shared(A, f) private(j, offset, r, z, ir, rr2,\
 		robin1, robin2, robin3)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (i = 2; i < NrInterior; i++)
 			{
 				// Each iteration fills 2 + 8 + 9 * (NzInterior - 2) + 10 + n_robin points.
@@ -973,7 +974,7 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 
 		#pragma omp parallel shared(A, f) private(offset)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 2; j < NzInterior; j++)
 			{
 				// Eac iteration fills 10 elements.
@@ -1200,7 +1201,7 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 		#pragma omp parallel shared(A, f) private(offset, z, rr2,\
 		robin1, robin2, robin3)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 1; j < NzInterior + 1; j++)
 			{
 				// Each iteration fills n_robin elements.
@@ -1353,3 +1354,39 @@ void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 	// All done.
 	return;
 }
+
+// Generators for each finite difference order (2, 4) and Robin BC type (1, 2, 3).
+typedef void (*csr_gen_flat_laplacian_t)(csr_matrix, const int, const int, const double, const double,
+	const double *, double *, const double, const int, const int);
+static const csr_gen_flat_laplacian_t csr_gen_flat_laplacian_kernels[2][3] =
+{
+	{ csr_gen_flat_laplacian_kernel<2, 1>, csr_gen_flat_laplacian_kernel<2, 2>, csr_gen_flat_laplacian_kernel<2, 3> },
+	{ csr_gen_flat_laplacian_kernel<4, 1>, csr_gen_flat_laplacian_kernel<4, 2>, csr_gen_flat_laplacian_kernel<4, 3> }
+};
+
+// Write CSR matrix for the flat laplacian: dispatch to specialized generator.
+// Returns ELL_ERROR_ARGUMENT without touching A for an unsupported pair.
+int csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
+	const int NrInterior,			// Number of r interior points.
+	const int NzInterior,			// Number of z interior points.
+	const int order,			// Finite difference order: 2 or 4.
+	const double dr,			// Spatial step in r.
+	const double dz,			// Spatial step in z.
+	const double *s,			// Linear source.
+	double *f,				// RHS.
+	const double uInf,			// Value at infinity.
+	const int robin,			// Robin BC type: 1, 2, 3.
+	const int r_sym,			// R symmetry: 1(even), -1(odd).
+	const int z_sym)			// Z symmetry: 1(even), -1(odd).
+{
+	if ((order != 2 && order != 4) || robin < 1 || robin > 3)
+	{
+		printf("CSR_GEN_FLAT_LAPLACIAN: ERROR! Unsupported order = %d, robin = %d.\n", order, robin);
+		return ELL_ERROR_ARGUMENT;
+	}
+
+	csr_gen_flat_laplacian_kernels[order / 2 - 1][robin - 1](A, NrInterior, NzInterior, dr, dz,
+		s, f, uInf, r_sym, z_sym);
+
+	return ELL_SUCCESS;
+}
@@ -1,8 +1,9 @@
 // Nonzero elements calculator.
 int nnz_flat_laplacian(const int NrInterior, const int NzInterior, const int order, const int robin);
 
-// Write CSR matrix for the flat laplacian.
-void csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
+// Write CSR matrix for the flat laplacian. Returns ELL_SUCCESS, or
+// ELL_ERROR_ARGUMENT for an unsupported order or Robin type.
+int csr_gen_flat_laplacian(csr_matrix A,	// CSR matrix structure.
 	const int NrInterior,			// Number of r interior points.
 	const int NzInterior,			// Number of z interior points.
 	const int order,			// Finite difference order: 2 or 4.
@@ -1,4 +1,6 @@
-void general_elliptic(double *u,// Output solution.
+// Returns ELL_SUCCESS or the status code of the failed PARDISO phase, in
+// which case u and res are left unchanged.
+int general_elliptic(double *u,// Output solution.
 	double *res,		// Output residual. 
 	const double *ell_a,	// Input a coefficient.
 	const double *ell_b,	// Input b coefficient.
@@ -16,6 +18,7 @@ void general_elliptic(double *u,// Output solution.
 	const int ghost_zones,	// Number of ghost zones.
 	const double dr,	// Spatial step in r.
 	const double dz,	// Spatial step in z.
-	const int norder,	// Finite difference evolution: 2 or 4.
+	const int norder,	// Finite difference evolution: 2, 4 or 6.
 	const int lr_use,	// Use low rank update.
-	const int precond_use);	// Calculate and/or use preconditioner.
+	const int precond_use,	// Calculate and/or use preconditioner.
+	solver_stats *stats = NULL);// Output solver statistics, optional.
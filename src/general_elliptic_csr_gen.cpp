@@ -32,11 +32,14 @@ int nnz_general_elliptic(const int NrInterior, const int NzInterior, const int o
 	return nnz;
 }
 
-// Write CSR matrix for the general elliptic equation.
-void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
+// Write CSR matrix for the general elliptic equation, specialized at compile
+// time on finite difference order, Robin BC type and the presence of the
+// mixed derivative term. Without it (mixed = 0) ell_b is not read and its
+// stencil entries are written as zeros, so the sparsity pattern is the same.
+template <int order, int robin, int mixed>
+static void csr_gen_general_elliptic_kernel(csr_matrix A,	// CSR matrix structure.
 	const int NrInterior,			// Number of r interior points.	
 	const int NzInterior,			// Number of z interior points.
-	const int order,			// Finite difference order: 2 or 4.
 	const double dr,			// Spatial step in r.
 	const double dz,			// Spatial step in z.
 	const double *ell_a,			// Coefficient of (d^2/dr^2)
@@ -47,7 +50,6 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 	const double *ell_s,			// Linear source.
 	double *ell_f,				// RHS.
 	const double uInf,			// Value at infinity.
-	const int robin,			// Robin BC type: 1, 2, 3.
 	const int r_sym,			// R symmetry: 1(even), -1(odd).
 	const int z_sym)			// Z symmetry: 1(even), -1(odd).
 {
@@ -100,7 +102,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		// Fill left-boundary using axis symmetry.
 		#pragma omp parallel shared(A, ell_f) private(offset)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 1; j < NzInterior + 1; j++)
 			{
 				// Each j iteration fills 2 elements.
@@ -135,7 +137,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		aux_a, aux_b, aux_c, aux_d, aux_e, aux_s,\
 		robin1, robin2, robin3)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (i = 1; i < NrInterior + 1; i++)
 			{
 				// Each iteration of i loop will fill 9 * NzInterior + (2 + n_robin) values.
@@ -158,7 +160,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 				{
 					// Fetch values, notice the dr * dz rescaling.
 					aux_a = ell_a[IDX(i, j)] * zor;
-					aux_b = 0.25 * ell_b[IDX(i, j)];
+					aux_b = mixed ? 0.25 * ell_b[IDX(i, j)] : 0.0;
 					aux_c = ell_c[IDX(i, j)] * roz;
 					aux_d = 0.5 * dz * ell_d[IDX(i, j)];
 					aux_e = 0.5 * dr * ell_e[IDX(i, j)];
@@ -262,7 +264,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		#pragma omp parallel shared(A, ell_f) private(offset, z, rr2,\
 		robin1, robin2, robin3)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 1; j < NzInterior + 1; j++)
 			{
                 		// Overall division by dr**2.
@@ -398,7 +400,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		// Fill left-boundary using axis symmetry.
 		#pragma omp parallel shared(A, ell_f) private(offset)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 1; j < NzInterior + 1; j++)
 			{
 				// Each j iteration fills 2 elements.
@@ -477,7 +479,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		//
 		j = 1;
 		aux_a = ell_a[IDX(i, j)] * zor;
-		aux_b = ell_b[IDX(i, j)];
+		aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 		aux_c = ell_c[IDX(i, j)] * roz;
 		aux_d = dz * ell_d[IDX(i, j)];
 		aux_e = dr * ell_e[IDX(i, j)];
@@ -554,13 +556,13 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		#pragma omp parallel shared(A, ell_f) private(offset,\
 		aux_a, aux_b, aux_c, aux_d, aux_e, aux_s)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 2; j < NzInterior; j++)
 			{
 				// Each iterations fills 16 elements.
 				offset = t_offset + 16 * (j - 2);
 				aux_a = ell_a[IDX(i, j)] * zor;
-				aux_b = ell_b[IDX(i, j)];
+				aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 				aux_c = ell_c[IDX(i, j)] * roz;
 				aux_d = dz * ell_d[IDX(i, j)];
 				aux_e = dr * ell_e[IDX(i, j)];
@@ -653,7 +655,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		//
 		j = NzInterior;
 		aux_a = ell_a[IDX(i, j)] * zor;
-		aux_b = ell_b[IDX(i, j)];
+		aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 		aux_c = ell_c[IDX(i, j)] * roz;
 		aux_d = dz * ell_d[IDX(i, j)];
 		aux_e = dr * ell_e[IDX(i, j)];
@@ -775,7 +777,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		aux_a, aux_b, aux_c, aux_d, aux_e, aux_s,\
 		robin1, robin2, robin3)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (i = 2; i < NrInterior; i++)
 			{
 				// Each iteration fills 2 + 16 + 17 * (NzInterior - 2) + 26 + n_robin points.
@@ -825,7 +827,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 				//
 				j = 1;
 				aux_a = ell_a[IDX(i, j)] * zor;
-				aux_b = ell_b[IDX(i, j)];
+				aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 				aux_c = ell_c[IDX(i, j)] * roz;
 				aux_d = dz * ell_d[IDX(i, j)];
 				aux_e = dr * ell_e[IDX(i, j)];
@@ -902,7 +904,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 				for (j = 2; j < NzInterior; j++)
 				{
 					aux_a = ell_a[IDX(i, j)] * zor;
-					aux_b = ell_b[IDX(i, j)];
+					aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 					aux_c = ell_c[IDX(i, j)] * roz;
 					aux_d = dz * ell_d[IDX(i, j)];
 					aux_e = dr * ell_e[IDX(i, j)];
@@ -992,7 +994,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 				//
 				j = NzInterior;
 				aux_a = ell_a[IDX(i, j)] * zor;
-				aux_b = ell_b[IDX(i, j)];
+				aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 				aux_c = ell_c[IDX(i, j)] * roz;
 				aux_d = dz * ell_d[IDX(i, j)];
 				aux_e = dr * ell_e[IDX(i, j)];
@@ -1181,7 +1183,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		//
 		j = 1;
 		aux_a = ell_a[IDX(i, j)] * zor;
-		aux_b = ell_b[IDX(i, j)];
+		aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 		aux_c = ell_c[IDX(i, j)] * roz;
 		aux_d = dz * ell_d[IDX(i, j)];
 		aux_e = dr * ell_e[IDX(i, j)];
@@ -1243,7 +1245,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
         	#pragma omp parallel shared(A, ell_f) private(offset,\
 		aux_a, aux_b, aux_c, aux_d, aux_e, aux_s)
 		{
-            		#pragma omp for schedule(guided)
+            		#pragma omp for schedule(static)
 			for (j = 2; j < NzInterior; j++)
 			{
 				// Eac iteration fills 26 elements.
@@ -1291,7 +1293,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 				// u(i+1, j+2) : -b/48
 				//
 				aux_a = ell_a[IDX(i, j)] * zor;
-				aux_b = ell_b[IDX(i, j)];
+				aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 				aux_c = ell_c[IDX(i, j)] * roz;
 				aux_d = dz * ell_d[IDX(i, j)];
 				aux_e = dr * ell_e[IDX(i, j)];
@@ -1414,7 +1416,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 		//
 		j = NzInterior;
 		aux_a = ell_a[IDX(i, j)] * zor;
-		aux_b = ell_b[IDX(i, j)];
+		aux_b = mixed ? ell_b[IDX(i, j)] : 0.0;
 		aux_c = ell_c[IDX(i, j)] * roz;
 		aux_d = dz * ell_d[IDX(i, j)];
 		aux_e = dr * ell_e[IDX(i, j)];
@@ -1569,7 +1571,7 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
         	#pragma omp parallel shared(A, ell_f) private(offset, z, rr2,\
 		robin1, robin2, robin3)
 		{
-			#pragma omp for schedule(guided)
+			#pragma omp for schedule(static)
 			for (j = 1; j < NzInterior + 1; j++)
 			{
 				// Each iteration fills n_robin elements.
@@ -1730,3 +1732,70 @@ void csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
 	// All done.
 	return;
 }
+
+// Check if the mixed derivative coefficient is nonzero anywhere.
+static int csr_gen_mixed_derivative(const double *ell_b, const int NrInterior, const int NzInterior)
+{
+	int k;
+	int DIM = (NrInterior + 2) * (NzInterior + 2);
+	int mixed = 0;
+
+	#pragma omp parallel for schedule(static) reduction(||:mixed)
+	for (k = 0; k < DIM; k++)
+		mixed = mixed || (ell_b[k] != 0.0);
+
+	return mixed;
+}
+
+// Generators for each finite difference order (2, 4), Robin BC type (1, 2, 3)
+// and mixed derivative term (absent, present).
+typedef void (*csr_gen_general_elliptic_t)(csr_matrix, const int, const int, const double, const double,
+	const double *, const double *, const double *, const double *, const double *, const double *, double *,
+	const double, const int, const int);
+static const csr_gen_general_elliptic_t csr_gen_general_elliptic_kernels[2][3][2] =
+{
+	{
+		{ csr_gen_general_elliptic_kernel<2, 1, 0>, csr_gen_general_elliptic_kernel<2, 1, 1> },
+		{ csr_gen_general_elliptic_kernel<2, 2, 0>, csr_gen_general_elliptic_kernel<2, 2, 1> },
+		{ csr_gen_general_elliptic_kernel<2, 3, 0>, csr_gen_general_elliptic_kernel<2, 3, 1> }
+	},
+	{
+		{ csr_gen_general_elliptic_kernel<4, 1, 0>, csr_gen_general_elliptic_kernel<4, 1, 1> },
+		{ csr_gen_general_elliptic_kernel<4, 2, 0>, csr_gen_general_elliptic_kernel<4, 2, 1> },
+		{ csr_gen_general_elliptic_kernel<4, 3, 0>, csr_gen_general_elliptic_kernel<4, 3, 1> }
+	}
+};
+
+// Write CSR matrix for the general elliptic equation: dispatch to specialized generator.
+// Returns ELL_ERROR_ARGUMENT without touching A for an unsupported pair.
+int csr_gen_general_elliptic(csr_matrix A,	// CSR matrix structure.
+	const int NrInterior,			// Number of r interior points.	
+	const int NzInterior,			// Number of z interior points.
+	const int order,			// Finite difference order: 2 or 4.
+	const double dr,			// Spatial step in r.
+	const double dz,			// Spatial step in z.
+	const double *ell_a,			// Coefficient of (d^2/dr^2)
+	const double *ell_b,			// Coefficient of (d^2/drdz)
+	const double *ell_c,			// Coefficient of (d^2/dz^)
+	const double *ell_d,			// Coefficient of (d/dr)
+	const double *ell_e,			// Coefficient of (d/dz)
+	const double *ell_s,			// Linear source.
+	double *ell_f,				// RHS.
+	const double uInf,			// Value at infinity.
+	const int robin,			// Robin BC type: 1, 2, 3.
+	const int r_sym,			// R symmetry: 1(even), -1(odd).
+	const int z_sym)			// Z symmetry: 1(even), -1(odd).
+{
+	if ((order != 2 && order != 4) || robin < 1 || robin > 3)
+	{
+		printf("CSR_GEN_GENERAL_ELLIPTIC: ERROR! Unsupported order = %d, robin = %d.\n", order, robin);
+		return ELL_ERROR_ARGUMENT;
+	}
+
+	int mixed = csr_gen_mixed_derivative(ell_b, NrInterior, NzInterior);
+
+	csr_gen_general_elliptic_kernels[order / 2 - 1][robin - 1][mixed](A, NrInterior, NzInterior, dr, dz,
+		ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, r_sym, z_sym);
+
+	return ELL_SUCCESS;
+}
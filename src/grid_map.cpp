@@ -0,0 +1,146 @@
+// Global header.
+#include "tools.h"
+#include "grid_map.h"
+
+// Stretched grids: the solvers discretize on a uniform cell-centered grid in
+// map coordinates x, y with steps dr, dz, and the physical coordinates are
+// rho = rho(x), z = z(y). Derivatives transform with the analytic Jacobians,
+//	u_rho = u_x / rho',
+//	u_rhorho = u_xx / rho'^2 - rho'' u_x / rho'^3,
+// so a stretched problem is an elliptic problem with modified coefficients
+// on the uniform grid.
+//
+// Maps are odd, rho(-x) = -rho(x): ghost points below the axis or the
+// equator are mirror images in both coordinates and the symmetry conditions
+// of ghost_fill are unchanged.
+//
+// The sinh map rho = w sinh(x / w) has unit Jacobian at the origin, so the
+// resolution there is dr, and grows exponentially beyond x ~ w. The last
+// point sits at w sinh(NrInterior dr / w): far Robin boundaries cost a
+// logarithmic number of points.
+
+// Map type and width per direction.
+static int map_type[2] = { GRID_MAP_UNIFORM, GRID_MAP_UNIFORM };
+static double map_width[2] = { 1.0, 1.0 };
+
+// Set map of a direction.
+#ifdef FORTRAN
+extern "C" void grid_map_set_(const int *p_dir, const int *p_type, const double *p_width)
+{
+	int dir = *p_dir;
+	int type = *p_type;
+	double width = *p_width;
+#else
+void grid_map_set(const int dir, const int type, const double width)
+{
+#endif
+	if ((dir != GRID_MAP_R) && (dir != GRID_MAP_Z))
+	{
+		printf("GRID MAP: ERROR! Unknown direction %d.\n", dir);
+		exit(1);
+	}
+	if ((type != GRID_MAP_UNIFORM) && (type != GRID_MAP_SINH))
+	{
+		printf("GRID MAP: ERROR! Unknown map type %d.\n", type);
+		exit(1);
+	}
+	if ((type == GRID_MAP_SINH) && !(width > 0.0))
+	{
+		printf("GRID MAP: ERROR! Map width %3.3E must be positive.\n", width);
+		exit(1);
+	}
+
+	map_type[dir] = type;
+	map_width[dir] = (type == GRID_MAP_SINH) ? width : 1.0;
+
+	return;
+}
+
+// Get map type of a direction.
+int grid_map_type(const int dir)
+{
+	return map_type[dir];
+}
+
+// Any direction stretched.
+int grid_map_active(void)
+{
+	return (map_type[GRID_MAP_R] != GRID_MAP_UNIFORM) || (map_type[GRID_MAP_Z] != GRID_MAP_UNIFORM);
+}
+
+// Physical coordinate of map coordinate x.
+double grid_map_coord(const int dir, const double x)
+{
+	double w = map_width[dir];
+
+	switch (map_type[dir])
+	{
+		case GRID_MAP_SINH:
+			return w * sinh(x / w);
+		default:
+			return x;
+	}
+}
+
+// First, second and third derivatives of the physical coordinate at x.
+void grid_map_jacobian(const int dir, const double x, double *j1, double *j2, double *j3)
+{
+	double w = map_width[dir];
+
+	switch (map_type[dir])
+	{
+		case GRID_MAP_SINH:
+			*j1 = cosh(x / w);
+			*j2 = sinh(x / w) / w;
+			*j3 = cosh(x / w) / (w * w);
+			break;
+		default:
+			*j1 = 1.0;
+			*j2 = 0.0;
+			*j3 = 0.0;
+			break;
+	}
+
+	return;
+}
+
+// Physical coordinate and its derivatives on the reduced grid.
+void grid_map_line(const int dir, const int N, const double h, double *x, double *j1, double *j2, double *j3)
+{
+	int i;
+
+	for (i = 0; i < N + 2; i++)
+	{
+		x[i] = grid_map_coord(dir, ((double)i - 0.5) * h);
+		grid_map_jacobian(dir, ((double)i - 0.5) * h, j1 + i, j2 + i, j3 + i);
+	}
+
+	return;
+}
+
+// Fill physical coordinate grids r and z with ghost zones.
+void grid_map_coordinates(double *r, double *z, const int NrInterior, const int NzInterior, const int ghost,
+	const double dr, const double dz)
+{
+	int NrTotal = ghost + NrInterior + 1;
+	int NzTotal = ghost + NzInterior + 1;
+	int i, j;
+	double aux_r, aux_z;
+
+	#pragma omp parallel shared(r, z) private(j, aux_r, aux_z)
+	{
+		#pragma omp for schedule(static)
+		for (i = 0; i < NrTotal; i++)
+		{
+			aux_r = grid_map_coord(GRID_MAP_R, ((double)(i - ghost) + 0.5) * dr);
+			for (j = 0; j < NzTotal; j++)
+			{
+				aux_z = grid_map_coord(GRID_MAP_Z, ((double)(j - ghost) + 0.5) * dz);
+				r[IDX(i, j)] = aux_r;
+				z[IDX(i, j)] = aux_z;
+			}
+		}
+	}
+
+	return;
+}
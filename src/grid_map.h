@@ -0,0 +1,30 @@
+// Coordinate maps: uniform(0) or sinh(1).
+#define GRID_MAP_UNIFORM 0
+#define GRID_MAP_SINH 1
+
+// Directions.
+#define GRID_MAP_R 0
+#define GRID_MAP_Z 1
+
+// Set map of a direction: width is the sinh scale, ignored for uniform maps.
+void grid_map_set(const int dir, const int type, const double width);
+
+// Get map type of a direction.
+int grid_map_type(const int dir);
+
+// Any direction stretched: 1(yes), 0(no).
+int grid_map_active(void);
+
+// Physical coordinate of map coordinate x.
+double grid_map_coord(const int dir, const double x);
+
+// First, second and third derivatives of the physical coordinate at x.
+void grid_map_jacobian(const int dir, const double x, double *j1, double *j2, double *j3);
+
+// Physical coordinate and its derivatives on points x = (i - 0.5) h of the
+// reduced grid, i = 0 ... N + 1.
+void grid_map_line(const int dir, const int N, const double h, double *x, double *j1, double *j2, double *j3);
+
+// Fill physical coordinate grids r and z with ghost zones.
+void grid_map_coordinates(double *r, double *z, const int NrInterior, const int NzInterior, const int ghost,
+	const double dr, const double dz);
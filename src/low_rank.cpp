@@ -80,6 +80,11 @@ int ndiff_general_elliptic(const int NrInterior, const int NzInterior, const int
 		 + (16 + 26) * (NrInterior + NzInterior - 4)
 		 + (14 + 21 + 21 + 27);
 	}
+	// Sixth order: the solver detects changed entries instead.
+	else
+	{
+		ndiff = 0;
+	}
 
 	return ndiff;
 }
@@ -99,6 +104,11 @@ extern "C" void ndiff_general_elliptic_(int *ndiff, const int *NrInterior, const
 		 + (16 + 26) * (*NrInterior + *NzInterior - 4)
 		 + (14 + 21 + 21 + 27);
 	}
+	// Sixth order: the solver detects changed entries instead.
+	else
+	{
+		*ndiff = 0;
+	}
 
 	return;
 }
@@ -716,3 +726,121 @@ void low_rank_general_elliptic(const int NrInterior, const int NzInterior, const
 	// All done.
 	return;
 }
+
+// Store matrix values after a direct numerical factorization.
+//
+// These are the reference for low_rank_detect.
+void low_rank_store(const csr_matrix A)
+{
+	if (factored_nnz != A.nnz)
+	{
+		free(factored_a);
+		factored_a = (double *)malloc(A.nnz * sizeof(double));
+		factored_nnz = A.nnz;
+	}
+	memcpy(factored_a, A.a, A.nnz * sizeof(double));
+
+	return;
+}
+
+// Store matrix values after a low rank update.
+//
+// Only the entries listed in diff entered the factors: the others keep the
+// values of the last factorization, so their reference must not move.
+void low_rank_store_diff(const csr_matrix A)
+{
+	// Auxiliary integers.
+	int l, k, row, col;
+	// Index base of the CSR matrix.
+	int base = A.ia[0];
+
+	if (factored_a == NULL || factored_nnz != A.nnz)
+		return;
+
+	#pragma omp parallel for schedule(static) private(k, row, col)
+	for (l = 0; l < diff[0]; l++)
+	{
+		row = diff[1 + 2 * l] - BASE;
+		col = diff[2 + 2 * l] - BASE + base;
+		for (k = A.ia[row] - base; k < A.ia[row + 1] - base; k++)
+		{
+			if (A.ja[k] == col)
+			{
+				factored_a[k] = A.a[k];
+				break;
+			}
+		}
+	}
+
+	return;
+}
+
+// Fill diff array with the entries that changed since the stored factorization.
+//
+// An entry is different if |a - a0| > threshold * |a0|; threshold = 0 keeps
+// every entry that changed at all. The diff array is reallocated to the
+// number of different entries, which is returned. Returns -1 if no
+// factorization of a matrix with the same number of nonzeros was stored.
+int low_rank_detect(const csr_matrix A, const double threshold)
+{
+	// Auxiliary integers.
+	int i, k, offset;
+	int ndiff = 0;
+	// Index base of the CSR matrix.
+	int base = A.ia[0];
+
+	if (factored_a == NULL || factored_nnz != A.nnz)
+		return -1;
+
+	// Count different entries per row.
+	int *count = (int *)malloc((A.nrows + 1) * sizeof(int));
+	#pragma omp parallel shared(count) private(k)
+	{
+		#pragma omp for schedule(static)
+		for (i = 0; i < A.nrows; i++)
+		{
+			count[i + 1] = 0;
+			for (k = A.ia[i] - base; k < A.ia[i + 1] - base; k++)
+			{
+				if (fabs(A.a[k] - factored_a[k]) > threshold * fabs(factored_a[k]))
+					count[i + 1]++;
+			}
+		}
+	}
+
+	// Row offsets into diff array.
+	count[0] = 0;
+	for (i = 0; i < A.nrows; i++)
+		count[i + 1] += count[i];
+	ndiff = count[A.nrows];
+
+	// Reallocate diff array.
+	free(diff);
+	diff = (int *)malloc((2 * ndiff + 1) * sizeof(int));
+	diff[0] = ndiff;
+
+	// Row and column indices of different entries.
+	#pragma omp parallel shared(diff) private(k, offset)
+	{
+		#pragma omp for schedule(static)
+		for (i = 0; i < A.nrows; i++)
+		{
+			offset = 1 + 2 * count[i];
+			for (k = A.ia[i] - base; k < A.ia[i + 1] - base; k++)
+			{
+				if (fabs(A.a[k] - factored_a[k]) > threshold * fabs(factored_a[k]))
+				{
+					// Row indices.
+					diff[offset] = BASE + i;
+					// Column indices.
+					diff[offset + 1] = BASE + A.ja[k] - base;
+					offset += 2;
+				}
+			}
+		}
+	}
+
+	free(count);
+
+	return ndiff;
+}
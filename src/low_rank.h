@@ -17,3 +17,12 @@ void low_rank_flat_laplacian(const int NrInterior, const int NzInterior);
 
 // General elliptic equation.
 void low_rank_general_elliptic(const int NrInterior, const int NzInterior, const int order);
+
+// Store matrix values after a direct numerical factorization.
+void low_rank_store(const csr_matrix A);
+
+// Store matrix values of the entries in diff after a low rank update.
+void low_rank_store_diff(const csr_matrix A);
+
+// Fill diff array with the entries that changed since the stored factorization.
+int low_rank_detect(const csr_matrix A, const double threshold);
@@ -2,6 +2,7 @@
 #include "tools.h"
 
 // PARDISO tools.
+#include "pardiso_param.h"
 #include "pardiso_start.h"
 #include "pardiso_stop.h"
 #include "low_rank.h"
@@ -12,6 +13,30 @@
 // General solver.
 #include "general_elliptic.h"
 
+// Nested iteration.
+#include "nested_iteration.h"
+
+// Solve session.
+#include "solve_session.h"
+
+// Solver statistics.
+#include "solver_stats.h"
+
+// Stretched grids.
+#include "grid_map.h"
+
+// Batched solves.
+#include "batch.h"
+
+// Nonlinear solver.
+#include "newton.h"
+
+// Coupled systems.
+#include "block_elliptic.h"
+
+// Recycled Krylov solver.
+#include "recycle.h"
+
 // SOLVER RANGES.
 #define NRINTERIOR_MIN 32
 #define NRINTERIOR_MAX 2048
@@ -22,6 +47,47 @@
 #define DZ_MAX 1.0
 #define DZ_MIN 0.000976562
 
+// Number of solve session steps.
+#define SESSION_STEPS 8
+// Maximum number of deferred corrections for fourth order.
+#define DEFERRED_CORRECTIONS 10
+// Additive Schwarz subdomains per direction.
+#define SCHWARZ_SUBDOMAINS 4
+// Number of batched solves in the source scan.
+#define BATCH_JOBS 8
+// Amplitude of the nonlinear source of the Newton solves.
+#define NEWTON_AMPLITUDE 0.1
+// Coupled fields and strength of their first derivative coupling.
+#define BLOCK_FIELDS 2
+#define BLOCK_COUPLING 0.1
+// Linear source growth per step of the recycled sequence.
+#define RECYCLE_DRIFT 0.05
+
+// Nonlinear source w u^5 of a Hamiltonian-like constraint and its derivative.
+static void newton_source(const double *u, double *g, const int DIM, void *ctx)
+{
+	const double *w = (const double *)ctx;
+	int k;
+
+	#pragma omp parallel for schedule(static)
+	for (k = 0; k < DIM; k++)
+		g[k] = w[k] * u[k] * u[k] * u[k] * u[k] * u[k];
+
+	return;
+}
+
+static void newton_source_derivative(const double *u, double *g, const int DIM, void *ctx)
+{
+	const double *w = (const double *)ctx;
+	int k;
+
+	#pragma omp parallel for schedule(static)
+	for (k = 0; k < DIM; k++)
+		g[k] = 5.0 * w[k] * u[k] * u[k] * u[k] * u[k];
+
+	return;
+}
+
 int main(int argc, char *argv[])
 {
 	// PARAMETERS: Default values.
@@ -33,15 +99,20 @@ int main(int argc, char *argv[])
 	char solver[256] = "flat";
 	char dirname[256] = "output";
 	int nrobin = 1;
+	double stretch = 0.0;
 	// Grid variables.
 	int NrTotal = 0;
 	int NzTotal = 0;
 	int ghost = 0;
 	int DIM = 0;
-	// Various timers.
-	clock_t start_time[10];
-	clock_t end_time[10];
-	double time[10];
+	// Various wall-clock timers: clock() sums CPU time over OpenMP threads.
+	double start_time[14] = { 0.0 };
+	double end_time[14] = { 0.0 };
+	double time[14] = { 0.0 };
+
+	// Per-solve statistics, written as JSON lines.
+	solver_stats stats;
+	FILE *stats_fp = NULL;
 
 	// User input character.
 	char opt;
@@ -69,9 +140,14 @@ int main(int argc, char *argv[])
 
 		// Finite difference order.
 		norder = atoi(argv[3]);
-		if ((norder != 2) && (norder != 4))
+		if ((norder != 2) && (norder != 4) && (norder != 6) && (norder != -4))
+		{
+			printf("ELLSOLVEC: ERROR! Finite difference %d is not supported, only 2, 4, 6 or -4.\n", norder);
+			exit(1);
+		}
+		if ((norder == -4) && !(strcmp(solver, "flat") == 0))
 		{
-			printf("ELLSOLVEC: ERROR! Finite difference %d is not supported, only 2 or 4.\n", norder);
+			printf("ELLSOLVEC: ERROR! Compact fourth order is only supported by the flat solver.\n");
 			exit(1);
 		}
 
@@ -104,7 +180,7 @@ int main(int argc, char *argv[])
 		}
 	}
 	// Get possible Robin operator.
-	if (argc == 9)
+	if (argc >= 9)
 	{
 		nrobin = atoi(argv[8]);
 		if (nrobin != 1 && nrobin != 2 && nrobin != 3)
@@ -113,12 +189,32 @@ int main(int argc, char *argv[])
 			exit(1);
 		}
 	}
+	// Get possible stretching: sinh map of the same width in r and z.
+	if (argc >= 10)
+	{
+		stretch = atof(argv[9]);
+		if (stretch < 0.0)
+		{
+			printf("ELLSOLVEC: ERROR! stretch = %3.3E must not be negative.\n", stretch);
+			exit(1);
+		}
+		if (stretch > 0.0 && norder == -4)
+		{
+			printf("ELLSOLVEC: ERROR! Compact fourth order needs a uniform grid.\n");
+			exit(1);
+		}
+		if (stretch > 0.0)
+		{
+			grid_map_set(GRID_MAP_R, GRID_MAP_SINH, stretch);
+			grid_map_set(GRID_MAP_Z, GRID_MAP_SINH, stretch);
+		}
+	}
 
 	// Do I/O on output directory.
 	make_directory_and_cd(dirname);
 
-	// First get finite difference order.
-	if (norder == 2)
+	// First get finite difference order: the compact scheme keeps the 3x3 stencil.
+	if (norder == 2 || norder == -4)
 	{
 		ghost = 2;
 	}
@@ -126,6 +222,10 @@ int main(int argc, char *argv[])
 	{
 		ghost = 3;
 	}
+	else if (norder == 6)
+	{
+		ghost = 4;
+	}
 	// Calculate longitudinal dimensions.
 	NrTotal = ghost + NrInterior + 1;
 	NzTotal = ghost + NzInterior + 1;
@@ -141,6 +241,7 @@ int main(int argc, char *argv[])
 	printf("\tdr\t= %4.8E\n", dr);
 	printf("\tdz\t= %4.8E\n", dz);
 	printf("\tnrobin\t= %d\n", nrobin);
+	printf("\tstretch\t= %4.8E\n", stretch);
 
 	// Grid functions.
 	double *r, *z, *u, *f, *s, *res;
@@ -168,19 +269,16 @@ int main(int argc, char *argv[])
 	int i, j, k;
 
 	// Fill grids.
-	#pragma omp parallel shared(r, z, u, f, s, res, a, b, c, d, e) private(aux_r, aux_z, j, k)
+	// Static schedule: first touch places rows where ghost_reduce reads them.
+	#pragma omp parallel shared(r, z, u, f, s, res, a, b, c, d, e) private(j, k)
 	{
-		#pragma omp for schedule(guided)
+		#pragma omp for schedule(static)
 		for (i = 0; i < NrTotal; i++)
 		{
-			aux_r = ((double)(i - ghost) + 0.5) * dr;
 			for (j = 0; j < NzTotal; j++)
 			{
-				aux_z = ((double)(j - ghost) + 0.5) * dz;
 				k = IDX(i, j);
-				r[k] = aux_r;
-				z[k] = aux_z;
-				// Set everything else to zero.
+				// Set everything to zero.
 				u[k] = 0.0;
 				f[k] = 0.0;
 				s[k] = 0.0;
@@ -193,6 +291,9 @@ int main(int argc, char *argv[])
 			}
 		}
 	}
+	// Physical coordinates: uniform unless stretched.
+	grid_map_coordinates(r, z, NrInterior, NzInterior, ghost, dr, dz);
+
 	// Write coordinate grids.
 	write_single_file(r, "r.asc", NrTotal, NzTotal);
 	write_single_file(z, "z.asc", NrTotal, NzTotal);
@@ -201,6 +302,11 @@ int main(int argc, char *argv[])
 	// Intialize memory and parameters.
 	pardiso_start(NrInterior, NzInterior);
 
+	// Open statistics file: one JSON line per solve.
+	stats_fp = fopen("stats.jsonl", "w");
+	if (stats_fp == NULL)
+		printf("ELLSOLVEC: WARNING! Could not open stats.jsonl, statistics will not be written.\n");
+
 	// Choose between flat and general solver.
     	// Flat solver.
 	if (strcmp(solver, "flat") == 0)
@@ -227,21 +333,36 @@ int main(int argc, char *argv[])
 
 		// Call solver.
 		printf("ELLSOLVEC: Calling normal solver.\n");
-		start_time[0] = clock();
+		solver_stats_reset(&stats);
+		start_time[0] = omp_get_wtime();
 		flat_laplacian(u, res, s, f, 1.0, nrobin, 1, 1, 
 			NrInterior, NzInterior, ghost, dr, dz, norder,
-			0, 0);
-		end_time[0] = clock();
-		time[0] = (double)(end_time[0] - start_time[0])/CLOCKS_PER_SEC;
+			0, 0, &stats);
+		end_time[0] = omp_get_wtime();
+		time[0] = end_time[0] - start_time[0];
+		solver_stats_json(stats_fp, &stats);
 
 		// Precondition with CGS.
 		printf("ELLSOLVEC: Solving with CGS.\n");
-		start_time[3] = clock();
+		solver_stats_reset(&stats);
+		start_time[3] = omp_get_wtime();
 		flat_laplacian(u, res, s, f, 1.0, nrobin, 1, 1, 
 			NrInterior, NzInterior, ghost, dr, dz, norder,
-			0, 6);
-		end_time[3] = clock();
-		time[3] = (double)(end_time[3] - start_time[3])/CLOCKS_PER_SEC;
+			0, 6, &stats);
+		end_time[3] = omp_get_wtime();
+		time[3] = end_time[3] - start_time[3];
+		solver_stats_json(stats_fp, &stats);
+
+		// CGS seeded by a coarse grid solve.
+		printf("ELLSOLVEC: Solving with CGS and nested iteration.\n");
+		solver_stats_reset(&stats);
+		start_time[4] = omp_get_wtime();
+		flat_laplacian_nested(u, res, s, f, 1.0, nrobin, 1, 1, 
+			NrInterior, NzInterior, ghost, dr, dz, norder,
+			0, 6, &stats);
+		end_time[4] = omp_get_wtime();
+		time[4] = end_time[4] - start_time[4];
+		solver_stats_json(stats_fp, &stats);
 
 		// Low rank update solve.
 		// Get number of differing elements.
@@ -254,12 +375,14 @@ int main(int argc, char *argv[])
 
 		// Call solver with low rank update.
 		printf("ELLSOLVEC: Solving with low rank update.\n");
-		start_time[5] = clock();
+		solver_stats_reset(&stats);
+		start_time[5] = omp_get_wtime();
 		flat_laplacian(u, res, s, f, 1.0, nrobin, 1, 1, 
 			NrInterior, NzInterior, ghost, dr, dz, norder,
-			1, 0);
-		end_time[5] = clock();
-		time[5] = (double)(end_time[5] - start_time[5])/CLOCKS_PER_SEC;
+			1, 0, &stats);
+		end_time[5] = omp_get_wtime();
+		time[5] = end_time[5] - start_time[5];
+		solver_stats_json(stats_fp, &stats);
 	}
     	// General solver.
 	else if (strcmp(solver, "general") == 0)
@@ -296,21 +419,36 @@ int main(int argc, char *argv[])
 
 		// Call solver.
 		printf("ELLSOLVEC: Calling normal solver.\n");
-		start_time[0] = clock();
+		solver_stats_reset(&stats);
+		start_time[0] = omp_get_wtime();
 		general_elliptic(u, res, a, b, c, d, e, s, f, 1.0, nrobin, 1, 1, 
 			NrInterior, NzInterior, ghost, dr, dz, norder,
-			0, 0);
-		end_time[0] = clock();
-		time[0] = (double)(end_time[0] - start_time[0])/CLOCKS_PER_SEC;
+			0, 0, &stats);
+		end_time[0] = omp_get_wtime();
+		time[0] = end_time[0] - start_time[0];
+		solver_stats_json(stats_fp, &stats);
 
 		// Precondition with CGS.
 		printf("ELLSOLVEC: Solving with CGS.\n");
-		start_time[3] = clock();
+		solver_stats_reset(&stats);
+		start_time[3] = omp_get_wtime();
 		general_elliptic(u, res, a, b, c, d, e, s, f, 1.0, nrobin, 1, 1, 
 			NrInterior, NzInterior, ghost, dr, dz, norder,
-			0, 6);
-		end_time[3] = clock();
-		time[3] = (double)(end_time[3] - start_time[3])/CLOCKS_PER_SEC;
+			0, 6, &stats);
+		end_time[3] = omp_get_wtime();
+		time[3] = end_time[3] - start_time[3];
+		solver_stats_json(stats_fp, &stats);
+
+		// CGS seeded by a coarse grid solve.
+		printf("ELLSOLVEC: Solving with CGS and nested iteration.\n");
+		solver_stats_reset(&stats);
+		start_time[4] = omp_get_wtime();
+		general_elliptic_nested(u, res, a, b, c, d, e, s, f, 1.0, nrobin, 1, 1, 
+			NrInterior, NzInterior, ghost, dr, dz, norder,
+			0, 6, &stats);
+		end_time[4] = omp_get_wtime();
+		time[4] = end_time[4] - start_time[4];
+		solver_stats_json(stats_fp, &stats);
 
 		// Low rank update solve.
 		// Get number of differing elements.
@@ -323,19 +461,16 @@ int main(int argc, char *argv[])
 
 		// Call solver with low rank update.
 		printf("ELLSOLVEC: Solving whith low rank update.\n"); 
-		start_time[5] = clock(); 
+		solver_stats_reset(&stats);
+		start_time[5] = omp_get_wtime(); 
 		general_elliptic(u, res, a, b, c, d, e, s, f, 1.0, nrobin, 1, 1, 
 		NrInterior, NzInterior, ghost, dr, dz, norder,
-			1, 0);
-		end_time[5] = clock();
-		time[5] = (double)(end_time[5] - start_time[5])/CLOCKS_PER_SEC;
+			1, 0, &stats);
+		end_time[5] = omp_get_wtime();
+		time[5] = end_time[5] - start_time[5];
+		solver_stats_json(stats_fp, &stats);
 	}
 
-	// Print execution times.
-	printf("ELLSOLVEC: Normal solver took %3.3E seconds.\n", time[0]);
-	printf("ELLSOLVEC: Solver with CGS took %3.3E seconds.\n", time[3]);
-	printf("ELLSOLVEC: Solver with low rank update took %3.3E seconds.\n", time[5]);
-
 	// Write solution and residual.
 	write_single_file(u, "u.asc", NrTotal, NzTotal);
 	write_single_file(res, "res.asc", NrTotal, NzTotal);
@@ -346,6 +481,284 @@ int main(int argc, char *argv[])
 	// Clear memory and parameters.
 	pardiso_stop();
 
+	// Repeated solves with a slowly varying linear source: the session
+	// picks full factorization, CGS or low rank update at each step.
+	printf("ELLSOLVEC: Solving %d steps with a solve session.\n", SESSION_STEPS);
+	solve_session session;
+	double *s_step = (double *)malloc(DIM_size);
+	int step;
+	start_time[6] = omp_get_wtime();
+	solve_session_start(&session, strcmp(solver, "general") == 0, NrInterior, NzInterior, ghost, dr, dz, norder, nrobin);
+	for (step = 0; step < SESSION_STEPS; step++)
+	{
+		// Linear source grows by 1% per step.
+		for (k = 0; k < DIM; k++)
+			s_step[k] = (1.0 + 0.01 * (double)step) * s[k];
+
+		solver_stats_reset(&stats);
+		if (session.general)
+		{
+			solve_session_general(&session, u, res, a, b, c, d, e, s_step, f, 1.0, 1, 1, &stats);
+		}
+		else
+		{
+			solve_session_flat(&session, u, res, s_step, f, 1.0, 1, 1, &stats);
+		}
+		solver_stats_json(stats_fp, &stats);
+	}
+	solve_session_stop(&session);
+	end_time[6] = omp_get_wtime();
+	time[6] = end_time[6] - start_time[6];
+
+	// The same sequence with a larger drift, solved from zero by GMRES on
+	// the first LU without and with a recycled subspace.
+	printf("ELLSOLVEC: Solving %d steps with recycled Krylov subspaces.\n", SESSION_STEPS);
+	recycle_solver rec;
+	int recycle_iterations[2];
+	for (i = 0; i < 2; i++)
+	{
+		if (i == 1)
+			start_time[13] = omp_get_wtime();
+		recycle_start(&rec, strcmp(solver, "general") == 0, NrInterior, NzInterior, ghost, dr, dz, norder, nrobin);
+		if (i == 0)
+			rec.dimension = 0;
+		memset(u, 0, DIM_size);
+		for (step = 0; step < SESSION_STEPS; step++)
+		{
+			for (k = 0; k < DIM; k++)
+				s_step[k] = (1.0 + RECYCLE_DRIFT * (double)step) * s[k];
+
+			solver_stats_reset(&stats);
+			if (rec.general)
+			{
+				recycle_general(&rec, u, res, a, b, c, d, e, s_step, f, 1.0, 1, 1, &stats);
+			}
+			else
+			{
+				recycle_flat(&rec, u, res, s_step, f, 1.0, 1, 1, &stats);
+			}
+			if (i == 1)
+				solver_stats_json(stats_fp, &stats);
+		}
+		recycle_iterations[i] = rec.iterations;
+		recycle_stop(&rec);
+	}
+	end_time[13] = omp_get_wtime();
+	time[13] = end_time[13] - start_time[13];
+	free(s_step);
+
+	// Fourth order through deferred correction with the second order LU.
+	if (norder == 4)
+	{
+		printf("ELLSOLVEC: Solving with deferred correction.\n");
+		pardiso_start(NrInterior, NzInterior);
+		dc_use = DEFERRED_CORRECTIONS;
+		solver_stats_reset(&stats);
+		start_time[7] = omp_get_wtime();
+		if (strcmp(solver, "general") == 0)
+		{
+			general_elliptic(u, res, a, b, c, d, e, s, f, 1.0, nrobin, 1, 1,
+				NrInterior, NzInterior, ghost, dr, dz, norder,
+				0, 0, &stats);
+		}
+		else
+		{
+			flat_laplacian(u, res, s, f, 1.0, nrobin, 1, 1,
+				NrInterior, NzInterior, ghost, dr, dz, norder,
+				0, 0, &stats);
+		}
+		end_time[7] = omp_get_wtime();
+		time[7] = end_time[7] - start_time[7];
+		solver_stats_json(stats_fp, &stats);
+		pardiso_stop();
+	}
+
+	// Second order solves extrapolated with a coarse grid solve.
+	if (norder == 2)
+	{
+		printf("ELLSOLVEC: Solving with Richardson extrapolation.\n");
+		pardiso_start(NrInterior, NzInterior);
+		solver_stats_reset(&stats);
+		start_time[8] = omp_get_wtime();
+		if (strcmp(solver, "general") == 0)
+		{
+			general_elliptic_richardson(u, res, a, b, c, d, e, s, f, 1.0, nrobin, 1, 1,
+				NrInterior, NzInterior, ghost, dr, dz, norder, &stats);
+		}
+		else
+		{
+			flat_laplacian_richardson(u, res, s, f, 1.0, nrobin, 1, 1,
+				NrInterior, NzInterior, ghost, dr, dz, norder, &stats);
+		}
+		end_time[8] = omp_get_wtime();
+		time[8] = end_time[8] - start_time[8];
+		solver_stats_json(stats_fp, &stats);
+		pardiso_stop();
+	}
+
+	// One LU per overlapping subdomain and GMRES.
+	printf("ELLSOLVEC: Solving with additive Schwarz GMRES.\n");
+	pardiso_start(NrInterior, NzInterior);
+	schwarz_use = SCHWARZ_SUBDOMAINS;
+	// Cold start: GMRES would otherwise start from the previous solution.
+	memset(u, 0, DIM_size);
+	solver_stats_reset(&stats);
+	start_time[9] = omp_get_wtime();
+	if (strcmp(solver, "general") == 0)
+	{
+		general_elliptic(u, res, a, b, c, d, e, s, f, 1.0, nrobin, 1, 1,
+			NrInterior, NzInterior, ghost, dr, dz, norder,
+			0, 0, &stats);
+	}
+	else
+	{
+		flat_laplacian(u, res, s, f, 1.0, nrobin, 1, 1,
+			NrInterior, NzInterior, ghost, dr, dz, norder,
+			0, 0, &stats);
+	}
+	end_time[9] = omp_get_wtime();
+	time[9] = end_time[9] - start_time[9];
+	solver_stats_json(stats_fp, &stats);
+	pardiso_stop();
+
+	// Scan of the linear source s(1 + 0.01 k) as a batch of independent solves.
+	double batch_rate = 0.0;
+	int batch_failed = 0;
+	if (strcmp(solver, "general") == 0)
+	{
+		printf("ELLSOLVEC: Solving a batch of %d general problems.\n", BATCH_JOBS);
+		pardiso_start(NrInterior, NzInterior);
+		batch_job jobs[BATCH_JOBS];
+		for (j = 0; j < BATCH_JOBS; j++)
+		{
+			double *s_j = (double *)malloc(DIM_size);
+			for (k = 0; k < DIM; k++)
+				s_j[k] = s[k] * (1.0 + 0.01 * j);
+			jobs[j].ell_a = a;
+			jobs[j].ell_b = b;
+			jobs[j].ell_c = c;
+			jobs[j].ell_d = d;
+			jobs[j].ell_e = e;
+			jobs[j].ell_s = s_j;
+			jobs[j].ell_f = f;
+			jobs[j].uInf = 1.0;
+			jobs[j].u = (double *)malloc(DIM_size);
+			jobs[j].res = (double *)malloc(DIM_size);
+		}
+		start_time[10] = omp_get_wtime();
+		batch_failed = batch_solve(jobs, BATCH_JOBS, nrobin, 1, 1,
+			NrInterior, NzInterior, ghost, dr, dz, norder, 0, 0, &batch_rate);
+		end_time[10] = omp_get_wtime();
+		time[10] = end_time[10] - start_time[10];
+		for (j = 0; j < BATCH_JOBS; j++)
+		{
+			solver_stats_json(stats_fp, &jobs[j].stats);
+			free((double *)jobs[j].ell_s);
+			free(jobs[j].u);
+			free(jobs[j].res);
+		}
+		pardiso_stop();
+	}
+
+	// Nonlinear equation r (Lap u + w u^5) = 0 with every Jacobian strategy.
+	if (strcmp(solver, "general") == 0)
+	{
+		double *w = (double *)malloc(DIM_size);
+		for (k = 0; k < DIM; k++)
+			w[k] = NEWTON_AMPLITUDE * r[k] * exp(-r[k] * r[k] - z[k] * z[k]);
+		newton_solver newton;
+		newton_start(&newton, NrInterior, NzInterior, ghost, dr, dz, norder, nrobin);
+		start_time[11] = omp_get_wtime();
+		for (j = NEWTON_FULL; j <= NEWTON_INEXACT; j++)
+		{
+			printf("ELLSOLVEC: Solving nonlinear equation with %s.\n", j == NEWTON_FULL ? "full Newton"
+				: j == NEWTON_CHORD ? "chord" : j == NEWTON_SHAMANSKII ? "Shamanskii" : "inexact Newton");
+			for (k = 0; k < DIM; k++)
+				u[k] = 1.0;
+			newton.method = j;
+			solver_stats_reset(&stats);
+			newton_solve(&newton, u, res, a, b, c, d, e, f, newton_source, newton_source_derivative, w,
+				1.0, 1, 1, &stats);
+			solver_stats_json(stats_fp, &stats);
+		}
+		end_time[11] = omp_get_wtime();
+		time[11] = end_time[11] - start_time[11];
+		newton_stop(&newton);
+		free(w);
+	}
+
+	// Two copies of the general problem coupled through d/dr and d/dz.
+	if (strcmp(solver, "general") == 0)
+	{
+		printf("ELLSOLVEC: Solving %d coupled general problems.\n", BLOCK_FIELDS);
+		int nblock = BLOCK_FIELDS * BLOCK_FIELDS * DIM;
+		double *block_coeff = (double *)calloc(6 * nblock, sizeof(double));
+		double *block_f = (double *)malloc(BLOCK_FIELDS * DIM_size);
+		double *block_u = (double *)malloc(BLOCK_FIELDS * DIM_size);
+		double *block_res = (double *)malloc(BLOCK_FIELDS * DIM_size);
+		double block_uInf[BLOCK_FIELDS];
+		int block_r_sym[BLOCK_FIELDS], block_z_sym[BLOCK_FIELDS];
+		for (i = 0; i < BLOCK_FIELDS; i++)
+		{
+			int diag = (i * BLOCK_FIELDS + i) * DIM;
+			memcpy(block_coeff + diag, a, DIM_size);
+			memcpy(block_coeff + nblock + diag, b, DIM_size);
+			memcpy(block_coeff + 2 * nblock + diag, c, DIM_size);
+			memcpy(block_coeff + 3 * nblock + diag, d, DIM_size);
+			memcpy(block_coeff + 4 * nblock + diag, e, DIM_size);
+			memcpy(block_coeff + 5 * nblock + diag, s, DIM_size);
+			memcpy(block_f + i * DIM, f, DIM_size);
+			block_uInf[i] = 1.0;
+			block_r_sym[i] = 1;
+			block_z_sym[i] = 1;
+		}
+		for (k = 0; k < DIM; k++)
+		{
+			double w = BLOCK_COUPLING * r[k] * exp(-r[k] * r[k] - z[k] * z[k]);
+			block_coeff[3 * nblock + DIM + k] = w;
+			block_coeff[4 * nblock + 2 * DIM + k] = w;
+		}
+		pardiso_start(NrInterior, NzInterior);
+		solver_stats_reset(&stats);
+		start_time[12] = omp_get_wtime();
+		block_elliptic(block_u, block_res, block_coeff, block_coeff + nblock, block_coeff + 2 * nblock,
+			block_coeff + 3 * nblock, block_coeff + 4 * nblock, block_coeff + 5 * nblock, block_f,
+			block_uInf, nrobin, block_r_sym, block_z_sym, NrInterior, NzInterior, ghost, dr, dz, norder,
+			BLOCK_FIELDS, &stats);
+		end_time[12] = omp_get_wtime();
+		time[12] = end_time[12] - start_time[12];
+		solver_stats_json(stats_fp, &stats);
+		pardiso_stop();
+		free(block_coeff);
+		free(block_f);
+		free(block_u);
+		free(block_res);
+	}
+
+	// Print execution times.
+	printf("ELLSOLVEC: Normal solver took %3.3E seconds.\n", time[0]);
+	printf("ELLSOLVEC: Solver with CGS took %3.3E seconds.\n", time[3]);
+	printf("ELLSOLVEC: Solver with CGS and nested iteration took %3.3E seconds.\n", time[4]);
+	printf("ELLSOLVEC: Solver with low rank update took %3.3E seconds.\n", time[5]);
+	printf("ELLSOLVEC: Solve session of %d steps took %3.3E seconds.\n", SESSION_STEPS, time[6]);
+	if (norder == 4)
+		printf("ELLSOLVEC: Solver with %d deferred corrections took %3.3E seconds.\n", stats.corrections, time[7]);
+	if (norder == 2)
+		printf("ELLSOLVEC: Solver with Richardson extrapolation took %3.3E seconds.\n", time[8]);
+	printf("ELLSOLVEC: Solver with additive Schwarz GMRES took %3.3E seconds.\n", time[9]);
+	if (strcmp(solver, "general") == 0)
+		printf("ELLSOLVEC: Batch of %d solves (%d failed) took %3.3E seconds, %3.3E solves per second.\n", BATCH_JOBS, batch_failed, time[10], batch_rate);
+	if (strcmp(solver, "general") == 0)
+		printf("ELLSOLVEC: Nonlinear solves with four Newton strategies took %3.3E seconds.\n", time[11]);
+	if (strcmp(solver, "general") == 0)
+		printf("ELLSOLVEC: Coupled solve of %d fields took %3.3E seconds.\n", BLOCK_FIELDS, time[12]);
+	printf("ELLSOLVEC: Recycled sequence of %d steps took %3.3E seconds, %d iterations (%d without recycling).\n",
+		SESSION_STEPS, time[13], recycle_iterations[1], recycle_iterations[0]);
+
+	// Close statistics file.
+	if (stats_fp != NULL)
+		fclose(stats_fp);
+
 	// Deallocate memory.
 	printf("ELLSOLVEC: Cleaning up...\n");
 	free(r);
@@ -1,6 +1,8 @@
 PROGRAM ELLSOLVE_F90
 	! C BINDINGS MODULE USED FOR PROPER C SIZES.
 	USE ISO_C_BINDING
+	! OPENMP WALL-CLOCK TIMER.
+	USE OMP_LIB
 	! NO IMPLICIT VARIABLES.
 	IMPLICIT NONE 
 	! SOLVER RANGES.
@@ -33,7 +35,7 @@ PROGRAM ELLSOLVE_F90
 	REAL(KIND=C_DOUBLE) :: UINF = 1.0
 	INTEGER(KIND=C_INT) :: RSYM = 1, ZSYM = 1
 	INTEGER(KIND=C_INT) :: LR_USE = 0, PRECOND_USE = 0
-	! VARIOUS TIMERS.
+	! VARIOUS WALL-CLOCK TIMERS: CPU_TIME SUMS OVER OPENMP THREADS.
 	REAL(KIND=C_DOUBLE) :: START_TIME(10), END_TIME(10), TIMES(10)
 	! NUMBER OF ARGUMENTS.
 	INTEGER(KIND=C_INT) :: NUM_ARG
@@ -70,8 +72,12 @@ PROGRAM ELLSOLVE_F90
 		! FINITE DIFFERENCE ORDER.
 		CALL GETARG(3, STRING)
 		READ (STRING, *) NORDER
-		IF ((NORDER .NE. 2) .AND. (NORDER .NE. 4)) THEN
-		    PRINT *, 'ELLSOLVEF: ERROR! Finite difference ', NORDER, ' is not supported, only 2 or 4.'
+		IF ((NORDER .NE. 2) .AND. (NORDER .NE. 4) .AND. (NORDER .NE. 6) .AND. (NORDER .NE. -4)) THEN
+		    PRINT *, 'ELLSOLVEF: ERROR! Finite difference ', NORDER, ' is not supported, only 2, 4, 6 or -4.'
+		    CALL EXIT(1)
+		END IF
+		IF ((NORDER == -4) .AND. (TRIM(SOLVER) .NE. 'flat')) THEN
+		    PRINT *, 'ELLSOLVEF: ERROR! Compact fourth order is only supported by the flat solver.'
 		    CALL EXIT(1)
 		END IF
 
@@ -119,10 +125,12 @@ PROGRAM ELLSOLVE_F90
 	CALL MAKE_DIRECTORY_AND_CD(TRIM(DIRNAME)//C_NULL_CHAR)
 
 	! GET NUMBER OF GHOST ZONES ACCORDING TO FINITE DIFFERENCE ORDER.
-	IF (NORDER == 2) THEN
+	IF ((NORDER == 2) .OR. (NORDER == -4)) THEN
 		GHOST = 2
 	ELSEIF (NORDER == 4) THEN
 		GHOST = 3
+	ELSEIF (NORDER == 6) THEN
+		GHOST = 4
 	END IF
 	! CALCULATE LONGITUDINAL DIMENSIONS.
 	NRTOTAL = GHOST + NRINTERIOR + 1
@@ -208,24 +216,24 @@ PROGRAM ELLSOLVE_F90
 		! CALL VANILLA SOLVER.
 		! ONCE AGAIN, NOTICE THAT VARIABLES ARE PASSED BY VALUE.
 		PRINT *, 'ELLSOLVEF: Calling normal solver.'
-		CALL CPU_TIME(START_TIME(1))
+		START_TIME(1) = OMP_GET_WTIME()
 		CALL FLAT_LAPLACIAN(U, RES, S, F, UINF, NROBIN, RSYM, ZSYM,&
 		    NRINTERIOR, NZINTERIOR, GHOST,&
 		    DR, DZ, NORDER,&
 		    LR_USE, PRECOND_USE)
-		CALL CPU_TIME(END_TIME(1))
+		END_TIME(1) = OMP_GET_WTIME()
 		TIMES(1) = END_TIME(1) - START_TIME(1)
 
 		! CALCULATE OTHER TYPES OF SOLVER.
 		PRINT *, 'ELLSOLVEF: Solving with CGS.'
 		LR_USE = 0
 		PRECOND_USE = 6
-		CALL CPU_TIME(START_TIME(4))
+		START_TIME(4) = OMP_GET_WTIME()
 		CALL FLAT_LAPLACIAN(U, RES, S, F, UINF, NROBIN, RSYM, ZSYM,&
 		    NRINTERIOR, NZINTERIOR, GHOST,&
 		    DR, DZ, NORDER,&
 		    LR_USE, PRECOND_USE)
-		CALL CPU_TIME(END_TIME(4))
+		END_TIME(4) = OMP_GET_WTIME()
 		TIMES(4) = END_TIME(4) - START_TIME(4)
 
 		! LOW RANK UPDATE SOLVE.
@@ -240,12 +248,12 @@ PROGRAM ELLSOLVE_F90
 		PRINT *, 'ELLSOLVEF: Solving with low rank update.'
 		LR_USE = 1
 		PRECOND_USE = 0
-		CALL CPU_TIME(START_TIME(6))
+		START_TIME(6) = OMP_GET_WTIME()
 		CALL FLAT_LAPLACIAN(U, RES, S, F, UINF, NROBIN, RSYM, ZSYM,&
 		    NRINTERIOR, NZINTERIOR, GHOST,&
 		    DR, DZ, NORDER,&
 		    LR_USE, PRECOND_USE)
-		CALL CPU_TIME(END_TIME(6))
+		END_TIME(6) = OMP_GET_WTIME()
 		TIMES(6) = END_TIME(6) - START_TIME(6)
 	ELSE IF (SOLVER == 'general') THEN
 		! FILLL COEFFICIENTS AND RHS.
@@ -279,24 +287,24 @@ PROGRAM ELLSOLVE_F90
 		! CALL VANILLA SOLVER.
 		! ONCE AGAIN, NOTICE THAT VARIABLES ARE PASSED BY VALUE.
 		PRINT *, 'ELLSOLVEF: Calling normal solver.'
-		CALL CPU_TIME(START_TIME(1))
+		START_TIME(1) = OMP_GET_WTIME()
 		CALL GENERAL_ELLIPTIC(U, RES, A, B, C, D, E, S, F, UINF, NROBIN, RSYM, ZSYM,&
 		    NRINTERIOR, NZINTERIOR, GHOST,&
 		    DR, DZ, NORDER,&
 		    LR_USE, PRECOND_USE)
-		CALL CPU_TIME(END_TIME(1))
+		END_TIME(1) = OMP_GET_WTIME()
 		TIMES(1) = END_TIME(1) - START_TIME(1)
 
 		! CALCULATE OTHER TYPES OF SOLVER.
 		PRINT *, 'ELLSOLVEF: Solving with CGS.'
 		LR_USE = 0
 		PRECOND_USE = 6
-		CALL CPU_TIME(START_TIME(4))
+		START_TIME(4) = OMP_GET_WTIME()
 		CALL GENERAL_ELLIPTIC(U, RES, A, B, C, D, E, S, F, UINF, NROBIN, RSYM, ZSYM,&
 		    NRINTERIOR, NZINTERIOR, GHOST,&
 		    DR, DZ, NORDER,&
 		    LR_USE, PRECOND_USE)
-		CALL CPU_TIME(END_TIME(4))
+		END_TIME(4) = OMP_GET_WTIME()
 		TIMES(4) = END_TIME(4) - START_TIME(4)
 
 		! LOW RANK UPDATE SOLVE.
@@ -311,12 +319,12 @@ PROGRAM ELLSOLVE_F90
 		PRINT *, 'ELLSOLVEF: Solving with low rank update.'
 		LR_USE = 1
 		PRECOND_USE = 0
-		CALL CPU_TIME(START_TIME(6))
+		START_TIME(6) = OMP_GET_WTIME()
 		CALL GENERAL_ELLIPTIC(U, RES, A, B, C, D, E, S, F, UINF, NROBIN, RSYM, ZSYM,&
 		    NRINTERIOR, NZINTERIOR, GHOST,&
 		    DR, DZ, NORDER,&
 		    LR_USE, PRECOND_USE)
-		CALL CPU_TIME(END_TIME(6))
+		END_TIME(6) = OMP_GET_WTIME()
 		TIMES(6) = END_TIME(6) - START_TIME(6)
 	END IF
 
@@ -0,0 +1,379 @@
+// Global header files.
+#include "tools.h"
+
+// PARDISO parameters are shared, each level has its own handle.
+#include "pardiso_param.h"
+#include "pardiso.h"
+
+// Elliptic solver headers.
+#include "stencil_csr_gen.h"
+#include "elliptic_tools.h"
+#include "grid_map.h"
+#include "thread_profile.h"
+#include "mesh_refinement.h"
+
+// MESH REFINEMENT DEFAULTS.
+#define MESH_REFINEMENT_TOL 1.0E-10
+#define MESH_REFINEMENT_MAX_ITERATIONS 50
+#define MESH_REFINEMENT_MAX_LEVELS 16
+#define MESH_REFINEMENT_MIN 16
+
+// Composite grid solve on nested patches.
+//
+// Every level is an ordinary reduced (NrInterior + 2) x (NzInterior + 2)
+// system assembled by the table-driven generator and factored once with its
+// own PARDISO handle. The levels are then coupled by iterating back
+// substitutions from the coarsest level to the finest:
+// - Interface: the outer boundary rows of a refined level are Dirichlet
+//   rows (Robin type 0) whose values are interpolated from the next coarser
+//   level.
+// - Restriction: on coarse points well inside the finer patch, the coarse
+//   RHS is replaced by A_c (R u_f), the coarse operator applied to the
+//   finer solution interpolated to the coarse points. This is the tau
+//   correction of FAS with the fine equation solved exactly, so the coarse
+//   solution carries the fine truncation error outside the patch too.
+// Iterations stop when no level changes by more than MESH_REFINEMENT_TOL
+// relative to the solution. Interface transfers are cubic, fourth order.
+
+// Level data: reduced arrays, matrix and PARDISO handle.
+typedef struct mesh_levels
+{
+	void *pt[64];
+	int iparm[64];
+	csr_matrix A;
+	double *u;	// Reduced solution.
+	double *b;	// RHS from the generator.
+	double *rhs;	// RHS of the current iteration.
+	double *v;	// Finer solution at the points of this level.
+	double *w;	// A v.
+} mesh_level;
+
+// Back substitution with the factors of a level.
+static int mesh_level_solve(mesh_level *level)
+{
+	int nrows = level->A.nrows;
+	int level_phase = 33, level_error = 0;
+
+	pardiso(level->pt, &maxfct, &mnum, &mtype, &level_phase,
+		&nrows, level->A.a, level->A.ia, level->A.ja, perm, &nrhs,
+		level->iparm, &msglvl, level->rhs, level->u, &level_error);
+	if (level_error != 0)
+	{
+		printf("MESH REFINEMENT: ERROR during solution: %d.\n", level_error);
+		return ELL_ERROR_SOLVE;
+	}
+
+	return ELL_SUCCESS;
+}
+
+// y = A x.
+static void mesh_level_mv(const csr_matrix A, const double *x, double *y)
+{
+	struct matrix_descr descrA;
+	sparse_matrix_t csrA;
+
+	mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, A.nrows, A.ncols, A.ia, A.ia + 1, A.ja, A.a);
+	descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
+	mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, descrA, x, 0.0, y);
+	mkl_sparse_destroy(csrA);
+
+	return;
+}
+
+int mesh_refinement_solve(const int nlevels,	// Number of levels.
+	double *const *u,		// Output solution per level.
+	double *const *res,		// Output residual per level.
+	const double *const *ell_a,	// Coefficient of (d^2/dr^2) per level.
+	const double *const *ell_b,	// Coefficient of (d^2/drdz) per level.
+	const double *const *ell_c,	// Coefficient of (d^2/dz^2) per level.
+	const double *const *ell_d,	// Coefficient of (d/dr) per level.
+	const double *const *ell_e,	// Coefficient of (d/dz) per level.
+	const double *const *ell_s,	// Linear source per level.
+	const double *const *ell_f,	// RHS per level.
+	const double uInf,		// Value at infinity for Robin BC.
+	const int robin,		// Robin BC type: 1, 2, 3.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym,		// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,		// Number of r interior points per level: even.
+	const int NzInterior,		// Number of z interior points per level: even.
+	const int ghost_zones,		// Number of ghost zones.
+	const double dr,		// Spatial step in r of the finest level.
+	const double dz,		// Spatial step in z of the finest level.
+	const int norder,		// Finite difference order: 2, 4 or 6.
+	solver_stats *stats)		// Output solver statistics, may be NULL.
+{
+	double t_start = omp_get_wtime();
+	double t0, t_assemble = 0.0, t_factor = 0.0, t_solve = 0.0;
+	int NrTotal = NrInterior + 2;
+	int NzTotal = NzInterior + 2;
+	int DIM0 = NrTotal * NzTotal;
+	int general = (ell_a != NULL);
+	int p = norder / 2;
+	int i, j, k, l, it = 0, nnz;
+	int converged = 0;
+	int status = ELL_SUCCESS;
+	double change = 0.0, unorm = 0.0, diff;
+
+	// Sanity checks.
+	if ((nlevels < 1) || (nlevels > MESH_REFINEMENT_MAX_LEVELS))
+	{
+		printf("MESH REFINEMENT: ERROR! Number of levels %d out of range [1, %d].\n", nlevels, MESH_REFINEMENT_MAX_LEVELS);
+		status = ELL_ERROR_ARGUMENT;
+	}
+	else if ((NrInterior % 2) || (NzInterior % 2) || (NrInterior < MESH_REFINEMENT_MIN) || (NzInterior < MESH_REFINEMENT_MIN))
+	{
+		printf("MESH REFINEMENT: ERROR! Patches of %d x %d points must be even and at least %d.\n",
+			NrInterior, NzInterior, MESH_REFINEMENT_MIN);
+		status = ELL_ERROR_ARGUMENT;
+	}
+	else if ((norder != 2) && (norder != 4) && (norder != 6))
+	{
+		printf("MESH REFINEMENT: ERROR! Finite difference order %d is not supported, only 2, 4 or 6.\n", norder);
+		status = ELL_ERROR_ARGUMENT;
+	}
+	else if (grid_map_active())
+	{
+		printf("MESH REFINEMENT: ERROR! Patches need a uniform grid.\n");
+		status = ELL_ERROR_ARGUMENT;
+	}
+	if (status != ELL_SUCCESS)
+	{
+		if (stats)
+			stats->status = status;
+		return status;
+	}
+
+	// Coarse points that take the finer solution: their stencil and the
+	// interpolation from the finer level stay clear of its boundary.
+	int Ir = NrInterior / 2 - p - 2;
+	int Jz = NzInterior / 2 - p - 2;
+
+	mesh_level *levels = (mesh_level *)malloc(nlevels * sizeof(mesh_level));
+
+	// Assemble and factor every level, stopping at the first failure.
+	int nbuilt = 0;
+	for (l = 0; l < nlevels && status == ELL_SUCCESS; l++)
+	{
+		mesh_level *level = levels + l;
+		double h_r = dr * (double)(1 << l);
+		double h_z = dz * (double)(1 << l);
+		int level_robin = (l == nlevels - 1) ? robin : 0;
+		int nrows = DIM0;
+		int level_phase, level_error = 0;
+
+		t0 = omp_get_wtime();
+		thread_phase_begin(PHASE_ASSEMBLE);
+		level->u = (double *)malloc(DIM0 * sizeof(double));
+		level->b = (double *)malloc(DIM0 * sizeof(double));
+		level->rhs = (double *)malloc(DIM0 * sizeof(double));
+		level->v = (double *)malloc(DIM0 * sizeof(double));
+		level->w = (double *)malloc(DIM0 * sizeof(double));
+		double *g_s = (double *)malloc(DIM0 * sizeof(double));
+		ghost_reduce(u[l], level->u, NrInterior, NzInterior, ghost_zones);
+		ghost_reduce(ell_s[l], g_s, NrInterior, NzInterior, ghost_zones);
+		ghost_reduce(ell_f[l], level->b, NrInterior, NzInterior, ghost_zones);
+
+		csr_allocate(&level->A, DIM0, DIM0, nnz_stencil(NrInterior, NzInterior, norder, level_robin, general));
+		if (general)
+		{
+			double *g_a = (double *)malloc(DIM0 * sizeof(double));
+			double *g_b = (double *)malloc(DIM0 * sizeof(double));
+			double *g_c = (double *)malloc(DIM0 * sizeof(double));
+			double *g_d = (double *)malloc(DIM0 * sizeof(double));
+			double *g_e = (double *)malloc(DIM0 * sizeof(double));
+			ghost_reduce(ell_a[l], g_a, NrInterior, NzInterior, ghost_zones);
+			ghost_reduce(ell_b[l], g_b, NrInterior, NzInterior, ghost_zones);
+			ghost_reduce(ell_c[l], g_c, NrInterior, NzInterior, ghost_zones);
+			ghost_reduce(ell_d[l], g_d, NrInterior, NzInterior, ghost_zones);
+			ghost_reduce(ell_e[l], g_e, NrInterior, NzInterior, ghost_zones);
+			csr_gen_stencil(level->A, NrInterior, NzInterior, norder, h_r, h_z, g_a, g_b, g_c, g_d, g_e,
+				g_s, level->b, uInf, level_robin, r_sym, z_sym);
+			free(g_a);
+			free(g_b);
+			free(g_c);
+			free(g_d);
+			free(g_e);
+		}
+		else
+		{
+			csr_gen_stencil(level->A, NrInterior, NzInterior, norder, h_r, h_z, NULL, NULL, NULL, NULL, NULL,
+				g_s, level->b, uInf, level_robin, r_sym, z_sym);
+		}
+		free(g_s);
+		thread_phase_end();
+		t_assemble += omp_get_wtime() - t0;
+
+		// Analysis and factorization with the handle of this level.
+		t0 = omp_get_wtime();
+		thread_phase_begin(PHASE_FACTOR);
+		for (k = 0; k < 64; k++)
+		{
+			level->iparm[k] = iparm[k];
+			level->pt[k] = 0;
+		}
+		level->iparm[4 - 1] = 0;	// No iterative-direct algorithm.
+		level->iparm[5 - 1] = 0;	// No user fill-in reducing permutation.
+		level->iparm[39 - 1] = 0;	// No low rank update.
+		level_phase = 12;
+		pardiso(level->pt, &maxfct, &mnum, &mtype, &level_phase,
+			&nrows, level->A.a, level->A.ia, level->A.ja, perm, &nrhs,
+			level->iparm, &msglvl, &ddum, &ddum, &level_error);
+		thread_phase_end();
+		t_factor += omp_get_wtime() - t0;
+		nbuilt++;
+		if (level_error != 0)
+		{
+			printf("MESH REFINEMENT: ERROR during factorization of level %d: %d.\n", l, level_error);
+			status = ELL_ERROR_FACTOR;
+		}
+	}
+
+	// Composite grid iterations.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_SOLVE);
+	for (it = 0; it < MESH_REFINEMENT_MAX_ITERATIONS && status == ELL_SUCCESS; it++)
+	{
+		change = 0.0;
+		unorm = 0.0;
+
+		for (l = nlevels - 1; l >= 0 && status == ELL_SUCCESS; l--)
+		{
+			mesh_level *level = levels + l;
+			memcpy(level->rhs, level->b, DIM0 * sizeof(double));
+
+			// Interface values from the coarser level, whose index
+			// coordinates are (i + 1/2) / 2.
+			if (l < nlevels - 1)
+			{
+				const double *c_u = levels[l + 1].u;
+				for (j = 1; j < NzTotal; j++)
+				{
+					level->rhs[IDX(NrInterior + 1, j)] = grid_interpolate(c_u, NrInterior, NzInterior,
+						0.5 * (double)(NrInterior + 1) + 0.25, 0.5 * (double)j + 0.25, r_sym, z_sym);
+				}
+				for (i = 1; i < NrTotal; i++)
+				{
+					level->rhs[IDX(i, NzInterior + 1)] = grid_interpolate(c_u, NrInterior, NzInterior,
+						0.5 * (double)i + 0.25, 0.5 * (double)(NzInterior + 1) + 0.25, r_sym, z_sym);
+				}
+			}
+
+			// Finer solution on coarse points, whose index coordinates
+			// on the finer level are 2i - 1/2.
+			if (l > 0 && it > 0)
+			{
+				const double *f_u = levels[l - 1].u;
+				memset(level->v, 0, DIM0 * sizeof(double));
+				for (i = 0; i <= NrInterior / 2; i++)
+				{
+					for (j = 0; j <= NzInterior / 2; j++)
+					{
+						level->v[IDX(i, j)] = grid_interpolate(f_u, NrInterior, NzInterior,
+							2.0 * (double)i - 0.5, 2.0 * (double)j - 0.5, r_sym, z_sym);
+					}
+				}
+				mesh_level_mv(level->A, level->v, level->w);
+				#pragma omp parallel for schedule(static) private(j)
+				for (i = 1; i <= Ir; i++)
+				{
+					for (j = 1; j <= Jz; j++)
+					{
+						level->rhs[IDX(i, j)] = level->w[IDX(i, j)];
+					}
+				}
+			}
+
+			// Keep previous solution to measure the change.
+			memcpy(level->v, level->u, DIM0 * sizeof(double));
+			status = mesh_level_solve(level);
+
+			for (k = 0; k < DIM0; k++)
+			{
+				diff = fabs(level->u[k] - level->v[k]);
+				change = (diff > change) ? diff : change;
+				unorm = (fabs(level->u[k]) > unorm) ? fabs(level->u[k]) : unorm;
+			}
+		}
+
+#ifdef VERBOSE
+		printf("MESH REFINEMENT: Iteration %d, change = %3.3E.\n", it + 1, change / unorm);
+#endif
+		if (status == ELL_SUCCESS && it > 0 && change <= MESH_REFINEMENT_TOL * unorm)
+		{
+			converged = 1;
+			it++;
+			break;
+		}
+	}
+	thread_phase_end();
+	t_solve = omp_get_wtime() - t0;
+
+	if (status != ELL_SUCCESS)
+		printf("MESH REFINEMENT: ERROR! Solver failed with status %d, solutions and residuals unchanged.\n", status);
+	else if (!converged)
+		printf("MESH REFINEMENT: WARNING! No convergence after %d iterations, change = %3.3E.\n", it, change / unorm);
+	else
+		printf("MESH REFINEMENT: Converged in %d iterations on %d levels.\n", it, nlevels);
+
+	// Residuals of the last iteration, transfer to original arrays and
+	// release the handles. A failed solve leaves the arrays unchanged.
+	double abs_residual = 0.0;
+	double rhs_norm = 0.0;
+	nnz = 0;
+	for (l = 0; l < nbuilt; l++)
+	{
+		mesh_level *level = levels + l;
+		int nrows = DIM0;
+		int level_phase = -1, level_error = 0;
+
+		if (status == ELL_SUCCESS)
+		{
+			mesh_level_mv(level->A, level->u, level->w);
+			for (k = 0; k < DIM0; k++)
+			{
+				level->w[k] = level->rhs[k] - level->w[k];
+				abs_residual = (fabs(level->w[k]) > abs_residual) ? fabs(level->w[k]) : abs_residual;
+				rhs_norm = (fabs(level->rhs[k]) > rhs_norm) ? fabs(level->rhs[k]) : rhs_norm;
+			}
+			ghost_fill(level->u, u[l], r_sym, z_sym, NrInterior, NzInterior, ghost_zones);
+			ghost_fill(level->w, res[l], r_sym, z_sym, NrInterior, NzInterior, ghost_zones);
+		}
+		nnz += level->A.nnz;
+
+		pardiso(level->pt, &maxfct, &mnum, &mtype, &level_phase,
+			&nrows, &ddum, &idum, &idum, &idum, &nrhs,
+			level->iparm, &msglvl, &ddum, &ddum, &level_error);
+		csr_deallocate(&level->A);
+		free(level->u);
+		free(level->b);
+		free(level->rhs);
+		free(level->v);
+		free(level->w);
+	}
+	free(levels);
+
+	if (status == ELL_SUCCESS)
+		printf("MESH REFINEMENT: Coarsest step %3.3E, ||r|| = %3.3E.\n", dr * (double)(1 << (nlevels - 1)), abs_residual);
+
+	if (stats)
+	{
+		stats->solver = general ? "general_fmr" : "flat_fmr";
+		stats->NrInterior = NrInterior;
+		stats->NzInterior = NzInterior;
+		stats->order = norder;
+		stats->robin = robin;
+		stats->nnz = nnz;
+		stats->t_assemble = t_assemble;
+		stats->t_factor = t_factor;
+		stats->t_solve = t_solve;
+		stats->t_total = omp_get_wtime() - t_start;
+		stats->iterations = it;
+		stats->abs_residual = abs_residual;
+		stats->rel_residual = (rhs_norm > 0.0) ? abs_residual / rhs_norm : abs_residual;
+		stats->convergence = converged;
+		stats->status = status;
+		stats->fallback = 0;
+	}
+
+	return status;
+}
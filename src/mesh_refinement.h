@@ -0,0 +1,29 @@
+// Fixed mesh refinement: nlevels nested patches around the origin, level 0
+// the finest with steps dr, dz and level l with steps 2^l dr, 2^l dz, all
+// with NrInterior x NzInterior points and the usual ghost zone layout.
+// Arrays are given per level; ell_a to ell_e are NULL for the flat Laplacian.
+// The coarsest level has the Robin boundary, finer levels take their
+// boundary from the next coarser one. Requires pardiso_start. Returns
+// ELL_SUCCESS, ELL_ERROR_ARGUMENT for unsupported levels, patch sizes, orders
+// or a stretched grid, or the failed PARDISO phase with u and res unchanged.
+int mesh_refinement_solve(const int nlevels,	// Number of levels.
+	double *const *u,		// Output solution per level.
+	double *const *res,		// Output residual per level.
+	const double *const *ell_a,	// Coefficient of (d^2/dr^2) per level.
+	const double *const *ell_b,	// Coefficient of (d^2/drdz) per level.
+	const double *const *ell_c,	// Coefficient of (d^2/dz^2) per level.
+	const double *const *ell_d,	// Coefficient of (d/dr) per level.
+	const double *const *ell_e,	// Coefficient of (d/dz) per level.
+	const double *const *ell_s,	// Linear source per level.
+	const double *const *ell_f,	// RHS per level.
+	const double uInf,		// Value at infinity for Robin BC.
+	const int robin,		// Robin BC type: 1, 2, 3.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym,		// Z symmetry: 1(even), -1(odd).
+	const int NrInterior,		// Number of r interior points per level: even.
+	const int NzInterior,		// Number of z interior points per level: even.
+	const int ghost_zones,		// Number of ghost zones.
+	const double dr,		// Spatial step in r of the finest level.
+	const double dz,		// Spatial step in z of the finest level.
+	const int norder,		// Finite difference order: 2, 4 or 6.
+	solver_stats *stats = NULL);	// Output solver statistics, optional.
@@ -0,0 +1,158 @@
+// Global headers and variables.
+#include "tools.h"
+
+// MPI.
+#include <mpi.h>
+
+// Distributed solvers.
+#include "distributed.h"
+
+// Solver statistics.
+#include "solver_stats.h"
+
+// Stretched grids.
+#include "grid_map.h"
+
+// Distributed driver: ELLSOLVEMPI dirname solver order NrInterior NzInterior dr dz [robin],
+// run as mpirun -np N ELLSOLVEMPI ... Every rank builds the same grid
+// functions as ELLSOLVEC, the solve is shared by all ranks and rank 0
+// writes the solution, residual and statistics.
+int main(int argc, char *argv[])
+{
+	// MPI.
+	int rank, size;
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	// PARAMETERS.
+	if (argc < 8)
+	{
+		if (rank == 0)
+			printf("Usage: mpirun -np N ELLSOLVEMPI dirname {flat|general} order NrInterior NzInterior dr dz [robin]\n");
+		MPI_Finalize();
+		return 1;
+	}
+	char *dirname = argv[1];
+	int general = (strcmp(argv[2], "general") == 0);
+	int norder = atoi(argv[3]);
+	int NrInterior = atoi(argv[4]);
+	int NzInterior = atoi(argv[5]);
+	double dr = atof(argv[6]);
+	double dz = atof(argv[7]);
+	int nrobin = (argc >= 9) ? atoi(argv[8]) : 1;
+	if (!general && strcmp(argv[2], "flat") != 0)
+	{
+		if (rank == 0)
+			printf("ELLSOLVEMPI: ERROR! Unrecognized solver %s. Only \"flat\" or \"general\" is supported.\n", argv[2]);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+	if ((norder != 2) && (norder != 4) && (norder != 6) && !(norder == -4 && !general))
+	{
+		if (rank == 0)
+			printf("ELLSOLVEMPI: ERROR! Finite difference %d is not supported.\n", norder);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+	if (nrobin != 1 && nrobin != 2 && nrobin != 3)
+	{
+		if (rank == 0)
+			printf("ELLSOLVEMPI: ERROR! nrobin = %d is not supported! Only 1, 2, 3.\n", nrobin);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+
+	// Rank 0 does the I/O.
+	if (rank == 0)
+	{
+		make_directory_and_cd(dirname);
+		printf("ELLSOLVEMPI: %s solver, order %d, %d x %d points on %d ranks.\n",
+			general ? "general" : "flat", norder, NrInterior, NzInterior, size);
+	}
+
+	// Grid.
+	int ghost = (norder == 4) ? 3 : (norder == 6) ? 4 : 2;
+	int NrTotal = ghost + NrInterior + 1;
+	int NzTotal = ghost + NzInterior + 1;
+	int DIM = NrTotal * NzTotal;
+	double *r = (double *)malloc(DIM * sizeof(double));
+	double *z = (double *)malloc(DIM * sizeof(double));
+	double *u = (double *)calloc(DIM, sizeof(double));
+	double *f = (double *)calloc(DIM, sizeof(double));
+	double *s = (double *)calloc(DIM, sizeof(double));
+	double *res = (double *)calloc(DIM, sizeof(double));
+	double *a = (double *)calloc(DIM, sizeof(double));
+	double *b = (double *)calloc(DIM, sizeof(double));
+	double *c = (double *)calloc(DIM, sizeof(double));
+	double *d = (double *)calloc(DIM, sizeof(double));
+	double *e = (double *)calloc(DIM, sizeof(double));
+	grid_map_coordinates(r, z, NrInterior, NzInterior, ghost, dr, dz);
+
+	// Same problems as ELLSOLVEC.
+	int k;
+	double aux_r, aux_z;
+	#pragma omp parallel for schedule(static) private(aux_r, aux_z)
+	for (k = 0; k < DIM; k++)
+	{
+		aux_r = r[k];
+		aux_z = z[k];
+		s[k] = exp(-aux_r * aux_r - aux_z * aux_z) * (0.5 + aux_r * aux_r * (-3.0 + aux_r * aux_r + aux_z * aux_z));
+		if (general)
+		{
+			a[k] = aux_r;
+			c[k] = aux_r;
+			d[k] = 1.0;
+			s[k] *= aux_r;
+		}
+	}
+
+	// Distributed solve.
+	solver_stats stats;
+	solver_stats_reset(&stats);
+	double t0 = omp_get_wtime();
+	if (general)
+	{
+		general_elliptic_mpi(u, res, a, b, c, d, e, s, f, 1.0, nrobin, 1, 1,
+			NrInterior, NzInterior, ghost, dr, dz, norder, MPI_COMM_WORLD, &stats);
+	}
+	else
+	{
+		flat_laplacian_mpi(u, res, s, f, 1.0, nrobin, 1, 1,
+			NrInterior, NzInterior, ghost, dr, dz, norder, MPI_COMM_WORLD, &stats);
+	}
+	double t = omp_get_wtime() - t0;
+
+	// Output.
+	if (rank == 0)
+	{
+		printf("ELLSOLVEMPI: Distributed solver took %3.3E seconds.\n", t);
+		write_single_file(u, "u.asc", NrTotal, NzTotal);
+		write_single_file(res, "res.asc", NrTotal, NzTotal);
+		FILE *stats_fp = fopen("stats.jsonl", "w");
+		if (stats_fp != NULL)
+		{
+			solver_stats_json(stats_fp, &stats);
+			fclose(stats_fp);
+		}
+		else
+		{
+			printf("ELLSOLVEMPI: WARNING! Could not open stats.jsonl, statistics not written.\n");
+		}
+	}
+
+	// Deallocate memory.
+	free(r);
+	free(z);
+	free(u);
+	free(f);
+	free(s);
+	free(res);
+	free(a);
+	free(b);
+	free(c);
+	free(d);
+	free(e);
+
+	MPI_Finalize();
+
+	// All done.
+	return 0;
+}
@@ -0,0 +1,699 @@
+// Global header files.
+#include "tools.h"
+
+// PARDISO global state is swapped out during the coarse solve.
+#include "pardiso_param.h"
+
+// Elliptic solver headers.
+#include "elliptic_tools.h"
+#include "thread_profile.h"
+#include "pardiso_start.h"
+#include "pardiso_stop.h"
+#include "flat_laplacian.h"
+#include "general_elliptic.h"
+
+// Minimum number of coarse interior points in each direction.
+#define NESTED_MIN 8
+
+#ifdef FORTRAN
+// FORTRAN entry points of the solvers.
+extern "C" void pardiso_start_(const int *p_NrInterior, const int *p_NzInterior);
+extern "C" void pardiso_stop_(void);
+extern "C" int flat_laplacian_(double *u, double *res, const double *s, const double *f,
+	const double *p_uInf, const int *p_robin, const int *p_r_sym, const int *p_z_sym,
+	const int *p_NrInterior, const int *p_NzInterior, const int *p_ghost_zones,
+	const double *p_dr, const double *p_dz, const int *p_norder, const int *p_lr_use, const int *p_precond_use);
+extern "C" int general_elliptic_(double *u, double *res, const double *ell_a, const double *ell_b,
+	const double *ell_c, const double *ell_d, const double *ell_e, const double *ell_s, const double *ell_f,
+	const double *p_uInf, const int *p_robin, const int *p_r_sym, const int *p_z_sym,
+	const int *p_NrInterior, const int *p_NzInterior, const int *p_ghost_zones,
+	const double *p_dr, const double *p_dz, const int *p_norder, const int *p_lr_use, const int *p_precond_use);
+#endif
+
+// PARDISO state of the fine problem while the coarse problem is solved:
+// everything pardiso_start sets, so the caller's options survive.
+typedef struct pardiso_states
+{
+	int solver;
+	int mtype;
+	int nrhs;
+	int n;
+	void *pt[64];
+	int iparm[64];
+	int maxfct;
+	int mnum;
+	int msglvl;
+	int error;
+	int *perm;
+	int *diff;
+	char uplo;
+	int guess_use;
+	int skip_analysis;
+	double *factored_a;
+	int factored_nnz;
+	double lr_threshold;
+	int dc_use;
+	int schwarz_use;
+	int fallback_use;
+	int threads[NUM_PHASES];
+} pardiso_state;
+
+// Save PARDISO global state.
+static void pardiso_state_save(pardiso_state *state)
+{
+	int k;
+
+	state->solver = solver;
+	state->mtype = mtype;
+	state->nrhs = nrhs;
+	state->n = n;
+	memcpy(state->pt, pt, sizeof(pt));
+	memcpy(state->iparm, iparm, sizeof(iparm));
+	state->maxfct = maxfct;
+	state->mnum = mnum;
+	state->msglvl = msglvl;
+	state->error = error;
+	state->perm = perm;
+	state->diff = diff;
+	state->uplo = uplo[0];
+	state->guess_use = guess_use;
+	state->skip_analysis = skip_analysis;
+	state->factored_a = factored_a;
+	state->factored_nnz = factored_nnz;
+	state->lr_threshold = lr_threshold;
+	state->dc_use = dc_use;
+	state->schwarz_use = schwarz_use;
+	state->fallback_use = fallback_use;
+	for (k = 0; k < NUM_PHASES; k++)
+		state->threads[k] = thread_profile_get(k);
+
+	return;
+}
+
+// Restore PARDISO global state.
+static void pardiso_state_restore(const pardiso_state *state)
+{
+	int k;
+
+	solver = state->solver;
+	mtype = state->mtype;
+	nrhs = state->nrhs;
+	n = state->n;
+	memcpy(pt, state->pt, sizeof(pt));
+	memcpy(iparm, state->iparm, sizeof(iparm));
+	maxfct = state->maxfct;
+	mnum = state->mnum;
+	msglvl = state->msglvl;
+	error = state->error;
+	perm = state->perm;
+	diff = state->diff;
+	uplo[0] = state->uplo;
+	guess_use = state->guess_use;
+	skip_analysis = state->skip_analysis;
+	factored_a = state->factored_a;
+	factored_nnz = state->factored_nnz;
+	lr_threshold = state->lr_threshold;
+	dc_use = state->dc_use;
+	schwarz_use = state->schwarz_use;
+	fallback_use = state->fallback_use;
+	for (k = 0; k < NUM_PHASES; k++)
+		thread_profile_set(k, state->threads[k]);
+
+	return;
+}
+
+// Restrict by 2x2 averaging, or by cubic interpolation weighted by r if
+// r_weight is set.
+static void nested_restrict(const double *u, double *c_u, const int NrInterior, const int NzInterior,
+	const int ghost, const int cubic, const int r_weight)
+{
+	if (cubic)
+		grid_restrict_cubic(u, c_u, NrInterior, NzInterior, ghost, r_weight);
+	else
+		grid_restrict(u, c_u, NrInterior, NzInterior, ghost);
+
+	return;
+}
+
+// Solve the problem on a grid with twice the spatial step into c_u, which
+// has the coarse size including ghost zones. Coefficients ell_a to ell_e are
+// NULL for the flat Laplacian. Coefficients are restricted by 2x2 averaging,
+// or by cubic interpolation if cubic is set, with the operator coefficients
+// weighted by r.
+//
+// The coarse problem has its own PARDISO handle so that the fine LU kept for
+// CGS is not lost. Returns the wall time, or -1 if the grid is too small or
+// the coarse solve failed.
+static double nested_coarse(double *c_u,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	double uInf,
+	int robin,
+	int r_sym,
+	int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	int ghost,
+	const double dr,
+	const double dz,
+	int norder,
+	const int cubic)
+{
+	double t0 = omp_get_wtime();
+	int general = (ell_a != NULL);
+
+	// Coarse grid.
+	int c_NrInterior = NrInterior / 2;
+	int c_NzInterior = NzInterior / 2;
+	double c_dr = 2.0 * dr;
+	double c_dz = 2.0 * dz;
+
+	if ((NrInterior % 2) || (NzInterior % 2) || (c_NrInterior < NESTED_MIN) || (c_NzInterior < NESTED_MIN))
+	{
+		printf("NESTED ITERATION: WARNING! Cannot coarsen %d x %d grid.\n", NrInterior, NzInterior);
+		return -1.0;
+	}
+
+	// Allocate coarse arrays.
+	size_t c_size = (ghost + c_NrInterior + 1) * (ghost + c_NzInterior + 1) * sizeof(double);
+	double *c_res = (double *)malloc(c_size);
+	double *c_s = (double *)malloc(c_size);
+	double *c_f = (double *)malloc(c_size);
+	double *c_a = NULL, *c_b = NULL, *c_c = NULL, *c_d = NULL, *c_e = NULL;
+
+	// Restrict linear source, RHS and coefficients.
+	memset(c_u, 0, c_size);
+	memset(c_res, 0, c_size);
+	nested_restrict(ell_s, c_s, NrInterior, NzInterior, ghost, cubic, 0);
+	nested_restrict(ell_f, c_f, NrInterior, NzInterior, ghost, cubic, 0);
+	if (general)
+	{
+		c_a = (double *)malloc(c_size);
+		c_b = (double *)malloc(c_size);
+		c_c = (double *)malloc(c_size);
+		c_d = (double *)malloc(c_size);
+		c_e = (double *)malloc(c_size);
+		nested_restrict(ell_a, c_a, NrInterior, NzInterior, ghost, cubic, 1);
+		nested_restrict(ell_b, c_b, NrInterior, NzInterior, ghost, cubic, 1);
+		nested_restrict(ell_c, c_c, NrInterior, NzInterior, ghost, cubic, 1);
+		nested_restrict(ell_d, c_d, NrInterior, NzInterior, ghost, cubic, 1);
+		nested_restrict(ell_e, c_e, NrInterior, NzInterior, ghost, cubic, 1);
+	}
+
+	// Direct coarse solve with its own PARDISO handle.
+	pardiso_state fine;
+	pardiso_state_save(&fine);
+	int status;
+#ifdef FORTRAN
+	int direct = 0;
+	pardiso_start_(&c_NrInterior, &c_NzInterior);
+	if (general)
+	{
+		status = general_elliptic_(c_u, c_res, c_a, c_b, c_c, c_d, c_e, c_s, c_f, &uInf, &robin, &r_sym, &z_sym,
+			&c_NrInterior, &c_NzInterior, &ghost, &c_dr, &c_dz, &norder, &direct, &direct);
+	}
+	else
+	{
+		status = flat_laplacian_(c_u, c_res, c_s, c_f, &uInf, &robin, &r_sym, &z_sym,
+			&c_NrInterior, &c_NzInterior, &ghost, &c_dr, &c_dz, &norder, &direct, &direct);
+	}
+	pardiso_stop_();
+#else
+	pardiso_start(c_NrInterior, c_NzInterior);
+	if (general)
+	{
+		status = general_elliptic(c_u, c_res, c_a, c_b, c_c, c_d, c_e, c_s, c_f, uInf, robin, r_sym, z_sym,
+			c_NrInterior, c_NzInterior, ghost, c_dr, c_dz, norder, 0, 0);
+	}
+	else
+	{
+		status = flat_laplacian(c_u, c_res, c_s, c_f, uInf, robin, r_sym, z_sym,
+			c_NrInterior, c_NzInterior, ghost, c_dr, c_dz, norder, 0, 0);
+	}
+	pardiso_stop();
+#endif
+	pardiso_state_restore(&fine);
+
+	// Clear memory.
+	free(c_res);
+	free(c_s);
+	free(c_f);
+	if (general)
+	{
+		free(c_a);
+		free(c_b);
+		free(c_c);
+		free(c_d);
+		free(c_e);
+	}
+
+	if (status != ELL_SUCCESS)
+	{
+		printf("NESTED ITERATION: WARNING! Coarse solve failed with status %d.\n", status);
+		return -1.0;
+	}
+
+	return omp_get_wtime() - t0;
+}
+
+// Solve the problem on a grid with twice the spatial step and prolong the
+// solution into u. Returns the wall time, or -1 if there is no coarse
+// solution, in which case u is unchanged.
+static double nested_coarse_solve(double *u,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	double uInf,
+	int robin,
+	int r_sym,
+	int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	int ghost,
+	const double dr,
+	const double dz,
+	int norder)
+{
+	size_t c_size = (ghost + NrInterior / 2 + 1) * (ghost + NzInterior / 2 + 1) * sizeof(double);
+	double *c_u = (double *)malloc(c_size);
+	double t_coarse = nested_coarse(c_u, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, robin, r_sym, z_sym,
+		NrInterior, NzInterior, ghost, dr, dz, norder, 0);
+
+	// Prolong: coarse ghost zones were filled by the solver.
+	if (t_coarse >= 0.0)
+		grid_prolong(c_u, u, NrInterior, NzInterior, ghost);
+	else
+		printf("NESTED ITERATION: WARNING! Solving without initial guess.\n");
+
+	free(c_u);
+
+	return t_coarse;
+}
+
+// Richardson extrapolation of the fine solution u with the solution of the
+// same problem on a grid with twice the spatial step.
+//
+// With errors e(h) = C h^p + ..., p the order, the fine solution restricted
+// to the coarse points and the coarse solution give the estimate
+//	e(h) = (u_2h - u_h) / (2^p - 1)
+// on coarse points. Coefficients and the fine solution are restricted with
+// cubic interpolation so that no second order term of their own enters the
+// difference, including in the ghost zones and next to the Robin boundary.
+// The estimate is prolonged and subtracted from u. Returns the maximum
+// estimated error on coarse interior points, or -1 if there is no coarse
+// solution, in which case u is unchanged.
+static double richardson_correct(double *u,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	double uInf,
+	int robin,
+	int r_sym,
+	int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	int ghost,
+	const double dr,
+	const double dz,
+	int norder,
+	double *t_coarse)
+{
+	int NrTotal = ghost + NrInterior + 1;
+	int NzTotal = ghost + NzInterior + 1;
+	int c_NrTotal = ghost + NrInterior / 2 + 1;
+	int c_NzTotal = ghost + NzInterior / 2 + 1;
+	double factor = 1.0 / (pow(2.0, (double)abs(norder)) - 1.0);
+	double estimate = 0.0;
+	int i, j, k;
+
+	double *c_u = (double *)malloc(c_NrTotal * c_NzTotal * sizeof(double));
+	*t_coarse = nested_coarse(c_u, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, robin, r_sym, z_sym,
+		NrInterior, NzInterior, ghost, dr, dz, norder, 1);
+	if (*t_coarse < 0.0)
+	{
+		printf("RICHARDSON: WARNING! No extrapolation.\n");
+		free(c_u);
+		return -1.0;
+	}
+
+	// Error estimate on coarse points, then fine points.
+	double *c_e = (double *)malloc(c_NrTotal * c_NzTotal * sizeof(double));
+	double *e = (double *)malloc(NrTotal * NzTotal * sizeof(double));
+	grid_restrict_cubic(u, c_e, NrInterior, NzInterior, ghost, 0);
+	#pragma omp parallel for schedule(static) private(j, k) reduction(max:estimate)
+	for (i = 0; i < c_NrTotal; i++)
+	{
+		for (j = 0; j < c_NzTotal; j++)
+		{
+			k = i * c_NzTotal + j;
+			c_e[k] = factor * (c_u[k] - c_e[k]);
+			if (i >= ghost && i < c_NrTotal - 1 && j >= ghost && j < c_NzTotal - 1)
+				estimate = fmax(estimate, fabs(c_e[k]));
+		}
+	}
+	grid_prolong(c_e, e, NrInterior, NzInterior, ghost);
+
+	// Extrapolate.
+	#pragma omp parallel for schedule(static)
+	for (k = 0; k < NrTotal * NzTotal; k++)
+		u[k] -= e[k];
+
+	free(c_u);
+	free(c_e);
+	free(e);
+
+	return estimate;
+}
+
+// Nested iteration for the flat Laplacian.
+//
+// Direct solves (precond_use = 0 or lr_use = 1) do not use an initial guess
+// and go straight to flat_laplacian.
+#ifdef FORTRAN
+extern "C" int flat_laplacian_nested_(double *u,
+	double *res,
+	const double *s,
+	const double *f,
+	const double *p_uInf,
+	const int *p_robin,
+	const int *p_r_sym,
+	const int *p_z_sym,
+	const int *p_NrInterior,
+	const int *p_NzInterior,
+	const int *p_ghost_zones,
+	const double *p_dr,
+	const double *p_dz,
+	const int *p_norder,
+	const int *p_lr_use,
+	const int *p_precond_use)
+{
+	if (*p_precond_use && !*p_lr_use)
+	{
+		guess_use = (nested_coarse_solve(u, NULL, NULL, NULL, NULL, NULL, s, f, *p_uInf, *p_robin, *p_r_sym, *p_z_sym,
+			*p_NrInterior, *p_NzInterior, *p_ghost_zones, *p_dr, *p_dz, *p_norder) >= 0.0);
+	}
+	int status = flat_laplacian_(u, res, s, f, p_uInf, p_robin, p_r_sym, p_z_sym, p_NrInterior, p_NzInterior,
+		p_ghost_zones, p_dr, p_dz, p_norder, p_lr_use, p_precond_use);
+	guess_use = 0;
+
+	return status;
+}
+#else
+int flat_laplacian_nested(double *u,
+	double *res,
+	const double *s,
+	const double *f,
+	const double uInf,
+	const int robin,
+	const int r_sym,
+	const int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	const int ghost_zones,
+	const double dr,
+	const double dz,
+	const int norder,
+	const int lr_use,
+	const int precond_use,
+	solver_stats *stats)
+{
+	double t_coarse = 0.0;
+
+	if (precond_use && !lr_use)
+	{
+		t_coarse = nested_coarse_solve(u, NULL, NULL, NULL, NULL, NULL, s, f, uInf, robin, r_sym, z_sym,
+			NrInterior, NzInterior, ghost_zones, dr, dz, norder);
+		guess_use = (t_coarse >= 0.0);
+	}
+	int status = flat_laplacian(u, res, s, f, uInf, robin, r_sym, z_sym, NrInterior, NzInterior,
+		ghost_zones, dr, dz, norder, lr_use, precond_use, stats);
+	guess_use = 0;
+
+	// Account for the coarse solve.
+	if (stats && t_coarse > 0.0)
+	{
+		stats->t_coarse = t_coarse;
+		stats->t_total += t_coarse;
+	}
+
+	return status;
+}
+#endif
+
+// Nested iteration for the general elliptic equation.
+#ifdef FORTRAN
+extern "C" int general_elliptic_nested_(double *u,
+	double *res,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	const double *p_uInf,
+	const int *p_robin,
+	const int *p_r_sym,
+	const int *p_z_sym,
+	const int *p_NrInterior,
+	const int *p_NzInterior,
+	const int *p_ghost_zones,
+	const double *p_dr,
+	const double *p_dz,
+	const int *p_norder,
+	const int *p_lr_use,
+	const int *p_precond_use)
+{
+	if (*p_precond_use && !*p_lr_use)
+	{
+		guess_use = (nested_coarse_solve(u, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, *p_uInf, *p_robin,
+			*p_r_sym, *p_z_sym, *p_NrInterior, *p_NzInterior, *p_ghost_zones, *p_dr, *p_dz, *p_norder) >= 0.0);
+	}
+	int status = general_elliptic_(u, res, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, p_uInf, p_robin, p_r_sym, p_z_sym,
+		p_NrInterior, p_NzInterior, p_ghost_zones, p_dr, p_dz, p_norder, p_lr_use, p_precond_use);
+	guess_use = 0;
+
+	return status;
+}
+#else
+int general_elliptic_nested(double *u,
+	double *res,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	const double uInf,
+	const int robin,
+	const int r_sym,
+	const int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	const int ghost_zones,
+	const double dr,
+	const double dz,
+	const int norder,
+	const int lr_use,
+	const int precond_use,
+	solver_stats *stats)
+{
+	double t_coarse = 0.0;
+
+	if (precond_use && !lr_use)
+	{
+		t_coarse = nested_coarse_solve(u, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, robin, r_sym, z_sym,
+			NrInterior, NzInterior, ghost_zones, dr, dz, norder);
+		guess_use = (t_coarse >= 0.0);
+	}
+	int status = general_elliptic(u, res, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, robin, r_sym, z_sym,
+		NrInterior, NzInterior, ghost_zones, dr, dz, norder, lr_use, precond_use, stats);
+	guess_use = 0;
+
+	// Account for the coarse solve.
+	if (stats && t_coarse > 0.0)
+	{
+		stats->t_coarse = t_coarse;
+		stats->t_total += t_coarse;
+	}
+
+	return status;
+}
+#endif
+
+// Richardson extrapolated solve for the flat Laplacian.
+//
+// Direct solve on the requested grid followed by a solve on a grid with
+// twice the spatial step. The residual is that of the fine solve.
+#ifdef FORTRAN
+extern "C" int flat_laplacian_richardson_(double *u,
+	double *res,
+	const double *s,
+	const double *f,
+	const double *p_uInf,
+	const int *p_robin,
+	const int *p_r_sym,
+	const int *p_z_sym,
+	const int *p_NrInterior,
+	const int *p_NzInterior,
+	const int *p_ghost_zones,
+	const double *p_dr,
+	const double *p_dz,
+	const int *p_norder,
+	double *p_error_estimate)
+{
+	int direct = 0;
+	double t_coarse;
+
+	int status = flat_laplacian_(u, res, s, f, p_uInf, p_robin, p_r_sym, p_z_sym, p_NrInterior, p_NzInterior,
+		p_ghost_zones, p_dr, p_dz, p_norder, &direct, &direct);
+	*p_error_estimate = -1.0;
+	if (status != ELL_SUCCESS)
+		return status;
+	*p_error_estimate = richardson_correct(u, NULL, NULL, NULL, NULL, NULL, s, f, *p_uInf, *p_robin, *p_r_sym, *p_z_sym,
+		*p_NrInterior, *p_NzInterior, *p_ghost_zones, *p_dr, *p_dz, *p_norder, &t_coarse);
+
+	return status;
+}
+#else
+int flat_laplacian_richardson(double *u,
+	double *res,
+	const double *s,
+	const double *f,
+	const double uInf,
+	const int robin,
+	const int r_sym,
+	const int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	const int ghost_zones,
+	const double dr,
+	const double dz,
+	const int norder,
+	solver_stats *stats)
+{
+	double t_coarse, estimate;
+
+	int status = flat_laplacian(u, res, s, f, uInf, robin, r_sym, z_sym, NrInterior, NzInterior,
+		ghost_zones, dr, dz, norder, 0, 0, stats);
+	// A failed fine solve leaves u unchanged: nothing to extrapolate.
+	if (status != ELL_SUCCESS)
+		return status;
+	estimate = richardson_correct(u, NULL, NULL, NULL, NULL, NULL, s, f, uInf, robin, r_sym, z_sym,
+		NrInterior, NzInterior, ghost_zones, dr, dz, norder, &t_coarse);
+	if (estimate >= 0.0)
+		printf("RICHARDSON: Estimated discretization error = %3.3E.\n", estimate);
+
+	// Account for the coarse solve.
+	if (stats)
+	{
+		stats->error_estimate = estimate;
+		if (t_coarse > 0.0)
+		{
+			stats->t_coarse = t_coarse;
+			stats->t_total += t_coarse;
+		}
+	}
+
+	return status;
+}
+#endif
+
+// Richardson extrapolated solve for the general elliptic equation.
+#ifdef FORTRAN
+extern "C" int general_elliptic_richardson_(double *u,
+	double *res,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	const double *p_uInf,
+	const int *p_robin,
+	const int *p_r_sym,
+	const int *p_z_sym,
+	const int *p_NrInterior,
+	const int *p_NzInterior,
+	const int *p_ghost_zones,
+	const double *p_dr,
+	const double *p_dz,
+	const int *p_norder,
+	double *p_error_estimate)
+{
+	int direct = 0;
+	double t_coarse;
+
+	int status = general_elliptic_(u, res, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, p_uInf, p_robin, p_r_sym, p_z_sym,
+		p_NrInterior, p_NzInterior, p_ghost_zones, p_dr, p_dz, p_norder, &direct, &direct);
+	*p_error_estimate = -1.0;
+	if (status != ELL_SUCCESS)
+		return status;
+	*p_error_estimate = richardson_correct(u, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, *p_uInf, *p_robin,
+		*p_r_sym, *p_z_sym, *p_NrInterior, *p_NzInterior, *p_ghost_zones, *p_dr, *p_dz, *p_norder, &t_coarse);
+
+	return status;
+}
+#else
+int general_elliptic_richardson(double *u,
+	double *res,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	const double uInf,
+	const int robin,
+	const int r_sym,
+	const int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	const int ghost_zones,
+	const double dr,
+	const double dz,
+	const int norder,
+	solver_stats *stats)
+{
+	double t_coarse, estimate;
+
+	int status = general_elliptic(u, res, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, robin, r_sym, z_sym,
+		NrInterior, NzInterior, ghost_zones, dr, dz, norder, 0, 0, stats);
+	// A failed fine solve leaves u unchanged: nothing to extrapolate.
+	if (status != ELL_SUCCESS)
+		return status;
+	estimate = richardson_correct(u, ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, robin, r_sym, z_sym,
+		NrInterior, NzInterior, ghost_zones, dr, dz, norder, &t_coarse);
+	if (estimate >= 0.0)
+		printf("RICHARDSON: Estimated discretization error = %3.3E.\n", estimate);
+
+	// Account for the coarse solve.
+	if (stats)
+	{
+		stats->error_estimate = estimate;
+		if (t_coarse > 0.0)
+		{
+			stats->t_coarse = t_coarse;
+			stats->t_total += t_coarse;
+		}
+	}
+
+	return status;
+}
+#endif
@@ -0,0 +1,91 @@
+// Nested iteration: seed CGS with the prolonged solution of a coarse solve.
+// Arguments and returned status are the same as flat_laplacian and
+// general_elliptic. A failed coarse solve only drops the initial guess.
+//
+// Flat Laplacian.
+int flat_laplacian_nested(double *u,
+	double *res,
+	const double *s,
+	const double *f,
+	const double uInf,
+	const int robin,
+	const int r_sym,
+	const int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	const int ghost_zones,
+	const double dr,
+	const double dz,
+	const int norder,
+	const int lr_use,
+	const int precond_use,
+	solver_stats *stats = NULL);
+
+// General elliptic equation.
+int general_elliptic_nested(double *u,
+	double *res,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	const double uInf,
+	const int robin,
+	const int r_sym,
+	const int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	const int ghost_zones,
+	const double dr,
+	const double dz,
+	const int norder,
+	const int lr_use,
+	const int precond_use,
+	solver_stats *stats = NULL);
+
+// Richardson extrapolation: solve on the requested grid and on a grid with
+// twice the spatial step, then combine both into a result of higher order.
+// The maximum estimated discretization error goes to stats->error_estimate.
+// Grid sizes must be even, as for nested iteration. Returns the status of the
+// fine solve; if it failed, u and res are unchanged and nothing is extrapolated.
+//
+// Flat Laplacian.
+int flat_laplacian_richardson(double *u,
+	double *res,
+	const double *s,
+	const double *f,
+	const double uInf,
+	const int robin,
+	const int r_sym,
+	const int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	const int ghost_zones,
+	const double dr,
+	const double dz,
+	const int norder,
+	solver_stats *stats = NULL);
+
+// General elliptic equation.
+int general_elliptic_richardson(double *u,
+	double *res,
+	const double *ell_a,
+	const double *ell_b,
+	const double *ell_c,
+	const double *ell_d,
+	const double *ell_e,
+	const double *ell_s,
+	const double *ell_f,
+	const double uInf,
+	const int robin,
+	const int r_sym,
+	const int z_sym,
+	const int NrInterior,
+	const int NzInterior,
+	const int ghost_zones,
+	const double dr,
+	const double dz,
+	const int norder,
+	solver_stats *stats = NULL);
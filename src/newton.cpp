@@ -0,0 +1,418 @@
+// Global header files.
+#include "tools.h"
+
+// PARDISO global state and initialization.
+#include "pardiso_param.h"
+#include "pardiso_start.h"
+#include "pardiso_stop.h"
+#include "low_rank.h"
+
+// Elliptic solver headers.
+#include "general_elliptic.h"
+#include "general_elliptic_csr_gen.h"
+#include "stencil_csr_gen.h"
+#include "elliptic_tools.h"
+#include "grid_map.h"
+#include "solver_stats.h"
+#include "newton.h"
+
+// The Newton solver is only available from C: the FORTRAN build has no C
+// entry points for the solvers.
+#ifndef FORTRAN
+
+// NEWTON DEFAULTS.
+#define NEWTON_TOL 1.0E-10
+#define NEWTON_MAX_ITERATIONS 50
+#define NEWTON_REFRESH 3
+#define NEWTON_CONTRACTION 0.5
+#define NEWTON_EW_GAMMA 0.9
+#define NEWTON_EW_ALPHA 2.0
+#define NEWTON_ETA_MAX 0.9
+#define NEWTON_CGS_MAX_ITERATIONS 20
+
+// Strategy names.
+static const char *newton_method_names[4] = { "newton_full", "newton_chord", "newton_shamanskii", "newton_inexact" };
+
+// Reduced grid work of the nonlinear residual.
+typedef struct newton_works
+{
+	csr_matrix A;
+	double *g_a, *g_b, *g_c, *g_d, *g_e, *g_s;
+	double *g_f;
+	double *g_u;
+	double *g_r;
+	int tabled;
+} newton_work;
+
+// Start solver: initializes PARDISO.
+//
+// Thresholds take their default values and may be changed by the caller
+// before the first solve.
+void newton_start(newton_solver *newton,
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost,	// Number of ghost zones.
+	const double dr,	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2, 4 or 6.
+	const int robin)	// Robin BC type: 1, 2, 3.
+{
+	size_t DIM_size = (ghost + NrInterior + 1) * (ghost + NzInterior + 1) * sizeof(double);
+
+	memset(newton, 0, sizeof(newton_solver));
+	newton->NrInterior = NrInterior;
+	newton->NzInterior = NzInterior;
+	newton->ghost = ghost;
+	newton->dr = dr;
+	newton->dz = dz;
+	newton->norder = norder;
+	newton->robin = robin;
+	newton->method = NEWTON_CHORD;
+	newton->refresh = NEWTON_REFRESH;
+	newton->tol = NEWTON_TOL;
+	newton->max_iterations = NEWTON_MAX_ITERATIONS;
+	newton->contraction = NEWTON_CONTRACTION;
+	newton->ew_gamma = NEWTON_EW_GAMMA;
+	newton->ew_alpha = NEWTON_EW_ALPHA;
+	newton->eta_max = NEWTON_ETA_MAX;
+	newton->cgs_max_iterations = NEWTON_CGS_MAX_ITERATIONS;
+
+	newton->g = (double *)malloc(DIM_size);
+	newton->s = (double *)malloc(DIM_size);
+	newton->s_ref = (double *)malloc(DIM_size);
+	newton->rhs = (double *)malloc(DIM_size);
+	newton->u_old = (double *)malloc(DIM_size);
+
+	// PARDISO for this grid: low rank diff arrays are detected at each update.
+	pardiso_start(NrInterior, NzInterior);
+
+	return;
+}
+
+// Nonlinear residual F(u) = f - g(u) - Lu on the reduced grid, with the
+// boundary rows of the linear solver, relative to the norm of f - g(u).
+// Also leaves g(u) in newton->g.
+static double newton_residual(newton_solver *newton, newton_work *work, const double *u,
+	const double *ell_f, newton_function residual, void *ctx,
+	const double uInf, const int r_sym, const int z_sym)
+{
+	struct matrix_descr descrA;
+	sparse_matrix_t csrA;
+	int NrInterior = newton->NrInterior;
+	int NzInterior = newton->NzInterior;
+	int ghost = newton->ghost;
+	int DIM = (ghost + NrInterior + 1) * (ghost + NzInterior + 1);
+	int k;
+
+	residual(u, newton->g, DIM, ctx);
+
+	#pragma omp parallel for schedule(static)
+	for (k = 0; k < DIM; k++)
+		newton->rhs[k] = ell_f[k] - newton->g[k];
+
+	ghost_reduce(newton->rhs, work->g_f, NrInterior, NzInterior, ghost);
+	ghost_reduce(u, work->g_u, NrInterior, NzInterior, ghost);
+
+	// Linear operator without source.
+	if (work->tabled)
+		csr_gen_stencil(work->A, NrInterior, NzInterior, newton->norder, newton->dr, newton->dz,
+			work->g_a, work->g_b, work->g_c, work->g_d, work->g_e, work->g_s, work->g_f, uInf, newton->robin, r_sym, z_sym);
+	else
+		csr_gen_general_elliptic(work->A, NrInterior, NzInterior, newton->norder, newton->dr, newton->dz,
+			work->g_a, work->g_b, work->g_c, work->g_d, work->g_e, work->g_s, work->g_f, uInf, newton->robin, r_sym, z_sym);
+
+	// r = f - g(u) - Lu.
+	mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, work->A.nrows, work->A.ncols,
+		work->A.ia, work->A.ia + 1, work->A.ja, work->A.a);
+	descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
+	mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, -1.0, csrA, descrA, work->g_u, 0.0, work->g_r);
+	mkl_sparse_destroy(csrA);
+	cblas_daxpy(work->A.nrows, 1.0, work->g_f, 1, work->g_r, 1);
+
+	double fnorm = cblas_dnrm2(work->A.nrows, work->g_f, 1);
+	double rnorm = cblas_dnrm2(work->A.nrows, work->g_r, 1);
+
+	return (fnorm > 0.0) ? rnorm / fnorm : rnorm;
+}
+
+// Linear Newton step: solve (L + s) u_new = f - g(u) + s u for the new
+// iterate, which keeps the Robin boundary condition on u itself.
+//
+// After the first factorization, direct steps detect the changed matrix
+// entries: an unchanged Jacobian skips the factorization and one that only
+// changed in s is refreshed with a low rank update of the diagonal. CGS
+// steps start from u, reuse the analysis and take the stale LU as
+// preconditioner. Returns the status of the linear solve.
+static int newton_step(newton_solver *newton, double *u, double *res,
+	const double *ell_a, const double *ell_b, const double *ell_c, const double *ell_d, const double *ell_e,
+	const double *s, const double *ell_f, const double uInf, const int r_sym, const int z_sym,
+	const int precond_use, solver_stats *lin)
+{
+	int DIM = (newton->ghost + newton->NrInterior + 1) * (newton->ghost + newton->NzInterior + 1);
+	int k;
+
+	#pragma omp parallel for schedule(static)
+	for (k = 0; k < DIM; k++)
+		newton->rhs[k] = ell_f[k] - newton->g[k] + s[k] * u[k];
+
+	skip_analysis = (precond_use > 0);
+	guess_use = (precond_use > 0);
+
+	int status = general_elliptic(u, res, ell_a, ell_b, ell_c, ell_d, ell_e, s, newton->rhs,
+		uInf, newton->robin, r_sym, z_sym, newton->NrInterior, newton->NzInterior, newton->ghost,
+		newton->dr, newton->dz, newton->norder, (newton->factored && !precond_use) ? 2 : 0, precond_use, lin);
+
+	skip_analysis = 0;
+	guess_use = 0;
+
+	return status;
+}
+
+// Add the phase times of a linear step.
+static void newton_add_stats(solver_stats *stats, const solver_stats *lin)
+{
+	stats->t_reduce += lin->t_reduce;
+	stats->t_assemble += lin->t_assemble;
+	stats->t_analyse += lin->t_analyse;
+	stats->t_factor += lin->t_factor;
+	stats->t_solve += lin->t_solve;
+	stats->t_residual += lin->t_residual;
+	stats->t_fill += lin->t_fill;
+	stats->nnz = lin->nnz;
+	stats->factor_nnz = lin->factor_nnz;
+	stats->factor_mflops = lin->factor_mflops;
+	stats->mem_peak_analysis = lin->mem_peak_analysis;
+	stats->mem_permanent = lin->mem_permanent;
+	stats->mem_factor = lin->mem_factor;
+	stats->perturbed_pivots += lin->perturbed_pivots;
+	stats->refinement_steps += lin->refinement_steps;
+
+	return;
+}
+
+// Solve the nonlinear equation with u as initial guess.
+//
+// Every iteration solves the linearized equation for the new iterate with
+// the linear source s of the Jacobian. Full Newton takes a fresh Jacobian
+// every iteration. Chord keeps the Jacobian, and with it the LU, while the
+// relative residual drops at least by contraction per iteration, and
+// Shamanskii also refreshes it every refresh iterations. Inexact Newton
+// evaluates the Jacobian every iteration but solves with CGS preconditioned
+// by the last LU, stopping at the Eisenstat-Walker forcing term (choice 2):
+//
+// eta_k = gamma (|F_k| / |F_k-1|)^alpha,
+//
+// safeguarded by gamma eta_k-1^alpha and capped at eta_max. A CGS solve
+// that fails or needs more than cgs_max_iterations is repeated with a low
+// rank update of the LU. A failed linear solve stops the iterations, drops
+// the LU and returns its status.
+int newton_solve(newton_solver *newton,
+	double *u,		// Solution: initial guess on input.
+	double *res,		// Output nonlinear residual.
+	const double *ell_a,	// Coefficient of (d^2/dr^2).
+	const double *ell_b,	// Coefficient of (d^2/drdz).
+	const double *ell_c,	// Coefficient of (d^2/dz^2).
+	const double *ell_d,	// Coefficient of (d/dr).
+	const double *ell_e,	// Coefficient of (d/dz).
+	const double *ell_f,	// RHS.
+	newton_function residual,	// Nonlinear term g(u).
+	newton_function jacobian,	// Its derivative dg/du.
+	void *ctx,		// Callback context.
+	const double uInf,	// u value at infinity for Robin BC.
+	const int r_sym,	// R symmetry: 1(even), -1(odd).
+	const int z_sym,	// Z symmetry: 1(even), -1(odd).
+	solver_stats *stats)	// Output statistics, may be NULL.
+{
+	solver_stats local_stats, lin;
+	double t_start = omp_get_wtime();
+	int NrInterior = newton->NrInterior;
+	int NzInterior = newton->NzInterior;
+	int ghost = newton->ghost;
+	int DIM = (ghost + NrInterior + 1) * (ghost + NzInterior + 1);
+	int DIM0 = (NrInterior + 2) * (NzInterior + 2);
+	size_t DIM_size = DIM * sizeof(double);
+	int status = ELL_SUCCESS;
+
+	if (stats == NULL)
+		stats = &local_stats;
+	solver_stats_reset(stats);
+
+	// Reduced operator of the nonlinear residual.
+	newton_work work;
+	work.tabled = (newton->norder == 6 || grid_map_active());
+	int nnz0 = work.tabled ? nnz_stencil(NrInterior, NzInterior, newton->norder, newton->robin, 1)
+		: nnz_general_elliptic(NrInterior, NzInterior, newton->norder, newton->robin);
+	csr_allocate(&work.A, DIM0, DIM0, nnz0);
+	work.g_a = (double *)malloc(DIM0 * sizeof(double));
+	work.g_b = (double *)malloc(DIM0 * sizeof(double));
+	work.g_c = (double *)malloc(DIM0 * sizeof(double));
+	work.g_d = (double *)malloc(DIM0 * sizeof(double));
+	work.g_e = (double *)malloc(DIM0 * sizeof(double));
+	work.g_s = (double *)calloc(DIM0, sizeof(double));
+	work.g_f = (double *)malloc(DIM0 * sizeof(double));
+	work.g_u = (double *)malloc(DIM0 * sizeof(double));
+	work.g_r = (double *)malloc(DIM0 * sizeof(double));
+	ghost_reduce(ell_a, work.g_a, NrInterior, NzInterior, ghost);
+	ghost_reduce(ell_b, work.g_b, NrInterior, NzInterior, ghost);
+	ghost_reduce(ell_c, work.g_c, NrInterior, NzInterior, ghost);
+	ghost_reduce(ell_d, work.g_d, NrInterior, NzInterior, ghost);
+	ghost_reduce(ell_e, work.g_e, NrInterior, NzInterior, ghost);
+
+	newton->iterations = 0;
+	newton->nfactor = 0;
+	newton->ncgs = 0;
+	newton->nfallback = 0;
+
+	double norm = newton_residual(newton, &work, u, ell_f, residual, ctx, uInf, r_sym, z_sym);
+	double norm_prev = norm;
+	double eta = newton->eta_max;
+	int refresh = 1;
+	int convergence = (norm < newton->tol);
+
+	printf("NEWTON: Iteration 0, relative residual %3.3E.\n", norm);
+
+	while (!convergence && newton->iterations < newton->max_iterations)
+	{
+		int precond_use = 0;
+		const double *s_step = newton->s_ref;
+
+		// Jacobian.
+		if (newton->method == NEWTON_FULL || !newton->factored)
+			refresh = 1;
+		else if (newton->method == NEWTON_SHAMANSKII && newton->iterations % newton->refresh == 0)
+			refresh = 1;
+
+		if (newton->method == NEWTON_INEXACT && newton->factored)
+		{
+			// Fresh Jacobian on the stale LU: the wrapper measures CGS
+			// against |f|, and the defect of the guess u is |F|.
+			jacobian(u, newton->s, DIM, ctx);
+			s_step = newton->s;
+			precond_use = (int)ceil(-log10(eta * norm));
+			precond_use = (precond_use < 1) ? 1 : precond_use;
+			memcpy(newton->u_old, u, DIM_size);
+		}
+		else if (refresh)
+		{
+			jacobian(u, newton->s_ref, DIM, ctx);
+		}
+
+		solver_stats_reset(&lin);
+		status = newton_step(newton, u, res, ell_a, ell_b, ell_c, ell_d, ell_e, s_step, ell_f, uInf, r_sym, z_sym, precond_use, &lin);
+		newton_add_stats(stats, &lin);
+
+		// Check CGS.
+		if (status == ELL_SUCCESS && precond_use)
+		{
+			if (lin.cgs_iterations < 0 || lin.cgs_iterations > newton->cgs_max_iterations)
+			{
+				printf("NEWTON: CGS iterations = %d, refactoring.\n", lin.cgs_iterations);
+				newton->nfallback++;
+				memcpy(u, newton->u_old, DIM_size);
+				memcpy(newton->s_ref, newton->s, DIM_size);
+				solver_stats_reset(&lin);
+				status = newton_step(newton, u, res, ell_a, ell_b, ell_c, ell_d, ell_e, newton->s_ref, ell_f, uInf, r_sym, z_sym, 0, &lin);
+				newton_add_stats(stats, &lin);
+				newton->nfactor++;
+			}
+			else
+			{
+				newton->ncgs++;
+			}
+		}
+		else if (refresh)
+		{
+			newton->nfactor++;
+			newton->factored = 1;
+		}
+
+		// Failed linear solve: u is unchanged and the LU is lost.
+		if (status != ELL_SUCCESS)
+		{
+			printf("NEWTON: ERROR! Linear solve failed with status %d in iteration %d.\n", status, newton->iterations + 1);
+			newton->factored = 0;
+			break;
+		}
+		refresh = 0;
+		newton->iterations++;
+
+		// New residual and forcing term.
+		norm_prev = norm;
+		norm = newton_residual(newton, &work, u, ell_f, residual, ctx, uInf, r_sym, z_sym);
+		convergence = (norm < newton->tol);
+		if (!isfinite(norm))
+		{
+			printf("NEWTON: ERROR! Iteration %d diverged.\n", newton->iterations);
+			break;
+		}
+
+		double eta_safe = newton->ew_gamma * pow(eta, newton->ew_alpha);
+		eta = newton->ew_gamma * pow(norm / norm_prev, newton->ew_alpha);
+		eta = (eta_safe > 0.1 && eta_safe > eta) ? eta_safe : eta;
+		eta = (eta > newton->eta_max) ? newton->eta_max : eta;
+
+		// Slow contraction: new Jacobian for the next iteration.
+		if ((newton->method == NEWTON_CHORD || newton->method == NEWTON_SHAMANSKII) && norm > newton->contraction * norm_prev)
+			refresh = 1;
+
+		printf("NEWTON: Iteration %d, relative residual %3.3E.\n", newton->iterations, norm);
+	}
+
+	// Nonlinear residual on the full grid.
+	double t0 = omp_get_wtime();
+	ghost_fill(work.g_r, res, r_sym, z_sym, NrInterior, NzInterior, ghost);
+	stats->t_fill += omp_get_wtime() - t0;
+
+	if (convergence)
+		printf("NEWTON: Converged in %d iterations with %d factorizations.\n", newton->iterations, newton->nfactor);
+	else
+		printf("NEWTON: WARNING! No convergence after %d iterations, relative residual %3.3E.\n", newton->iterations, norm);
+
+	newton->norm = norm;
+
+	stats->solver = newton_method_names[newton->method];
+	stats->NrInterior = NrInterior;
+	stats->NzInterior = NzInterior;
+	stats->order = newton->norder;
+	stats->robin = newton->robin;
+	stats->lr_use = 2;
+	stats->iterations = newton->iterations;
+	stats->abs_residual = cblas_dnrm2(DIM0, work.g_r, 1);
+	stats->rel_residual = norm;
+	stats->convergence = convergence;
+	stats->status = status;
+	stats->t_total = omp_get_wtime() - t_start;
+
+	csr_deallocate(&work.A);
+	free(work.g_a);
+	free(work.g_b);
+	free(work.g_c);
+	free(work.g_d);
+	free(work.g_e);
+	free(work.g_s);
+	free(work.g_f);
+	free(work.g_u);
+	free(work.g_r);
+
+	return status;
+}
+
+// Stop solver: releases PARDISO and solver memory.
+void newton_stop(newton_solver *newton)
+{
+	low_rank_deallocate();
+	pardiso_stop();
+	free(newton->g);
+	free(newton->s);
+	free(newton->s_ref);
+	free(newton->rhs);
+	free(newton->u_old);
+	newton->g = NULL;
+	newton->s = NULL;
+	newton->s_ref = NULL;
+	newton->rhs = NULL;
+	newton->u_old = NULL;
+
+	return;
+}
+#endif
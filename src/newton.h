@@ -0,0 +1,67 @@
+// Jacobian strategies of the Newton solver.
+#define NEWTON_FULL 0		// Fresh Jacobian and factorization every iteration.
+#define NEWTON_CHORD 1		// Keep the first Jacobian while the residual contracts.
+#define NEWTON_SHAMANSKII 2	// Refresh the Jacobian every refresh iterations.
+#define NEWTON_INEXACT 3	// Fresh Jacobian solved by CGS on the stale LU.
+
+// Nonlinear term callback: fills g on the full DIM grid, with ghost zones,
+// for the solution u. ctx is passed through unchanged.
+typedef void (*newton_function)(const double *u, double *g, const int DIM, void *ctx);
+
+// Newton solver for the nonlinear elliptic equation
+//     2       2       2
+// (a d  +  b d  +  c d  +  d d  +  e d ) u  +  g(u)  =  f,
+//     rr      rz      zz      r       z
+//
+// where the residual callback gives g(u) and the Jacobian callback its
+// derivative dg/du, the linear source s of the Jacobian.
+typedef struct newton_solvers
+{
+	// Problem: fixed for the whole solver.
+	int NrInterior;
+	int NzInterior;
+	int ghost;
+	double dr;
+	double dz;
+	int norder;
+	int robin;
+	// Strategy and thresholds.
+	int method;		// NEWTON_FULL, NEWTON_CHORD, NEWTON_SHAMANSKII or NEWTON_INEXACT.
+	int refresh;		// Shamanskii: iterations per Jacobian.
+	double tol;		// Relative nonlinear residual tolerance.
+	int max_iterations;	// Maximum Newton iterations.
+	double contraction;	// Chord/Shamanskii: refresh when the residual drops less.
+	double ew_gamma;	// Eisenstat-Walker forcing terms, choice 2.
+	double ew_alpha;
+	double eta_max;
+	int cgs_max_iterations;	// Inexact: refactor when CGS needs more iterations.
+	// Counters.
+	int iterations;
+	int nfactor;
+	int ncgs;
+	int nfallback;
+	double norm;
+	// Work arrays: full grid.
+	double *g;
+	double *s;
+	double *s_ref;
+	double *rhs;
+	double *u_old;
+	int factored;
+} newton_solver;
+
+// Start solver: initializes PARDISO.
+void newton_start(newton_solver *newton, const int NrInterior, const int NzInterior,
+	const int ghost, const double dr, const double dz, const int norder, const int robin);
+
+// Solve the nonlinear equation with u as initial guess. res holds the
+// nonlinear residual on output. Returns ELL_SUCCESS, or the status of a
+// failed linear solve, which stops the iterations; stats->convergence holds
+// the convergence flag.
+int newton_solve(newton_solver *newton, double *u, double *res,
+	const double *ell_a, const double *ell_b, const double *ell_c, const double *ell_d, const double *ell_e,
+	const double *ell_f, newton_function residual, newton_function jacobian, void *ctx,
+	const double uInf, const int r_sym, const int z_sym, solver_stats *stats = NULL);
+
+// Stop solver: releases PARDISO and solver memory.
+void newton_stop(newton_solver *newton);
@@ -2,6 +2,9 @@
 #undef VERBOSE
 // PARDISO message level.
 #define MESSAGE_LEVEL 0
+// Fallback chain steps on PARDISO failures, tried in this order.
+#define FALLBACK_PERTURB 1	// Analyse and factor again with a larger pivot perturbation.
+#define FALLBACK_ITERATIVE 2	// GMRES preconditioned with the LU of the last good matrix.
 // Standard headers for allocation.
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,6 +46,21 @@ int *perm;
 int *diff;
 // Matrix-vector multiplication type.
 char uplo[1];
+// Use input solution as initial guess for CGS: on(1), off(0).
+int guess_use;
+// Skip reordering and symbolic factorization of an unchanged pattern: on(1), off(0).
+int skip_analysis;
+// Matrix values of the last direct numerical factorization.
+double *factored_a;
+int factored_nnz;
+// Relative change below which an entry is not a low rank difference.
+double lr_threshold;
+// Deferred correction of fourth order with the second order LU: maximum number of corrections, off(0).
+int dc_use;
+// Additive Schwarz preconditioned GMRES: subdomains per direction, off(0).
+int schwarz_use;
+// Fallback chain on PARDISO failures: sum of FALLBACK_* steps, off(0).
+int fallback_use;
 #else
 extern int solver;
 extern int mtype;
@@ -60,4 +78,12 @@ extern int idum;
 extern int *perm;
 extern int *diff;
 extern char uplo[1];
+extern int guess_use;
+extern int skip_analysis;
+extern double *factored_a;
+extern int factored_nnz;
+extern double lr_threshold;
+extern int dc_use;
+extern int schwarz_use;
+extern int fallback_use;
 #endif
@@ -2,6 +2,9 @@
 #define PARDISO_MAIN_FILE
 #include "pardiso_param.h"
 
+// Per-phase thread counts.
+#include "thread_profile.h"
+
 #undef DEBUG
 
 // Initialize PARDISO parameters and memory.
@@ -68,10 +71,34 @@ void pardiso_start(const int NrInterior, const int NzInterior)
 	// Set Low Rank array pointing towards NULL.
 	diff = NULL;
 
+	// Solution is not used as initial guess by default.
+	guess_use = 0;
+	// Always analyse by default.
+	skip_analysis = 0;
+
+	// No factorization stored yet: low rank differences must be exact.
+	factored_a = NULL;
+	factored_nnz = 0;
+	lr_threshold = 0.0;
+
+	// Fourth order is factored directly by default.
+	dc_use = 0;
+
+	// One global LU by default.
+	schwarz_use = 0;
+
+	// Complete fallback chain by default.
+	fallback_use = FALLBACK_PERTURB + FALLBACK_ITERATIVE;
+
 	// Setup matrix-vector multiplication type.
 	// Non-transposed, i.e. y = A*x.
 	uplo[0] = 'N';
 
+	// Optional per-phase thread profile written by ELLBENCH tune.
+	char *profile = getenv("ELL_THREAD_PROFILE");
+	if (profile != NULL)
+		thread_profile_load(profile);
+
 #ifdef VERBOSE
 	printf("PARDISO: Setup solver memory and parameters.\n");
 #endif
@@ -23,6 +23,11 @@ void pardiso_stop(void)
 
 	// Delete permutation vector.
 	free(perm);
+
+	// Delete stored factorization values.
+	free(factored_a);
+	factored_a = NULL;
+	factored_nnz = 0;
 #ifdef VERBOSE
 	printf("PARDISO: All memory clear.\n");
 #endif
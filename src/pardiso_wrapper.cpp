@@ -1,81 +1,90 @@
 #include "tools.h"
 #include "pardiso_param.h"
 #include "pardiso.h"
+#include "thread_profile.h"
+#include "low_rank.h"
 
 // Define for matrix, vector checks.
 #undef DEBUG
 
-void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
-	double *u,			// Solution array.
-	double *f,			// RHS array.
-	double *r,			// Residual, r = f - Au, array.
-	const double tol,		// Tolerance convergence.
-	double *norm,			// Pointer to final norm.
-	int *convergence,		// Pointer to convergence flag.
-	const int infnorm,		// Select infnorm or twonorm.
-	const int lr_use,		// Low Rank update: on(1), off(0).
-	const int precond_use)		// Use previously computed LU with CGS iteration.
-					// 0: Do not use CGS preconditioner.
-					// L: Stopping criterion of Krylov-Subspace iteration 10**(-L).
+// Fallback chain: pivot perturbation 10^(-FALLBACK_PIVOT) and iterative
+// refinement steps of the retry, GMRES restart length, maximum iterations
+// and relative residual.
+#define FALLBACK_PIVOT 8
+#define FALLBACK_REFINEMENT 20
+#define FALLBACK_RESTART 30
+#define FALLBACK_MAX_ITERATIONS 300
+#define FALLBACK_TOL 1.0E-10
+
+// Compute residual r = f - Au with MKL CSR MV.
+static void pardiso_residual(const csr_matrix A, const double *u, const double *f, double *r)
 {
-	// Auxiliary doubles for residual.
-	double res, res0;
+	struct matrix_descr descrA;
+	sparse_matrix_t csrA;
+	// Create hanlde with matrix.
+	mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, A.nrows, A.ncols, A.ia, A.ia + 1, A.ja, A.a);
+	// Create matrix description.
+	descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
+	// Analyze sparse matrix: choose proper kernels and workload.
+	mkl_sparse_optimize(csrA);
+	// Compute r = alpha * A * u + beta * r.
+	mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, -1.0, csrA, descrA, u, 0.0, r);
+	// Add RHS.
+	cblas_daxpy(A.nrows, 1.0, f, 1, r, 1);
+	// Release memory.
+	mkl_sparse_destroy(csrA);
 
-	// Modify parameters according to CGS preconditioner.
-	if (precond_use)
-	{
-		/// LU preconditioned with CGS.
-		iparm[4 - 1] = 10 * precond_use + 1;
-	}
+	return;
+}
 
-	// Modify parameters according to Low-Rank update.
-	if (lr_use)
-	{
-		// Check if we are calling preconditioner.
-		if (precond_use)
-		{
-			printf("WARNING: Calling preconditioner while using low rank update is not possible. Turning preconditioner off.\n");
-		}
-		// Set low rank parameters.
-		iparm[39 - 1] = 1;
-		iparm[24 - 1] = 10;
-		// No permutation.
-		iparm[5 - 1] = 0;
-		// No CGS.
-		iparm[4 - 1] = 0;
-		// Additional values.
-		iparm[28 - 1] = 0;
-		iparm[31 - 1] = 0;
-		iparm[36 - 1] = 0;
-		iparm[37 - 1] = 0;
-		iparm[56 - 1] = 0;
-		iparm[60 - 1] = 0;
-	}
+// The factors in pt belong to the last matrix solved by pardiso_wrapper,
+// false after a solve that failed or needed the GMRES fallback.
+static int pardiso_factored = 0;
 
+// Analysis, factorization and solve phases: low rank update or complete.
+// Phase times are added to the timers. Returns ELL_SUCCESS or the status
+// code of the failed phase.
+static int pardiso_direct(const csr_matrix A,// Matrix system to solve: Au = f.
+	double *u,			// Solution array.
+	double *f,			// RHS array.
+	const int low_rank,		// Low Rank update: on(1), off(0).
+	const int precond_use,		// CGS stopping criterion 10**(-L), off(0).
+	const int analyse,		// Reordering and symbolic factorization: on(1), off(0).
+	double *t_analyse,		// Analysis timer.
+	double *t_factor,		// Factorization timer.
+	double *t_solve)		// Solve timer.
+{
+	double t0;
 
-	// Debugging and recheck procedures.
-#ifdef DEBUG
-	// Check matrix for errors.
-	iparm[27 - 1] = 1;
-#endif
+	pardiso_factored = 0;
 
 	// If using low-rank, calls are different.
 	// Notice in particular that diff is used instead of perm array.
-	if (lr_use)
+	if (low_rank)
 	{
 #ifdef VERBOSE
 		printf("PARDISO: Using Low Rank update to skip analysis phase.\n");
 #endif
-		// Numerical factorization.
-		phase = 22;
-		pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
-			&n, A.a, A.ia, A.ja, diff, &nrhs, 
-			iparm, &msglvl, &ddum, &ddum, &error);
-
-		if (error != 0) 
+		// Numerical factorization: nothing to update if no entry changed.
+		if (diff[0] > 0)
 		{
-			printf("ERROR during numerical factorization: %d.\n", error);
-			exit(2);
+			t0 = omp_get_wtime();
+			thread_phase_begin(PHASE_FACTOR);
+			numa_interleave_begin();
+			phase = 22;
+			pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
+				&n, A.a, A.ia, A.ja, diff, &nrhs, 
+				iparm, &msglvl, &ddum, &ddum, &error);
+			numa_interleave_end();
+			thread_phase_end();
+			*t_factor += omp_get_wtime() - t0;
+
+			if (error != 0) 
+			{
+				printf("ERROR during numerical factorization: %d.\n", error);
+				return ELL_ERROR_FACTOR;
+			}
+			low_rank_store_diff(A);
 		}
 
 #ifdef VERBOSE
@@ -83,15 +92,19 @@ void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
 #endif
 
 		// Back substitution and iterative refinement.
+		t0 = omp_get_wtime();
+		thread_phase_begin(PHASE_SOLVE);
 		phase = 33;
 		pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
 			&n, A.a, A.ia, A.ja, diff, &nrhs, 
 			iparm, &msglvl, f, u, &error);
+		thread_phase_end();
+		*t_solve += omp_get_wtime() - t0;
 
 		if (error != 0) 
 		{
 			printf("ERROR during solution: %d,\n", error);
-			exit(3);
+			return ELL_ERROR_SOLVE;
 		}
 
 	}
@@ -99,16 +112,26 @@ void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
 	else 
 	{
 
-		// Reordering and symbolic factorization.
-		phase = 11;
-		pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
-			&n, A.a, A.ia, A.ja, perm, &nrhs, 
-			iparm, &msglvl, &ddum, &ddum, &error);
-
-		if (error != 0) 
+		// Reordering and symbolic factorization: may be kept from a
+		// previous call with the same sparsity pattern.
+		if (analyse)
 		{
-			printf("ERROR during symbolic factorization: %d.\n", error);
-			exit(1);
+			t0 = omp_get_wtime();
+			thread_phase_begin(PHASE_ANALYSE);
+			numa_interleave_begin();
+			phase = 11;
+			pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
+				&n, A.a, A.ia, A.ja, perm, &nrhs, 
+				iparm, &msglvl, &ddum, &ddum, &error);
+			numa_interleave_end();
+			thread_phase_end();
+			*t_analyse += omp_get_wtime() - t0;
+
+			if (error != 0) 
+			{
+				printf("ERROR during symbolic factorization: %d.\n", error);
+				return ELL_ERROR_ANALYSIS;
+			}
 		}
 		
 #ifdef VERBOSE
@@ -118,26 +141,70 @@ void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
 #endif
 
 		// Numerical factorization.
+		t0 = omp_get_wtime();
+		thread_phase_begin(PHASE_FACTOR);
+		numa_interleave_begin();
 		phase = 22;
 		pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
 			&n, A.a, A.ia, A.ja, perm, &nrhs, 
 			iparm, &msglvl, &ddum, &ddum, &error);
+		numa_interleave_end();
+		thread_phase_end();
+		*t_factor += omp_get_wtime() - t0;
 
 		if (error != 0) 
 		{
 			printf("ERROR during numerical factorization: %d.\n", error);
-			exit(2);
+			return ELL_ERROR_FACTOR;
 		}
 
+		// Keep values of direct factorizations for low rank differences:
+		// with CGS the LU may belong to an older matrix.
+		if (!precond_use)
+			low_rank_store(A);
+
 #ifdef VERBOSE
 		printf("PARDISO: Factorization completed.\n");
 #endif
 
 		// Back substitution and iterative refinement.
+		t0 = omp_get_wtime();
+		thread_phase_begin(PHASE_SOLVE);
 		phase = 33;
-		pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
-			&n, A.a, A.ia, A.ja, perm, &nrhs, 
-			iparm, &msglvl, f, u, &error);
+		if (precond_use && guess_use)
+		{
+			// Defect correction from the initial guess: solve A e = f - Au
+			// and update u = u + e. CGS only has to reduce the defect to
+			// the original 10^(-L) * ||f||, so L is lowered accordingly.
+			double *d = (double *)malloc(A.nrows * sizeof(double));
+			double *e = (double *)malloc(A.nrows * sizeof(double));
+			pardiso_residual(A, u, f, d);
+			double dnorm = cblas_dnrm2(A.nrows, d, 1);
+			double fnorm = cblas_dnrm2(A.nrows, f, 1);
+			int L = precond_use;
+			if (dnorm > 0.0 && fnorm > 0.0)
+				L = (int)ceil((double)precond_use + log10(dnorm / fnorm));
+			L = (L < 1) ? 1 : L;
+			iparm[4 - 1] = 10 * L + 1;
+#ifdef VERBOSE
+			printf("PARDISO: Initial guess defect %e, CGS stopping criterion 10^(-%d).\n", dnorm / fnorm, L);
+#endif
+			pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
+				&n, A.a, A.ia, A.ja, perm, &nrhs, 
+				iparm, &msglvl, d, e, &error);
+			cblas_daxpy(A.nrows, 1.0, e, 1, u, 1);
+			iparm[4 - 1] = 10 * precond_use + 1;
+			free(d);
+			free(e);
+		}
+		else
+		{
+			pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
+				&n, A.a, A.ia, A.ja, perm, &nrhs, 
+				iparm, &msglvl, f, u, &error);
+		}
+		thread_phase_end();
+		*t_solve += omp_get_wtime() - t0;
 
 		// Report CGS iterations.
 #ifdef VERBOSE
@@ -148,26 +215,368 @@ void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
 		if (error != 0) 
 		{
 			printf("ERROR during solution: %d,\n", error);
-			exit(3);
+			return ELL_ERROR_SOLVE;
 		}
 	}
 
+	pardiso_factored = 1;
+
+	return ELL_SUCCESS;
+}
+
+// First fallback: analyse and factor again with a larger pivot perturbation
+// and more iterative refinement steps. A failed low rank update or CGS
+// solve is retried as a complete direct solve.
+static int pardiso_fallback_perturb(const csr_matrix A, double *u, double *f,
+	double *t_analyse, double *t_factor, double *t_solve)
+{
+	// Keep parameters of the regular solves.
+	int pivot = iparm[10 - 1];
+	int refinement = iparm[8 - 1];
+	int status;
+
+	printf("PARDISO: FALLBACK! Retrying with pivot perturbation 1E-%d.\n", MIN(pivot, FALLBACK_PIVOT));
+	iparm[10 - 1] = MIN(pivot, FALLBACK_PIVOT);
+	iparm[8 - 1] = MAX(refinement, FALLBACK_REFINEMENT);
+	iparm[4 - 1] = 0;
+	iparm[39 - 1] = 0;
+
+	status = pardiso_direct(A, u, f, 0, 0, 1, t_analyse, t_factor, t_solve);
+
+	iparm[10 - 1] = pivot;
+	iparm[8 - 1] = refinement;
+
+	return status;
+}
+
+// Apply the fallback preconditioner: z = P^(-1) r with the LU of P.
+static int pardiso_fallback_apply(void **f_pt, int *f_iparm, const csr_matrix A, const double *P,
+	double *r, double *z, double *t_solve)
+{
+	double t0 = omp_get_wtime();
+	int f_phase = 33;
+	int f_error = 0;
+
+	thread_phase_begin(PHASE_SOLVE);
+	pardiso(f_pt, &maxfct, &mnum, &mtype, &f_phase, 
+		&n, P, A.ia, A.ja, perm, &nrhs, 
+		f_iparm, &msglvl, r, z, &f_error);
+	thread_phase_end();
+	*t_solve += omp_get_wtime() - t0;
+
+	return f_error;
+}
+
+// Second fallback: restarted GMRES on Au = f, right preconditioned with the
+// LU of the last successfully factored matrix P.
+//
+// PARDISO does not keep the previous factors of a handle whose numerical
+// factorization failed, so the values of P, already kept for low rank
+// differences, are factored in a separate handle. P differs from A by one
+// step of the host simulation, so GMRES typically needs a few iterations.
+// The iteration stops at a relative residual of MIN(tol, FALLBACK_TOL) or
+// after FALLBACK_MAX_ITERATIONS. Returns ELL_SUCCESS if it converged.
+static int pardiso_fallback_gmres(const csr_matrix A, double *u, double *f, const double tol,
+	const int status, int *iterations, double *t_factor, double *t_solve)
+{
+	// Separate handle for the LU of P: no iterative refinement, so the
+	// solve phase only applies the factors.
+	void *f_pt[64];
+	int f_iparm[64];
+	int f_phase, f_error = 0;
+
+	// GMRES variables.
+	int N = A.nrows;
+	int m = FALLBACK_RESTART;
+	int i, j, k, it = 0, converged = 0;
+	double beta, target, h, rho, t0;
+
+	if (factored_a == NULL || factored_nnz != A.nnz)
+	{
+		printf("PARDISO: FALLBACK! No previous factorization to precondition GMRES.\n");
+		return status;
+	}
+	printf("PARDISO: FALLBACK! GMRES with the last good factorization as preconditioner.\n");
+
+	for (k = 0; k < 64; k++)
+	{
+		f_pt[k] = 0;
+		f_iparm[k] = iparm[k];
+	}
+	f_iparm[4 - 1] = 0;
+	f_iparm[5 - 1] = 0;
+	f_iparm[8 - 1] = 0;
+	f_iparm[39 - 1] = 0;
+
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_FACTOR);
+	numa_interleave_begin();
+	f_phase = 12;
+	pardiso(f_pt, &maxfct, &mnum, &mtype, &f_phase, 
+		&n, factored_a, A.ia, A.ja, perm, &nrhs, 
+		f_iparm, &msglvl, &ddum, &ddum, &f_error);
+	numa_interleave_end();
+	thread_phase_end();
+	*t_factor += omp_get_wtime() - t0;
+
+	// Krylov basis, Hessenberg matrix with Givens rotations and work arrays.
+	double *V = (double *)malloc((m + 1) * N * sizeof(double));
+	double *H = (double *)malloc((m + 1) * m * sizeof(double));
+	double *cs = (double *)malloc(m * sizeof(double));
+	double *sn = (double *)malloc(m * sizeof(double));
+	double *g = (double *)malloc((m + 1) * sizeof(double));
+	double *w = (double *)malloc(N * sizeof(double));
+	double *z = (double *)malloc(N * sizeof(double));
 
-	// Compute residual with MKL CSR MV.
 	struct matrix_descr descrA;
 	sparse_matrix_t csrA;
-	// Create hanlde with matrix.
 	mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, A.nrows, A.ncols, A.ia, A.ia + 1, A.ja, A.a);
-	// Create matrix description.
 	descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
-	// Analyze sparse matrix: choose proper kernels and workload.
 	mkl_sparse_optimize(csrA);
-	// Compute r = alpha * A * u + beta * r.
-	mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, -1.0, csrA, descrA, u, 0.0, r);
-	// Add RHS.
-	cblas_daxpy(A.nrows, 1.0, f, 1, r, 1);
+
+	target = MIN(tol, FALLBACK_TOL);
+	target *= cblas_dnrm2(N, f, 1);
+	memset(u, 0, N * sizeof(double));
+
+	while (f_error == 0 && !converged && it < FALLBACK_MAX_ITERATIONS)
+	{
+		// Residual of the current iterate.
+		cblas_dcopy(N, f, 1, w, 1);
+		mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, -1.0, csrA, descrA, u, 1.0, w);
+		beta = cblas_dnrm2(N, w, 1);
+		if (beta <= target)
+		{
+			converged = 1;
+			break;
+		}
+		cblas_dcopy(N, w, 1, V, 1);
+		cblas_dscal(N, 1.0 / beta, V, 1);
+		g[0] = beta;
+
+		// Arnoldi with modified Gram-Schmidt.
+		for (j = 0; j < m && it < FALLBACK_MAX_ITERATIONS; )
+		{
+			f_error = pardiso_fallback_apply(f_pt, f_iparm, A, factored_a, V + j * N, z, t_solve);
+			if (f_error != 0)
+				break;
+			mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, 1.0, csrA, descrA, z, 0.0, w);
+			for (i = 0; i <= j; i++)
+			{
+				H[i * m + j] = cblas_ddot(N, w, 1, V + i * N, 1);
+				cblas_daxpy(N, -H[i * m + j], V + i * N, 1, w, 1);
+			}
+			H[(j + 1) * m + j] = cblas_dnrm2(N, w, 1);
+			if (H[(j + 1) * m + j] > 0.0)
+			{
+				cblas_dcopy(N, w, 1, V + (j + 1) * N, 1);
+				cblas_dscal(N, 1.0 / H[(j + 1) * m + j], V + (j + 1) * N, 1);
+			}
+
+			// Previous rotations and a new one to annihilate H(j + 1, j).
+			for (i = 0; i < j; i++)
+			{
+				h = cs[i] * H[i * m + j] + sn[i] * H[(i + 1) * m + j];
+				H[(i + 1) * m + j] = -sn[i] * H[i * m + j] + cs[i] * H[(i + 1) * m + j];
+				H[i * m + j] = h;
+			}
+			rho = sqrt(H[j * m + j] * H[j * m + j] + H[(j + 1) * m + j] * H[(j + 1) * m + j]);
+			cs[j] = H[j * m + j] / rho;
+			sn[j] = H[(j + 1) * m + j] / rho;
+			H[j * m + j] = rho;
+			g[j + 1] = -sn[j] * g[j];
+			g[j] = cs[j] * g[j];
+			j++;
+			it++;
+
+			if (ABS(g[j]) <= target || H[j * m + j - 1] == 0.0)
+				break;
+		}
+
+		// Update u = u + P^(-1) V y with H y = g.
+		for (i = j - 1; i >= 0; i--)
+		{
+			for (k = i + 1; k < j; k++)
+				g[i] -= H[i * m + k] * g[k];
+			g[i] /= H[i * m + i];
+		}
+		memset(w, 0, N * sizeof(double));
+		for (i = 0; i < j; i++)
+			cblas_daxpy(N, g[i], V + i * N, 1, w, 1);
+		if (j > 0 && f_error == 0)
+		{
+			f_error = pardiso_fallback_apply(f_pt, f_iparm, A, factored_a, w, z, t_solve);
+			cblas_daxpy(N, 1.0, z, 1, u, 1);
+		}
+	}
+
+#ifdef VERBOSE
+	printf("PARDISO: FALLBACK GMRES: %d iterations.\n", it);
+#endif
+	*iterations = it;
+
 	// Release memory.
 	mkl_sparse_destroy(csrA);
+	free(V);
+	free(H);
+	free(cs);
+	free(sn);
+	free(g);
+	free(w);
+	free(z);
+	f_phase = -1;
+	pardiso(f_pt, &maxfct, &mnum, &mtype, &f_phase, 
+		&n, &ddum, &idum, &idum, &idum, &nrhs, 
+		f_iparm, &msglvl, &ddum, &ddum, &f_error);
+
+	if (!converged)
+	{
+		printf("PARDISO: FALLBACK! GMRES did not converge in %d iterations.\n", it);
+		return status;
+	}
+
+	return ELL_SUCCESS;
+}
+
+// Solve Au = f and compute the residual.
+//
+// A failed phase no longer stops the program: the fallback steps selected
+// in fallback_use are tried in order and the status code of the failed
+// phase is returned if none of them solves the system. u is then undefined.
+int pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
+	double *u,			// Solution array.
+	double *f,			// RHS array.
+	double *r,			// Residual, r = f - Au, array.
+	const double tol,		// Tolerance convergence.
+	double *norm,			// Pointer to final norm.
+	int *convergence,		// Pointer to convergence flag.
+	const int infnorm,		// Select infnorm or twonorm.
+	const int lr_use,		// Low Rank update: on(1), off(0), detect changed entries(2).
+	const int precond_use,		// Use previously computed LU with CGS iteration.
+					// 0: Do not use CGS preconditioner.
+					// L: Stopping criterion of Krylov-Subspace iteration 10**(-L).
+	solver_stats *stats)		// Output phase times and PARDISO statistics, may be NULL.
+{
+	// Auxiliary doubles for residual.
+	double res, res0;
+
+	// Solver status and fallback step that produced the solution.
+	int status;
+	int fallback = 0;
+	int iterations = 0;
+
+	// Wall-clock phase timers.
+	double t0;
+	double t_analyse = 0.0;
+	double t_factor = 0.0;
+	double t_solve = 0.0;
+	double t_residual = 0.0;
+
+	// Low rank update: with lr_use = 2 the diff array holds only the entries
+	// that changed since the last direct factorization.
+	int low_rank = lr_use;
+	if (lr_use == 2)
+	{
+		int ndiff = low_rank_detect(A, lr_threshold);
+		if (ndiff < 0)
+		{
+			printf("WARNING: No previous factorization to compare with, low rank update turned off.\n");
+			low_rank = 0;
+		}
+#ifdef VERBOSE
+		else
+		{
+			printf("PARDISO LOW RANK UPDATE: %d of %d entries changed.\n", ndiff, A.nnz);
+		}
+#endif
+	}
+
+	// Modify parameters according to CGS preconditioner.
+	if (precond_use)
+	{
+		/// LU preconditioned with CGS.
+		iparm[4 - 1] = 10 * precond_use + 1;
+	}
+	else
+	{
+		// Direct solve: clear CGS left over from a previous call.
+		iparm[4 - 1] = 0;
+	}
+	// Clear low rank left over from a previous call.
+	iparm[39 - 1] = 0;
+
+	// Modify parameters according to Low-Rank update.
+	if (low_rank)
+	{
+		// Check if we are calling preconditioner.
+		if (precond_use)
+		{
+			printf("WARNING: Calling preconditioner while using low rank update is not possible. Turning preconditioner off.\n");
+		}
+		// Set low rank parameters.
+		iparm[39 - 1] = 1;
+		iparm[24 - 1] = 10;
+		// No permutation.
+		iparm[5 - 1] = 0;
+		// No CGS.
+		iparm[4 - 1] = 0;
+		// Additional values.
+		iparm[28 - 1] = 0;
+		iparm[31 - 1] = 0;
+		iparm[36 - 1] = 0;
+		iparm[37 - 1] = 0;
+		iparm[56 - 1] = 0;
+		iparm[60 - 1] = 0;
+	}
+
+
+	// Debugging and recheck procedures.
+#ifdef DEBUG
+	// Check matrix for errors.
+	iparm[27 - 1] = 1;
+#endif
+
+	status = pardiso_direct(A, u, f, low_rank, precond_use, !skip_analysis, &t_analyse, &t_factor, &t_solve);
+
+	// Fallback chain.
+	if (status != ELL_SUCCESS && (fallback_use & FALLBACK_PERTURB))
+	{
+		status = pardiso_fallback_perturb(A, u, f, &t_analyse, &t_factor, &t_solve);
+		if (status == ELL_SUCCESS)
+			fallback = FALLBACK_PERTURB;
+	}
+	if (status != ELL_SUCCESS && (fallback_use & FALLBACK_ITERATIVE))
+	{
+		status = pardiso_fallback_gmres(A, u, f, tol, status, &iterations, &t_factor, &t_solve);
+		if (status == ELL_SUCCESS)
+			fallback = FALLBACK_ITERATIVE;
+	}
+	// Failed solve: no solution to check.
+	if (status != ELL_SUCCESS)
+	{
+		printf("PARDISO: ERROR! Solve failed with status %d.\n", status);
+		*norm = 0.0;
+		*convergence = 0;
+		if (stats)
+		{
+			stats->t_analyse = t_analyse;
+			stats->t_factor = t_factor;
+			stats->t_solve = t_solve;
+			stats->t_residual = 0.0;
+			stats->nnz = A.nnz;
+			stats->lr_use = low_rank;
+			stats->precond_use = precond_use;
+			stats->iterations = iterations;
+			stats->convergence = 0;
+			stats->status = status;
+			stats->fallback = 0;
+		}
+		return status;
+	}
+
+	// Compute residual with MKL CSR MV.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_RESIDUAL);
+	pardiso_residual(A, u, f, r);
 
 	// Calculate norms.
 	if (infnorm) 
@@ -182,6 +591,8 @@ void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
 	}
 	// Relative residual.
 	res0 = res / res0;
+	thread_phase_end();
+	t_residual = omp_get_wtime() - t0;
 
 #ifdef VERBOSE
 	printf("PARDISO: Relative residual = %e.\n", res0);
@@ -208,6 +619,161 @@ void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
 #endif
 	}
 
+	// Report phase times and PARDISO outputs.
+	if (stats)
+	{
+		stats->t_analyse = t_analyse;
+		stats->t_factor = t_factor;
+		stats->t_solve = t_solve;
+		stats->t_residual = t_residual;
+		stats->nnz = A.nnz;
+		stats->lr_use = low_rank;
+		stats->precond_use = precond_use;
+		stats->perturbed_pivots = iparm[14 - 1];
+		stats->mem_peak_analysis = iparm[15 - 1];
+		stats->mem_permanent = iparm[16 - 1];
+		stats->mem_factor = iparm[17 - 1];
+		stats->factor_nnz = iparm[18 - 1];
+		stats->factor_mflops = iparm[19 - 1];
+		stats->cgs_iterations = iparm[20 - 1];
+		stats->refinement_steps = iparm[7 - 1];
+		stats->corrections = 0;
+		stats->iterations = iterations;
+		stats->abs_residual = res;
+		stats->rel_residual = res0;
+		stats->convergence = *convergence;
+		stats->status = ELL_SUCCESS;
+		stats->fallback = fallback;
+	}
+
 	// Return.
-	return;
+	return ELL_SUCCESS;
+}
+
+// Deferred correction: solve A4 u = f4 with the LU of the cheaper A2.
+//
+// The second order solution A2 u = f2 is corrected with
+//	u = u + A2^(-1) (f4 - A4 u)
+// until the correction falls below tol relative to u, i.e. u is within the
+// fourth order truncation error of the solution of A4, or max_corrections
+// are done. A4 only enters through matrix-vector products, so its denser LU
+// is never formed. Each correction shrinks the difference to the fourth
+// order solution to about a third of its size for the Laplacian.
+int pardiso_deferred(const csr_matrix A2,// Matrix that is factored.
+	const csr_matrix A4,		// Matrix system to solve: A4 u = f4.
+	double *u,			// Solution array.
+	double *f2,			// RHS array of A2.
+	double *f4,			// RHS array of A4.
+	double *r,			// Residual, r = f4 - A4 u, array.
+	const double tol,		// Tolerance convergence.
+	double *norm,			// Pointer to final norm.
+	int *convergence,		// Pointer to convergence flag.
+	const int infnorm,		// Select infnorm or twonorm.
+	const int max_corrections,	// Maximum number of corrections.
+	solver_stats *stats)		// Output phase times and PARDISO statistics, may be NULL.
+{
+	double res, res0, t0, enorm, unorm;
+	double t_solve = 0.0;
+	double t_residual = 0.0;
+	int k = 0;
+
+	// Correction array.
+	double *e = (double *)malloc(A2.nrows * sizeof(double));
+
+	// Second order solve: analysis and factorization of A2.
+	int status = pardiso_wrapper(A2, u, f2, r, tol, norm, convergence, infnorm, 0, 0, stats);
+	if (status != ELL_SUCCESS)
+	{
+		free(e);
+		return status;
+	}
+	// The GMRES fallback leaves no LU of A2 to correct with: the second
+	// order solution is only checked against A4.
+	int corrections = max_corrections;
+	if (!pardiso_factored)
+	{
+		printf("PARDISO: WARNING! No second order LU after fallback, deferred corrections skipped.\n");
+		corrections = 0;
+	}
+
+	while (k < corrections)
+	{
+		// Fourth order residual.
+		t0 = omp_get_wtime();
+		thread_phase_begin(PHASE_RESIDUAL);
+		pardiso_residual(A4, u, f4, r);
+		thread_phase_end();
+		t_residual += omp_get_wtime() - t0;
+
+		// Back substitution with the second order LU.
+		t0 = omp_get_wtime();
+		thread_phase_begin(PHASE_SOLVE);
+		phase = 33;
+		pardiso(pt, &maxfct, &mnum, &mtype, &phase, 
+			&n, A2.a, A2.ia, A2.ja, perm, &nrhs, 
+			iparm, &msglvl, r, e, &error);
+		thread_phase_end();
+		t_solve += omp_get_wtime() - t0;
+
+		if (error != 0) 
+		{
+			printf("ERROR during solution: %d,\n", error);
+			free(e);
+			*norm = 0.0;
+			*convergence = 0;
+			if (stats)
+			{
+				stats->convergence = 0;
+				stats->status = ELL_ERROR_SOLVE;
+			}
+			return ELL_ERROR_SOLVE;
+		}
+		cblas_daxpy(A2.nrows, 1.0, e, 1, u, 1);
+		k++;
+
+		// Size of the correction.
+		enorm = ABS(e[cblas_idamax(A2.nrows, e, 1)]);
+		unorm = ABS(u[cblas_idamax(A2.nrows, u, 1)]);
+#ifdef VERBOSE
+		printf("PARDISO DEFERRED CORRECTION: %d, relative correction = %e.\n", k, enorm / unorm);
+#endif
+		if (enorm <= tol * unorm)
+			break;
+	}
+
+	// Final fourth order residual.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_RESIDUAL);
+	pardiso_residual(A4, u, f4, r);
+	if (infnorm)
+	{
+		res = ABS(r[cblas_idamax(A4.nrows, r, 1)]);
+		res0 = ABS(f4[cblas_idamax(A4.nrows, f4, 1)]);
+	}
+	else
+	{
+		res = cblas_dnrm2(A4.nrows, r, 1);
+		res0 = cblas_dnrm2(A4.nrows, f4, 1);
+	}
+	thread_phase_end();
+	t_residual += omp_get_wtime() - t0;
+
+	free(e);
+
+	*norm = res;
+	*convergence = (res / res0 < tol);
+
+	// Report the fourth order system on top of the second order factorization.
+	if (stats)
+	{
+		stats->t_solve += t_solve;
+		stats->t_residual += t_residual;
+		stats->nnz = A4.nnz;
+		stats->corrections = k;
+		stats->abs_residual = res;
+		stats->rel_residual = res / res0;
+		stats->convergence = *convergence;
+	}
+
+	return ELL_SUCCESS;
 }
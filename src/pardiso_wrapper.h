@@ -1,4 +1,6 @@
-void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
+// Solve Au = f with PARDISO and the fallback chain: returns ELL_SUCCESS or
+// the status code of the failed phase.
+int pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
 	double *u,			// Solution array.
 	double *f,			// RHS array.
 	double *r,			// Residual, r = f - Au, array.
@@ -6,7 +8,22 @@ void pardiso_wrapper(const csr_matrix A,// Matrix system to solve: Au = f.
 	double *norm,			// Pointer to final norm.
 	int *convergence,		// Pointer to convergence flag.
 	const int infnorm,		// Select infnorm or twonorm.
-	const int lr_use,		// Low Rank update: on(1), off(0).
-	const int precond_use);		// Use previously computed LU with CGS iteration.
+	const int lr_use,		// Low Rank update: on(1), off(0), detect changed entries(2).
+	const int precond_use,		// Use previously computed LU with CGS iteration.
 					// 0: Do not use CGS preconditioner.
 					// L: Stopping criterion of Krylov-Subspace iteration 10**(-L).
+	solver_stats *stats);		// Output phase times and PARDISO statistics, may be NULL.
+
+// Deferred correction: solve A4 u = f4 with the LU of A2. Returns a status code.
+int pardiso_deferred(const csr_matrix A2,// Matrix that is factored.
+	const csr_matrix A4,		// Matrix system to solve: A4 u = f4.
+	double *u,			// Solution array.
+	double *f2,			// RHS array of A2.
+	double *f4,			// RHS array of A4.
+	double *r,			// Residual, r = f4 - A4 u, array.
+	const double tol,		// Tolerance convergence.
+	double *norm,			// Pointer to final norm.
+	int *convergence,		// Pointer to convergence flag.
+	const int infnorm,		// Select infnorm or twonorm.
+	const int max_corrections,	// Maximum number of corrections.
+	solver_stats *stats);		// Output phase times and PARDISO statistics, may be NULL.
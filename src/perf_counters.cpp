@@ -0,0 +1,206 @@
+// Global header.
+#include "tools.h"
+#include "thread_profile.h"
+#include "perf_counters.h"
+
+// Linux perf events.
+#ifdef PERF_COUNTERS
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+// Counted events: group leader first.
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_LLC_MISSES 2
+#define PERF_EVENTS 3
+
+// Totals of the current solve per phase and event.
+static long long perf_totals[NUM_PHASES][PERF_EVENTS];
+
+// Phase being counted, -1 outside phases.
+static int perf_phase = -1;
+
+#ifdef PERF_COUNTERS
+// Counter state: 0 not opened yet, 1 counting, -1 unavailable.
+static int perf_state = 0;
+
+// One event group per OpenMP thread: file descriptors and values at the
+// start of the current phase.
+static int perf_nthreads = 0;
+static int *perf_fd = NULL;
+static long long *perf_start = NULL;
+
+// Group read format: number of events, enabled and running times, values.
+typedef struct perf_group_reads
+{
+	unsigned long long nr;
+	unsigned long long time_enabled;
+	unsigned long long time_running;
+	unsigned long long values[PERF_EVENTS];
+} perf_group_read;
+
+// Open one counter of the calling thread.
+static int perf_open(const int event, const int group_fd)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(struct perf_event_attr));
+	attr.size = sizeof(struct perf_event_attr);
+	attr.type = (event == PERF_LLC_MISSES) ? PERF_TYPE_HW_CACHE : PERF_TYPE_HARDWARE;
+	attr.config = (event == PERF_CYCLES) ? PERF_COUNT_HW_CPU_CYCLES
+		: (event == PERF_INSTRUCTIONS) ? PERF_COUNT_HW_INSTRUCTIONS
+		: (PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+// Open an event group in every OpenMP thread.
+//
+// Counters follow the thread that opened them, so they are opened inside a
+// parallel region with the full team: later OpenMP regions and MKL, which
+// reuse the same thread pool, are counted. Kernel and hypervisor time is
+// excluded, which also keeps perf_event_paranoid = 2 sufficient.
+static void perf_counters_open(void)
+{
+	int t, e, failed = 0, err = 0;
+
+	perf_nthreads = omp_get_max_threads();
+	perf_fd = (int *)malloc(perf_nthreads * PERF_EVENTS * sizeof(int));
+	perf_start = (long long *)calloc(perf_nthreads * PERF_EVENTS, sizeof(long long));
+	for (t = 0; t < perf_nthreads * PERF_EVENTS; t++)
+		perf_fd[t] = -1;
+
+	#pragma omp parallel num_threads(perf_nthreads) private(e) reduction(+:failed) reduction(max:err)
+	{
+		int th = omp_get_thread_num();
+		for (e = 0; e < PERF_EVENTS; e++)
+		{
+			perf_fd[th * PERF_EVENTS + e] = perf_open(e, (e == 0) ? -1 : perf_fd[th * PERF_EVENTS]);
+			if (perf_fd[th * PERF_EVENTS + e] < 0)
+			{
+				failed++;
+				err = errno;
+				break;
+			}
+		}
+	}
+
+	if (failed)
+	{
+		printf("PERF COUNTERS: WARNING! Could not open hardware counters: %s. Counting disabled.\n", strerror(err));
+		for (t = 0; t < perf_nthreads * PERF_EVENTS; t++)
+			if (perf_fd[t] >= 0)
+				close(perf_fd[t]);
+		free(perf_fd);
+		free(perf_start);
+		perf_fd = NULL;
+		perf_start = NULL;
+		perf_state = -1;
+		return;
+	}
+
+	perf_state = 1;
+#ifdef VERBOSE
+	printf("PERF COUNTERS: Counting %d threads.\n", perf_nthreads);
+#endif
+
+	return;
+}
+
+// Read the group of thread t, scaled for multiplexing.
+static void perf_read(const int t, long long *values)
+{
+	perf_group_read group;
+	int e;
+
+	if (read(perf_fd[t * PERF_EVENTS], &group, sizeof(perf_group_read)) != (ssize_t)sizeof(perf_group_read))
+	{
+		for (e = 0; e < PERF_EVENTS; e++)
+			values[e] = 0;
+		return;
+	}
+	for (e = 0; e < PERF_EVENTS; e++)
+	{
+		values[e] = (group.time_running > 0 && group.time_running < group.time_enabled)
+			? (long long)((double)group.values[e] * (double)group.time_enabled / (double)group.time_running)
+			: (long long)group.values[e];
+	}
+
+	return;
+}
+#endif
+
+// Start counting a new solve.
+void perf_counters_reset(void)
+{
+	memset(perf_totals, 0, sizeof(perf_totals));
+	perf_phase = -1;
+
+#ifdef PERF_COUNTERS
+	if (perf_state == 0)
+		perf_counters_open();
+#endif
+
+	return;
+}
+
+// Read counters at the start of a phase.
+void perf_phase_begin(const int phase)
+{
+#ifdef PERF_COUNTERS
+	int t;
+
+	if (perf_state != 1 || phase < 0 || phase >= NUM_PHASES)
+		return;
+
+	perf_phase = phase;
+	for (t = 0; t < perf_nthreads; t++)
+		perf_read(t, perf_start + t * PERF_EVENTS);
+#else
+	(void)phase;
+#endif
+
+	return;
+}
+
+// Accumulate counters at the end of the current phase.
+void perf_phase_end(void)
+{
+#ifdef PERF_COUNTERS
+	long long values[PERF_EVENTS];
+	int t, e;
+
+	if (perf_state != 1 || perf_phase < 0)
+		return;
+
+	for (t = 0; t < perf_nthreads; t++)
+	{
+		perf_read(t, values);
+		for (e = 0; e < PERF_EVENTS; e++)
+			perf_totals[perf_phase][e] += values[e] - perf_start[t * PERF_EVENTS + e];
+	}
+	perf_phase = -1;
+#endif
+
+	return;
+}
+
+// Copy phase totals of the current solve into the solver statistics.
+void perf_counters_read(solver_stats *stats)
+{
+	int k;
+
+	for (k = 0; k < NUM_PHASES; k++)
+	{
+		stats->cycles[k] = perf_totals[k][PERF_CYCLES];
+		stats->instructions[k] = perf_totals[k][PERF_INSTRUCTIONS];
+		stats->llc_misses[k] = perf_totals[k][PERF_LLC_MISSES];
+	}
+
+	return;
+}
@@ -0,0 +1,16 @@
+// Hardware counters per solver phase: cycles, instructions and last level
+// cache misses of all OpenMP threads, accumulated between thread_phase_begin
+// and thread_phase_end. Only counted in builds with -DPERF_COUNTERS.
+
+// Start counting a new solve: opens the counters on first use and clears
+// the totals of all phases.
+void perf_counters_reset(void);
+
+// Read counters at the start of a phase.
+void perf_phase_begin(const int phase);
+
+// Accumulate counters at the end of the current phase.
+void perf_phase_end(void);
+
+// Copy phase totals of the current solve into the solver statistics.
+void perf_counters_read(solver_stats *stats);
@@ -0,0 +1,316 @@
+// Python headers must come first.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pythread.h>
+
+// Global headers and variables.
+#include "tools.h"
+
+// PARDISO tools.
+#include "pardiso_start.h"
+#include "pardiso_stop.h"
+#include "low_rank.h"
+
+// Solvers.
+#include "flat_laplacian.h"
+#include "general_elliptic.h"
+
+// Solver statistics.
+#include "solver_stats.h"
+
+// CPython extension module "ellsolve".
+//
+// Grid functions are passed through the buffer protocol: any C-contiguous
+// writable double precision buffer of NrTotal * NzTotal elements, such as a
+// NumPy array of shape (NrTotal, NzTotal), is used in place without copies.
+// The GIL is released while PARDISO runs. The solvers keep their state in
+// PARDISO globals, so a module lock serializes calls from several threads;
+// it is only taken without the GIL, so a waiting thread never blocks Python.
+static PyThread_type_lock solver_lock = NULL;
+
+// Borrow the memory of a double precision grid function.
+static int grid_buffer(PyObject *obj, Py_buffer *view, const int writable, const Py_ssize_t DIM, const char *name)
+{
+	int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+
+	if (PyObject_GetBuffer(obj, view, flags) < 0)
+		return -1;
+
+	// Native double: "d", optionally with a native or little-endian prefix.
+	const char *format = view->format;
+	if (format != NULL && (format[0] == '@' || format[0] == '=' || format[0] == '<'))
+		format++;
+	if (view->itemsize != sizeof(double) || format == NULL || strcmp(format, "d") != 0)
+	{
+		PyErr_Format(PyExc_TypeError, "%s must be a float64 array.", name);
+		PyBuffer_Release(view);
+		return -1;
+	}
+	if (view->len != DIM * (Py_ssize_t)sizeof(double))
+	{
+		PyErr_Format(PyExc_ValueError, "%s has %zd elements, expected NrTotal * NzTotal = %zd.",
+			name, view->len / (Py_ssize_t)sizeof(double), DIM);
+		PyBuffer_Release(view);
+		return -1;
+	}
+
+	return 0;
+}
+
+// Borrow several grid functions: the first nwritable are written by the solver.
+static int grid_buffers(PyObject **objs, Py_buffer *views, const char **names, const int count,
+	const int nwritable, const Py_ssize_t DIM)
+{
+	int k, l;
+
+	for (k = 0; k < count; k++)
+	{
+		if (grid_buffer(objs[k], &views[k], k < nwritable, DIM, names[k]) < 0)
+		{
+			for (l = 0; l < k; l++)
+				PyBuffer_Release(&views[l]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+// Release grid functions.
+static void grid_release(Py_buffer *views, const int count)
+{
+	int k;
+
+	for (k = 0; k < count; k++)
+		PyBuffer_Release(&views[k]);
+
+	return;
+}
+
+// Solver statistics as a dictionary with the keys of solver_stats_json.
+static PyObject *stats_dict(const solver_stats *stats)
+{
+	return Py_BuildValue("{s:s,s:i,s:i,s:i,s:i,s:i,s:i,s:i,"
+		"s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,"
+		"s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,"
+		"s:d,s:d,s:i,s:i,s:i,s:d}",
+		"solver", stats->solver, "NrInterior", stats->NrInterior, "NzInterior", stats->NzInterior,
+		"order", stats->order, "robin", stats->robin, "nnz", stats->nnz,
+		"lr_use", stats->lr_use, "precond_use", stats->precond_use,
+		"t_reduce", stats->t_reduce, "t_assemble", stats->t_assemble, "t_analyse", stats->t_analyse,
+		"t_factor", stats->t_factor, "t_solve", stats->t_solve, "t_residual", stats->t_residual,
+		"t_fill", stats->t_fill, "t_coarse", stats->t_coarse, "t_total", stats->t_total,
+		"factor_nnz", stats->factor_nnz, "factor_mflops", stats->factor_mflops,
+		"mem_peak_analysis_kb", stats->mem_peak_analysis, "mem_permanent_kb", stats->mem_permanent,
+		"mem_factor_kb", stats->mem_factor, "mem_peak_kb", solver_stats_peak_memory(stats),
+		"perturbed_pivots", stats->perturbed_pivots, "cgs_iterations", stats->cgs_iterations,
+		"refinement_steps", stats->refinement_steps, "corrections", stats->corrections,
+		"iterations", stats->iterations,
+		"abs_residual", stats->abs_residual, "rel_residual", stats->rel_residual,
+		"convergence", stats->convergence, "status", stats->status, "fallback", stats->fallback,
+		"error_estimate", stats->error_estimate);
+}
+
+// Number of points of the full grid with ghost zones.
+static Py_ssize_t grid_size(const int NrInterior, const int NzInterior, const int ghost)
+{
+	return (Py_ssize_t)(ghost + NrInterior + 1) * (Py_ssize_t)(ghost + NzInterior + 1);
+}
+
+// pardiso_start(NrInterior, NzInterior)
+static PyObject *py_pardiso_start(PyObject *self, PyObject *args)
+{
+	int NrInterior, NzInterior;
+
+	if (!PyArg_ParseTuple(args, "ii", &NrInterior, &NzInterior))
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(solver_lock, WAIT_LOCK);
+	pardiso_start(NrInterior, NzInterior);
+	PyThread_release_lock(solver_lock);
+	Py_END_ALLOW_THREADS
+
+	Py_RETURN_NONE;
+}
+
+// pardiso_stop()
+static PyObject *py_pardiso_stop(PyObject *self, PyObject *args)
+{
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(solver_lock, WAIT_LOCK);
+	pardiso_stop();
+	PyThread_release_lock(solver_lock);
+	Py_END_ALLOW_THREADS
+
+	Py_RETURN_NONE;
+}
+
+// flat_laplacian(u, res, s, f, uInf, robin, r_sym, z_sym, NrInterior, NzInterior,
+//	ghost, dr, dz, order, lr_use=0, precond_use=0) -> statistics.
+static PyObject *py_flat_laplacian(PyObject *self, PyObject *args, PyObject *kwds)
+{
+	static const char *keywords[] = { "u", "res", "s", "f", "uInf", "robin", "r_sym", "z_sym",
+		"NrInterior", "NzInterior", "ghost", "dr", "dz", "order", "lr_use", "precond_use", NULL };
+	static const char *names[] = { "u", "res", "s", "f" };
+	PyObject *objs[4];
+	Py_buffer views[4];
+	double uInf, dr, dz;
+	int robin, r_sym, z_sym, NrInterior, NzInterior, ghost, norder;
+	int lr_use = 0, precond_use = 0;
+	solver_stats stats;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOOdiiiiiiddi|ii", (char **)keywords,
+		&objs[0], &objs[1], &objs[2], &objs[3], &uInf, &robin, &r_sym, &z_sym,
+		&NrInterior, &NzInterior, &ghost, &dr, &dz, &norder, &lr_use, &precond_use))
+		return NULL;
+
+	if (grid_buffers(objs, views, names, 4, 2, grid_size(NrInterior, NzInterior, ghost)) < 0)
+		return NULL;
+
+	solver_stats_reset(&stats);
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(solver_lock, WAIT_LOCK);
+	flat_laplacian((double *)views[0].buf, (double *)views[1].buf,
+		(const double *)views[2].buf, (const double *)views[3].buf,
+		uInf, robin, r_sym, z_sym, NrInterior, NzInterior, ghost, dr, dz, norder,
+		lr_use, precond_use, &stats);
+	PyThread_release_lock(solver_lock);
+	Py_END_ALLOW_THREADS
+
+	grid_release(views, 4);
+
+	return stats_dict(&stats);
+}
+
+// general_elliptic(u, res, a, b, c, d, e, s, f, uInf, robin, r_sym, z_sym,
+//	NrInterior, NzInterior, ghost, dr, dz, order, lr_use=0, precond_use=0) -> statistics.
+static PyObject *py_general_elliptic(PyObject *self, PyObject *args, PyObject *kwds)
+{
+	static const char *keywords[] = { "u", "res", "a", "b", "c", "d", "e", "s", "f", "uInf",
+		"robin", "r_sym", "z_sym", "NrInterior", "NzInterior", "ghost", "dr", "dz", "order",
+		"lr_use", "precond_use", NULL };
+	static const char *names[] = { "u", "res", "a", "b", "c", "d", "e", "s", "f" };
+	PyObject *objs[9];
+	Py_buffer views[9];
+	double uInf, dr, dz;
+	int robin, r_sym, z_sym, NrInterior, NzInterior, ghost, norder;
+	int lr_use = 0, precond_use = 0;
+	solver_stats stats;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOOOOOOOdiiiiiiddi|ii", (char **)keywords,
+		&objs[0], &objs[1], &objs[2], &objs[3], &objs[4], &objs[5], &objs[6], &objs[7], &objs[8],
+		&uInf, &robin, &r_sym, &z_sym, &NrInterior, &NzInterior, &ghost, &dr, &dz, &norder,
+		&lr_use, &precond_use))
+		return NULL;
+
+	if (grid_buffers(objs, views, names, 9, 2, grid_size(NrInterior, NzInterior, ghost)) < 0)
+		return NULL;
+
+	solver_stats_reset(&stats);
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(solver_lock, WAIT_LOCK);
+	general_elliptic((double *)views[0].buf, (double *)views[1].buf,
+		(const double *)views[2].buf, (const double *)views[3].buf, (const double *)views[4].buf,
+		(const double *)views[5].buf, (const double *)views[6].buf, (const double *)views[7].buf,
+		(const double *)views[8].buf, uInf, robin, r_sym, z_sym, NrInterior, NzInterior, ghost,
+		dr, dz, norder, lr_use, precond_use, &stats);
+	PyThread_release_lock(solver_lock);
+	Py_END_ALLOW_THREADS
+
+	grid_release(views, 9);
+
+	return stats_dict(&stats);
+}
+
+// low_rank_flat_laplacian(NrInterior, NzInterior): allocate and fill the diff array.
+static PyObject *py_low_rank_flat_laplacian(PyObject *self, PyObject *args)
+{
+	int NrInterior, NzInterior;
+
+	if (!PyArg_ParseTuple(args, "ii", &NrInterior, &NzInterior))
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(solver_lock, WAIT_LOCK);
+	low_rank_allocate(ndiff_flat_laplacian(NrInterior, NzInterior));
+	low_rank_flat_laplacian(NrInterior, NzInterior);
+	PyThread_release_lock(solver_lock);
+	Py_END_ALLOW_THREADS
+
+	Py_RETURN_NONE;
+}
+
+// low_rank_general_elliptic(NrInterior, NzInterior, order): allocate and fill the diff array.
+static PyObject *py_low_rank_general_elliptic(PyObject *self, PyObject *args)
+{
+	int NrInterior, NzInterior, norder;
+
+	if (!PyArg_ParseTuple(args, "iii", &NrInterior, &NzInterior, &norder))
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(solver_lock, WAIT_LOCK);
+	low_rank_allocate(ndiff_general_elliptic(NrInterior, NzInterior, norder));
+	low_rank_general_elliptic(NrInterior, NzInterior, norder);
+	PyThread_release_lock(solver_lock);
+	Py_END_ALLOW_THREADS
+
+	Py_RETURN_NONE;
+}
+
+// low_rank_deallocate(): release the diff array.
+static PyObject *py_low_rank_deallocate(PyObject *self, PyObject *args)
+{
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(solver_lock, WAIT_LOCK);
+	low_rank_deallocate();
+	PyThread_release_lock(solver_lock);
+	Py_END_ALLOW_THREADS
+
+	Py_RETURN_NONE;
+}
+
+// Module methods.
+static PyMethodDef ellsolve_methods[] =
+{
+	{ "pardiso_start", py_pardiso_start, METH_VARARGS,
+		"pardiso_start(NrInterior, NzInterior)\n\nInitialize PARDISO for the grid." },
+	{ "pardiso_stop", py_pardiso_stop, METH_NOARGS,
+		"pardiso_stop()\n\nRelease PARDISO memory." },
+	{ "flat_laplacian", (PyCFunction)(void (*)(void))py_flat_laplacian, METH_VARARGS | METH_KEYWORDS,
+		"flat_laplacian(u, res, s, f, uInf, robin, r_sym, z_sym, NrInterior, NzInterior, ghost, dr, dz, order, lr_use=0, precond_use=0)\n\n"
+		"Solve the flat Laplacian in place on float64 arrays of NrTotal * NzTotal points. Returns the solver statistics;\n"
+		"a nonzero status means the solve failed and u and res are unchanged." },
+	{ "general_elliptic", (PyCFunction)(void (*)(void))py_general_elliptic, METH_VARARGS | METH_KEYWORDS,
+		"general_elliptic(u, res, a, b, c, d, e, s, f, uInf, robin, r_sym, z_sym, NrInterior, NzInterior, ghost, dr, dz, order, lr_use=0, precond_use=0)\n\n"
+		"Solve the general elliptic equation in place on float64 arrays of NrTotal * NzTotal points. Returns the solver statistics;\n"
+		"a nonzero status means the solve failed and u and res are unchanged." },
+	{ "low_rank_flat_laplacian", py_low_rank_flat_laplacian, METH_VARARGS,
+		"low_rank_flat_laplacian(NrInterior, NzInterior)\n\nAllocate and fill the low rank diff array of the flat Laplacian." },
+	{ "low_rank_general_elliptic", py_low_rank_general_elliptic, METH_VARARGS,
+		"low_rank_general_elliptic(NrInterior, NzInterior, order)\n\nAllocate and fill the low rank diff array of the general elliptic equation." },
+	{ "low_rank_deallocate", py_low_rank_deallocate, METH_NOARGS,
+		"low_rank_deallocate()\n\nRelease the low rank diff array." },
+	{ NULL, NULL, 0, NULL }
+};
+
+// Module definition.
+static struct PyModuleDef ellsolve_module =
+{
+	PyModuleDef_HEAD_INIT,
+	"ellsolve",
+	"Axisymmetric elliptic solvers on NumPy arrays without copies.",
+	-1,
+	ellsolve_methods
+};
+
+// Module initialization.
+PyMODINIT_FUNC PyInit_ellsolve(void)
+{
+	solver_lock = PyThread_allocate_lock();
+	if (solver_lock == NULL)
+		return PyErr_NoMemory();
+
+	return PyModule_Create(&ellsolve_module);
+}
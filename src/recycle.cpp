@@ -0,0 +1,838 @@
+// Global header files.
+#include "tools.h"
+
+// PARDISO parameters are shared, the preconditioner has its own handle.
+#include "pardiso_param.h"
+#include "pardiso.h"
+#include "pardiso_start.h"
+#include "pardiso_stop.h"
+#include "mkl_lapacke.h"
+
+// Elliptic solver headers.
+#include "flat_laplacian_csr_gen.h"
+#include "general_elliptic_csr_gen.h"
+#include "stencil_csr_gen.h"
+#include "elliptic_tools.h"
+#include "thread_profile.h"
+#include "grid_map.h"
+#include "solver_stats.h"
+#include "recycle.h"
+
+// Recycled solvers are only available from C: the FORTRAN build has no C
+// entry points for PARDISO initialization.
+#ifndef FORTRAN
+
+// RECYCLE DEFAULTS.
+#define RECYCLE_RESTART 30
+#define RECYCLE_DIMENSION 10
+#define RECYCLE_TOL 1.0E-10
+#define RECYCLE_MAX_ITERATIONS 1000
+#define RECYCLE_REFACTOR_ITERATIONS 30
+
+// GCRO-DR with right preconditioning (Parks et al. 2006).
+//
+// The solver keeps k vectors Y with C = A Y orthonormal. A new system is
+// first solved on span(Y): x = x + Y C^T r, r = r - C C^T r. Each cycle
+// then runs m - k Arnoldi steps on (I - C C^T) A M^(-1), where M^(-1) is
+// the LU of the matrix P factored earlier in the sequence:
+//
+//	A [Y, Z] = [C, V] G,	G = | I  B |,
+//				    | 0  H |
+//
+// with Z = M^(-1) V, B = C^T A Z and H the Arnoldi Hessenberg matrix. G is
+// upper Hessenberg, so the Givens rotations of GMRES give the residual at
+// every step; the minimizer is y = (-B y2, y2) with y2 the GMRES solution.
+//
+// After every cycle the subspace is replaced by the k harmonic Ritz vectors
+// of A M^(-1) with smallest harmonic Ritz values, which approximate the
+// slow modes that the stale LU does not resolve. In preconditioned
+// variables the search space is [U, V] with U = P Y, and the harmonic Ritz
+// problem is
+//
+//	G^T G p = theta G^T [C, V]^T [U, V] p.
+//
+// The new Y = [Y, Z] p and U = [U, V] p are scaled by the R of
+// G p = Q R, so that C = [C, V] Q stays orthonormal. When the matrix
+// changes C = A Y is orthonormalized again; when the LU is refreshed U is
+// recomputed. The recycled subspace is therefore valid for any A and M.
+
+// y = beta * y + alpha * A x.
+static void recycle_mv(sparse_matrix_t csrA, const double alpha, const double *x, const double beta, double *y)
+{
+	struct matrix_descr descrA;
+	descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
+	mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, alpha, csrA, descrA, x, beta, y);
+
+	return;
+}
+
+// z = M^(-1) r with the LU of P.
+static int recycle_precondition(recycle_solver *rec, double *r, double *z)
+{
+	int rec_phase = 33, rec_error = 0, rec_idum = 0;
+
+	pardiso(rec->pt, &maxfct, &mnum, &mtype, &rec_phase,
+		&rec->P.nrows, rec->P.a, rec->P.ia, rec->P.ja, &rec_idum, &nrhs,
+		rec->iparm, &msglvl, r, z, &rec_error);
+	if (rec_error != 0)
+	{
+		printf("RECYCLE: ERROR during preconditioner solution: %d.\n", rec_error);
+		return ELL_ERROR_SOLVE;
+	}
+
+	return ELL_SUCCESS;
+}
+
+// Release the preconditioner: the next solve analyses and factors again.
+static void recycle_release(recycle_solver *rec, csr_matrix A)
+{
+	int k, rec_phase = -1, rec_error = 0, rec_idum = 0;
+	double rec_ddum = 0.0;
+
+	pardiso(rec->pt, &maxfct, &mnum, &mtype, &rec_phase,
+		&A.nrows, &rec_ddum, A.ia, A.ja, &rec_idum, &nrhs,
+		rec->iparm, &msglvl, &rec_ddum, &rec_ddum, &rec_error);
+	for (k = 0; k < 64; k++)
+		rec->pt[k] = 0;
+	if (rec->factored)
+		csr_deallocate(&rec->P);
+	rec->factored = 0;
+
+	return;
+}
+
+// Factor A, which becomes the preconditioner matrix P: the pattern is the
+// same for the whole sequence and is only analysed once. A failed phase
+// releases the preconditioner and returns its status code.
+static int recycle_factor(recycle_solver *rec, csr_matrix A, solver_stats *stats)
+{
+	int rec_phase, rec_error = 0, rec_idum = 0;
+	double rec_ddum = 0.0;
+	double t0 = omp_get_wtime();
+
+	if (!rec->factored)
+	{
+		thread_phase_begin(PHASE_ANALYSE);
+		rec_phase = 11;
+		pardiso(rec->pt, &maxfct, &mnum, &mtype, &rec_phase,
+			&A.nrows, A.a, A.ia, A.ja, &rec_idum, &nrhs,
+			rec->iparm, &msglvl, &rec_ddum, &rec_ddum, &rec_error);
+		thread_phase_end();
+		if (rec_error != 0)
+		{
+			printf("RECYCLE: ERROR during symbolic factorization: %d.\n", rec_error);
+			recycle_release(rec, A);
+			return ELL_ERROR_ANALYSIS;
+		}
+		stats->t_analyse = omp_get_wtime() - t0;
+	}
+
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_FACTOR);
+	rec_phase = 22;
+	pardiso(rec->pt, &maxfct, &mnum, &mtype, &rec_phase,
+		&A.nrows, A.a, A.ia, A.ja, &rec_idum, &nrhs,
+		rec->iparm, &msglvl, &rec_ddum, &rec_ddum, &rec_error);
+	thread_phase_end();
+	if (rec_error != 0)
+	{
+		printf("RECYCLE: ERROR during numerical factorization: %d.\n", rec_error);
+		recycle_release(rec, A);
+		return ELL_ERROR_FACTOR;
+	}
+	if (rec->factored)
+		csr_deallocate(&rec->P);
+	stats->t_factor = omp_get_wtime() - t0;
+	stats->perturbed_pivots = rec->iparm[14 - 1];
+	stats->mem_peak_analysis = rec->iparm[15 - 1];
+	stats->mem_permanent = rec->iparm[16 - 1];
+	stats->mem_factor = rec->iparm[17 - 1];
+	stats->factor_nnz = rec->iparm[18 - 1];
+	stats->factor_mflops = rec->iparm[19 - 1];
+
+	rec->P = A;
+	rec->factored = 1;
+	rec->stale = 0;
+	rec->nfactor++;
+
+	return ELL_SUCCESS;
+}
+
+// C = A Y orthonormalized by modified Gram-Schmidt, with the same
+// operations on Y and U. Dependent vectors are dropped.
+static void recycle_orthonormalize(recycle_solver *rec, sparse_matrix_t csrA, const int N)
+{
+	int i, l, kk = 0;
+	double aux;
+
+	for (l = 0; l < rec->k; l++)
+	{
+		double *y = rec->Y + (size_t)kk * N;
+		double *c = rec->C + (size_t)kk * N;
+		double *u = rec->U + (size_t)kk * N;
+
+		if (kk != l)
+		{
+			cblas_dcopy(N, rec->Y + (size_t)l * N, 1, y, 1);
+			cblas_dcopy(N, rec->U + (size_t)l * N, 1, u, 1);
+		}
+		recycle_mv(csrA, 1.0, y, 0.0, c);
+		double cnorm = cblas_dnrm2(N, c, 1);
+		for (i = 0; i < kk; i++)
+		{
+			aux = cblas_ddot(N, rec->C + (size_t)i * N, 1, c, 1);
+			cblas_daxpy(N, -aux, rec->C + (size_t)i * N, 1, c, 1);
+			cblas_daxpy(N, -aux, rec->Y + (size_t)i * N, 1, y, 1);
+			cblas_daxpy(N, -aux, rec->U + (size_t)i * N, 1, u, 1);
+		}
+		aux = cblas_dnrm2(N, c, 1);
+		if (aux <= 1.0E-12 * cnorm || aux == 0.0)
+			continue;
+		cblas_dscal(N, 1.0 / aux, c, 1);
+		cblas_dscal(N, 1.0 / aux, y, 1);
+		cblas_dscal(N, 1.0 / aux, u, 1);
+		kk++;
+	}
+	rec->k = kk;
+
+	return;
+}
+
+// x = x + Y C^T r, r = r - C C^T r.
+static void recycle_project(recycle_solver *rec, const int N, double *x, double *r)
+{
+	int i;
+	double aux;
+
+	for (i = 0; i < rec->k; i++)
+	{
+		aux = cblas_ddot(N, rec->C + (size_t)i * N, 1, r, 1);
+		cblas_daxpy(N, aux, rec->Y + (size_t)i * N, 1, x, 1);
+		cblas_daxpy(N, -aux, rec->C + (size_t)i * N, 1, r, 1);
+	}
+
+	return;
+}
+
+// Replace the recycled subspace with the harmonic Ritz vectors of the last
+// cycle: k old vectors and j Arnoldi steps stored in V, Z, the unrotated
+// Hessenberg matrix Hs and B, all with row stride m. W is workspace for
+// 3 * dimension vectors.
+static void recycle_update(recycle_solver *rec, const int N, const int m, const int j,
+	const double *V, const double *Z, const double *Hs, const double *B, double *W)
+{
+	int k = rec->k;
+	int mm = k + j;
+	int i, l, p, q, kn;
+	double aux;
+
+	if (mm == 0 || rec->dimension == 0)
+		return;
+
+	// G ((mm + 1) x mm) and E = [C, V]^T [U, V] ((mm + 1) x mm).
+	double *G = (double *)calloc((mm + 1) * mm, sizeof(double));
+	double *E = (double *)calloc((mm + 1) * mm, sizeof(double));
+	for (i = 0; i < k; i++)
+	{
+		G[i * mm + i] = 1.0;
+		for (l = 0; l < j; l++)
+			G[i * mm + k + l] = B[i * m + l];
+		for (l = 0; l < k; l++)
+			E[i * mm + l] = cblas_ddot(N, rec->C + (size_t)i * N, 1, rec->U + (size_t)l * N, 1);
+	}
+	for (i = 0; i <= j; i++)
+	{
+		for (l = 0; l < j; l++)
+			G[(k + i) * mm + k + l] = Hs[i * m + l];
+		for (l = 0; l < k; l++)
+			E[(k + i) * mm + l] = cblas_ddot(N, V + (size_t)i * N, 1, rec->U + (size_t)l * N, 1);
+		if (i < j)
+			E[(k + i) * mm + k + i] = 1.0;
+	}
+
+	// Generalized eigenproblem G^T G p = theta G^T E p.
+	double *GG = (double *)calloc(mm * mm, sizeof(double));
+	double *GE = (double *)calloc(mm * mm, sizeof(double));
+	double *alphar = (double *)malloc(mm * sizeof(double));
+	double *alphai = (double *)malloc(mm * sizeof(double));
+	double *betav = (double *)malloc(mm * sizeof(double));
+	double *VR = (double *)malloc(mm * mm * sizeof(double));
+	double vl_dum = 0.0;
+	for (p = 0; p < mm; p++)
+	{
+		for (q = 0; q < mm; q++)
+		{
+			for (i = 0; i <= mm; i++)
+			{
+				GG[p * mm + q] += G[i * mm + p] * G[i * mm + q];
+				GE[p * mm + q] += G[i * mm + p] * E[i * mm + q];
+			}
+		}
+	}
+	lapack_int info = LAPACKE_dggev(LAPACK_ROW_MAJOR, 'N', 'V', mm, GG, mm, GE, mm,
+		alphar, alphai, betav, &vl_dum, 1, VR, mm);
+	if (info != 0)
+	{
+		printf("RECYCLE: WARNING harmonic Ritz problem failed: %d, keeping subspace.\n", (int)info);
+		free(G);
+		free(E);
+		free(GG);
+		free(GE);
+		free(alphar);
+		free(alphai);
+		free(betav);
+		free(VR);
+		return;
+	}
+
+	// Select the smallest harmonic Ritz values: a complex pair enters with
+	// its real and imaginary parts or not at all.
+	int kmax = MIN(rec->dimension, mm);
+	int *sel = (int *)malloc(mm * sizeof(int));
+	int *used = (int *)calloc(mm, sizeof(int));
+	double *theta = (double *)malloc(mm * sizeof(double));
+	for (p = 0; p < mm; p++)
+		theta[p] = (betav[p] != 0.0) ? sqrt(alphar[p] * alphar[p] + alphai[p] * alphai[p]) / fabs(betav[p]) : HUGE_VAL;
+	kn = 0;
+	while (kn < kmax)
+	{
+		q = -1;
+		for (p = 0; p < mm; p++)
+		{
+			// Skip second members of complex pairs and used values.
+			if (used[p] || (alphai[p] < 0.0 && p > 0 && alphai[p - 1] > 0.0))
+				continue;
+			if (q < 0 || theta[p] < theta[q])
+				q = p;
+		}
+		if (q < 0)
+			break;
+		used[q] = 1;
+		if (alphai[q] > 0.0 && q + 1 < mm)
+		{
+			if (kn + 2 > kmax)
+				continue;
+			sel[kn++] = q;
+			sel[kn++] = q + 1;
+		}
+		else
+		{
+			sel[kn++] = q;
+		}
+	}
+
+	// Q R = G P by modified Gram-Schmidt; P is mm x kn.
+	double *GP = (double *)calloc((mm + 1) * kn, sizeof(double));
+	double *R = (double *)calloc(kn * kn, sizeof(double));
+	for (i = 0; i <= mm; i++)
+		for (l = 0; l < kn; l++)
+			for (p = 0; p < mm; p++)
+				GP[i * kn + l] += G[i * mm + p] * VR[p * mm + sel[l]];
+	int kk = 0;
+	for (l = 0; l < kn; l++)
+	{
+		double gnorm = 0.0;
+		for (i = 0; i <= mm; i++)
+			gnorm += GP[i * kn + l] * GP[i * kn + l];
+		gnorm = sqrt(gnorm);
+		for (p = 0; p < kk; p++)
+		{
+			aux = 0.0;
+			for (i = 0; i <= mm; i++)
+				aux += GP[i * kn + p] * GP[i * kn + l];
+			R[p * kn + kk] = aux;
+			for (i = 0; i <= mm; i++)
+				GP[i * kn + l] -= aux * GP[i * kn + p];
+		}
+		aux = 0.0;
+		for (i = 0; i <= mm; i++)
+			aux += GP[i * kn + l] * GP[i * kn + l];
+		aux = sqrt(aux);
+		// Dependent harmonic Ritz vectors are dropped.
+		if (aux <= 1.0E-12 * gnorm || aux == 0.0)
+			continue;
+		R[kk * kn + kk] = aux;
+		for (i = 0; i <= mm; i++)
+			GP[i * kn + kk] = GP[i * kn + l] / aux;
+		sel[kk] = sel[l];
+		kk++;
+	}
+	kn = kk;
+
+	// New Y = [Y, Z] P R^(-1), U = [U, V] P R^(-1) and C = [C, V] Q.
+	double *Yn = W;
+	double *Un = W + (size_t)rec->dimension * N;
+	double *Cn = W + 2 * (size_t)rec->dimension * N;
+	double *pk = (double *)malloc((mm + 1) * sizeof(double));
+	for (l = 0; l < kn; l++)
+	{
+		double *y = Yn + (size_t)l * N;
+		double *u = Un + (size_t)l * N;
+		double *c = Cn + (size_t)l * N;
+
+		for (p = 0; p < mm; p++)
+			pk[p] = VR[p * mm + sel[l]];
+		cblas_dgemv(CblasRowMajor, CblasTrans, j, N, 1.0, Z, N, pk + k, 1, 0.0, y, 1);
+		cblas_dgemv(CblasRowMajor, CblasTrans, j, N, 1.0, V, N, pk + k, 1, 0.0, u, 1);
+		if (k > 0)
+		{
+			cblas_dgemv(CblasRowMajor, CblasTrans, k, N, 1.0, rec->Y, N, pk, 1, 1.0, y, 1);
+			cblas_dgemv(CblasRowMajor, CblasTrans, k, N, 1.0, rec->U, N, pk, 1, 1.0, u, 1);
+		}
+		for (i = 0; i < l; i++)
+		{
+			cblas_daxpy(N, -R[i * kn + l], Yn + (size_t)i * N, 1, y, 1);
+			cblas_daxpy(N, -R[i * kn + l], Un + (size_t)i * N, 1, u, 1);
+		}
+		cblas_dscal(N, 1.0 / R[l * kn + l], y, 1);
+		cblas_dscal(N, 1.0 / R[l * kn + l], u, 1);
+
+		for (i = 0; i <= mm; i++)
+			pk[i] = GP[i * kn + l];
+		cblas_dgemv(CblasRowMajor, CblasTrans, j + 1, N, 1.0, V, N, pk + k, 1, 0.0, c, 1);
+		if (k > 0)
+			cblas_dgemv(CblasRowMajor, CblasTrans, k, N, 1.0, rec->C, N, pk, 1, 1.0, c, 1);
+	}
+	memcpy(rec->Y, Yn, (size_t)kn * N * sizeof(double));
+	memcpy(rec->U, Un, (size_t)kn * N * sizeof(double));
+	memcpy(rec->C, Cn, (size_t)kn * N * sizeof(double));
+	rec->k = kn;
+
+	free(G);
+	free(E);
+	free(GG);
+	free(GE);
+	free(alphar);
+	free(alphai);
+	free(betav);
+	free(VR);
+	free(sel);
+	free(used);
+	free(theta);
+	free(GP);
+	free(R);
+	free(pk);
+
+	return;
+}
+
+// GCRO-DR iterations on Ax = b from the initial guess x; r returns the
+// residual and iterations the number of iterations. Returns the status of
+// the preconditioner solves.
+static int recycle_gcrodr(recycle_solver *rec, sparse_matrix_t csrA, const int N, double *x, double *b, double *r,
+	int *iterations)
+{
+	int m = rec->restart;
+	int i, j, l, it = 0;
+	int status = ELL_SUCCESS;
+	double beta, bnorm, aux, c, s;
+
+	// Krylov basis V, preconditioned basis Z, Hessenberg matrix H and its
+	// unrotated copy Hs, projections B on C, Givens rotations (cs, sn),
+	// rotated residual g and workspace for the subspace update.
+	double *V = (double *)malloc((size_t)(m + 1) * N * sizeof(double));
+	double *Z = (double *)malloc((size_t)m * N * sizeof(double));
+	double *H = (double *)malloc((m + 1) * m * sizeof(double));
+	double *Hs = (double *)malloc((m + 1) * m * sizeof(double));
+	double *B = (double *)malloc((rec->dimension + 1) * m * sizeof(double));
+	double *cs = (double *)malloc(m * sizeof(double));
+	double *sn = (double *)malloc(m * sizeof(double));
+	double *g = (double *)malloc((m + 1) * sizeof(double));
+	double *W = (double *)malloc(3 * (size_t)(rec->dimension + 1) * N * sizeof(double));
+
+	bnorm = cblas_dnrm2(N, b, 1);
+	if (bnorm == 0.0)
+		bnorm = 1.0;
+
+	// r = b - A x.
+	cblas_dcopy(N, b, 1, r, 1);
+	recycle_mv(csrA, -1.0, x, 1.0, r);
+
+	// Recycled subspace for the new matrix.
+	if (rec->k > 0)
+		recycle_orthonormalize(rec, csrA, N);
+
+	while (it < rec->max_iterations)
+	{
+		// Solve on the recycled subspace: r is orthogonal to C.
+		recycle_project(rec, N, x, r);
+		beta = cblas_dnrm2(N, r, 1);
+		if (beta / bnorm < rec->tol)
+			break;
+
+		int k = rec->k;
+		int mk = m - k;
+		cblas_dcopy(N, r, 1, V, 1);
+		cblas_dscal(N, 1.0 / beta, V, 1);
+		for (l = 0; l <= mk; l++)
+			g[l] = 0.0;
+		g[0] = beta;
+
+		for (j = 0; j < mk && it < rec->max_iterations; j++)
+		{
+			double *v = V + (size_t)j * N;
+			double *w = V + (size_t)(j + 1) * N;
+			double *z = Z + (size_t)j * N;
+
+			// w = (I - C C^T) A M^(-1) v, orthogonalized by modified Gram-Schmidt.
+			status = recycle_precondition(rec, v, z);
+			if (status != ELL_SUCCESS)
+				break;
+			recycle_mv(csrA, 1.0, z, 0.0, w);
+			for (i = 0; i < k; i++)
+			{
+				B[i * m + j] = cblas_ddot(N, w, 1, rec->C + (size_t)i * N, 1);
+				cblas_daxpy(N, -B[i * m + j], rec->C + (size_t)i * N, 1, w, 1);
+			}
+			for (i = 0; i <= j; i++)
+			{
+				H[i * m + j] = cblas_ddot(N, w, 1, V + (size_t)i * N, 1);
+				cblas_daxpy(N, -H[i * m + j], V + (size_t)i * N, 1, w, 1);
+			}
+			H[(j + 1) * m + j] = cblas_dnrm2(N, w, 1);
+			if (H[(j + 1) * m + j] > 0.0)
+				cblas_dscal(N, 1.0 / H[(j + 1) * m + j], w, 1);
+			for (i = 0; i <= j + 1; i++)
+				Hs[i * m + j] = H[i * m + j];
+
+			// Previous rotations on the new column, then a new rotation.
+			for (i = 0; i < j; i++)
+			{
+				aux = cs[i] * H[i * m + j] + sn[i] * H[(i + 1) * m + j];
+				H[(i + 1) * m + j] = -sn[i] * H[i * m + j] + cs[i] * H[(i + 1) * m + j];
+				H[i * m + j] = aux;
+			}
+			aux = sqrt(H[j * m + j] * H[j * m + j] + H[(j + 1) * m + j] * H[(j + 1) * m + j]);
+			c = (aux > 0.0) ? H[j * m + j] / aux : 1.0;
+			s = (aux > 0.0) ? H[(j + 1) * m + j] / aux : 0.0;
+			cs[j] = c;
+			sn[j] = s;
+			H[j * m + j] = aux;
+			H[(j + 1) * m + j] = 0.0;
+			g[j + 1] = -s * g[j];
+			g[j] = c * g[j];
+			it++;
+#ifdef VERBOSE
+			printf("RECYCLE GCRO-DR: %d, relative residual = %e.\n", it, fabs(g[j + 1]) / bnorm);
+#endif
+			if (fabs(g[j + 1]) / bnorm < rec->tol)
+			{
+				j++;
+				break;
+			}
+		}
+
+		if (status != ELL_SUCCESS)
+			break;
+
+		// Back substitution of H y2 = g, then x = x + Z y2 - Y B y2.
+		for (i = j - 1; i >= 0; i--)
+		{
+			aux = g[i];
+			for (l = i + 1; l < j; l++)
+				aux -= H[i * m + l] * g[l];
+			g[i] = aux / H[i * m + i];
+		}
+		for (i = 0; i < j; i++)
+			cblas_daxpy(N, g[i], Z + (size_t)i * N, 1, x, 1);
+		for (i = 0; i < k; i++)
+		{
+			aux = 0.0;
+			for (l = 0; l < j; l++)
+				aux += B[i * m + l] * g[l];
+			cblas_daxpy(N, -aux, rec->Y + (size_t)i * N, 1, x, 1);
+		}
+
+		// True residual and new recycled subspace.
+		cblas_dcopy(N, b, 1, r, 1);
+		recycle_mv(csrA, -1.0, x, 1.0, r);
+		recycle_update(rec, N, m, j, V, Z, Hs, B, W);
+	}
+
+	free(V);
+	free(Z);
+	free(H);
+	free(Hs);
+	free(B);
+	free(cs);
+	free(sn);
+	free(g);
+	free(W);
+
+	*iterations = it;
+	return status;
+}
+
+// Start solver: initializes PARDISO.
+//
+// Parameters take their default values and may be changed by the caller
+// before the first solve.
+void recycle_start(recycle_solver *rec,
+	const int general,	// Solver: general elliptic(1) or flat Laplacian(0).
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost,	// Number of ghost zones.
+	const double dr,	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2, 4 or 6.
+	const int robin)	// Robin BC type: 1, 2, 3.
+{
+	int k;
+
+	memset(rec, 0, sizeof(recycle_solver));
+	rec->general = general;
+	rec->NrInterior = NrInterior;
+	rec->NzInterior = NzInterior;
+	rec->ghost = ghost;
+	rec->dr = dr;
+	rec->dz = dz;
+	rec->norder = norder;
+	rec->robin = robin;
+	rec->restart = RECYCLE_RESTART;
+	rec->dimension = RECYCLE_DIMENSION;
+	rec->tol = RECYCLE_TOL;
+	rec->max_iterations = RECYCLE_MAX_ITERATIONS;
+	rec->refactor_iterations = RECYCLE_REFACTOR_ITERATIONS;
+
+	// Global fine-tuning for the preconditioner handle.
+	pardiso_start(NrInterior, NzInterior);
+	for (k = 0; k < 64; k++)
+	{
+		rec->iparm[k] = iparm[k];
+		rec->pt[k] = 0;
+	}
+	rec->iparm[4 - 1] = 0;	// No iterative-direct algorithm.
+	rec->iparm[5 - 1] = 0;	// No user fill-in reducing permutation.
+	rec->iparm[39 - 1] = 0;	// No low rank update.
+
+	return;
+}
+
+// Reduce, assemble and solve one system of the sequence. A failed solve
+// leaves u and res unchanged and returns its status code.
+static int recycle_solve(recycle_solver *rec, double *u, double *res,
+	const double **coeff, const double *f, const double uInf, const int r_sym, const int z_sym, solver_stats *stats)
+{
+	solver_stats local_stats;
+	int NrInterior = rec->NrInterior;
+	int NzInterior = rec->NzInterior;
+	int ghost = rec->ghost;
+	int norder = rec->norder;
+	int robin = rec->robin;
+	double dr = rec->dr;
+	double dz = rec->dz;
+	int k, it = 0;
+	int status = ELL_SUCCESS;
+
+	if (stats == NULL)
+		stats = &local_stats;
+	solver_stats_reset(stats);
+
+	if (rec->restart <= rec->dimension || rec->dimension < 0)
+	{
+		printf("RECYCLE: ERROR! Restart %d must exceed the recycled dimension %d.\n", rec->restart, rec->dimension);
+		stats->status = ELL_ERROR_ARGUMENT;
+		return ELL_ERROR_ARGUMENT;
+	}
+
+	// Wall-clock phase timers.
+	double t_start = omp_get_wtime();
+	double t0 = t_start;
+
+	// Reduce arrays.
+	int NrTotal = NrInterior + 2;
+	int NzTotal = NzInterior + 2;
+	int N = NrTotal * NzTotal;
+	int ncoeff = rec->general ? 6 : 1;
+	double *g_u = grid_allocate(NrTotal, NzTotal);
+	double *g_f = grid_allocate(NrTotal, NzTotal);
+	double *g_res = grid_allocate(NrTotal, NzTotal);
+	double *g_coeff[6];
+	thread_phase_begin(PHASE_REDUCE);
+	ghost_reduce(u, g_u, NrInterior, NzInterior, ghost);
+	ghost_reduce(f, g_f, NrInterior, NzInterior, ghost);
+	for (k = 0; k < ncoeff; k++)
+	{
+		g_coeff[k] = grid_allocate(NrTotal, NzTotal);
+		ghost_reduce(coeff[k], g_coeff[k], NrInterior, NzInterior, ghost);
+	}
+	thread_phase_end();
+	stats->t_reduce = omp_get_wtime() - t0;
+
+	// Assemble matrix and RHS with the generator of the direct solver.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_ASSEMBLE);
+	int tabled = (norder == 6 || grid_map_active());
+	csr_matrix A;
+	if (rec->general)
+	{
+		csr_allocate(&A, N, N, tabled ? nnz_stencil(NrInterior, NzInterior, norder, robin, 1)
+			: nnz_general_elliptic(NrInterior, NzInterior, norder, robin));
+		if (tabled)
+			csr_gen_stencil(A, NrInterior, NzInterior, norder, dr, dz, g_coeff[0], g_coeff[1], g_coeff[2],
+				g_coeff[3], g_coeff[4], g_coeff[5], g_f, uInf, robin, r_sym, z_sym);
+		else
+			status = csr_gen_general_elliptic(A, NrInterior, NzInterior, norder, dr, dz, g_coeff[0], g_coeff[1], g_coeff[2],
+				g_coeff[3], g_coeff[4], g_coeff[5], g_f, uInf, robin, r_sym, z_sym);
+	}
+	else
+	{
+		csr_allocate(&A, N, N, tabled ? nnz_stencil(NrInterior, NzInterior, norder, robin, 0)
+			: nnz_flat_laplacian(NrInterior, NzInterior, norder, robin));
+		if (tabled)
+			csr_gen_stencil(A, NrInterior, NzInterior, norder, dr, dz, NULL, NULL, NULL, NULL, NULL,
+				g_coeff[0], g_f, uInf, robin, r_sym, z_sym);
+		else
+			status = csr_gen_flat_laplacian(A, NrInterior, NzInterior, norder, dr, dz, g_coeff[0], g_f, uInf, robin, r_sym, z_sym);
+	}
+	thread_phase_end();
+	stats->t_assemble = omp_get_wtime() - t0;
+
+	// Recycled subspace storage.
+	if (rec->Y == NULL && rec->dimension > 0)
+	{
+		rec->Y = (double *)malloc((size_t)rec->dimension * N * sizeof(double));
+		rec->C = (double *)malloc((size_t)rec->dimension * N * sizeof(double));
+		rec->U = (double *)malloc((size_t)rec->dimension * N * sizeof(double));
+	}
+
+	// Preconditioner: the first matrix, refreshed after slow solves. A
+	// refreshed LU changes the preconditioned recycled vectors U = P Y.
+	// A rejected assembly solves nothing.
+	int refactor = (!rec->factored || rec->stale);
+	int keep = 0;
+	sparse_matrix_t csrA;
+	mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, A.nrows, A.ncols, A.ia, A.ia + 1, A.ja, A.a);
+	mkl_sparse_optimize(csrA);
+	if (refactor && status == ELL_SUCCESS)
+	{
+		status = recycle_factor(rec, A, stats);
+		keep = (status == ELL_SUCCESS);
+		if (keep)
+		{
+			for (k = 0; k < rec->k; k++)
+				recycle_mv(csrA, 1.0, rec->Y + (size_t)k * N, 0.0, rec->U + (size_t)k * N);
+		}
+	}
+
+	// Iterations.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_SOLVE);
+	if (status == ELL_SUCCESS)
+		status = recycle_gcrodr(rec, csrA, N, g_u, g_f, g_res, &it);
+	thread_phase_end();
+	stats->t_solve = omp_get_wtime() - t0;
+
+	// Final residual: r = f - A u was left by the iterations.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_RESIDUAL);
+	double norm = cblas_dnrm2(N, g_res, 1);
+	double res0 = norm / cblas_dnrm2(N, g_f, 1);
+	thread_phase_end();
+	stats->t_residual = omp_get_wtime() - t0;
+	mkl_sparse_destroy(csrA);
+
+	// Same tolerance as the direct solvers.
+	double tol = (norder == 6) ? dr * dr * dr * dz * dz * dz : (norder == 4) ? dr * dr * dz * dz : dr * dz;
+	int convergence = (status == ELL_SUCCESS && res0 < tol);
+
+	// A failed preconditioner solve also refreshes the LU next time.
+	rec->stale = (status != ELL_SUCCESS || it > rec->refactor_iterations || it >= rec->max_iterations);
+	rec->iterations += it;
+	rec->nsolves++;
+	if (status != ELL_SUCCESS)
+	{
+		printf("RECYCLE: ERROR! Solve %d failed with status %d, solution and residual unchanged.\n", rec->nsolves, status);
+	}
+	else
+	{
+		printf("RECYCLE: Solve %d took %d iterations with %d recycled vectors%s.\n",
+			rec->nsolves, it, rec->k, refactor ? " after refactoring" : "");
+		printf("RECYCLE: ||r|| = %3.3E.\n", norm);
+	}
+
+	// Transfer solution and residual to original arrays.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_FILL);
+	if (status == ELL_SUCCESS)
+	{
+		ghost_fill(g_u, u, r_sym, z_sym, NrInterior, NzInterior, ghost);
+		ghost_fill(g_res, res, r_sym, z_sym, NrInterior, NzInterior, ghost);
+	}
+	thread_phase_end();
+	stats->t_fill = omp_get_wtime() - t0;
+
+	// The factored matrix is kept as preconditioner.
+	if (!keep)
+		csr_deallocate(&A);
+	free(g_u);
+	free(g_f);
+	free(g_res);
+	for (k = 0; k < ncoeff; k++)
+		free(g_coeff[k]);
+
+	stats->solver = rec->general ? "general_recycle" : "flat_recycle";
+	stats->NrInterior = NrInterior;
+	stats->NzInterior = NzInterior;
+	stats->order = norder;
+	stats->robin = robin;
+	stats->nnz = rec->P.nnz;
+	stats->iterations = it;
+	stats->abs_residual = norm;
+	stats->rel_residual = res0;
+	stats->convergence = convergence;
+	stats->status = status;
+	stats->t_total = omp_get_wtime() - t_start;
+
+	return status;
+}
+
+// Solve flat Laplacian with u as initial guess.
+int recycle_flat(recycle_solver *rec, double *u, double *res, const double *s, const double *f,
+	const double uInf, const int r_sym, const int z_sym, solver_stats *stats)
+{
+	const double *coeff[1] = { s };
+
+	return recycle_solve(rec, u, res, coeff, f, uInf, r_sym, z_sym, stats);
+}
+
+// Solve general elliptic equation with u as initial guess.
+int recycle_general(recycle_solver *rec, double *u, double *res,
+	const double *ell_a, const double *ell_b, const double *ell_c, const double *ell_d, const double *ell_e,
+	const double *ell_s, const double *ell_f, const double uInf, const int r_sym, const int z_sym,
+	solver_stats *stats)
+{
+	const double *coeff[6] = { ell_a, ell_b, ell_c, ell_d, ell_e, ell_s };
+
+	return recycle_solve(rec, u, res, coeff, ell_f, uInf, r_sym, z_sym, stats);
+}
+
+// Stop solver: releases PARDISO and solver memory.
+void recycle_stop(recycle_solver *rec)
+{
+	int rec_phase = -1, rec_error = 0, rec_idum = 0;
+	double rec_ddum = 0.0;
+
+	printf("RECYCLE: %d solves, %d factorizations, %d iterations.\n",
+		rec->nsolves, rec->nfactor, rec->iterations);
+
+	if (rec->factored)
+	{
+		pardiso(rec->pt, &maxfct, &mnum, &mtype, &rec_phase,
+			&rec->P.nrows, &rec_ddum, rec->P.ia, rec->P.ja, &rec_idum, &nrhs,
+			rec->iparm, &msglvl, &rec_ddum, &rec_ddum, &rec_error);
+		csr_deallocate(&rec->P);
+		rec->factored = 0;
+	}
+	free(rec->Y);
+	free(rec->C);
+	free(rec->U);
+	rec->Y = NULL;
+	rec->C = NULL;
+	rec->U = NULL;
+	rec->k = 0;
+	pardiso_stop();
+
+	return;
+}
+#endif
@@ -0,0 +1,54 @@
+// Recycled Krylov solver (GCRO-DR) for sequences of slowly varying systems,
+// such as time steps: a deflation subspace from the previous solves is kept
+// and the stale LU of an earlier matrix is the preconditioner.
+typedef struct recycle_solvers
+{
+	// Problem: fixed for the whole sequence.
+	int general;
+	int NrInterior;
+	int NzInterior;
+	int ghost;
+	double dr;
+	double dz;
+	int norder;
+	int robin;
+	// Parameters.
+	int restart;		// Krylov subspace dimension per cycle, recycled vectors included.
+	int dimension;		// Maximum recycled subspace dimension, 0 for plain GMRES.
+	double tol;		// Relative residual tolerance.
+	int max_iterations;	// Maximum iterations per solve.
+	int refactor_iterations;// Refactor after a solve that needs more iterations.
+	// Preconditioner: LU of the matrix P.
+	void *pt[64];
+	int iparm[64];
+	csr_matrix P;
+	int factored;
+	int stale;
+	// Recycled subspace: A Y = C with orthonormal C, U = P Y.
+	int k;
+	double *Y;
+	double *C;
+	double *U;
+	// Counters.
+	int nsolves;
+	int nfactor;
+	int iterations;		// Total iterations of the sequence.
+} recycle_solver;
+
+// Start solver: initializes PARDISO.
+void recycle_start(recycle_solver *rec, const int general, const int NrInterior, const int NzInterior,
+	const int ghost, const double dr, const double dz, const int norder, const int robin);
+
+// Solve flat Laplacian with u as initial guess. Returns ELL_SUCCESS, or
+// ELL_ERROR_ARGUMENT or the failed PARDISO phase with u and res unchanged.
+int recycle_flat(recycle_solver *rec, double *u, double *res, const double *s, const double *f,
+	const double uInf, const int r_sym, const int z_sym, solver_stats *stats = NULL);
+
+// Solve general elliptic equation with u as initial guess: same status codes.
+int recycle_general(recycle_solver *rec, double *u, double *res,
+	const double *ell_a, const double *ell_b, const double *ell_c, const double *ell_d, const double *ell_e,
+	const double *ell_s, const double *ell_f, const double uInf, const int r_sym, const int z_sym,
+	solver_stats *stats = NULL);
+
+// Stop solver: releases PARDISO and solver memory.
+void recycle_stop(recycle_solver *rec);
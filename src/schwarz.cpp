@@ -0,0 +1,563 @@
+// Global header files.
+#include "tools.h"
+
+// PARDISO parameters are shared, each subdomain has its own handle.
+#include "pardiso_param.h"
+#include "pardiso.h"
+#include "mkl_service.h"
+#include "mkl_lapacke.h"
+
+// Elliptic solver headers.
+#include "thread_profile.h"
+#include "schwarz.h"
+
+// SCHWARZ DEFAULTS.
+// Overlap in points on each side: at least the stencil half width.
+#define SCHWARZ_OVERLAP 4
+// GMRES relative residual, restart length and iteration limit.
+#define SCHWARZ_TOL 1.0E-10
+#define SCHWARZ_RESTART 60
+#define SCHWARZ_MAX_ITERATIONS 1000
+
+// Restricted additive Schwarz (RAS) preconditioner.
+//
+// The reduced grid is split into nsub x nsub rectangular cores, which are
+// grown by SCHWARZ_OVERLAP points on each side into boxes. The matrix rows
+// and columns of every box form an independent local system (couplings
+// leaving the box are dropped, i.e. zero Dirichlet data), factored once
+// with its own PARDISO handle. The preconditioner solves every box with
+// the restricted residual and keeps the solution on the core only:
+//
+//	M^(-1) r = sum_k R0_k^T A_k^(-1) R_k r,
+//
+// so boxes write disjoint points. Factorizations and solves of the boxes
+// are OpenMP tasks, each running sequential MKL, and idle threads take the
+// remaining boxes. The total fill of the box factors grows like
+// N log(N / nsub^2) instead of N log N.
+//
+// Box solves alone only exchange information between neighbours, so the
+// iterations would grow with nsub. A coarse space with one constant per
+// core, Q = R0^T (R0 A R0^T)^(-1) R0, is applied first and the boxes solve
+// for what is left (hybrid two-level Schwarz):
+//
+//	M^(-1) r = Q r + RAS (r - A Q r).
+
+// Subdomain: box, core and local system.
+typedef struct schwarz_subdomains
+{
+	int i0, i1, j0, j1;	// Box: i0 <= i < i1, j0 <= j < j1.
+	int c0, c1, d0, d1;	// Core: c0 <= i < c1, d0 <= j < d1.
+	void *pt[64];
+	int iparm[64];
+	csr_matrix A;
+	double *b;
+	double *x;
+	int error;
+} schwarz_subdomain;
+
+// Coarse space: core of every point and dense LU of R0 A R0^T.
+typedef struct schwarz_coarses
+{
+	int n;
+	int *owner;
+	double *A0;
+	lapack_int *piv;
+	lapack_int info;	// LAPACK factorization info: 0 on success.
+	double *y;
+} schwarz_coarse;
+
+// Rows and columns of the box in the global matrix.
+static void schwarz_extract(const csr_matrix A, const int NzTotal, schwarz_subdomain *sub)
+{
+	int i, j, k, col, ci, cj, nnz = 0;
+	int nj = sub->j1 - sub->j0;
+	int nrows = (sub->i1 - sub->i0) * nj;
+
+	// Nonzeros inside the box.
+	for (i = sub->i0; i < sub->i1; i++)
+	{
+		for (j = sub->j0; j < sub->j1; j++)
+		{
+			for (k = A.ia[IDX(i, j)] - BASE; k < A.ia[IDX(i, j) + 1] - BASE; k++)
+			{
+				col = A.ja[k] - BASE;
+				ci = col / NzTotal;
+				cj = col % NzTotal;
+				if (ci >= sub->i0 && ci < sub->i1 && cj >= sub->j0 && cj < sub->j1)
+					nnz++;
+			}
+		}
+	}
+
+	// Local rows in the same rho-major order: columns stay sorted.
+	csr_allocate(&sub->A, nrows, nrows, nnz);
+	nnz = 0;
+	sub->A.ia[0] = BASE;
+	for (i = sub->i0; i < sub->i1; i++)
+	{
+		for (j = sub->j0; j < sub->j1; j++)
+		{
+			for (k = A.ia[IDX(i, j)] - BASE; k < A.ia[IDX(i, j) + 1] - BASE; k++)
+			{
+				col = A.ja[k] - BASE;
+				ci = col / NzTotal;
+				cj = col % NzTotal;
+				if (ci >= sub->i0 && ci < sub->i1 && cj >= sub->j0 && cj < sub->j1)
+				{
+					sub->A.a[nnz] = A.a[k];
+					sub->A.ja[nnz] = BASE + (ci - sub->i0) * nj + (cj - sub->j0);
+					nnz++;
+				}
+			}
+			sub->A.ia[(i - sub->i0) * nj + (j - sub->j0) + 1] = BASE + nnz;
+		}
+	}
+	sub->b = (double *)malloc(nrows * sizeof(double));
+	sub->x = (double *)malloc(nrows * sizeof(double));
+
+	return;
+}
+
+// Extract and factor a box with sequential MKL.
+static void schwarz_factor(const csr_matrix A, const int NzTotal, schwarz_subdomain *sub)
+{
+	int k, sub_phase = 12, sub_idum = 0;
+	double sub_ddum = 0.0;
+
+	schwarz_extract(A, NzTotal, sub);
+
+	// Global fine-tuning with sequential reordering and factorization.
+	for (k = 0; k < 64; k++)
+	{
+		sub->iparm[k] = iparm[k];
+		sub->pt[k] = 0;
+	}
+	sub->iparm[2 - 1] = 2;	// Sequential fill-in reordering from METIS.
+	sub->iparm[4 - 1] = 0;	// No iterative-direct algorithm.
+	sub->iparm[5 - 1] = 0;	// No user fill-in reducing permutation.
+	sub->iparm[24 - 1] = 0;	// Classic numerical factorization.
+	sub->iparm[25 - 1] = 0;	// Sequential forward/backward solve.
+	sub->iparm[27 - 1] = 0;	// Matrix was checked as a whole.
+	sub->iparm[39 - 1] = 0;	// No low rank update.
+
+	int prev = mkl_set_num_threads_local(1);
+	pardiso(sub->pt, &maxfct, &mnum, &mtype, &sub_phase,
+		&sub->A.nrows, sub->A.a, sub->A.ia, sub->A.ja, &sub_idum, &nrhs,
+		sub->iparm, &msglvl, &sub_ddum, &sub_ddum, &sub->error);
+	mkl_set_num_threads_local(prev);
+
+	return;
+}
+
+// Solve a box with the restricted residual and write its core into z.
+static void schwarz_solve(const double *r, double *z, const int NzTotal, schwarz_subdomain *sub)
+{
+	int i, j, sub_phase = 33, sub_idum = 0;
+	int nj = sub->j1 - sub->j0;
+
+	for (i = sub->i0; i < sub->i1; i++)
+		for (j = sub->j0; j < sub->j1; j++)
+			sub->b[(i - sub->i0) * nj + (j - sub->j0)] = r[IDX(i, j)];
+
+	int prev = mkl_set_num_threads_local(1);
+	pardiso(sub->pt, &maxfct, &mnum, &mtype, &sub_phase,
+		&sub->A.nrows, sub->A.a, sub->A.ia, sub->A.ja, &sub_idum, &nrhs,
+		sub->iparm, &msglvl, sub->b, sub->x, &sub->error);
+	mkl_set_num_threads_local(prev);
+
+	for (i = sub->c0; i < sub->c1; i++)
+		for (j = sub->d0; j < sub->d1; j++)
+			z[IDX(i, j)] = sub->x[(i - sub->i0) * nj + (j - sub->j0)];
+
+	return;
+}
+
+// z = M^(-1) r over all boxes: returns ELL_ERROR_SOLVE if a box failed.
+static int schwarz_apply(schwarz_subdomain *subs, const int nsubs, const double *r, double *z, const int NzTotal)
+{
+	int k;
+
+	#pragma omp parallel
+	{
+		#pragma omp single
+		{
+			for (k = 0; k < nsubs; k++)
+			{
+				#pragma omp task firstprivate(k)
+				schwarz_solve(r, z, NzTotal, &subs[k]);
+			}
+		}
+	}
+	for (k = 0; k < nsubs; k++)
+	{
+		if (subs[k].error != 0)
+		{
+			printf("SCHWARZ: ERROR during solution of subdomain %d: %d.\n", k, subs[k].error);
+			return ELL_ERROR_SOLVE;
+		}
+	}
+
+	return ELL_SUCCESS;
+}
+
+// Galerkin coarse matrix A0 = R0 A R0^T and its LU with partial pivoting.
+static void schwarz_coarse_setup(const csr_matrix A, schwarz_subdomain *subs, const int nsub,
+	const int NzTotal, schwarz_coarse *coarse)
+{
+	int n0 = nsub * nsub;
+	int i, j, k;
+
+	coarse->n = n0;
+	coarse->owner = (int *)malloc(A.nrows * sizeof(int));
+	coarse->A0 = (double *)calloc(n0 * n0, sizeof(double));
+	coarse->piv = (lapack_int *)malloc(n0 * sizeof(lapack_int));
+	coarse->y = (double *)malloc(n0 * sizeof(double));
+
+	for (k = 0; k < n0; k++)
+		for (i = subs[k].c0; i < subs[k].c1; i++)
+			for (j = subs[k].d0; j < subs[k].d1; j++)
+				coarse->owner[IDX(i, j)] = k;
+
+	for (i = 0; i < A.nrows; i++)
+		for (j = A.ia[i] - BASE; j < A.ia[i + 1] - BASE; j++)
+			coarse->A0[coarse->owner[i] * n0 + coarse->owner[A.ja[j] - BASE]] += A.a[j];
+
+	coarse->info = LAPACKE_dgetrf(LAPACK_ROW_MAJOR, n0, n0, coarse->A0, n0, coarse->piv);
+	if (coarse->info != 0)
+		printf("SCHWARZ: WARNING coarse factorization failed: %d, one-level preconditioner.\n", (int)coarse->info);
+
+	return;
+}
+
+// z = Q r: restrict by sums over cores, solve with A0, prolong constants.
+static void schwarz_coarse_apply(const schwarz_coarse *coarse, const int N, const double *r, double *z)
+{
+	int n0 = coarse->n;
+	double *y = coarse->y;
+	int i, k;
+
+	for (k = 0; k < n0; k++)
+		y[k] = 0.0;
+	if (coarse->info == 0)
+	{
+		for (i = 0; i < N; i++)
+			y[coarse->owner[i]] += r[i];
+		LAPACKE_dgetrs(LAPACK_ROW_MAJOR, 'N', n0, 1, coarse->A0, n0, coarse->piv, y, 1);
+	}
+
+	#pragma omp parallel for schedule(static)
+	for (i = 0; i < N; i++)
+		z[i] = y[coarse->owner[i]];
+
+	return;
+}
+
+// y = beta * y + alpha * A x.
+static void schwarz_mv(sparse_matrix_t csrA, const double alpha, const double *x, const double beta, double *y)
+{
+	struct matrix_descr descrA;
+	descrA.type = SPARSE_MATRIX_TYPE_GENERAL;
+	mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, alpha, csrA, descrA, x, beta, y);
+
+	return;
+}
+
+// z = M^(-1) r = Q r + RAS (r - A Q r), t and w are workspace.
+static int schwarz_precondition(sparse_matrix_t csrA, schwarz_subdomain *subs, const schwarz_coarse *coarse,
+	const int N, const int NzTotal, const double *r, double *z, double *t, double *w)
+{
+	schwarz_coarse_apply(coarse, N, r, t);
+	cblas_dcopy(N, r, 1, w, 1);
+	schwarz_mv(csrA, -1.0, t, 1.0, w);
+	int status = schwarz_apply(subs, coarse->n, w, z, NzTotal);
+	cblas_daxpy(N, 1.0, t, 1, z, 1);
+
+	return status;
+}
+
+// Release the handles and memory of all boxes.
+static void schwarz_release(schwarz_subdomain *subs, const int nsubs)
+{
+	int k, sub_phase = -1, sub_idum = 0;
+	double sub_ddum = 0.0;
+
+	for (k = 0; k < nsubs; k++)
+	{
+		pardiso(subs[k].pt, &maxfct, &mnum, &mtype, &sub_phase,
+			&subs[k].A.nrows, &sub_ddum, subs[k].A.ia, subs[k].A.ja, &sub_idum, &nrhs,
+			subs[k].iparm, &msglvl, &sub_ddum, &sub_ddum, &subs[k].error);
+		csr_deallocate(&subs[k].A);
+		free(subs[k].b);
+		free(subs[k].x);
+	}
+	free(subs);
+
+	return;
+}
+
+// Restarted GMRES with right preconditioning: the preconditioned vectors
+// are kept, so the update needs no extra preconditioner applications.
+// Returns ELL_ERROR_ARGUMENT for boxes smaller than the overlap and
+// ELL_ERROR_FACTOR or ELL_ERROR_SOLVE if a box fails.
+int schwarz_gmres(const csr_matrix A,	// Matrix system to solve: Au = f.
+	double *u,			// Solution array.
+	double *f,			// RHS array.
+	double *r,			// Residual, r = f - Au, array.
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const double tol,		// Tolerance convergence.
+	double *norm,			// Pointer to final norm.
+	int *convergence,		// Pointer to convergence flag.
+	const int infnorm,		// Select infnorm or twonorm.
+	const int nsub,			// Subdomains per direction.
+	solver_stats *stats)		// Output phase times and PARDISO statistics, may be NULL.
+{
+	int NrTotal = NrInterior + 2;
+	int NzTotal = NzInterior + 2;
+	int N = A.nrows;
+	int nsubs = nsub * nsub;
+	int i, j, k, it = 0;
+	double t0, t_factor, t_solve, t_residual;
+	double res, res0, fnorm, beta, aux, c, s;
+	int status = ELL_SUCCESS;
+
+	if (nsub < 1 || NrTotal / nsub <= SCHWARZ_OVERLAP || NzTotal / nsub <= SCHWARZ_OVERLAP)
+	{
+		printf("SCHWARZ: ERROR! %d x %d subdomains are too small for %d x %d points.\n", nsub, nsub, NrTotal, NzTotal);
+		*convergence = 0;
+		if (stats)
+		{
+			stats->status = ELL_ERROR_ARGUMENT;
+			stats->fallback = 0;
+		}
+		return ELL_ERROR_ARGUMENT;
+	}
+
+	// Boxes and cores.
+	schwarz_subdomain *subs = (schwarz_subdomain *)malloc(nsubs * sizeof(schwarz_subdomain));
+	for (i = 0; i < nsub; i++)
+	{
+		for (j = 0; j < nsub; j++)
+		{
+			schwarz_subdomain *sub = &subs[i * nsub + j];
+			sub->c0 = i * NrTotal / nsub;
+			sub->c1 = (i + 1) * NrTotal / nsub;
+			sub->d0 = j * NzTotal / nsub;
+			sub->d1 = (j + 1) * NzTotal / nsub;
+			sub->i0 = MAX(0, sub->c0 - SCHWARZ_OVERLAP);
+			sub->i1 = MIN(NrTotal, sub->c1 + SCHWARZ_OVERLAP);
+			sub->j0 = MAX(0, sub->d0 - SCHWARZ_OVERLAP);
+			sub->j1 = MIN(NzTotal, sub->d1 + SCHWARZ_OVERLAP);
+		}
+	}
+
+	// Factor all boxes.
+	t0 = omp_get_wtime();
+	#pragma omp parallel
+	{
+		#pragma omp single
+		{
+			for (k = 0; k < nsubs; k++)
+			{
+				#pragma omp task firstprivate(k)
+				schwarz_factor(A, NzTotal, &subs[k]);
+			}
+		}
+	}
+	long factor_nnz = 0, factor_mflops = 0, mem = 0;
+	for (k = 0; k < nsubs; k++)
+	{
+		if (subs[k].error != 0 && status == ELL_SUCCESS)
+		{
+			printf("SCHWARZ: ERROR during factorization of subdomain %d: %d.\n", k, subs[k].error);
+			status = ELL_ERROR_FACTOR;
+		}
+		factor_nnz += subs[k].iparm[18 - 1];
+		factor_mflops += subs[k].iparm[19 - 1];
+		mem += MAX(subs[k].iparm[15 - 1], subs[k].iparm[16 - 1] + subs[k].iparm[17 - 1]);
+	}
+	t_factor = omp_get_wtime() - t0;
+	if (status != ELL_SUCCESS)
+	{
+		schwarz_release(subs, nsubs);
+		*convergence = 0;
+		if (stats)
+		{
+			stats->t_factor = t_factor;
+			stats->status = status;
+			stats->fallback = 0;
+		}
+		return status;
+	}
+	printf("SCHWARZ: Factored %d subdomains with %ld nonzeros in factors.\n", nsubs, factor_nnz);
+
+	// Coarse space.
+	schwarz_coarse coarse;
+	schwarz_coarse_setup(A, subs, nsub, NzTotal, &coarse);
+
+	// Matrix handle for products.
+	sparse_matrix_t csrA;
+	mkl_sparse_d_create_csr(&csrA, SPARSE_INDEX_BASE_ONE, A.nrows, A.ncols, A.ia, A.ia + 1, A.ja, A.a);
+	mkl_sparse_optimize(csrA);
+
+	// Krylov basis V, preconditioned basis Z, Hessenberg matrix H,
+	// Givens rotations (cs, sn) and rotated residual g.
+	int m = SCHWARZ_RESTART;
+	double *V = (double *)malloc((size_t)(m + 1) * N * sizeof(double));
+	double *Z = (double *)malloc((size_t)m * N * sizeof(double));
+	double *H = (double *)malloc((m + 1) * m * sizeof(double));
+	double *cs = (double *)malloc(m * sizeof(double));
+	double *sn = (double *)malloc(m * sizeof(double));
+	double *g = (double *)malloc((m + 1) * sizeof(double));
+	double *t = (double *)malloc(N * sizeof(double));
+	double *w0 = (double *)malloc(N * sizeof(double));
+
+	t0 = omp_get_wtime();
+	fnorm = cblas_dnrm2(N, f, 1);
+	if (fnorm == 0.0)
+		fnorm = 1.0;
+	while (it < SCHWARZ_MAX_ITERATIONS)
+	{
+		// Restart: r = f - A u.
+		cblas_dcopy(N, f, 1, r, 1);
+		schwarz_mv(csrA, -1.0, u, 1.0, r);
+		beta = cblas_dnrm2(N, r, 1);
+		if (beta / fnorm < SCHWARZ_TOL)
+			break;
+		cblas_dcopy(N, r, 1, V, 1);
+		cblas_dscal(N, 1.0 / beta, V, 1);
+		for (k = 0; k <= m; k++)
+			g[k] = 0.0;
+		g[0] = beta;
+
+		for (j = 0; j < m && it < SCHWARZ_MAX_ITERATIONS; j++)
+		{
+			double *v = V + (size_t)j * N;
+			double *w = V + (size_t)(j + 1) * N;
+			double *z = Z + (size_t)j * N;
+
+			// w = A M^(-1) v, orthogonalized by modified Gram-Schmidt.
+			status = schwarz_precondition(csrA, subs, &coarse, N, NzTotal, v, z, t, w0);
+			if (status != ELL_SUCCESS)
+				break;
+			schwarz_mv(csrA, 1.0, z, 0.0, w);
+			for (i = 0; i <= j; i++)
+			{
+				H[i * m + j] = cblas_ddot(N, w, 1, V + (size_t)i * N, 1);
+				cblas_daxpy(N, -H[i * m + j], V + (size_t)i * N, 1, w, 1);
+			}
+			H[(j + 1) * m + j] = cblas_dnrm2(N, w, 1);
+			if (H[(j + 1) * m + j] > 0.0)
+				cblas_dscal(N, 1.0 / H[(j + 1) * m + j], w, 1);
+
+			// Previous rotations on the new column, then a new rotation.
+			for (i = 0; i < j; i++)
+			{
+				aux = cs[i] * H[i * m + j] + sn[i] * H[(i + 1) * m + j];
+				H[(i + 1) * m + j] = -sn[i] * H[i * m + j] + cs[i] * H[(i + 1) * m + j];
+				H[i * m + j] = aux;
+			}
+			aux = sqrt(H[j * m + j] * H[j * m + j] + H[(j + 1) * m + j] * H[(j + 1) * m + j]);
+			c = (aux > 0.0) ? H[j * m + j] / aux : 1.0;
+			s = (aux > 0.0) ? H[(j + 1) * m + j] / aux : 0.0;
+			cs[j] = c;
+			sn[j] = s;
+			H[j * m + j] = aux;
+			H[(j + 1) * m + j] = 0.0;
+			g[j + 1] = -s * g[j];
+			g[j] = c * g[j];
+			it++;
+#ifdef VERBOSE
+			printf("SCHWARZ GMRES: %d, relative residual = %e.\n", it, fabs(g[j + 1]) / fnorm);
+#endif
+			if (fabs(g[j + 1]) / fnorm < SCHWARZ_TOL)
+			{
+				j++;
+				break;
+			}
+		}
+
+		if (status != ELL_SUCCESS)
+			break;
+
+		// Back substitution of H y = g, then u = u + Z y.
+		for (i = j - 1; i >= 0; i--)
+		{
+			aux = g[i];
+			for (k = i + 1; k < j; k++)
+				aux -= H[i * m + k] * g[k];
+			g[i] = aux / H[i * m + i];
+		}
+		for (i = 0; i < j; i++)
+			cblas_daxpy(N, g[i], Z + (size_t)i * N, 1, u, 1);
+	}
+	t_solve = omp_get_wtime() - t0;
+	printf("SCHWARZ GMRES: %d iterations.\n", it);
+
+	// Final residual.
+	t0 = omp_get_wtime();
+	thread_phase_begin(PHASE_RESIDUAL);
+	cblas_dcopy(N, f, 1, r, 1);
+	schwarz_mv(csrA, -1.0, u, 1.0, r);
+	if (infnorm)
+	{
+		res = fabs(r[cblas_idamax(N, r, 1)]);
+		res0 = fabs(f[cblas_idamax(N, f, 1)]);
+	}
+	else
+	{
+		res = cblas_dnrm2(N, r, 1);
+		res0 = cblas_dnrm2(N, f, 1);
+	}
+	res0 = res / res0;
+	thread_phase_end();
+	t_residual = omp_get_wtime() - t0;
+
+	*norm = res;
+	*convergence = (status == ELL_SUCCESS && res0 < tol);
+
+	// Release subdomain memory.
+	schwarz_release(subs, nsubs);
+	mkl_sparse_destroy(csrA);
+	free(V);
+	free(Z);
+	free(H);
+	free(cs);
+	free(sn);
+	free(g);
+	free(t);
+	free(w0);
+	free(coarse.owner);
+	free(coarse.A0);
+	free(coarse.piv);
+	free(coarse.y);
+
+	// Report phase times: factor and memory totals are summed over boxes.
+	if (stats)
+	{
+		stats->t_analyse = 0.0;
+		stats->t_factor = t_factor;
+		stats->t_solve = t_solve;
+		stats->t_residual = t_residual;
+		stats->nnz = A.nnz;
+		stats->lr_use = 0;
+		stats->precond_use = 0;
+		stats->perturbed_pivots = 0;
+		stats->mem_peak_analysis = (int)mem;
+		stats->mem_permanent = (int)mem;
+		stats->mem_factor = 0;
+		stats->factor_nnz = (int)factor_nnz;
+		stats->factor_mflops = (int)factor_mflops;
+		stats->cgs_iterations = 0;
+		stats->refinement_steps = 0;
+		stats->corrections = 0;
+		stats->iterations = it;
+		stats->abs_residual = res;
+		stats->rel_residual = res0;
+		stats->convergence = *convergence;
+		stats->status = status;
+		stats->fallback = 0;
+	}
+
+	return status;
+}
@@ -0,0 +1,17 @@
+// Restricted additive Schwarz preconditioned GMRES: solve Au = f on the
+// reduced (NrInterior + 2) x (NzInterior + 2) grid split into nsub x nsub
+// overlapping boxes, each factored by its own PARDISO handle.
+// u holds the initial guess on input. Returns ELL_SUCCESS, ELL_ERROR_ARGUMENT
+// for too many subdomains, or ELL_ERROR_FACTOR/ELL_ERROR_SOLVE if a box fails.
+int schwarz_gmres(const csr_matrix A,	// Matrix system to solve: Au = f.
+	double *u,			// Solution array.
+	double *f,			// RHS array.
+	double *r,			// Residual, r = f - Au, array.
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const double tol,		// Tolerance convergence.
+	double *norm,			// Pointer to final norm.
+	int *convergence,		// Pointer to convergence flag.
+	const int infnorm,		// Select infnorm or twonorm.
+	const int nsub,			// Subdomains per direction.
+	solver_stats *stats);		// Output phase times and PARDISO statistics, may be NULL.
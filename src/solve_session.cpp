@@ -0,0 +1,249 @@
+// Global header files.
+#include "tools.h"
+
+// PARDISO global state and initialization.
+#include "pardiso_param.h"
+#include "pardiso_start.h"
+#include "pardiso_stop.h"
+#include "low_rank.h"
+
+// Elliptic solvers.
+#include "flat_laplacian.h"
+#include "general_elliptic.h"
+#include "solve_session.h"
+#include "solver_stats.h"
+
+// Sessions are only available from C: the FORTRAN build has no C entry
+// points for the solvers.
+#ifndef FORTRAN
+
+// SESSION DEFAULTS.
+#define SESSION_CGS_CHANGE 0.05
+#define SESSION_CGS_MAX_ITERATIONS 20
+#define SESSION_CGS_L 6
+
+// Strategy names.
+static const char *session_mode_names[3] = { "full", "low_rank", "cgs" };
+
+// Start session: initializes PARDISO.
+//
+// Thresholds take their default values and may be changed by the caller
+// before the first solve.
+void solve_session_start(solve_session *session,
+	const int general,	// Solver: general elliptic(1) or flat Laplacian(0).
+	const int NrInterior,	// Number of r interior points.
+	const int NzInterior,	// Number of z interior points.
+	const int ghost,	// Number of ghost zones.
+	const double dr,	// Spatial step in r.
+	const double dz,	// Spatial step in z.
+	const int norder,	// Finite difference order: 2 or 4.
+	const int robin)	// Robin BC type: 1, 2, 3.
+{
+	int k;
+	size_t DIM_size = (ghost + NrInterior + 1) * (ghost + NzInterior + 1) * sizeof(double);
+
+	memset(session, 0, sizeof(solve_session));
+	session->general = general;
+	session->NrInterior = NrInterior;
+	session->NzInterior = NzInterior;
+	session->ghost = ghost;
+	session->dr = dr;
+	session->dz = dz;
+	session->norder = norder;
+	session->robin = robin;
+	session->cgs_change = SESSION_CGS_CHANGE;
+	session->cgs_max_iterations = SESSION_CGS_MAX_ITERATIONS;
+	session->cgs_L = SESSION_CGS_L;
+
+	// Reference coefficients.
+	session->ncoeff = general ? 6 : 1;
+	for (k = 0; k < session->ncoeff; k++)
+		session->ref[k] = (double *)malloc(DIM_size);
+
+	// PARDISO for this grid: low rank diff arrays are detected at each update.
+	pardiso_start(NrInterior, NzInterior);
+
+	return;
+}
+
+// Maximum relative change of the coefficients since the last factorization.
+static double session_change(const solve_session *session, const double **coeff)
+{
+	int DIM = (session->ghost + session->NrInterior + 1) * (session->ghost + session->NzInterior + 1);
+	double change = 0.0, diff, scale;
+	int c, k;
+
+	for (c = 0; c < session->ncoeff; c++)
+	{
+		const double *x = coeff[c];
+		const double *x0 = session->ref[c];
+		diff = 0.0;
+		scale = 0.0;
+		#pragma omp parallel for schedule(static) reduction(max:diff, scale)
+		for (k = 0; k < DIM; k++)
+		{
+			diff = fmax(diff, fabs(x[k] - x0[k]));
+			scale = fmax(scale, fabs(x0[k]));
+		}
+		// Coefficients that were identically zero are compared in absolute terms.
+		diff = (scale > 0.0) ? diff / scale : diff;
+		change = (diff > change) ? diff : change;
+	}
+
+	return change;
+}
+
+// Call solver with the given strategy. Returns the solver status.
+static int session_call(solve_session *session, const int mode, double *u, double *res,
+	const double **coeff, const double *f, const double uInf, const int r_sym, const int z_sym, solver_stats *stats)
+{
+	// Low rank updates only include the entries that changed.
+	int lr_use = (mode == SESSION_LOW_RANK) ? 2 : 0;
+	int precond_use = (mode == SESSION_CGS) ? session->cgs_L : 0;
+	int status;
+
+	// CGS reuses the analysis and starts from the previous solution.
+	skip_analysis = (mode == SESSION_CGS);
+	guess_use = (mode == SESSION_CGS);
+
+	if (session->general)
+	{
+		status = general_elliptic(u, res, coeff[0], coeff[1], coeff[2], coeff[3], coeff[4], coeff[5], f,
+			uInf, session->robin, r_sym, z_sym, session->NrInterior, session->NzInterior, session->ghost,
+			session->dr, session->dz, session->norder, lr_use, precond_use, stats);
+	}
+	else
+	{
+		status = flat_laplacian(u, res, coeff[0], f, uInf, session->robin, r_sym, z_sym,
+			session->NrInterior, session->NzInterior, session->ghost,
+			session->dr, session->dz, session->norder, lr_use, precond_use, stats);
+	}
+
+	skip_analysis = 0;
+	guess_use = 0;
+
+	return status;
+}
+
+// Choose strategy, solve and fall back to refactorization if CGS is not good enough.
+//
+// The first solve is a full factorization. Later solves reuse the stale LU
+// through CGS while the coefficients stay within cgs_change of those at the
+// last factorization; otherwise the LU is refreshed with a low rank update,
+// which keeps the analysis. A CGS solve that fails, needs more than
+// cgs_max_iterations or does not converge is repeated with a low rank update.
+// One that needs more than half of them marks the LU as stale for the next solve.
+// A failed solve, or one that needed the GMRES fallback, leaves no LU of the
+// session: the next solve is a full factorization. Returns the solver status.
+static int session_solve(solve_session *session, double *u, double *res,
+	const double **coeff, const double *f, const double uInf, const int r_sym, const int z_sym, solver_stats *stats)
+{
+	solver_stats local_stats;
+	int DIM = (session->ghost + session->NrInterior + 1) * (session->ghost + session->NzInterior + 1);
+	int k, mode, status;
+
+	if (stats == NULL)
+	{
+		solver_stats_reset(&local_stats);
+		stats = &local_stats;
+	}
+
+	// Choose strategy.
+	session->change = session->factored ? session_change(session, coeff) : HUGE_VAL;
+	if (!session->factored)
+		mode = SESSION_FULL;
+	else if (!session->stale && session->change <= session->cgs_change)
+		mode = SESSION_CGS;
+	else
+		mode = SESSION_LOW_RANK;
+
+	status = session_call(session, mode, u, res, coeff, f, uInf, r_sym, z_sym, stats);
+
+	// Check CGS.
+	if (mode == SESSION_CGS)
+	{
+		if (status != ELL_SUCCESS || stats->cgs_iterations < 0 || stats->cgs_iterations > session->cgs_max_iterations
+			|| !stats->convergence)
+		{
+			printf("SOLVE SESSION: CGS status = %d, iterations = %d, convergence = %d, refactoring.\n",
+				status, stats->cgs_iterations, stats->convergence);
+			session->nfallback++;
+			mode = SESSION_LOW_RANK;
+			status = session_call(session, mode, u, res, coeff, f, uInf, r_sym, z_sym, stats);
+		}
+		else
+		{
+			session->ncgs++;
+			session->stale = (2 * stats->cgs_iterations > session->cgs_max_iterations);
+		}
+	}
+
+	// No usable LU left: refactor at the next solve.
+	if (status != ELL_SUCCESS || stats->fallback == FALLBACK_ITERATIVE)
+	{
+		session->factored = 0;
+	}
+	// Store coefficients of the new factorization.
+	else if (mode != SESSION_CGS)
+	{
+		for (k = 0; k < session->ncoeff; k++)
+			memcpy(session->ref[k], coeff[k], DIM * sizeof(double));
+		session->factored = 1;
+		session->stale = 0;
+		if (mode == SESSION_FULL)
+			session->nfull++;
+		else
+			session->nlow_rank++;
+	}
+
+	session->mode = mode;
+	session->nsolves++;
+
+	if (status != ELL_SUCCESS)
+		printf("SOLVE SESSION: Solve %d failed with %s, status %d.\n", session->nsolves, session_mode_names[mode], status);
+	else
+		printf("SOLVE SESSION: Solve %d used %s, coefficient change %3.3E.\n",
+			session->nsolves, session_mode_names[mode], session->change);
+
+	return status;
+}
+
+// Solve flat Laplacian within session.
+int solve_session_flat(solve_session *session, double *u, double *res, const double *s, const double *f,
+	const double uInf, const int r_sym, const int z_sym, solver_stats *stats)
+{
+	const double *coeff[1] = { s };
+
+	return session_solve(session, u, res, coeff, f, uInf, r_sym, z_sym, stats);
+}
+
+// Solve general elliptic equation within session.
+int solve_session_general(solve_session *session, double *u, double *res,
+	const double *ell_a, const double *ell_b, const double *ell_c, const double *ell_d, const double *ell_e,
+	const double *ell_s, const double *ell_f, const double uInf, const int r_sym, const int z_sym,
+	solver_stats *stats)
+{
+	const double *coeff[6] = { ell_a, ell_b, ell_c, ell_d, ell_e, ell_s };
+
+	return session_solve(session, u, res, coeff, ell_f, uInf, r_sym, z_sym, stats);
+}
+
+// Stop session: releases PARDISO and session memory.
+void solve_session_stop(solve_session *session)
+{
+	int k;
+
+	printf("SOLVE SESSION: %d solves, %d full, %d low rank, %d CGS, %d CGS fallbacks.\n",
+		session->nsolves, session->nfull, session->nlow_rank, session->ncgs, session->nfallback);
+
+	low_rank_deallocate();
+	pardiso_stop();
+	for (k = 0; k < session->ncoeff; k++)
+	{
+		free(session->ref[k]);
+		session->ref[k] = NULL;
+	}
+
+	return;
+}
+#endif
@@ -0,0 +1,54 @@
+// Solve strategies chosen by a session.
+#define SESSION_FULL 0
+#define SESSION_LOW_RANK 1
+#define SESSION_CGS 2
+
+// Session for repeated solves on a fixed grid: chooses between full
+// factorization, low rank update and CGS with the stale LU.
+typedef struct solve_sessions
+{
+	// Problem: fixed for the whole session.
+	int general;
+	int NrInterior;
+	int NzInterior;
+	int ghost;
+	double dr;
+	double dz;
+	int norder;
+	int robin;
+	// Coefficients at the last factorization: s for flat, a, b, c, d, e, s for general.
+	double *ref[6];
+	int ncoeff;
+	int factored;
+	int stale;
+	// Thresholds.
+	double cgs_change;	// Maximum relative coefficient change for CGS reuse.
+	int cgs_max_iterations;	// Refactor when CGS needs more iterations.
+	int cgs_L;		// CGS stopping criterion 10^(-L).
+	// Counters.
+	int nsolves;
+	int nfull;
+	int nlow_rank;
+	int ncgs;
+	int nfallback;
+	// Last solve.
+	int mode;
+	double change;
+} solve_session;
+
+// Start session: initializes PARDISO.
+void solve_session_start(solve_session *session, const int general, const int NrInterior, const int NzInterior,
+	const int ghost, const double dr, const double dz, const int norder, const int robin);
+
+// Solve flat Laplacian within session. Returns the solver status.
+int solve_session_flat(solve_session *session, double *u, double *res, const double *s, const double *f,
+	const double uInf, const int r_sym, const int z_sym, solver_stats *stats = NULL);
+
+// Solve general elliptic equation within session. Returns the solver status.
+int solve_session_general(solve_session *session, double *u, double *res,
+	const double *ell_a, const double *ell_b, const double *ell_c, const double *ell_d, const double *ell_e,
+	const double *ell_s, const double *ell_f, const double uInf, const int r_sym, const int z_sym,
+	solver_stats *stats = NULL);
+
+// Stop session: releases PARDISO and session memory.
+void solve_session_stop(solve_session *session);
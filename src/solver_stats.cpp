@@ -0,0 +1,119 @@
+// Global header: solver_stats type is defined here.
+#include "tools.h"
+#include "thread_profile.h"
+
+// Bytes moved per last level cache miss.
+#define CACHE_LINE 64
+
+// Reset solver statistics: all times, counters and norms to zero.
+void solver_stats_reset(solver_stats *stats)
+{
+	memset(stats, 0, sizeof(solver_stats));
+	stats->solver = "none";
+
+	return;
+}
+
+// Peak PARDISO memory in KB.
+//
+// Following the MKL manual the peak is the maximum of the analysis peak
+// iparm(15) and the permanent plus numerical factorization memory iparm(16) + iparm(17).
+int solver_stats_peak_memory(const solver_stats *stats)
+{
+	int mem_factor = stats->mem_permanent + stats->mem_factor;
+
+	return MAX(stats->mem_peak_analysis, mem_factor);
+}
+
+// Wall time of a phase.
+static double solver_stats_phase_time(const solver_stats *stats, const int phase)
+{
+	switch (phase)
+	{
+	case PHASE_REDUCE:
+		return stats->t_reduce;
+	case PHASE_ASSEMBLE:
+		return stats->t_assemble;
+	case PHASE_ANALYSE:
+		return stats->t_analyse;
+	case PHASE_FACTOR:
+		return stats->t_factor;
+	case PHASE_SOLVE:
+		return stats->t_solve;
+	case PHASE_RESIDUAL:
+		return stats->t_residual;
+	case PHASE_FILL:
+		return stats->t_fill;
+	}
+
+	return 0.0;
+}
+
+// Write hardware counters per phase as a JSON object.
+//
+// Derived rates: instructions per cycle, memory bandwidth assuming one
+// cache line of traffic per LLC miss, and for the factorization the
+// PARDISO flop count iparm(19) over its wall time. A low IPC with high
+// bandwidth marks a memory-bound phase.
+static void solver_stats_json_perf(FILE *fp, const solver_stats *stats)
+{
+	int k;
+	double t, ipc, gbytes, gflops;
+
+	fprintf(fp, ",\"perf\":{");
+	for (k = 0; k < NUM_PHASES; k++)
+	{
+		t = solver_stats_phase_time(stats, k);
+		ipc = (stats->cycles[k] > 0) ? (double)stats->instructions[k] / (double)stats->cycles[k] : 0.0;
+		gbytes = (t > 0.0) ? (double)stats->llc_misses[k] * CACHE_LINE / t * 1.0E-9 : 0.0;
+		gflops = (k == PHASE_FACTOR && t > 0.0) ? (double)stats->factor_mflops / t * 1.0E-3 : 0.0;
+		fprintf(fp, "%s\"%s\":{\"cycles\":%lld,\"instructions\":%lld,\"llc_misses\":%lld,"
+			"\"ipc\":%.3f,\"gbytes_per_s\":%.6E,\"gflops_per_s\":%.6E}",
+			(k > 0) ? "," : "", thread_phase_name(k), stats->cycles[k], stats->instructions[k], stats->llc_misses[k],
+			ipc, gbytes, gflops);
+	}
+	fprintf(fp, "}");
+
+	return;
+}
+
+// Write solver statistics as a single JSON line.
+//
+// One object per line so that logs can be grepped and streamed into dashboards.
+// Builds with hardware counters add a "perf" object with one entry per phase.
+// A NULL file, e.g. one that could not be opened, writes nothing.
+void solver_stats_json(FILE *fp, const solver_stats *stats)
+{
+	if (fp == NULL)
+		return;
+
+	fprintf(fp, "{\"solver\":\"%s\",\"NrInterior\":%d,\"NzInterior\":%d,\"order\":%d,\"robin\":%d,"
+		"\"nnz\":%d,\"lr_use\":%d,\"precond_use\":%d,",
+		stats->solver, stats->NrInterior, stats->NzInterior, stats->order, stats->robin,
+		stats->nnz, stats->lr_use, stats->precond_use);
+	fprintf(fp, "\"t_reduce\":%.6E,\"t_assemble\":%.6E,\"t_analyse\":%.6E,\"t_factor\":%.6E,"
+		"\"t_solve\":%.6E,\"t_residual\":%.6E,\"t_fill\":%.6E,\"t_coarse\":%.6E,\"t_total\":%.6E,",
+		stats->t_reduce, stats->t_assemble, stats->t_analyse, stats->t_factor,
+		stats->t_solve, stats->t_residual, stats->t_fill, stats->t_coarse, stats->t_total);
+	fprintf(fp, "\"factor_nnz\":%d,\"factor_mflops\":%d,\"mem_peak_analysis_kb\":%d,\"mem_permanent_kb\":%d,"
+		"\"mem_factor_kb\":%d,\"mem_peak_kb\":%d,\"perturbed_pivots\":%d,\"cgs_iterations\":%d,\"refinement_steps\":%d,"
+		"\"corrections\":%d,\"iterations\":%d,",
+		stats->factor_nnz, stats->factor_mflops, stats->mem_peak_analysis, stats->mem_permanent,
+		stats->mem_factor, solver_stats_peak_memory(stats), stats->perturbed_pivots,
+		stats->cgs_iterations, stats->refinement_steps, stats->corrections, stats->iterations);
+	fprintf(fp, "\"abs_residual\":%.6E,\"rel_residual\":%.6E,\"convergence\":%d,\"status\":%d,\"fallback\":%d,"
+		"\"error_estimate\":%.6E",
+		stats->abs_residual, stats->rel_residual, stats->convergence, stats->status, stats->fallback,
+		stats->error_estimate);
+
+	// Hardware counters only when they were counted.
+	int k;
+	long long counted = 0;
+	for (k = 0; k < NUM_PHASES; k++)
+		counted += stats->cycles[k];
+	if (counted > 0)
+		solver_stats_json_perf(fp, stats);
+	fprintf(fp, "}\n");
+
+	return;
+}
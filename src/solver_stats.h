@@ -0,0 +1,8 @@
+// Reset solver statistics.
+void solver_stats_reset(solver_stats *stats);
+
+// Peak PARDISO memory in KB.
+int solver_stats_peak_memory(const solver_stats *stats);
+
+// Write solver statistics as a single JSON line: nothing if fp is NULL.
+void solver_stats_json(FILE *fp, const solver_stats *stats);
@@ -0,0 +1,759 @@
+// Global header.
+// One-based indexing BASE is defined in this header.
+#include "tools.h"
+#include "grid_map.h"
+
+// Print CSR matrix for debug.
+#undef DEBUG
+
+// Table-driven discretization on the reduced (NrInterior + 2) x (NzInterior + 2) grid.
+//
+// Every row is assembled from one-dimensional finite difference weights:
+// - Interior points use centered weights on u(i - p) ... u(i + p), p = order / 2.
+//   Points below the axis or the equator are folded back with the symmetry,
+//   u(-m) = sym * u(m + 1), since the grid is cell-centered.
+// - Interior points whose centered stencil would pass the Robin boundary use
+//   weights shifted to end at the boundary: 2p + 2 points for the second
+//   derivative and 2p + 1 for the first.
+// - The mixed derivative uses the diagonal points u(i +- m, j +- m), m <= p,
+//   combined to cancel the lower order errors, or the product of the first
+//   derivative weights where either stencil is shifted.
+// - Robin rows use one-sided weights of derivative k on k + order points.
+//   Robin type 0 is a Dirichlet condition with the boundary values of ell_f,
+//   used by the inner patches of mesh refinement.
+// - Axis and equator rows impose the symmetry on their ghost point.
+// - The compact fourth order scheme (order -4, flat Laplacian) keeps the 3x3
+//   stencil and moves the leading truncation error to the RHS, see
+//   stencil_compact. Its Robin rows are fourth order.
+// - On stretched grids (grid_map.h) the grid is uniform in the map
+//   coordinates: interior coefficients and Robin derivatives are transformed
+//   with the map Jacobians. The compact scheme assumes a uniform grid.
+//
+// Rows are accumulated, merged and sorted by column, so the nonzero layout
+// comes from the tables instead of offset arithmetic.
+
+// Maximum one-dimensional stencil width and row length.
+#define STENCIL_WIDTH 9
+#define STENCIL_MAX (STENCIL_WIDTH * STENCIL_WIDTH)
+
+// Centered weights of u(i - p) ... u(i + p): [order / 2 - 1][derivative - 1].
+static const double stencil_centered[3][2][STENCIL_WIDTH] =
+{
+	// Second order.
+	{
+		{ -1.0 / 2.0, 0.0, 1.0 / 2.0 },
+		{ 1.0, -2.0, 1.0 }
+	},
+	// Fourth order.
+	{
+		{ 1.0 / 12.0, -2.0 / 3.0, 0.0, 2.0 / 3.0, -1.0 / 12.0 },
+		{ -1.0 / 12.0, 4.0 / 3.0, -5.0 / 2.0, 4.0 / 3.0, -1.0 / 12.0 }
+	},
+	// Sixth order.
+	{
+		{ -1.0 / 60.0, 3.0 / 20.0, -3.0 / 4.0, 0.0, 3.0 / 4.0, -3.0 / 20.0, 1.0 / 60.0 },
+		{ 1.0 / 90.0, -3.0 / 20.0, 3.0 / 2.0, -49.0 / 18.0, 3.0 / 2.0, -3.0 / 20.0, 1.0 / 90.0 }
+	}
+};
+
+// Shifted weights of u(N - 2p) ... u(N + 1) at i = N - row:
+// [order / 2 - 1][row][derivative - 1]. Second order never needs them.
+static const double stencil_shifted[3][2][2][STENCIL_WIDTH] =
+{
+	// Second order.
+	{
+		{ { 0.0 }, { 0.0 } },
+		{ { 0.0 }, { 0.0 } }
+	},
+	// Fourth order.
+	{
+		{
+			{ 0.0, -1.0 / 12.0, 1.0 / 2.0, -3.0 / 2.0, 5.0 / 6.0, 1.0 / 4.0 },
+			{ 1.0 / 12.0, -1.0 / 2.0, 7.0 / 6.0, -1.0 / 3.0, -5.0 / 4.0, 5.0 / 6.0 }
+		},
+		{ { 0.0 }, { 0.0 } }
+	},
+	// Sixth order.
+	{
+		{
+			{ 0.0, -1.0 / 30.0, 1.0 / 4.0, -5.0 / 6.0, 5.0 / 3.0, -5.0 / 2.0, 77.0 / 60.0, 1.0 / 6.0 },
+			{ 11.0 / 180.0, -1.0 / 2.0, 9.0 / 5.0, -67.0 / 18.0, 19.0 / 4.0, -27.0 / 10.0, -7.0 / 18.0, 7.0 / 10.0 }
+		},
+		{
+			{ 0.0, 1.0 / 60.0, -2.0 / 15.0, 1.0 / 2.0, -4.0 / 3.0, 7.0 / 12.0, 2.0 / 5.0, -1.0 / 30.0 },
+			{ -1.0 / 90.0, 4.0 / 45.0, -3.0 / 10.0, 17.0 / 36.0, 13.0 / 18.0, -21.0 / 10.0, 107.0 / 90.0, -11.0 / 180.0 }
+		}
+	}
+};
+
+// One-sided weights of derivative k at the boundary point, farthest point
+// first: [order / 2 - 1][k - 1], k + order points.
+static const double stencil_robin[3][3][STENCIL_WIDTH] =
+{
+	// Second order.
+	{
+		{ 1.0 / 2.0, -2.0, 3.0 / 2.0 },
+		{ -1.0, 4.0, -5.0, 2.0 },
+		{ 3.0 / 2.0, -7.0, 12.0, -9.0, 5.0 / 2.0 }
+	},
+	// Fourth order.
+	{
+		{ 1.0 / 4.0, -4.0 / 3.0, 3.0, -4.0, 25.0 / 12.0 },
+		{ -5.0 / 6.0, 61.0 / 12.0, -13.0, 107.0 / 6.0, -77.0 / 6.0, 15.0 / 4.0 },
+		{ 15.0 / 8.0, -13.0, 307.0 / 8.0, -62.0, 461.0 / 8.0, -29.0, 49.0 / 8.0 }
+	},
+	// Sixth order.
+	{
+		{ 1.0 / 6.0, -6.0 / 5.0, 15.0 / 4.0, -20.0 / 3.0, 15.0 / 2.0, -6.0, 49.0 / 20.0 },
+		{ -7.0 / 10.0, 1019.0 / 180.0, -201.0 / 10.0, 41.0, -949.0 / 18.0, 879.0 / 20.0, -223.0 / 10.0, 469.0 / 90.0 },
+		{ 469.0 / 240.0, -527.0 / 30.0, 561.0 / 8.0, -4891.0 / 30.0, 1457.0 / 6.0, -2391.0 / 10.0, 18353.0 / 120.0, -349.0 / 6.0, 801.0 / 80.0 }
+	}
+};
+
+// Diagonal weights of the mixed derivative for m = 1 ... p, applied as
+// w_m * (u(i + m, j + m) - u(i + m, j - m) - u(i - m, j + m) + u(i - m, j - m)).
+static const double stencil_diagonal[3][3] =
+{
+	{ 1.0 / 4.0 },
+	{ 1.0 / 3.0, -1.0 / 48.0 },
+	{ 3.0 / 8.0, -3.0 / 80.0, 1.0 / 360.0 }
+};
+
+// Physical coordinates and their derivatives per grid line, tabulated
+// before the parallel loops. NULL means a uniform grid.
+typedef struct stencil_maps
+{
+	double *r[4];
+	double *z[4];
+} stencil_map;
+
+// Row under construction: merged columns and values.
+typedef struct stencil_rows
+{
+	int n;
+	int col[STENCIL_MAX];
+	double val[STENCIL_MAX];
+} stencil_row;
+
+// Add value to column, merging repeated columns.
+static void stencil_add(stencil_row *row, const int col, const double val)
+{
+	int k;
+
+	for (k = 0; k < row->n; k++)
+	{
+		if (row->col[k] == col)
+		{
+			row->val[k] += val;
+			return;
+		}
+	}
+	row->col[row->n] = col;
+	row->val[row->n] = val;
+	row->n++;
+
+	return;
+}
+
+// Sort row by column.
+static void stencil_sort(stencil_row *row)
+{
+	int k, l, col;
+	double val;
+
+	for (k = 1; k < row->n; k++)
+	{
+		col = row->col[k];
+		val = row->val[k];
+		for (l = k - 1; l >= 0 && row->col[l] > col; l--)
+		{
+			row->col[l + 1] = row->col[l];
+			row->val[l + 1] = row->val[l];
+		}
+		row->col[l + 1] = col;
+		row->val[l + 1] = val;
+	}
+
+	return;
+}
+
+// One-dimensional weights at interior point i of N: returns the first point,
+// which may lie below the axis, and sets the derivative weights.
+static int stencil_weights(const int p, const int i, const int N, const double **w1, const double **w2)
+{
+	int row = N - i;
+
+	if (i + p <= N + 1)
+	{
+		*w1 = stencil_centered[p - 1][0];
+		*w2 = stencil_centered[p - 1][1];
+		return i - p;
+	}
+
+	*w1 = stencil_shifted[p - 1][row][0];
+	*w2 = stencil_shifted[p - 1][row][1];
+	return N - 2 * p;
+}
+
+// Fold point below the axis back into the grid: returns the symmetry factor.
+static double stencil_fold(int *m, const int sym)
+{
+	if (*m < 0)
+	{
+		*m = 1 - *m;
+		return (double)sym;
+	}
+	return 1.0;
+}
+
+// Interior row with rescaled coefficients: a and c multiply second
+// derivatives, b the mixed one, d and e first derivatives and s the point.
+static void stencil_interior(stencil_row *row, const int i, const int j, const int NrInterior, const int NzInterior,
+	const int p, const int mixed, const int r_sym, const int z_sym,
+	const double a, const double b, const double c, const double d, const double e, const double s)
+{
+	int NzTotal = NzInterior + 2;
+	const double *r1, *r2, *z1, *z2;
+	int r0 = stencil_weights(p, i, NrInterior, &r1, &r2);
+	int z0 = stencil_weights(p, j, NzInterior, &z1, &z2);
+	int k, l, m, n;
+	double sign;
+
+	// Radial derivatives.
+	for (k = 0; k < STENCIL_WIDTH; k++)
+	{
+		if (r1[k] != 0.0 || r2[k] != 0.0)
+		{
+			m = r0 + k;
+			sign = stencil_fold(&m, r_sym);
+			stencil_add(row, IDX(m, j), sign * (a * r2[k] + d * r1[k]));
+		}
+	}
+
+	// Axial derivatives.
+	for (l = 0; l < STENCIL_WIDTH; l++)
+	{
+		if (z1[l] != 0.0 || z2[l] != 0.0)
+		{
+			n = z0 + l;
+			sign = stencil_fold(&n, z_sym);
+			stencil_add(row, IDX(i, n), sign * (c * z2[l] + e * z1[l]));
+		}
+	}
+
+	// Linear source.
+	stencil_add(row, IDX(i, j), s);
+
+	// Mixed derivative: diagonal points if both stencils are centered.
+	if (mixed && r0 == i - p && z0 == j - p)
+	{
+		for (k = 1; k <= p; k++)
+		{
+			for (l = 0; l < 4; l++)
+			{
+				m = (l < 2) ? i + k : i - k;
+				n = (l % 2) ? j - k : j + k;
+				sign = stencil_fold(&m, r_sym) * stencil_fold(&n, z_sym);
+				stencil_add(row, IDX(m, n), ((l == 1 || l == 2) ? -sign : sign) * b * stencil_diagonal[p - 1][k - 1]);
+			}
+		}
+	}
+	else if (mixed)
+	{
+		for (k = 0; k < STENCIL_WIDTH; k++)
+		{
+			for (l = 0; l < STENCIL_WIDTH; l++)
+			{
+				if (r1[k] != 0.0 && z1[l] != 0.0)
+				{
+					m = r0 + k;
+					n = z0 + l;
+					sign = stencil_fold(&m, r_sym) * stencil_fold(&n, z_sym);
+					stencil_add(row, IDX(m, n), sign * b * r1[k] * z1[l]);
+				}
+			}
+		}
+	}
+
+	return;
+}
+
+// Grid function g at (m, n): points on or below the axis or the equator are
+// folded back with the symmetry.
+static double stencil_data(const double *g, int m, int n, const int NzInterior, const int r_sym, const int z_sym)
+{
+	int NzTotal = NzInterior + 2;
+	double sign = 1.0;
+
+	if (m <= 0)
+	{
+		m = 1 - m;
+		sign *= (double)r_sym;
+	}
+	if (n <= 0)
+	{
+		n = 1 - n;
+		sign *= (double)z_sym;
+	}
+
+	return sign * g[IDX(m, n)];
+}
+
+// Second order first and second differences of g at interior point (i, j)
+// along (di, dj), per grid step. The last interior point uses one-sided
+// differences: boundary values of the data are not trusted.
+static void stencil_data_derivatives(const double *g, const int i, const int j, const int di, const int dj,
+	const int last, const int NzInterior, const int r_sym, const int z_sym, double *g1, double *g2)
+{
+	double g0 = stencil_data(g, i, j, NzInterior, r_sym, z_sym);
+	double gm1 = stencil_data(g, i - di, j - dj, NzInterior, r_sym, z_sym);
+	double gm2, gm3, gp1;
+
+	if ((di ? i : j) < last)
+	{
+		gp1 = stencil_data(g, i + di, j + dj, NzInterior, r_sym, z_sym);
+		*g1 = 0.5 * (gp1 - gm1);
+		*g2 = gp1 - 2.0 * g0 + gm1;
+	}
+	else
+	{
+		gm2 = stencil_data(g, i - 2 * di, j - 2 * dj, NzInterior, r_sym, z_sym);
+		gm3 = stencil_data(g, i - 3 * di, j - 3 * dj, NzInterior, r_sym, z_sym);
+		*g1 = 0.5 * (3.0 * g0 - 4.0 * gm1 + gm2);
+		*g2 = 2.0 * g0 - 5.0 * gm1 + 4.0 * gm2 - gm3;
+	}
+
+	return;
+}
+
+// Compact fourth order row of u_rr + u_r / r + u_zz + s u = f.
+//
+// Central differences have truncation error
+//	dr^2 / 12 * (u_rrrr + 2 u_rrr / r) + dz^2 / 12 * u_zzzz.
+// Differentiating the equation expresses u_rrr, u_rrrr and u_zzzz through
+// derivatives that the 3x3 stencil resolves to second order, u_rzz and
+// u_rrzz among them, plus derivatives of s and f. Those of u correct the
+// stencil, those of f correct the RHS:
+//	f + dr^2 / 12 * (f_rr + f_r / r) + dz^2 / 12 * f_zz.
+// s is assumed even in r and z, f has the symmetry of u. Near the axis
+// dr / r is not small and the truncation error grows as dr^4 / r^2, which
+// costs a logarithm in the global error.
+static void stencil_compact(stencil_row *row, double *rhs, const int i, const int j,
+	const int NrInterior, const int NzInterior, const double dr, const double dz,
+	const double *ell_s, const double *ell_f, const int r_sym, const int z_sym)
+{
+	int NzTotal = NzInterior + 2;
+	double r = ((double)i - 0.5) * dr;
+	double dr2 = dr * dr;
+	double dz2 = dz * dz;
+	double w1[3] = { -0.5, 0.0, 0.5 };
+	double w2[3] = { 1.0, -2.0, 1.0 };
+	double s = 0.0, s_r = 0.0, s_rr = 0.0, s_z = 0.0, s_zz = 0.0;
+	double f = 0.0, f_r = 0.0, f_rr = 0.0, f_z = 0.0, f_zz = 0.0;
+	double alpha, beta, gamma, epsilon, sigma, mu, nu, w;
+	int k, l;
+
+	// Data derivatives.
+	if (ell_s)
+	{
+		s = ell_s[IDX(i, j)];
+		stencil_data_derivatives(ell_s, i, j, 1, 0, NrInterior, NzInterior, 1, 1, &s_r, &s_rr);
+		stencil_data_derivatives(ell_s, i, j, 0, 1, NzInterior, NzInterior, 1, 1, &s_z, &s_zz);
+		s_r /= dr;
+		s_rr /= dr2;
+		s_z /= dz;
+		s_zz /= dz2;
+	}
+	if (ell_f)
+	{
+		f = ell_f[IDX(i, j)];
+		stencil_data_derivatives(ell_f, i, j, 1, 0, NrInterior, NzInterior, r_sym, z_sym, &f_r, &f_rr);
+		stencil_data_derivatives(ell_f, i, j, 0, 1, NzInterior, NzInterior, r_sym, z_sym, &f_z, &f_zz);
+		f_r /= dr;
+		f_rr /= dr2;
+		f_zz /= dz2;
+	}
+
+	// Coefficients of u_rr, u_zz, u_r, u_z, u, u_rzz and u_rrzz.
+	alpha = 1.0 + dr2 * (s - 1.0 / (r * r)) / 12.0;
+	beta = 1.0 + dz2 * s / 12.0;
+	gamma = 1.0 / r + dr2 * (1.0 / (r * r * r) + s / r + 2.0 * s_r) / 12.0;
+	epsilon = dz2 * s_z / 6.0;
+	sigma = s + dr2 * (s_rr + s_r / r) / 12.0 + dz2 * s_zz / 12.0;
+	mu = (dr2 + dz2) / (12.0 * r);
+	nu = (dr2 + dz2) / 12.0;
+
+	// 3x3 stencil: notice the dr * dz rescaling.
+	for (k = 0; k < 3; k++)
+	{
+		for (l = 0; l < 3; l++)
+		{
+			w = mu * w1[k] * w2[l] / (dr * dz2) + nu * w2[k] * w2[l] / (dr2 * dz2);
+			if (l == 1)
+				w += alpha * w2[k] / dr2 + gamma * w1[k] / dr;
+			if (k == 1)
+				w += beta * w2[l] / dz2 + epsilon * w1[l] / dz;
+			if (k == 1 && l == 1)
+				w += sigma;
+			stencil_add(row, IDX(i + k - 1, j + l - 1), dr * dz * w);
+		}
+	}
+
+	*rhs = dr * dz * (f + dr2 * (f_rr + f_r / r) / 12.0 + dz2 * f_zz / 12.0);
+
+	return;
+}
+
+// Robin row: u + sum_k robin_k / k! * (d^k u / dx^k) = uInf along the line
+// ending at (i, j) with steps (di, dj).
+//
+// The coefficients are those of the hand-written generators in physical
+// units: x is the distance factor and t the squared tangent ratio (0 on the
+// diagonal). j1, j2 and j3 are the derivatives of the physical coordinate
+// per grid step, which turn physical derivatives into grid derivatives:
+//	u_x = D1 / j1,
+//	u_xx = D2 / j1^2 - j2 D1 / j1^3,
+//	u_xxx = D3 / j1^3 - 3 j2 D2 / j1^4 + (3 j2^2 / j1^5 - j3 / j1^4) D1.
+static void stencil_robin_row(stencil_row *row, const int i, const int j, const int di, const int dj,
+	const int NzInterior, const int p, const int robin, const double x, const double t,
+	const double j1, const double j2, const double j3)
+{
+	int NzTotal = NzInterior + 2;
+	double phys[3] = { 0.0, 0.0, 0.0 };
+	double coef[3];
+	int k, m, npoints;
+
+	switch (robin)
+	{
+		case 1:
+			phys[0] = x;
+			break;
+		case 2:
+			phys[1] = 0.5 * x * x;
+			phys[0] = 0.5 * x * (4.0 - t);
+			break;
+		case 3:
+			phys[2] = x * x * x / 6.0;
+			phys[1] = x * x * (9.0 - 3.0 * t) / 6.0;
+			phys[0] = x * (18.0 + t * (-9.0 + 3.0 * (1.0 + t))) / 6.0;
+			break;
+	}
+
+	// Grid derivatives.
+	coef[0] = phys[0] / j1 - phys[1] * j2 / (j1 * j1 * j1)
+		+ phys[2] * (3.0 * j2 * j2 / (j1 * j1 * j1 * j1 * j1) - j3 / (j1 * j1 * j1 * j1));
+	coef[1] = phys[1] / (j1 * j1) - 3.0 * phys[2] * j2 / (j1 * j1 * j1 * j1);
+	coef[2] = phys[2] / (j1 * j1 * j1);
+
+	stencil_add(row, IDX(i, j), 1.0);
+	for (k = 0; k < robin; k++)
+	{
+		npoints = k + 1 + 2 * p;
+		for (m = 0; m < npoints; m++)
+		{
+			stencil_add(row, IDX(i - di * (npoints - 1 - m), j - dj * (npoints - 1 - m)),
+				coef[k] * stencil_robin[p - 1][k][m]);
+		}
+	}
+
+	return;
+}
+
+// Symmetry row: u(i, j) - sym * u(m, n) = 0.
+static void stencil_symmetry_row(stencil_row *row, const int i, const int j, const int m, const int n,
+	const int NzInterior, const double sym)
+{
+	int NzTotal = NzInterior + 2;
+
+	stencil_add(row, IDX(i, j), 1.0);
+	stencil_add(row, IDX(m, n), -sym);
+
+	return;
+}
+
+// Build row (i, j) and its RHS. Coefficients ell_a to ell_e are NULL for the
+// flat Laplacian, ell_s and ell_f are NULL when only the pattern is needed.
+// Order -4 selects the compact fourth order scheme.
+static void stencil_build(stencil_row *row, double *rhs, const int i, const int j,
+	const int NrInterior, const int NzInterior, const int order, const double dr, const double dz,
+	const double *ell_a, const double *ell_b, const double *ell_c, const double *ell_d, const double *ell_e,
+	const double *ell_s, const double *ell_f, const double uInf, const int robin, const int mixed,
+	const int r_sym, const int z_sym, const stencil_map *map)
+{
+	int NzTotal = NzInterior + 2;
+	int compact = (order < 0);
+	int p = compact ? -order / 2 : order / 2;
+	double roz = dr / dz;
+	double zor = dz / dr;
+	// Physical coordinates and their derivatives.
+	double r = map ? map->r[0][i] : ((double)i - 0.5) * dr;
+	double r1 = map ? map->r[1][i] : 1.0;
+	double r2 = map ? map->r[2][i] : 0.0;
+	double r3 = map ? map->r[3][i] : 0.0;
+	double z = map ? map->z[0][j] : ((double)j - 0.5) * dz;
+	double z1 = map ? map->z[1][j] : 1.0;
+	double z2 = map ? map->z[2][j] : 0.0;
+	double z3 = map ? map->z[3][j] : 0.0;
+	double rr2, a, b, c, d, e, s;
+
+	row->n = 0;
+	*rhs = 0.0;
+
+	// Axis, equator and their corners.
+	if (i == 0)
+	{
+		if (j == 0)
+			stencil_symmetry_row(row, 0, 0, 1, 1, NzInterior, (double)(r_sym * z_sym));
+		else
+			stencil_symmetry_row(row, 0, j, 1, j, NzInterior, (double)r_sym);
+	}
+	else if (j == 0)
+	{
+		stencil_symmetry_row(row, i, 0, i, 1, NzInterior, (double)z_sym);
+	}
+	// Upper-right corner: Robin along the diagonal.
+	else if (i == NrInterior + 1 && j == NzInterior + 1)
+	{
+		// The diagonal is taken as radial, as in the hand-written generators.
+		stencil_robin_row(row, i, j, 1, 1, NzInterior, p, robin,
+			sqrt((r * r + z * z) / (r1 * r1 * dr * dr + z1 * z1 * dz * dz)), 0.0, 1.0, 0.0, 0.0);
+		*rhs = robin ? uInf : (ell_f ? ell_f[IDX(i, j)] : 0.0);
+	}
+	// Right boundary: Robin along r.
+	else if (i == NrInterior + 1)
+	{
+		rr2 = r * r + z * z;
+		stencil_robin_row(row, i, j, 1, 0, NzInterior, p, robin, rr2 / r, (z / r) * (z / r),
+			r1 * dr, r2 * dr * dr, r3 * dr * dr * dr);
+		*rhs = robin ? uInf : (ell_f ? ell_f[IDX(i, j)] : 0.0);
+	}
+	// Top boundary: Robin along z.
+	else if (j == NzInterior + 1)
+	{
+		rr2 = r * r + z * z;
+		stencil_robin_row(row, i, j, 0, 1, NzInterior, p, robin, rr2 / z, (r / z) * (r / z),
+			z1 * dz, z2 * dz * dz, z3 * dz * dz * dz);
+		*rhs = robin ? uInf : (ell_f ? ell_f[IDX(i, j)] : 0.0);
+	}
+	// Compact interior.
+	else if (compact)
+	{
+		stencil_compact(row, rhs, i, j, NrInterior, NzInterior, dr, dz, ell_s, ell_f, r_sym, z_sym);
+	}
+	// Interior: notice the dr * dz rescaling.
+	else
+	{
+		if (ell_a)
+		{
+			a = ell_a[IDX(i, j)];
+			b = ell_b[IDX(i, j)];
+			c = ell_c[IDX(i, j)];
+			d = ell_d[IDX(i, j)];
+			e = ell_e[IDX(i, j)];
+		}
+		else
+		{
+			a = 1.0;
+			b = 0.0;
+			c = 1.0;
+			d = 1.0 / r;
+			e = 0.0;
+		}
+		// Map coordinates: first derivatives pick up the map curvature.
+		d = d / r1 - a * r2 / (r1 * r1 * r1);
+		e = e / z1 - c * z2 / (z1 * z1 * z1);
+		a = a * zor / (r1 * r1);
+		b = b / (r1 * z1);
+		c = c * roz / (z1 * z1);
+		d = dz * d;
+		e = dr * e;
+		s = ell_s ? dr * dz * ell_s[IDX(i, j)] : 0.0;
+		stencil_interior(row, i, j, NrInterior, NzInterior, p, mixed, r_sym, z_sym, a, b, c, d, e, s);
+		*rhs = ell_f ? dr * dz * ell_f[IDX(i, j)] : 0.0;
+	}
+
+	stencil_sort(row);
+
+	return;
+}
+
+// Nonzero calculator of the r-strip i_begin <= i < i_end.
+int nnz_stencil_rows(const int NrInterior, const int NzInterior, const int order, const int robin, const int mixed,
+	const int i_begin, const int i_end)
+{
+	int i, j;
+	int nnz = 0;
+	double rhs;
+
+	#pragma omp parallel private(j, rhs) reduction(+:nnz)
+	{
+		stencil_row row;
+		#pragma omp for schedule(static)
+		for (i = i_begin; i < i_end; i++)
+		{
+			for (j = 0; j < NzInterior + 2; j++)
+			{
+				stencil_build(&row, &rhs, i, j, NrInterior, NzInterior, order, 1.0, 1.0,
+					NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0.0, robin, mixed, 1, 1, NULL);
+				nnz += row.n;
+			}
+		}
+	}
+
+	return nnz;
+}
+
+// Nonzero calculator.
+int nnz_stencil(const int NrInterior, const int NzInterior, const int order, const int robin, const int mixed)
+{
+	return nnz_stencil_rows(NrInterior, NzInterior, order, robin, mixed, 0, NrInterior + 2);
+}
+
+// Write the rows of the r-strip i_begin <= i < i_end: row offsets are local
+// to the strip while columns keep the global numbering. Only the strip rows
+// of ell_f are overwritten.
+//
+// Row lengths are counted first and their prefix sum gives the row offsets,
+// then rows are built again and written in parallel.
+void csr_gen_stencil_rows(csr_matrix A,	// CSR matrix structure.
+	const int i_begin,		// First r row of the strip.
+	const int i_end,		// One past the last r row of the strip.
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const int order,		// Finite difference order: 2, 4, 6 or -4 (compact).
+	const double dr,		// Spatial step in r.
+	const double dz,		// Spatial step in z.
+	const double *ell_a,		// Coefficient of (d^2/dr^2)
+	const double *ell_b,		// Coefficient of (d^2/drdz)
+	const double *ell_c,		// Coefficient of (d^2/dz^)
+	const double *ell_d,		// Coefficient of (d/dr)
+	const double *ell_e,		// Coefficient of (d/dz)
+	const double *ell_s,		// Linear source.
+	double *ell_f,			// RHS.
+	const double uInf,		// Value at infinity.
+	const int robin,		// Robin BC type: 1, 2, 3.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym)		// Z symmetry: 1(even), -1(odd).
+{
+	// Grid extensions.
+	int NrTotal = NrInterior + 2;
+	int NzTotal = NzInterior + 2;
+
+	// Mixed derivative pattern for the general elliptic equation.
+	int mixed = (ell_a != NULL);
+
+	// Auxiliary variables.
+	int i, j, k, offset;
+	double rhs;
+
+	// The compact RHS reads neighbouring values of f, so it reads a copy
+	// while ell_f is overwritten.
+	double *f0 = ell_f;
+	if (order < 0)
+	{
+		f0 = (double *)malloc(NrTotal * NzTotal * sizeof(double));
+		memcpy(f0, ell_f, NrTotal * NzTotal * sizeof(double));
+	}
+
+	// Stretched grid: tabulate the map on every grid line.
+	stencil_map map;
+	stencil_map *pmap = NULL;
+	if (grid_map_active())
+	{
+		for (k = 0; k < 4; k++)
+		{
+			map.r[k] = (double *)malloc(NrTotal * sizeof(double));
+			map.z[k] = (double *)malloc(NzTotal * sizeof(double));
+		}
+		grid_map_line(GRID_MAP_R, NrInterior, dr, map.r[0], map.r[1], map.r[2], map.r[3]);
+		grid_map_line(GRID_MAP_Z, NzInterior, dz, map.z[0], map.z[1], map.z[2], map.z[3]);
+		pmap = &map;
+	}
+
+	// Row lengths.
+	#pragma omp parallel shared(A) private(j, rhs)
+	{
+		stencil_row row;
+		#pragma omp for schedule(static)
+		for (i = i_begin; i < i_end; i++)
+		{
+			for (j = 0; j < NzTotal; j++)
+			{
+				stencil_build(&row, &rhs, i, j, NrInterior, NzInterior, order, dr, dz,
+					NULL, NULL, NULL, NULL, NULL, NULL, NULL, uInf, robin, mixed, r_sym, z_sym, NULL);
+				A.ia[IDX(i - i_begin, j) + 1] = row.n;
+			}
+		}
+	}
+
+	// Row offsets.
+	A.ia[0] = BASE;
+	for (k = 0; k < (i_end - i_begin) * NzTotal; k++)
+		A.ia[k + 1] += A.ia[k];
+
+	// Fill rows: the RHS is overwritten in place, so it is written after
+	// the row has been built.
+	#pragma omp parallel shared(A, ell_f, f0, pmap) private(j, k, offset, rhs)
+	{
+		stencil_row row;
+		#pragma omp for schedule(static)
+		for (i = i_begin; i < i_end; i++)
+		{
+			for (j = 0; j < NzTotal; j++)
+			{
+				stencil_build(&row, &rhs, i, j, NrInterior, NzInterior, order, dr, dz,
+					ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, f0, uInf, robin, mixed, r_sym, z_sym, pmap);
+				offset = A.ia[IDX(i - i_begin, j)] - BASE;
+				for (k = 0; k < row.n; k++)
+				{
+					A.a[offset + k] = row.val[k];
+					A.ja[offset + k] = BASE + row.col[k];
+				}
+				ell_f[IDX(i, j)] = rhs;
+			}
+		}
+	}
+
+	if (f0 != ell_f)
+		free(f0);
+	if (pmap)
+	{
+		for (k = 0; k < 4; k++)
+		{
+			free(map.r[k]);
+			free(map.z[k]);
+		}
+	}
+
+	// All done.
+	return;
+}
+
+// Write CSR matrix from finite difference weight tables.
+void csr_gen_stencil(csr_matrix A,	// CSR matrix structure.
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const int order,		// Finite difference order: 2, 4, 6 or -4 (compact).
+	const double dr,		// Spatial step in r.
+	const double dz,		// Spatial step in z.
+	const double *ell_a,		// Coefficient of (d^2/dr^2)
+	const double *ell_b,		// Coefficient of (d^2/drdz)
+	const double *ell_c,		// Coefficient of (d^2/dz^)
+	const double *ell_d,		// Coefficient of (d/dr)
+	const double *ell_e,		// Coefficient of (d/dz)
+	const double *ell_s,		// Linear source.
+	double *ell_f,			// RHS.
+	const double uInf,		// Value at infinity.
+	const int robin,		// Robin BC type: 1, 2, 3.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym)		// Z symmetry: 1(even), -1(odd).
+{
+	csr_gen_stencil_rows(A, 0, NrInterior + 2, NrInterior, NzInterior, order, dr, dz,
+		ell_a, ell_b, ell_c, ell_d, ell_e, ell_s, ell_f, uInf, robin, r_sym, z_sym);
+
+#ifdef DEBUG
+	csr_print(A, "st_A_a.asc", "st_A_ia.asc", "st_A_ja.asc");
+#endif
+	// All done.
+	return;
+}
@@ -0,0 +1,50 @@
+// Nonzero calculator for the table-driven discretization.
+// Mixed selects the pattern with the mixed derivative term (general elliptic).
+int nnz_stencil(const int NrInterior, const int NzInterior, const int order, const int robin, const int mixed);
+// Nonzero calculator of the r-strip i_begin <= i < i_end of the reduced grid.
+int nnz_stencil_rows(const int NrInterior, const int NzInterior, const int order, const int robin, const int mixed,
+	const int i_begin, const int i_end);
+
+// Write CSR matrix from finite difference weight tables: orders 2, 4 and 6.
+// Coefficients ell_a to ell_e are NULL for the flat Laplacian, which also
+// has the compact fourth order scheme on a 3x3 stencil: order -4.
+void csr_gen_stencil(csr_matrix A,	// CSR matrix structure.
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const int order,		// Finite difference order: 2, 4, 6 or -4 (compact).
+	const double dr,		// Spatial step in r.
+	const double dz,		// Spatial step in z.
+	const double *ell_a,		// Coefficient of (d^2/dr^2)
+	const double *ell_b,		// Coefficient of (d^2/drdz)
+	const double *ell_c,		// Coefficient of (d^2/dz^)
+	const double *ell_d,		// Coefficient of (d/dr)
+	const double *ell_e,		// Coefficient of (d/dz)
+	const double *ell_s,		// Linear source.
+	double *ell_f,			// RHS.
+	const double uInf,		// Value at infinity.
+	const int robin,		// Robin BC type: 1, 2, 3, or 0 for Dirichlet values in ell_f.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym);		// Z symmetry: 1(even), -1(odd).
+
+// Write the rows of the r-strip i_begin <= i < i_end only, for distributed
+// assembly: row offsets are local to the strip, columns keep the global
+// numbering and only the strip rows of ell_f are overwritten.
+void csr_gen_stencil_rows(csr_matrix A,	// CSR matrix structure.
+	const int i_begin,		// First r row of the strip.
+	const int i_end,		// One past the last r row of the strip.
+	const int NrInterior,		// Number of r interior points.
+	const int NzInterior,		// Number of z interior points.
+	const int order,		// Finite difference order: 2, 4, 6 or -4 (compact).
+	const double dr,		// Spatial step in r.
+	const double dz,		// Spatial step in z.
+	const double *ell_a,		// Coefficient of (d^2/dr^2)
+	const double *ell_b,		// Coefficient of (d^2/drdz)
+	const double *ell_c,		// Coefficient of (d^2/dz^)
+	const double *ell_d,		// Coefficient of (d/dr)
+	const double *ell_e,		// Coefficient of (d/dz)
+	const double *ell_s,		// Linear source.
+	double *ell_f,			// RHS.
+	const double uInf,		// Value at infinity.
+	const int robin,		// Robin BC type: 1, 2, 3, or 0 for Dirichlet values in ell_f.
+	const int r_sym,		// R symmetry: 1(even), -1(odd).
+	const int z_sym);		// Z symmetry: 1(even), -1(odd).
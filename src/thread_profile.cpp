@@ -0,0 +1,150 @@
+// Global header.
+#include "tools.h"
+#include "thread_profile.h"
+#include "perf_counters.h"
+
+// MKL threading control.
+#include "mkl_service.h"
+
+// Profile file line length.
+#define PROFILE_LINE 256
+
+// Thread count per phase: 0 means OpenMP/MKL defaults.
+static int phase_threads[NUM_PHASES] = { 0 };
+
+// Thread counts in effect before the current phase.
+static int prev_omp_threads = 0;
+static int prev_mkl_threads = 0;
+static int phase_active = 0;
+
+// Phase names as written in profile files.
+static const char *phase_names[NUM_PHASES] = { "reduce", "assemble", "analyse", "factor", "solve", "residual", "fill" };
+
+// Phase name as written in profile files.
+const char *thread_phase_name(const int phase)
+{
+	return ((phase >= 0) && (phase < NUM_PHASES)) ? phase_names[phase] : "unknown";
+}
+
+// Set thread count of a phase.
+void thread_profile_set(const int phase, const int nthreads)
+{
+	if ((phase >= 0) && (phase < NUM_PHASES))
+	{
+		phase_threads[phase] = (nthreads > 0) ? nthreads : 0;
+	}
+
+	return;
+}
+
+// Get thread count of a phase.
+int thread_profile_get(const int phase)
+{
+	return ((phase >= 0) && (phase < NUM_PHASES)) ? phase_threads[phase] : 0;
+}
+
+// Clear all phase thread counts.
+void thread_profile_clear(void)
+{
+	int k;
+
+	for (k = 0; k < NUM_PHASES; k++)
+		phase_threads[k] = 0;
+
+	return;
+}
+
+// Load profile file.
+//
+// Each non-comment line is "phase nthreads". Unknown phases are ignored so
+// that profiles written by newer versions remain readable.
+int thread_profile_load(const char *fname)
+{
+	char line[PROFILE_LINE];
+	char name[PROFILE_LINE];
+	int nthreads, k;
+
+	FILE *fp = fopen(fname, "r");
+	if (fp == NULL)
+	{
+		printf("THREAD PROFILE: WARNING! Could not open %s, using default thread counts.\n", fname);
+		return 1;
+	}
+
+	while (fgets(line, PROFILE_LINE, fp) != NULL)
+	{
+		// Skip comments and blank lines.
+		if ((line[0] == '#') || (sscanf(line, "%255s %d", name, &nthreads) != 2))
+			continue;
+
+		for (k = 0; k < NUM_PHASES; k++)
+		{
+			if (strcmp(name, phase_names[k]) == 0)
+				thread_profile_set(k, nthreads);
+		}
+	}
+	fclose(fp);
+
+#ifdef VERBOSE
+	printf("THREAD PROFILE: Loaded %s.\n", fname);
+#endif
+
+	return 0;
+}
+
+// Save profile file.
+int thread_profile_save(const char *fname, const int NrInterior, const int NzInterior, const int order)
+{
+	int k;
+
+	FILE *fp = fopen(fname, "w");
+	if (fp == NULL)
+	{
+		printf("THREAD PROFILE: WARNING! Could not write %s.\n", fname);
+		return 1;
+	}
+
+	fprintf(fp, "# Thread profile tuned for NrInterior = %d, NzInterior = %d, order = %d, %d threads available.\n",
+		NrInterior, NzInterior, order, omp_get_num_procs());
+	for (k = 0; k < NUM_PHASES; k++)
+		fprintf(fp, "%s %d\n", phase_names[k], phase_threads[k]);
+	fclose(fp);
+
+	return 0;
+}
+
+// Apply thread count of a phase before it starts.
+//
+// OpenMP loops use omp_set_num_threads and PARDISO/Sparse BLAS use the
+// thread-local MKL count. Phases do not nest. Hardware counters of the
+// phase start after the thread counts are set.
+void thread_phase_begin(const int phase)
+{
+	int nthreads = thread_profile_get(phase);
+
+	phase_active = 0;
+	if (nthreads > 0)
+	{
+		prev_omp_threads = omp_get_max_threads();
+		omp_set_num_threads(nthreads);
+		prev_mkl_threads = mkl_set_num_threads_local(nthreads);
+		phase_active = 1;
+	}
+	perf_phase_begin(phase);
+
+	return;
+}
+
+// Restore previous thread counts after a phase ends.
+void thread_phase_end(void)
+{
+	perf_phase_end();
+	if (phase_active)
+	{
+		omp_set_num_threads(prev_omp_threads);
+		mkl_set_num_threads_local(prev_mkl_threads);
+		phase_active = 0;
+	}
+
+	return;
+}
@@ -0,0 +1,33 @@
+// Solver phases with independent thread counts.
+#define PHASE_REDUCE 0
+#define PHASE_ASSEMBLE 1
+#define PHASE_ANALYSE 2
+#define PHASE_FACTOR 3
+#define PHASE_SOLVE 4
+#define PHASE_RESIDUAL 5
+#define PHASE_FILL 6
+#define NUM_PHASES 7
+
+// Phase name as written in profile files.
+const char *thread_phase_name(const int phase);
+
+// Set thread count of a phase: 0 leaves the OpenMP/MKL defaults untouched.
+void thread_profile_set(const int phase, const int nthreads);
+
+// Get thread count of a phase.
+int thread_profile_get(const int phase);
+
+// Clear all phase thread counts.
+void thread_profile_clear(void);
+
+// Load profile file: returns 0 on success.
+int thread_profile_load(const char *fname);
+
+// Save profile file: returns 0 on success.
+int thread_profile_save(const char *fname, const int NrInterior, const int NzInterior, const int order);
+
+// Apply thread count of a phase before it starts.
+void thread_phase_begin(const int phase);
+
+// Restore previous thread counts after a phase ends.
+void thread_phase_end(void);
@@ -10,6 +10,11 @@
 // System headers.
 #include <sys/types.h>
 #include <sys/stat.h>
+
+// NUMA memory policy.
+#ifdef NUMA
+#include <numa.h>
+#endif
 #include <unistd.h>
 
 // CSR matrix index base.
@@ -64,7 +69,8 @@ extern "C" void print_help_(void)
 	printf("ELLSOLVEF: WARNING! Usage is  $./ELLSOLVEF dirname solver norder NrInterior NzInterior dr dz nrobin\n");
 	printf("           [solver] is the type of solver: flat or general.\n");
 	printf("           [dirname] is a valid directory string name.\n");
-	printf("           [norder] is an integer equal to 2 or 4 corresponding to the finite difference order.\n");
+	printf("           [norder] is an integer equal to 2, 4 or 6 corresponding to the finite difference order,\n");
+	printf("           or -4 for the compact fourth order flat Laplacian.\n");
 	printf("           [NrInterior] and [NzInterior] are integers equal to the number of interior points in r, z.\n");
 	printf("           [dr] and [dz] are floating point doubles equal to the spatial step in r, z.\n");
 	printf("           [nrobin] is an optional argument corresponding to Robin operator order: 1, 2, 3.\n");
@@ -89,13 +95,15 @@ void print_help(void)
 	// User input char.
 	char opt;
 
-	printf("ELLSOLVEC: WARNING! Usage is  $./ELLSOLVEC dirname solver norder NrInterior NzInterior dr dz nrobin\n");
+	printf("ELLSOLVEC: WARNING! Usage is  $./ELLSOLVEC dirname solver norder NrInterior NzInterior dr dz nrobin stretch\n");
 	printf("           [solver] is the type of solver: flat or general.\n");
 	printf("           [dirname] is a valid directory string name.\n");
-	printf("           [norder] is an integer equal to 2 or 4 corresponding to the finite difference order.\n");
+	printf("           [norder] is an integer equal to 2, 4 or 6 corresponding to the finite difference order,\n");
+	printf("           or -4 for the compact fourth order flat Laplacian.\n");
 	printf("           [NrInterior] and [NzInterior] are integers equal to the number of interior points in r, z.\n");
 	printf("           [dr] and [dz] are floating point doubles equal to the spatial step in r, z.\n");
 	printf("           [nrobin] is an optional argument corresponding to Robin operator order: 1, 2, 3.\n");
+	printf("           [stretch] is an optional sinh map width for stretched r, z grids, uniform if 0.\n");
 	printf("Press (y/n) to procede with default arguments:\n");
 	opt = getchar();
 	getchar();
@@ -220,9 +228,71 @@ extern "C" void write_single_file_(const double *u, const char *fname, const int
 }
 #endif
 
+// Allocate nrows x ncols grid array with parallel first-touch.
+//
+// Pages are placed on the NUMA node of the thread that first writes them.
+// Rows are touched with the same static partition used by ghost_reduce,
+// ghost_fill and the CSR generators so that each thread later works on
+// local memory.
+double *grid_allocate(const int nrows, const int ncols)
+{
+	// Auxiliary integers.
+	int i, j;
+
+	// Allocate array.
+	double *x = (double *)malloc(sizeof(double) * nrows * ncols);
+
+	// First touch.
+	#pragma omp parallel shared(x) private(j)
+	{
+		#pragma omp for schedule(static)
+		for (i = 0; i < nrows; i++)
+		{
+			for (j = 0; j < ncols; j++)
+			{
+				x[i * ncols + j] = 0.0;
+			}
+		}
+	}
+
+	return x;
+}
+
+// Interleave pages allocated by the calling thread across all NUMA nodes.
+//
+// Used around PARDISO analysis and factorization, whose workspace is
+// allocated internally and shared by all threads. Requires -DNUMA and
+// libnuma, otherwise it does nothing.
+void numa_interleave_begin(void)
+{
+#ifdef NUMA
+	if (numa_available() != -1)
+		numa_set_interleave_mask(numa_all_nodes_ptr);
+#endif
+	return;
+}
+
+// Restore local NUMA allocation.
+void numa_interleave_end(void)
+{
+#ifdef NUMA
+	if (numa_available() != -1)
+		numa_set_localalloc();
+#endif
+	return;
+}
+
 // Create CSR matrix.
+//
+// Arrays are touched in parallel with a static row partition. The stencils
+// have nearly constant nonzeros per row, so row i owns the proportional
+// slice [i * nnz / nrows, (i + 1) * nnz / nrows) of a and ja.
 void csr_allocate(csr_matrix *A, const int nrows, const int ncols, const int nnz)
 {
+	// Auxiliary integers.
+	int i;
+	long k;
+
 	// Set integer parameters.
 	A->nrows = nrows;
 	A->ncols = ncols;
@@ -232,6 +302,22 @@ void csr_allocate(csr_matrix *A, const int nrows, const int ncols, const int nnz
 	A->ja = (int *)malloc(sizeof(int) * nnz);
 	A->ia = (int *)malloc(sizeof(int) * (nrows + 1));
 
+	// First touch.
+	#pragma omp parallel shared(A) private(k)
+	{
+		#pragma omp for schedule(static)
+		for (i = 0; i < nrows; i++)
+		{
+			A->ia[i] = 0;
+			for (k = (long)i * nnz / nrows; k < (long)(i + 1) * nnz / nrows; k++)
+			{
+				A->a[k] = 0.0;
+				A->ja[k] = 0;
+			}
+		}
+	}
+	A->ia[nrows] = 0;
+
 	return;
 }
 
@@ -16,15 +16,23 @@
 #define IDX(i, j) ((i) * NzTotal + (j))
 
 // MIN/MAX macros.
-#define MIN(X, Y) ((X) < (Y)) ? (X) : (Y)
-#define MAX(X, Y) ((X) > (Y)) ? (X) : (Y)
+#define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
 
 // ABS macro.
-#define ABS(X) ((X) < 0) ? -(X) : (X)
+#define ABS(X) (((X) < 0) ? -(X) : (X))
 
 // CSR matrix index base.
 #define BASE 1
 
+// Solver status codes: the failed PARDISO phase, or an unsupported
+// combination of arguments.
+#define ELL_SUCCESS 0
+#define ELL_ERROR_ANALYSIS 1
+#define ELL_ERROR_FACTOR 2
+#define ELL_ERROR_SOLVE 3
+#define ELL_ERROR_ARGUMENT 4
+
 // CSR matrix type.
 typedef struct csr_matrices
 {
@@ -37,6 +45,58 @@ typedef struct csr_matrices
 
 } csr_matrix;
 
+// Solver phases: NUM_PHASES sizes the hardware counters.
+#include "thread_profile.h"
+
+// Per-solve statistics type: filled by flat_laplacian and general_elliptic.
+typedef struct solver_statistics
+{
+	// Solver name: "flat" or "general".
+	const char *solver;
+	// Problem size and options.
+	int NrInterior;
+	int NzInterior;
+	int order;
+	int robin;
+	int nnz;
+	int lr_use;
+	int precond_use;
+	// Wall time per phase in seconds.
+	double t_reduce;
+	double t_assemble;
+	double t_analyse;
+	double t_factor;
+	double t_solve;
+	double t_residual;
+	double t_fill;
+	double t_coarse;	// Coarse grid solve of nested iteration.
+	double t_total;
+	// PARDISO outputs.
+	int factor_nnz;		// iparm(18): nonzeros in LU factors.
+	int factor_mflops;	// iparm(19): MFLOPs of factorization.
+	int mem_peak_analysis;	// iparm(15): peak memory in analysis (KB).
+	int mem_permanent;	// iparm(16): permanent memory after analysis (KB).
+	int mem_factor;		// iparm(17): memory of numerical factorization (KB).
+	int perturbed_pivots;	// iparm(14): number of perturbed pivots.
+	int cgs_iterations;	// iparm(20): CGS iterations, negative on failure.
+	int refinement_steps;	// iparm(7): iterative refinement steps.
+	int corrections;	// Deferred corrections with the second order LU.
+	int iterations;		// Mesh refinement composite grid, Schwarz GMRES, fallback GMRES or Newton iterations.
+	// Residual norms and convergence flag.
+	double abs_residual;
+	double rel_residual;
+	int convergence;
+	// Status code and fallback step that produced the solution, 0 if none.
+	int status;
+	int fallback;
+	// Richardson extrapolation.
+	double error_estimate;	// Maximum estimated discretization error.
+	// Hardware counters per phase (perf builds), in thread_profile.h order.
+	long long cycles[NUM_PHASES];
+	long long instructions[NUM_PHASES];
+	long long llc_misses[NUM_PHASES];
+} solver_stats;
+
 // Forward declarations.
 // 
 // Print help message.
@@ -45,6 +105,12 @@ void print_help(void);
 void make_directory_and_cd(const char *dirname);
 // Write simple ASCII 2D file.
 void write_single_file(const double *u, const char *fname, const int NrTotal, const int NzTotal);
+// Allocate nrows x ncols grid array with parallel first-touch.
+double *grid_allocate(const int nrows, const int ncols);
+// Interleave factor workspace across NUMA nodes (NUMA builds only).
+void numa_interleave_begin(void);
+// Restore local NUMA allocation.
+void numa_interleave_end(void);
 // Create CSR matrix.
 void csr_allocate(csr_matrix *A, const int nrows, const int ncols, const int nnz);
 // Destroy CSR matrx.